@@ -2,346 +2,110 @@
 
 #include "altsound.h"
 
-#include "altsound_data.hpp"
+#include "altsound_context.hpp"
 #include "altsound_ini_processor.hpp"
 #include "altsound_processor_base.hpp"
 #include "altsound_processor.hpp"
 #include "gsound_processor.hpp"
-#include "miniaudio_bass_compat.hpp"
-#include "miniaudio_private.h"
 
 #include <thread>
 #include <chrono>
 #include <atomic>
 #include <condition_variable>
-#include <unordered_map>
-
-StreamArray channel_stream;
-std::mutex io_mutex;
-BehaviorInfo music_behavior;
-BehaviorInfo callout_behavior;
-BehaviorInfo sfx_behavior;
-BehaviorInfo solo_behavior;
-BehaviorInfo overlay_behavior;
-AltsoundLogger alog;
-
-AltsoundProcessorBase* g_pProcessor = NULL;
-ALTSOUND_HARDWARE_GEN g_hardwareGen = ALTSOUND_HARDWARE_GEN_NONE;
-CmdData g_cmdData;
+#include <fstream>
 
-std::unordered_map<unsigned int, _internal_stream_data> g_streamMap;
-std::mutex g_streamMapMutex;
+AltsoundLogger alog;
 
-static AltSoundAudioCallback g_audioCallback = nullptr;
-static void* g_audioUserData = nullptr;
-static std::mutex g_audioMutex;
-uint32_t g_sampleRate = 44100;
-uint32_t g_channels = 2;
-uint32_t g_nextStreamId = 1;
-int g_last_ma_err = 0;
-ma_engine* g_engine = nullptr;
-ma_context* g_context = nullptr;
+// The instance driven by the AltSound*() API
+static AltSoundContext g_defaultContext;
 
-static uint32_t g_bufferSizeFrames = 256;
+static bool altsound_process_command(unsigned int cmd, int attenuation, uint64_t start_frame, void* user);
 
 /******************************************************
  * Audio mixing
  *
- * miniAudio owns the audio thread (a realtime-paced null device). Its engine
- * mixes every playing ma_sound (volume, channel conversion and resampling
- * included) and hands us the finished buffer through onProcess, which we just
- * forward to the host. miniAudio handles all timing, throttling and buffering.
+ * miniAudio owns the audio thread (a realtime-paced null device) and handles
+ * all timing, throttling and buffering. Each period, the context's mixer sums
+ * the playing voices into the device buffer, which we then forward to the
+ * host. Samples are decoded at the output rate, so mixing is only gain and sum.
  ******************************************************/
 
-static void AltsoundEngineProcess(void* pUserData, float* pFramesOut, ma_uint64 frameCount)
+static void AltsoundDeviceProcess(ma_device* pDevice, void* pOutput, const void* pInput, ma_uint32 frameCount)
 {
-    // Streams that just reached their end were queued by the miniAudio end
-    // callback. Fire their SYNCPROCs here (safe point, after the read), which
-    // frees the sounds and adjusts ducking.
-    std::vector<EndedStream> ended;
-    {
-        std::lock_guard<std::mutex> lock(g_endedMutex);
-        ended.swap(g_endedStreams);
+    AltSoundContext* ctx = static_cast<AltSoundContext*>(pDevice->pUserData);
+
+    ctx->trace.setThreadName("audio");
+    AltsoundTraceScope trace_scope(ctx->trace, "EngineProcess", "frames", static_cast<uint32_t>(frameCount));
+
+    float* pFramesOut = static_cast<float*>(pOutput);
+    ctx->mixer.mix(pFramesOut, frameCount);
+
+    // End-of-stream SYNCPROCs run on the housekeeping thread; this thread
+    // only hands the mixed buffer to the host.
+    // Announce the binding before using it, and confirm it is still current,
+    // so a setter never returns while its old binding is being called
+    const AudioCallbackBinding* binding = ctx->audio_binding.load();
+    for (;;) {
+        ctx->audio_binding_in_use.store(binding);
+        const AudioCallbackBinding* current = ctx->audio_binding.load();
+        if (current == binding)
+            break;
+        binding = current;
     }
 
-    for (const auto& e : ended)
-        e.callback(e.hsync, e.hstream, 0, e.userdata);
+    if (binding && binding->callback)
+        binding->callback(pFramesOut, static_cast<size_t>(frameCount), ctx->sample_rate, ctx->channels, binding->userData);
+
+    ctx->audio_binding_in_use.store(nullptr, std::memory_order_release);
+}
+
+// Publish a new host callback. Returns once the audio thread can no longer be
+// calling the previous one
+static void AltsoundPublishAudioCallback(AltSoundContext* ctx, AltSoundAudioCallback callback, void* userData)
+{
+	std::lock_guard<std::mutex> lock(ctx->audio_binding_mutex);
+
+	AudioCallbackBinding* binding = nullptr;
+	if (callback) {
+		binding = &ctx->audio_bindings[ctx->audio_binding_next];
+		binding->callback = callback;
+		binding->userData = userData;
+		ctx->audio_binding_next ^= 1;
+	}
 
-    std::lock_guard<std::mutex> lock(g_audioMutex);
-    if (g_audioCallback)
-        g_audioCallback(pFramesOut, static_cast<size_t>(frameCount), g_sampleRate, g_channels, g_audioUserData);
+	const AudioCallbackBinding* old = ctx->audio_binding.exchange(binding);
+	while (old && ctx->audio_binding_in_use.load() == old)
+		std::this_thread::yield();
 }
 
 /******************************************************
  * altsound_preprocess_commands
+ *
+ * Runs the hardware generation's preprocessing step for a new command byte
+ * and applies a ROM volume change it decoded
  ******************************************************/
 
-void altsound_preprocess_commands(int cmd)
+static void altsound_preprocess_commands(AltSoundContext* ctx, unsigned int cmd)
 {
-	ALT_DEBUG(0, "BEGIN altsound_preprocess_commands()");
-	ALT_INDENT;
-
-	ALT_DEBUG(0, "MAME_GEN: 0x%013x", (uint64_t)g_hardwareGen);
-
-	switch (g_hardwareGen) {
-		case ALTSOUND_HARDWARE_GEN_WPCDCS:
-		case ALTSOUND_HARDWARE_GEN_WPCSECURITY:
-		case ALTSOUND_HARDWARE_GEN_WPC95DCS:
-		case ALTSOUND_HARDWARE_GEN_WPC95: {
-			ALT_DEBUG(0, "Hardware Generation: WPCDCS, WPCSECURITY, WPC95DCS, WPC95");
-
-			// For future improvements, also check https://github.com/mjrgh/DCSExplorer/ for a lot of new info on the DCS inner workings
-
-			// E.g.: One more note on command processing: each byte of a command sequence must be received on the DCS side within 100ms of the previous byte.
-			//   The DCS software clears any buffered bytes if more than 100ms elapses between consecutive bytes.
-			//   This implies that a sender can wait a little longer than 100ms before sending the first byte of a new command if it wants to essentially reset the network connection,
-			//   ensuring that the DCS receiver doesn't think it's in the middle of some earlier partially-sent command sequence.
-
-			ALT_DEBUG(0, "Hardware Generation: GEN_WPCDCS, GEN_WPCSECURITY, GEN_WPC95DCS, GEN_WPC95");
-
-			if ((g_cmdData.cmd_buffer[3] == 0x55) && (g_cmdData.cmd_buffer[2] >= 0xAB) && (g_cmdData.cmd_buffer[2] <= 0xB0) && (g_cmdData.cmd_buffer[1] == (g_cmdData.cmd_buffer[0] ^ 0xFF))) // per-DCS-channel mixing level, but on our interpretation level we do not have any knowledge about the internal channel structures of DCS
-			{
-				ALT_DEBUG(0, "Change volume pc %u %u", g_cmdData.cmd_buffer[2], g_cmdData.cmd_buffer[1]);
-
-				for (int i = 0; i < ALT_MAX_CMDS; ++i)
-					g_cmdData.cmd_buffer[i] = ~0;
-
-				g_cmdData.cmd_counter = 0;
-				g_cmdData.cmd_filter = 1;
-			}
-			else
-			if ((g_cmdData.cmd_buffer[3] == 0x55) && (g_cmdData.cmd_buffer[2] == 0xC2)) // DCS software major version number
-			{
-				for (int i = 0; i < ALT_MAX_CMDS; ++i)
-					g_cmdData.cmd_buffer[i] = ~0;
-
-				g_cmdData.cmd_counter = 0;
-				g_cmdData.cmd_filter = 1;
-			}
-			else
-			if ((g_cmdData.cmd_buffer[3] == 0x55) && (g_cmdData.cmd_buffer[2] == 0xC3)) // DCS software minor version number
-			{
-				for (int i = 0; i < ALT_MAX_CMDS; ++i)
-					g_cmdData.cmd_buffer[i] = ~0;
-
-				g_cmdData.cmd_counter = 0;
-				g_cmdData.cmd_filter = 1;
-			}
-			else
-			if ((g_cmdData.cmd_buffer[3] == 0x55) && (g_cmdData.cmd_buffer[2] >= 0xBA) && (g_cmdData.cmd_buffer[2] <= 0xC1) && (g_cmdData.cmd_buffer[1] == (g_cmdData.cmd_buffer[0] ^ 0xFF))) // mystery command, see http://mjrnet.org/pinscape/dcsref/DCS_format_reference.html#SpecialCommands
-			{
-				for (int i = 0; i < ALT_MAX_CMDS; ++i)
-					g_cmdData.cmd_buffer[i] = ~0;
-
-				g_cmdData.cmd_counter = 0;
-				g_cmdData.cmd_filter = 1;
-			}
-			else
-			if (((g_cmdData.cmd_buffer[3] == 0x55) && (g_cmdData.cmd_buffer[2] == 0xAA))) { // change master volume?
-				// DAR@20240208 The check below is dangerous.  If this is still a
-				//              problem, it would be better to revisit it when it
-				//              reappears to implement a more robust solution that
-				//              works for all systems
-				//              See https://github.com/vpinball/pinmame/issues/220
-				// Maybe implementing the 'nothing happened in >100ms' reset queue (see above) would also resolve this??
-				//|| ((g_cmdData.cmd_buffer[2] == 0x00) && (g_cmdData.cmd_buffer[1] == 0x00) && (g_cmdData.cmd_buffer[0] == 0x00))) { // glitch in command buffer?
-				if ((g_cmdData.cmd_buffer[3] == 0x55) && (g_cmdData.cmd_buffer[2] == 0xAA) && (g_cmdData.cmd_buffer[1] == (g_cmdData.cmd_buffer[0] ^ 0xFF))) { // change volume op (following first byte = volume, second = ~volume, if these don't match: ignore)
-					if (g_pProcessor->romControlsVol()) {
-						//g_pProcessor->setGlobalVol(std::min((float)g_cmdData.cmd_buffer[1] / 127.f, 1.0f)); //!! input is 0..255 (or ..248 in practice? BUT at least MM triggers 255 at max volume in the menu) though, not just 0..127!
-						g_pProcessor->setGlobalVol((g_cmdData.cmd_buffer[1] == 0) ? 0.f : std::min(powf(0.981201f, (float)(255u - g_cmdData.cmd_buffer[1])) * 4.0f,1.0f)); //!! *4 is magic, similar to the *2 above
-						ALT_INFO(0, "Change volume %.02f (%u)", g_pProcessor->getGlobalVol(), g_cmdData.cmd_buffer[1]);
-					}
-				}
-				else
-					ALT_DEBUG(0, "Command filtered %02X %02X %02X %02X", g_cmdData.cmd_buffer[3], g_cmdData.cmd_buffer[2], g_cmdData.cmd_buffer[1], g_cmdData.cmd_buffer[0]);
-
-				for (int i = 0; i < ALT_MAX_CMDS; ++i)
-					g_cmdData.cmd_buffer[i] = ~0;
-
-				g_cmdData.cmd_counter = 0;
-				g_cmdData.cmd_filter = 1;
-			}
-			else
-				g_cmdData.cmd_filter = 0;
-
-			break;
-		}
-
-		case ALTSOUND_HARDWARE_GEN_WPCALPHA_2: //!! ?? test this gen actually
-		case ALTSOUND_HARDWARE_GEN_WPCDMD: // remaps everything to 16bit, a bit stupid maybe
-		case ALTSOUND_HARDWARE_GEN_WPCFLIPTRON: {
-			ALT_DEBUG(0, "Hardware Generation: WPCALPHA_2, WPCDMD, WPCFLIPTRON");
-
-			g_cmdData.cmd_filter = 0;
-			if ((g_cmdData.cmd_buffer[2] == 0x79) && (g_cmdData.cmd_buffer[1] == (g_cmdData.cmd_buffer[0] ^ 0xFF))) { // change volume op (following first byte = volume, second = ~volume, if these don't match: ignore)
-				if (g_pProcessor->romControlsVol()) {
-					g_pProcessor->setGlobalVol(std::min((float)g_cmdData.cmd_buffer[1] / 127.f, 1.0f));
-					ALT_INFO(0, "Change volume %.02f", g_pProcessor->getGlobalVol());
-				}
+	AltsoundCmdAction action;
+	ctx->cmd_decoder->preprocess(ctx->cmd_data, cmd, action);
 
-				for (int i = 0; i < ALT_MAX_CMDS; ++i)
-					g_cmdData.cmd_buffer[i] = ~0;
-
-				g_cmdData.cmd_counter = 0;
-				g_cmdData.cmd_filter = 1;
-			}
-			else if (g_cmdData.cmd_buffer[1] == 0x7A) { // 16bit command second part //!! TZ triggers a 0xFF in the beginning -> check sequence and filter?
-				g_cmdData.stored_command = g_cmdData.cmd_buffer[1];
-				g_cmdData.cmd_counter = 0;
-			}
-			else if (cmd != 0x7A) { // 8 bit command
-				g_cmdData.stored_command = 0;
-				g_cmdData.cmd_counter = 0;
-			}
-			else // 16bit command first part
-				g_cmdData.cmd_counter = 1;
-
-			break;
-		}
-
-		case ALTSOUND_HARDWARE_GEN_WPCALPHA_1: // remaps everything to 16bit, a bit stupid maybe //!! test all these generations!
-		case ALTSOUND_HARDWARE_GEN_S11:
-		case ALTSOUND_HARDWARE_GEN_S11X:
-		case ALTSOUND_HARDWARE_GEN_S11B2:
-		case ALTSOUND_HARDWARE_GEN_S11C: {
-			ALT_DEBUG(0, "Hardware Generation: WPCALPHA_1, S11, S11X, S11B2, S11C");
-
-			if (cmd != g_cmdData.cmd_buffer[1]) { //!! some stuff is doubled or tripled -> filter out?
-				g_cmdData.stored_command = 0; // 8 bit command //!! 7F & 7E opcodes?
-				g_cmdData.cmd_counter = 0;
-			}
-			else
-				g_cmdData.cmd_counter = 1;
-
-			break;
-		}
-
-		case ALTSOUND_HARDWARE_GEN_DEDMD16: // remaps everything to 16bit, a bit stupid maybe
-		case ALTSOUND_HARDWARE_GEN_DEDMD32:
-		case ALTSOUND_HARDWARE_GEN_DEDMD64:
-		case ALTSOUND_HARDWARE_GEN_DE: { // this one just tested with BTTF so far
-			ALT_DEBUG(0, "Hardware Generation: DEDMD16, DEDMD32, DEDMD64, DE");
-
-			if (cmd != 0xFF && cmd != 0x00) { // 8 bit command
-				g_cmdData.stored_command = 0;
-				g_cmdData.cmd_counter = 0;
-			}
-			else // ignore
-				g_cmdData.cmd_counter = 1;
-
-			if (g_cmdData.cmd_buffer[1] == 0x00 && cmd == 0x00) { // handle 0x0000 special //!! meh?
-				g_cmdData.stored_command = 0;
- 				g_cmdData.cmd_counter = 0;
-			}
-
-			break;
-		}
-
-		case ALTSOUND_HARDWARE_GEN_WS:
-		case ALTSOUND_HARDWARE_GEN_WS_1:
-		case ALTSOUND_HARDWARE_GEN_WS_2: {
-			ALT_DEBUG(0, "Hardware Generation: WS, WS_1, WS_2");
-
-			g_cmdData.cmd_filter = 0;
-			if (g_cmdData.cmd_buffer[1] == 0xFE) {
-				if (cmd >= 0x10 && cmd <= 0x2F) {
-					if (g_pProcessor->romControlsVol()) {
-						g_pProcessor->setGlobalVol((float)(0x2F - cmd) / 31.f);
-						ALT_INFO(0, "Change volume %.02f", g_pProcessor->getGlobalVol());
-					}
-
-					for (int i = 0; i < ALT_MAX_CMDS; ++i)
-						g_cmdData.cmd_buffer[i] = ~0;
-
-					g_cmdData.cmd_counter = 0;
-					g_cmdData.cmd_filter = 1;
-				}
-				else if (cmd >= 0x01 && cmd <= 0x0F) { // ignore FE 01 ... FE 0F
-					g_cmdData.stored_command = 0;
-					g_cmdData.cmd_counter = 0;
-					g_cmdData.cmd_filter = 1;
-				}
-			}
-
-			if ((cmd & 0xFC) == 0xFC) // start byte of a command will ALWAYS be FF, FE, FD, FC, and never the second byte!
-				g_cmdData.cmd_counter = 1;
-
-			break;
-		}
-
-		// DAR@20240207 Seems to be 8-bit commands
-		case ALTSOUND_HARDWARE_GEN_GTS80/*A*/: {  // Gottlieb System 80A
-			ALT_DEBUG(0, "Hardware Generation: GTS80A");
-
-			// DAR@29249297 It appears that this system sends 0x00 commands as a clock
-			//              signal, since we recieve a ridiculous number of them.
-			//              Filter them out
-			if (cmd == 0x00) { // handle 0x00
-				g_cmdData.stored_command = 0;
-				g_cmdData.cmd_counter = 0;
-				g_cmdData.cmd_filter = 1;
-			}
-			else {
-				g_cmdData.stored_command = 0;
-				g_cmdData.cmd_counter = 0;
-				g_cmdData.cmd_filter = 0;
-			}
-
-			break;
-		}
-
-		default: break;
+	if (action.set_volume && ctx->processor->romControlsVol()) {
+		ctx->processor->setGlobalVol(action.volume);
+		ALT_INFO(0, "Change volume %.02f (%u)", ctx->processor->getGlobalVol(), action.raw);
 	}
-
-	ALT_OUTDENT;
-	ALT_DEBUG(0, "END altsound_preprocess_commands()");
 }
 
 /******************************************************
  * altsound_postprocess_commands
  ******************************************************/
 
-void altsound_postprocess_commands(const unsigned int combined_cmd)
+static void altsound_postprocess_commands(AltSoundContext* ctx, const unsigned int combined_cmd)
 {
-	ALT_DEBUG(0, "BEGIN altsound_postprocess_commands()");
-	ALT_INDENT;
-
-	ALT_DEBUG(0, "MAME_GEN: 0x%013x", (uint64_t)g_hardwareGen);
-
-	switch (g_hardwareGen) {
-		case ALTSOUND_HARDWARE_GEN_WPCDCS:
-		case ALTSOUND_HARDWARE_GEN_WPCSECURITY:
-		case ALTSOUND_HARDWARE_GEN_WPC95DCS:
-		case ALTSOUND_HARDWARE_GEN_WPC95:
-			if (combined_cmd == 0x03E3) { // stop music
-				ALT_INFO(0, "Stopping MUSIC(2)");
-				g_pProcessor->stopMusic();
-			}
-			break;
-
-		//!! old WPC machines music stop? -> 0x00 for SYS11?
-
-		case ALTSOUND_HARDWARE_GEN_DEDMD32:
-			if ((combined_cmd == 0x0018 || combined_cmd == 0x0023)) { // stop music //!! ???? 0x0019??
-				ALT_INFO(0, "Stopping MUSIC(3)");
-				g_pProcessor->stopMusic();
-			}
-			break;
-
-		case ALTSOUND_HARDWARE_GEN_WS:
-		case ALTSOUND_HARDWARE_GEN_WS_1:
-		case ALTSOUND_HARDWARE_GEN_WS_2:
-			if (((combined_cmd == 0x0000 || (combined_cmd & 0xf0ff) == 0xf000))) { // stop music
-				ALT_INFO(0, "Stopping MUSIC(4)");
-				g_pProcessor->stopMusic();
-			}
-			break;
-
-		default: break;
+	if (ctx->cmd_decoder->stops_music(combined_cmd)) {
+		ALT_INFO(0, "Stopping %s", ctx->cmd_decoder->stop_music_label);
+		ctx->processor->stopMusic();
 	}
-
-	ALT_OUTDENT;
-	ALT_DEBUG(0, "END postprocess_commands()");
 }
 
 /******************************************************
@@ -356,42 +120,72 @@ ALTSOUNDAPI void AltSoundSetLogger(const string& logPath, ALTSOUND_LOG_LEVEL log
 }
 
 /******************************************************
- * AltSoundInit
+ * altsound_init_cleanup
+ *
+ * Releases what a failed AltSoundContextInit() set up,
+ * so the context can be initialized again
  ******************************************************/
 
-ALTSOUNDAPI bool AltSoundInit(const string& pinmamePath, const string& gameName,
+static void altsound_init_cleanup(AltSoundContext* ctx)
+{
+	delete ctx->processor;
+	ctx->processor = NULL;
+
+	ctx->sample_pack.close();
+
+	if (ctx->device) {
+		altsound_ma_device_uninit(ctx->device);
+		delete ctx->device;
+		ctx->device = nullptr;
+	}
+
+	if (ctx->context) {
+		altsound_ma_context_uninit(ctx->context);
+		delete ctx->context;
+		ctx->context = nullptr;
+	}
+}
+
+/******************************************************
+ * AltSoundContextInit
+ ******************************************************/
+
+ALTSOUNDAPI bool AltSoundContextInit(AltSoundContext* ctx, const string& pinmamePath, const string& gameName,
                               uint32_t sampleRate, uint32_t channels, uint32_t bufferSizeFrames)
 {
-	ALT_DEBUG(0, "BEGIN AltSoundInit()");
+	ALT_DEBUG(0, "BEGIN AltSoundContextInit()");
 	ALT_INDENT;
 
-	if (g_pProcessor) {
+	if (ctx->processor) {
 		ALT_ERROR(0, "Processor already defined");
 		ALT_OUTDENT;
-		ALT_DEBUG(0, "END AltSoundInit()");
+		ALT_DEBUG(0, "END AltSoundContextInit()");
 		return false;
 	}
 
-	g_sampleRate = sampleRate;
-	g_channels = channels;
-	g_bufferSizeFrames = bufferSizeFrames;
-
-	g_engine = new ma_engine();
-	g_context = new ma_context();
-	if (altsound_ma_engine_init_null_device(g_channels, g_sampleRate, g_bufferSizeFrames,
-			AltsoundEngineProcess, nullptr, g_context, g_engine) != MA_SUCCESS) {
-		ALT_ERROR(0, "FAILED to initialize miniAudio engine");
-		delete g_engine;
-		g_engine = nullptr;
-		delete g_context;
-		g_context = nullptr;
-		ALT_OUTDENT;
-		ALT_DEBUG(0, "END AltSoundInit()");
-		return false;
+	ctx->sample_rate = sampleRate;
+	ctx->channels = channels;
+	ctx->buffer_size_frames = bufferSizeFrames;
+
+	// the host drives mixing through AltSoundRender() in pull and offline mode
+	if (ctx->render_mode == ALTSOUND_RENDER_MODE_CALLBACK) {
+		ctx->context = new ma_context();
+		ctx->device = new ma_device();
+		if (altsound_ma_device_init_null(ctx->channels, ctx->sample_rate, ctx->buffer_size_frames,
+			AltsoundDeviceProcess, ctx, ctx->context, ctx->device) != MA_SUCCESS) {
+			ALT_ERROR(0, "FAILED to initialize miniAudio device");
+			delete ctx->device;
+			ctx->device = nullptr;
+			delete ctx->context;
+			ctx->context = nullptr;
+			ALT_OUTDENT;
+			ALT_DEBUG(0, "END AltSoundContextInit()");
+			return false;
+		}
 	}
 
-	// initialize channel_stream storage
-	std::fill(channel_stream.begin(), channel_stream.end(), nullptr);
+	static const char* const render_modes[] = { "callback", "pull", "offline" };
+	ALT_INFO(0, "Render mode: %s", render_modes[ctx->render_mode]);
 
 	string szPinmamePath = pinmamePath;
 
@@ -407,120 +201,322 @@ ALTSOUNDAPI bool AltSoundInit(const string& pinmamePath, const string& gameName,
 	if (!ini_proc.parse_altsound_ini(szAltSoundPath)) {
 		// Error message and return
 		ALT_ERROR(0, "Failed to parse_altsound_ini(%s)", szAltSoundPath.c_str());
+		altsound_init_cleanup(ctx);
 		ALT_OUTDENT;
-		ALT_DEBUG(0, "END AltSoundInit()");
+		ALT_DEBUG(0, "END AltSoundContextInit()");
 		return false;
 	}
 
+	// the logger is process-wide, so only the default context takes its level
+	// from altsound.ini; other contexts leave it to AltSoundSetLogger()
+	if (ctx == &g_defaultContext)
+		alog.setLogLevel(ini_proc.getLogLevel());
+
 	string format = ini_proc.getAltsoundFormat();
 
+	// a single-file sample pack replaces the loose sample files
+	const string pack_path = szAltSoundPath + ALTPACK_FILENAME;
+	if (std::ifstream(pack_path).good() && ctx->sample_pack.open(pack_path)) {
+		if (ctx->sample_pack.getFormat() != format) {
+			ALT_ERROR(0, "Sample pack format (%s) does not match altsound.ini format (%s). Ignoring pack",
+			          ctx->sample_pack.getFormat().c_str(), format.c_str());
+			ctx->sample_pack.close();
+		}
+	}
+
 	if (format == "g-sound") {
 		// G-Sound only supports new CSV format. No need to specify format
 		// in the constructor
-		g_pProcessor = new GSoundProcessor(gameName, szPinmamePath);
+		ctx->processor = new GSoundProcessor(*ctx, ini_proc, gameName, szPinmamePath);
 	}
 	else if (format == "altsound" || format == "legacy") {
-		g_pProcessor = new AltsoundProcessor(gameName, szPinmamePath, format);
+		ctx->processor = new AltsoundProcessor(*ctx, gameName, szPinmamePath, format);
 	}
 	else {
 		ALT_ERROR(0, "Unknown AltSound format: %s", format.c_str());
+		altsound_init_cleanup(ctx);
 		ALT_OUTDENT;
-		ALT_DEBUG(0, "END AltSoundInit()");
+		ALT_DEBUG(0, "END AltSoundContextInit()");
 		return false;
 	}
 
-	if (!g_pProcessor) {
+	if (!ctx->processor) {
 		ALT_ERROR(0, "FAILED: Unable to create AltSound Processor");
+		altsound_init_cleanup(ctx);
 		ALT_OUTDENT;
-		ALT_DEBUG(0, "END AltSoundInit()");
+		ALT_DEBUG(0, "END AltSoundContextInit()");
 		return false;
 	}
 
 	ALT_INFO(0, "%s processor created", format.c_str());
 
-	g_pProcessor->setMasterVol(1.0f);
-	g_pProcessor->setGlobalVol(1.0f);
-	g_pProcessor->romControlsVol(ini_proc.usingRomVolumeControl());
-	g_pProcessor->recordSoundCmds(ini_proc.recordSoundCmds());
-	g_pProcessor->setSkipCount(ini_proc.getSkipCount());
+	ctx->processor->setMasterVol(1.0f);
+	ctx->processor->setGlobalVol(1.0f);
+	ctx->processor->romControlsVol(ini_proc.usingRomVolumeControl());
+	ctx->processor->recordSoundCmds(ini_proc.recordSoundCmds());
+	ctx->processor->setSkipCount(ini_proc.getSkipCount());
+
+	// one channel per voice, each holding at most one stream
+	const AltsoundVoicePolicy& voice_policy = ini_proc.getVoicePolicy();
+	ctx->processor->setVoicePolicy(voice_policy);
+	ctx->channel_stream.init(voice_policy.voices, ctx->stream_info_pool);
+	ALT_INFO(0, "Voices: %u, steal policy: %s, fade: %u ms", voice_policy.voices,
+	         toString(voice_policy.steal), voice_policy.fade_ms);
+
+	ctx->sample_cache.setBudget(static_cast<size_t>(ini_proc.getSampleCacheMB()) * 1024 * 1024);
+	ALT_INFO(0, "Sample cache budget: %u MB", ini_proc.getSampleCacheMB());
+
+	// samples entering the cache are converted to the output rate once
+	ctx->resample_quality = ini_proc.getResampleQuality();
+	ALT_INFO(0, "Resample quality: %s", altsound_resample_quality_name(ctx->resample_quality));
+
+	// preallocate voice objects so sound commands don't hit the heap
+	ctx->stream_info_pool.reserve(voice_policy.voices + ALT_VOICE_POOL_HEADROOM);
+	MiniAudio_VoicePoolInit(*ctx, voice_policy.voices + ALT_VOICE_POOL_HEADROOM);
+	ALT_INFO(0, "Mixer kernels: %s", ctx->mixer.getKernelName());
+
+	// long samples are decoded ahead of the audio thread. Offline rendering
+	// has no deadline to miss, so it decodes them while mixing
+	ctx->read_ahead_threshold_ms = ini_proc.getReadAheadThresholdMs();
+	if (ctx->read_ahead_threshold_ms > 0 && ctx->render_mode != ALTSOUND_RENDER_MODE_OFFLINE) {
+		ctx->read_ahead.start(ctx->sample_rate, ini_proc.getReadAheadBufferMs(), voice_policy.voices + ALT_VOICE_POOL_HEADROOM);
+		ALT_INFO(0, "Read-ahead: samples over %u ms, %u ms buffers", ctx->read_ahead_threshold_ms, ini_proc.getReadAheadBufferMs());
+	}
+
+	// record events on all threads before any of them start
+	if (ini_proc.traceEvents()) {
+		ctx->trace_path = szAltSoundPath + "altsound_trace.json";
+		ctx->trace.start();
+		ALT_INFO(0, "Event tracing enabled: %s", ctx->trace_path.c_str());
+	}
+
+	// runs end-of-stream SYNCPROCs off the audio thread. Offline rendering
+	// runs them from AltSoundRender() instead
+	ctx->housekeeper.start(ctx->render_mode != ALTSOUND_RENDER_MODE_OFFLINE);
+
+	// pipeline latency histograms cover this session only
+	ctx->metrics.reset();
 
 	// perform processor initialization (load samples, etc)
-	g_pProcessor->init();
+	ctx->processor->init();
+
+	// decode the sample table into the cache in the background
+	if (ini_proc.preloadSamples() && ctx->sample_cache.getBudget() > 0) {
+		ctx->preloader.start(ctx->processor->getPreloadItems(), ini_proc.getPreloadThreads());
+		ALT_INFO(0, "Preloading %u samples", ctx->preloader.getTotalCount());
+	}
 
-	g_cmdData.cmd_counter = 0;
-	g_cmdData.stored_command = -1;
-	g_cmdData.cmd_filter = 0;
-	std::fill_n(g_cmdData.cmd_buffer, ALT_MAX_CMDS, ~0);
+	// timestamped commands start their sounds this far behind emulator time.
+	// Anything under two periods would start late on the audio thread
+	ctx->schedule_latency_frames = std::max<uint64_t>(
+		static_cast<uint64_t>(ini_proc.getScheduleLatencyMs()) * ctx->sample_rate / 1000,
+		2 * static_cast<uint64_t>(ctx->buffer_size_frames));
+	ctx->schedule_clock = ScheduleClock();
+	ALT_INFO(0, "Schedule latency: %u frames", static_cast<unsigned int>(ctx->schedule_latency_frames));
+
+	ctx->cmd_data.cmd_counter = 0;
+	ctx->cmd_data.stored_command = -1;
+	ctx->cmd_data.cmd_filter = 0;
+	std::fill_n(ctx->cmd_data.cmd_buffer, ALT_MAX_CMDS, ~0);
+
+	if (ctx->render_mode == ALTSOUND_RENDER_MODE_CALLBACK)
+		altsound_ma_device_start(ctx->device);
+	else
+		ctx->render_enabled.store(true);
+
+	// run the command pipeline on a worker, so the emulator only queues.
+	// Offline rendering needs commands applied at exact frame positions
+	if (ini_proc.asyncCommands() && ctx->render_mode == ALTSOUND_RENDER_MODE_OFFLINE) {
+		ALT_INFO(0, "Asynchronous command processing is disabled for offline rendering");
+	}
+	else if (ini_proc.asyncCommands()) {
+		ctx->cmd_queue.start(altsound_process_command, ctx);
+		ALT_INFO(0, "Asynchronous command processing enabled");
+	}
 
-	altsound_ma_engine_start(g_engine);
+	ctx->initialized = true;
 
-	ALT_DEBUG(0, "END AltSoundInit()");
+	ALT_DEBUG(0, "END AltSoundContextInit()");
 	return true;
 }
 
 /******************************************************
- * AltSoundProcessCommand
+ * AltSoundContextSetRenderMode
  ******************************************************/
 
-ALTSOUNDAPI void AltSoundSetHardwareGen(ALTSOUND_HARDWARE_GEN hardwareGen)
+ALTSOUNDAPI void AltSoundContextSetRenderMode(AltSoundContext* ctx, ALTSOUND_RENDER_MODE mode)
+{
+	ALT_DEBUG(0, "BEGIN AltSoundContextSetRenderMode()");
+	ALT_INDENT;
+
+	// the audio thread is created for a render mode in AltSoundContextInit()
+	if (ctx->initialized) {
+		ALT_ERROR(0, "Render mode must be set before AltSoundContextInit()");
+	}
+	else {
+		ctx->render_mode = mode;
+	}
+
+	ALT_OUTDENT;
+	ALT_DEBUG(0, "END AltSoundContextSetRenderMode()");
+}
+
+/******************************************************
+ * AltSoundContextSetHardwareGen
+ ******************************************************/
+
+ALTSOUNDAPI void AltSoundContextSetHardwareGen(AltSoundContext* ctx, ALTSOUND_HARDWARE_GEN hardwareGen)
 {
-	ALT_DEBUG(0, "BEGIN AltSoundSetHardwareGen()");
+	ALT_DEBUG(0, "BEGIN AltSoundContextSetHardwareGen()");
 	ALT_INDENT;
 
-	g_hardwareGen = hardwareGen;
+	ctx->hardware_gen = hardwareGen;
+
+	// select the preprocessing once, so the per-command path does not
+	// switch on the generation
+	ctx->cmd_decoder = &altsound_find_cmd_decoder(hardwareGen);
 
-	ALT_DEBUG(0, "MAME_GEN: 0x%013x", (uint64_t)g_hardwareGen);
+	ALT_DEBUG(0, "MAME_GEN: 0x%013x", (uint64_t)ctx->hardware_gen);
+	ALT_DEBUG(0, "Command decoder: %s", ctx->cmd_decoder->name);
 
 	ALT_OUTDENT;
-	ALT_DEBUG(0, "END AltSoundSetHardwareGen()");
+	ALT_DEBUG(0, "END AltSoundContextSetHardwareGen()");
 }
 
 /******************************************************
- * AltSoundSetAudioCallback
+ * AltSoundContextSetAudioCallback
  ******************************************************/
 
-ALTSOUNDAPI void AltSoundSetAudioCallback(AltSoundAudioCallback callback, void* userData)
+ALTSOUNDAPI void AltSoundContextSetAudioCallback(AltSoundContext* ctx, AltSoundAudioCallback callback, void* userData)
 {
-	ALT_DEBUG(0, "BEGIN AltSoundSetAudioCallback()");
+	ALT_DEBUG(0, "BEGIN AltSoundContextSetAudioCallback()");
 	ALT_INDENT;
 
-	std::lock_guard<std::mutex> lock(g_audioMutex);
-	g_audioCallback = callback;
-	g_audioUserData = userData;
+	AltsoundPublishAudioCallback(ctx, callback, userData);
 
 	ALT_DEBUG(0, "Audio callback %s", callback ? "set" : "cleared");
 
 	ALT_OUTDENT;
-	ALT_DEBUG(0, "END AltSoundSetAudioCallback()");
+	ALT_DEBUG(0, "END AltSoundContextSetAudioCallback()");
 }
 
 /******************************************************
- * AltSoundProcessCommand
+ * AltSoundContextRender
+ *
+ * Pull and offline modes only: mixes frameCount frames of
+ * interleaved float output (at the rate and channel count
+ * passed to AltSoundInit) into out.  Returns the number of
+ * frames mixed; the rest of out is zeroed.  In pull mode it
+ * is meant to be called from the host's audio callback, and
+ * never blocks.  In offline mode, streams that ended during
+ * the block are handled before returning, so output only
+ * depends on the commands and where they were injected
  ******************************************************/
 
-ALTSOUNDAPI bool AltSoundProcessCommand(const unsigned int cmd, int attenuation)
+ALTSOUNDAPI size_t AltSoundContextRender(AltSoundContext* ctx, float* out, size_t frameCount)
+{
+	if (!out || frameCount == 0)
+		return 0;
+
+	ctx->trace.setThreadName("host audio");
+	AltsoundTraceScope trace_scope(ctx->trace, "Render", "frames", static_cast<uint32_t>(frameCount));
+
+	size_t frames_read = 0;
+
+	ctx->render_in_flight.store(true);
+	if (ctx->render_enabled.load()) {
+		ctx->mixer.mix(out, frameCount);
+		frames_read = frameCount;
+	}
+	ctx->render_in_flight.store(false);
+
+	if (ctx->render_mode == ALTSOUND_RENDER_MODE_OFFLINE)
+		ctx->housekeeper.dispatch();
+
+	if (frames_read < frameCount)
+		std::fill(out + frames_read * ctx->channels, out + frameCount * ctx->channels, 0.0f);
+
+	return frames_read;
+}
+
+/******************************************************
+ * altsound_schedule_frame
+ *
+ * Maps emulator time to the mixer frame the sounds of
+ * a command start at.  The first command anchors its
+ * time to the current mixer time plus the scheduling
+ * latency, and later commands keep their spacing in
+ * emulator time.  The clock re-anchors when a start
+ * would fall within a period of the mixer time (the
+ * emulator fell behind), more than twice the latency
+ * ahead of it (the emulator ran ahead) or when
+ * emulator time goes backwards (reset)
+ ******************************************************/
+
+static uint64_t altsound_schedule_frame(AltSoundContext* ctx, uint64_t emu_time_ns)
 {
+	ScheduleClock& clock = ctx->schedule_clock;
+	const uint64_t now = ctx->mixer.getTime();
+
+	if (clock.anchored && emu_time_ns >= clock.emu_ns) {
+		const uint64_t delta_ns = emu_time_ns - clock.emu_ns;
+		const uint64_t frame = clock.frame + delta_ns / 1000000000 * ctx->sample_rate
+		                     + delta_ns % 1000000000 * ctx->sample_rate / 1000000000;
+
+		if (frame >= now + ctx->buffer_size_frames && frame <= now + 2 * ctx->schedule_latency_frames)
+			return frame;
+
+		ALT_DEBUG(0, "Schedule clock drifted by %lld frames. Re-anchoring",
+		          static_cast<long long>(frame - (now + ctx->schedule_latency_frames)));
+	}
+
+	clock.anchored = true;
+	clock.emu_ns = emu_time_ns;
+	clock.frame = now + ctx->schedule_latency_frames;
+	return clock.frame;
+}
+
+/******************************************************
+ * altsound_process_command
+ *
+ * Runs one command through the pipeline: attenuation,
+ * preprocessing, handleCmd and postprocessing.  Called
+ * directly by AltSoundProcessCommand(At), or from the
+ * command queue worker in asynchronous mode.  Streams
+ * the command starts begin at start_frame, or at once
+ * when it is 0
+ ******************************************************/
+
+static bool altsound_process_command(unsigned int cmd, int attenuation, uint64_t start_frame, void* user)
+{
+	AltSoundContext* ctx = static_cast<AltSoundContext*>(user);
+
 	ALT_DEBUG(0, "BEGIN AltSoundProcessCommand()");
 
-	float master_vol = g_pProcessor->getMasterVol();
+	AltsoundStageTimer command_timer(ctx->metrics, ALTSOUND_STAGE_COMMAND);
+	AltsoundTraceScope trace_scope(ctx->trace, "ProcessCommand", "cmd", cmd);
+
+	float master_vol = ctx->processor->getMasterVol();
 	while (attenuation++ < 0) {
 		master_vol /= 1.122018454f; // = (10 ^ (1/20)) = 1dB
 	}
-	g_pProcessor->setMasterVol(master_vol);
+	ctx->processor->setMasterVol(master_vol);
 	ALT_DEBUG(0, "Master Volume (Post Attenuation): %.02f", master_vol);
 
-	g_cmdData.cmd_counter++;
+	ctx->cmd_data.cmd_counter++;
 
 	//Shift all commands up to free up slot 0
 	for (int i = ALT_MAX_CMDS - 1; i > 0; --i)
-		g_cmdData.cmd_buffer[i] = g_cmdData.cmd_buffer[i - 1];
+		ctx->cmd_data.cmd_buffer[i] = ctx->cmd_data.cmd_buffer[i - 1];
 
-	g_cmdData.cmd_buffer[0] = cmd; //add command to slot 0
+	ctx->cmd_data.cmd_buffer[0] = cmd; //add command to slot 0
 
 	// pre-process commands based on ROM hardware platform
-	altsound_preprocess_commands(cmd);
+	const uint64_t preprocess_start = AltsoundMetrics::now();
+	altsound_preprocess_commands(ctx, cmd);
+	ctx->metrics.recordSince(ALTSOUND_STAGE_PREPROCESS, preprocess_start);
 
-	if (g_cmdData.cmd_filter || (g_cmdData.cmd_counter & 1) != 0) {
+	if (ctx->cmd_data.cmd_filter || (ctx->cmd_data.cmd_counter & 1) != 0) {
 		// Some commands are 16-bits collected from two 8-bit commands.  If
 		// the command is filtered or we have not received enough data yet,
 		// try again on the next command
@@ -531,13 +527,13 @@ ALTSOUNDAPI bool AltSoundProcessCommand(const unsigned int cmd, int attenuation)
 		// bookkeeping
 
 		// Store the command for accumulation
-		g_cmdData.stored_command = cmd;
+		ctx->cmd_data.stored_command = cmd;
 
-		if (g_cmdData.cmd_filter) {
+		if (ctx->cmd_data.cmd_filter) {
 			ALT_DEBUG(0, "Command filtered: %04X", cmd);
 		}
 
-		if ((g_cmdData.cmd_counter & 1) != 0) {
+		if ((ctx->cmd_data.cmd_counter & 1) != 0) {
 			ALT_DEBUG(0, "Command incomplete: %04X", cmd);
 		}
 
@@ -548,13 +544,17 @@ ALTSOUNDAPI bool AltSoundProcessCommand(const unsigned int cmd, int attenuation)
 	ALT_DEBUG(0, "Command complete. Processing...");
 
 	// combine stored command with the current
-	const unsigned int cmd_combined = (g_cmdData.stored_command << 8) | cmd;
+	const unsigned int cmd_combined = (ctx->cmd_data.stored_command << 8) | cmd;
 
 	// Handle the resulting command
-	if (!ALT_CALL(g_pProcessor->handleCmd(cmd_combined))) {
+	MiniAudio_SetStreamStartTime(*ctx, start_frame);
+	const bool handled = ALT_CALL(ctx->processor->handleCmd(cmd_combined));
+	MiniAudio_SetStreamStartTime(*ctx, 0);
+
+	if (!handled) {
 		ALT_WARNING(0, "FAILED processor::handleCmd()");
 
-		altsound_postprocess_commands(cmd_combined);
+		altsound_postprocess_commands(ctx, cmd_combined);
 
 		ALT_OUTDENT;
 		ALT_DEBUG(0, "END alt_sound_handle()");
@@ -562,7 +562,7 @@ ALTSOUNDAPI bool AltSoundProcessCommand(const unsigned int cmd, int attenuation)
 	}
 	ALT_INFO(0, "SUCCESS processor::handleCmd()");
 
-	altsound_postprocess_commands(cmd_combined);
+	altsound_postprocess_commands(ctx, cmd_combined);
 
 	ALT_OUTDENT;
 	ALT_DEBUG(0, "END AltSoundProcessCommand()");
@@ -572,24 +572,68 @@ ALTSOUNDAPI bool AltSoundProcessCommand(const unsigned int cmd, int attenuation)
 }
 
 /******************************************************
- * AltSoundPause
+ * AltSoundContextProcessCommand
  ******************************************************/
 
-ALTSOUNDAPI void AltSoundPause(bool pause)
+ALTSOUNDAPI bool AltSoundContextProcessCommand(AltSoundContext* ctx, const unsigned int cmd, int attenuation)
+{
+	// no processor if AltSoundContextInit() failed or was never called
+	if (!ctx->processor)
+		return false;
+
+	ctx->trace.setThreadName("emulator");
+
+	if (ctx->cmd_queue.isRunning()) {
+		ctx->trace.instant("QueueCommand", "cmd", cmd);
+		return ctx->cmd_queue.post(cmd, attenuation);
+	}
+
+	return altsound_process_command(cmd, attenuation, 0, ctx);
+}
+
+/******************************************************
+ * AltSoundContextProcessCommandAt
+ ******************************************************/
+
+ALTSOUNDAPI bool AltSoundContextProcessCommandAt(AltSoundContext* ctx, const unsigned int cmd, int attenuation, uint64_t emuTimeNs)
+{
+	if (!ctx->processor)
+		return false;
+
+	ctx->trace.setThreadName("emulator");
+
+	const uint64_t start_frame = altsound_schedule_frame(ctx, emuTimeNs);
+
+	if (ctx->cmd_queue.isRunning()) {
+		ctx->trace.instant("QueueCommand", "cmd", cmd);
+		return ctx->cmd_queue.post(cmd, attenuation, start_frame);
+	}
+
+	return altsound_process_command(cmd, attenuation, start_frame, ctx);
+}
+
+/******************************************************
+ * AltSoundContextPause
+ ******************************************************/
+
+ALTSOUNDAPI void AltSoundContextPause(AltSoundContext* ctx, bool pause)
 {
-	ALT_DEBUG(0, "BEGIN alt_sound_pause()");
+	ALT_DEBUG(0, "BEGIN AltSoundContextPause()");
 	ALT_INDENT;
 
+	// stream handles are only modified under ctx->io_mutex
+	std::lock_guard<std::mutex> guard(ctx->io_mutex);
+
 	if (pause) {
 		ALT_INFO(0, "Pausing stream playback (ALL)");
 
 		// Pause all channels
-		for (int i = 0; i < ALT_MAX_CHANNELS; ++i) {
-			if (!channel_stream[i])
+		for (size_t i = 0; i < ctx->channel_stream.size(); ++i) {
+			if (!ctx->channel_stream[i])
 				continue;
 
-			if (MiniAudio_ChannelPause(channel_stream[i]->hstream)) {
-				ALT_INFO(0, "SUCCESS: Paused stream %u", channel_stream[i]->hstream);
+			if (MiniAudio_ChannelPause(*ctx, ctx->channel_stream[i]->hstream)) {
+				ALT_INFO(0, "SUCCESS: Paused stream %u", ctx->channel_stream[i]->hstream);
 			}
 		}
 	}
@@ -597,63 +641,326 @@ ALTSOUNDAPI void AltSoundPause(bool pause)
 		ALT_INFO(0, "Resuming stream playback (ALL)");
 
 		// Resume all channels
-		for (int i = 0; i < ALT_MAX_CHANNELS; ++i) {
-			if (!channel_stream[i])
+		for (size_t i = 0; i < ctx->channel_stream.size(); ++i) {
+			if (!ctx->channel_stream[i])
 				continue;
 
-			if (MiniAudio_ChannelPlay(channel_stream[i]->hstream, false)) {
-				ALT_INFO(0, "SUCCESS: Resumed stream %u", channel_stream[i]->hstream);
+			if (MiniAudio_ChannelPlay(*ctx, ctx->channel_stream[i]->hstream, false)) {
+				ALT_INFO(0, "SUCCESS: Resumed stream %u", ctx->channel_stream[i]->hstream);
 			}
 		}
 	}
 
 	ALT_OUTDENT;
-	ALT_DEBUG(0, "END alt_sound_pause()");
+	ALT_DEBUG(0, "END AltSoundContextPause()");
 }
 
 /******************************************************
- * AltSoundShutdown
+ * AltSoundContextGetPreloadProgress
  ******************************************************/
 
-ALTSOUNDAPI void AltSoundShutdown()
+ALTSOUNDAPI bool AltSoundContextGetPreloadProgress(AltSoundContext* ctx, uint32_t& done, uint32_t& total)
+{
+	done = ctx->preloader.getDoneCount();
+	total = ctx->preloader.getTotalCount();
+	return done >= total;
+}
+
+/******************************************************
+ * AltSoundContextGetCommandQueueStats
+ ******************************************************/
+
+ALTSOUNDAPI bool AltSoundContextGetCommandQueueStats(AltSoundContext* ctx, uint32_t& depth, uint32_t& maxDepth, uint64_t& maxLatencyUs, uint64_t& overflows)
 {
-	ALT_DEBUG(0, "BEGIN AltSoundShutdown()");
+	const CommandQueueStats stats = ctx->cmd_queue.getStats();
+	depth = stats.depth;
+	maxDepth = stats.max_depth;
+	maxLatencyUs = stats.max_latency_ns / 1000;
+	overflows = stats.overflows;
+	return ctx->cmd_queue.isRunning();
+}
+
+/******************************************************
+ * AltSoundContextGetVoiceStats
+ ******************************************************/
+
+ALTSOUNDAPI bool AltSoundContextGetVoiceStats(AltSoundContext* ctx, uint32_t& voices, uint32_t& activeVoices, uint64_t& steals, uint64_t& drops)
+{
+	// ctx->channel_stream is only modified under ctx->io_mutex
+	std::lock_guard<std::mutex> guard(ctx->io_mutex);
+
+	voices = static_cast<uint32_t>(ctx->channel_stream.size());
+	activeVoices = ctx->channel_stream.getActiveCount();
+	steals = ctx->processor ? ctx->processor->getStealCount() : 0;
+	drops = ctx->processor ? ctx->processor->getDropCount() : 0;
+	return ctx->processor != NULL;
+}
+
+/******************************************************
+ * AltSoundContextGetReadAheadStats
+ ******************************************************/
+
+ALTSOUNDAPI bool AltSoundContextGetReadAheadStats(AltSoundContext* ctx, uint32_t& activeStreams, uint32_t& minFillMs, uint64_t& starvations, uint64_t& starvedFrames)
+{
+	const ReadAheadStats stats = ctx->read_ahead.getStats();
+	activeStreams = stats.active;
+	minFillMs = static_cast<uint32_t>(stats.min_fill_frames * 1000 / ctx->sample_rate);
+	starvations = stats.starvations;
+	starvedFrames = stats.starved_frames;
+	return ctx->read_ahead.isRunning();
+}
+
+/******************************************************
+ * AltSoundContextGetStats
+ ******************************************************/
+
+ALTSOUNDAPI void AltSoundContextGetStats(AltSoundContext* ctx, AltSoundStats& stats)
+{
+	ctx->metrics.snapshot(stats);
+}
+
+/******************************************************
+ * AltSoundContextResetStats
+ ******************************************************/
+
+ALTSOUNDAPI void AltSoundContextResetStats(AltSoundContext* ctx)
+{
+	ctx->metrics.reset();
+}
+
+/******************************************************
+ * AltSoundContextWriteTrace
+ ******************************************************/
+
+ALTSOUNDAPI bool AltSoundContextWriteTrace(AltSoundContext* ctx, const string& tracePath)
+{
+	const string path = tracePath.empty() ? ctx->trace_path : tracePath;
+	if (path.empty())
+		return false;
+
+	return ctx->trace.write(path);
+}
+
+/******************************************************
+ * AltSoundContextShutdown
+ ******************************************************/
+
+ALTSOUNDAPI void AltSoundContextShutdown(AltSoundContext* ctx)
+{
+	ALT_DEBUG(0, "BEGIN AltSoundContextShutdown()");
 	ALT_INDENT;
 
-	// Stop miniAudio's audio thread first so no further mixing/onProcess
-	// callbacks run while we tear down the streams and engine.
-	if (g_engine)
-		altsound_ma_engine_stop(g_engine);
+	// Stop accepting commands before anything they use is torn down
+	ctx->cmd_queue.stop();
+	const CommandQueueStats cmd_stats = ctx->cmd_queue.getStats();
+	if (cmd_stats.processed || cmd_stats.overflows) {
+		ALT_INFO(0, "Command queue: %llu processed, %llu dropped, max depth %u, latency avg %.3f ms / max %.3f ms",
+			(unsigned long long)cmd_stats.processed, (unsigned long long)cmd_stats.overflows, cmd_stats.max_depth,
+			cmd_stats.processed ? cmd_stats.total_latency_ns / 1e6 / cmd_stats.processed : 0.0,
+			cmd_stats.max_latency_ns / 1e6);
+	}
 
-	// Discard any end-of-stream notifications that were never drained; the
-	// streams they reference are about to be freed.
-	{
-		std::lock_guard<std::mutex> lock(g_endedMutex);
-		g_endedStreams.clear();
+	// Stop miniAudio's audio thread first so no further mixing runs while we
+	// tear down the streams. In pull mode, wait out a host render in progress
+	// instead.
+	if (ctx->render_mode != ALTSOUND_RENDER_MODE_CALLBACK) {
+		ctx->render_enabled.store(false);
+		while (ctx->render_in_flight.load())
+			std::this_thread::yield();
+	}
+	else if (ctx->device) {
+		altsound_ma_device_stop(ctx->device);
 	}
 
-	if (g_pProcessor) {
-		delete g_pProcessor;
-		g_pProcessor = NULL;
+	// Cancel outstanding preload work before the processor and cache go away
+	ctx->preloader.stop();
+
+	// Join the housekeeping thread, discarding end-of-stream notifications
+	// that were never run; the streams they reference are about to be freed.
+	ctx->housekeeper.stop();
+
+	if (ctx->processor) {
+		ALT_INFO(0, "Voices: %llu streams stolen, %llu samples dropped (no free voice)",
+			(unsigned long long)ctx->processor->getStealCount(),
+			(unsigned long long)ctx->processor->getDropCount());
+
+		delete ctx->processor;
+		ctx->processor = NULL;
 	}
 
-	if (g_engine) {
-		altsound_ma_engine_uninit(g_engine);
-		delete g_engine;
-		g_engine = nullptr;
+	// free streams still playing at shutdown, returning them to the pools
+	MiniAudio_StreamFreeAll(*ctx);
+	ALT_INFO(0, "Voice pools: %llu heap fallbacks, %llu streams refused (no free slot)",
+		(unsigned long long)(ctx->stream_info_pool.getHeapAllocCount() + MiniAudio_VoicePoolHeapAllocs(*ctx)),
+		(unsigned long long)MiniAudio_StreamSlotMisses(*ctx));
+
+	// streams are closed, so the decode thread has nothing left to fill
+	const ReadAheadStats ra_stats = ctx->read_ahead.getStats();
+	ctx->read_ahead.stop();
+	if (ra_stats.opened) {
+		ALT_INFO(0, "Read-ahead: %llu streams, %llu frames decoded, min fill %llu/%llu frames, %llu starvations (%llu frames)",
+			(unsigned long long)ra_stats.opened, (unsigned long long)ra_stats.decoded_frames,
+			(unsigned long long)ra_stats.min_fill_frames, (unsigned long long)ra_stats.capacity_frames,
+			(unsigned long long)ra_stats.starvations, (unsigned long long)ra_stats.starved_frames);
+		if (ra_stats.starvations)
+			ALT_WARNING(0, "Read-ahead ran dry %llu times. Increase read_ahead_buffer_ms", (unsigned long long)ra_stats.starvations);
 	}
 
-	if (g_context) {
-		altsound_ma_context_uninit(g_context);
-		delete g_context;
-		g_context = nullptr;
+	const HousekeeperStats hk_stats = ctx->housekeeper.getStats();
+	ALT_INFO(0, "Housekeeping: %llu SYNCPROCs, max depth %u, latency avg %.3f ms / max %.3f ms",
+		(unsigned long long)hk_stats.dispatched, hk_stats.max_depth,
+		hk_stats.dispatched ? hk_stats.total_latency_ns / 1e6 / hk_stats.dispatched : 0.0,
+		hk_stats.max_latency_ns / 1e6);
+	if (hk_stats.dropped)
+		ALT_WARNING(0, "End-of-stream queue overflowed: %llu notifications lost", (unsigned long long)hk_stats.dropped);
+
+	if (ctx->device) {
+		altsound_ma_device_uninit(ctx->device);
+		delete ctx->device;
+		ctx->device = nullptr;
 	}
+	ctx->initialized = false;
 
-	std::lock_guard<std::mutex> lock(g_audioMutex);
-	g_audioCallback = nullptr;
-	g_audioUserData = nullptr;
+	if (ctx->context) {
+		altsound_ma_context_uninit(ctx->context);
+		delete ctx->context;
+		ctx->context = nullptr;
+	}
+
+	// no stream references the mapping once they are all freed
+	ctx->sample_pack.close();
+
+	// Cached PCM is in the output format, which may differ next init
+	const SampleCacheStats cache_stats = ctx->sample_cache.getStats();
+	ALT_INFO(0, "Sample cache: %llu hits, %llu misses, %llu evictions, %llu entries, %llu/%llu bytes",
+		(unsigned long long)cache_stats.hits, (unsigned long long)cache_stats.misses,
+		(unsigned long long)cache_stats.evictions, (unsigned long long)cache_stats.entries,
+		(unsigned long long)cache_stats.bytes, (unsigned long long)cache_stats.budget);
+	ctx->sample_cache.clear();
+
+	// every thread that records events has stopped
+	if (ctx->trace.isEnabled()) {
+		ctx->trace.stop();
+		if (ctx->trace.write(ctx->trace_path)) {
+			ALT_INFO(0, "Event trace written: %s", ctx->trace_path.c_str());
+		}
+		else {
+			ALT_ERROR(0, "FAILED to write event trace: %s", ctx->trace_path.c_str());
+		}
+	}
+
+	AltsoundPublishAudioCallback(ctx, nullptr, nullptr);
 
 	ALT_OUTDENT;
-	ALT_DEBUG(0, "END AltSoundShutdown()");
+	ALT_DEBUG(0, "END AltSoundContextShutdown()");
+}
+
+/******************************************************
+ * AltSoundContextCreate
+ ******************************************************/
+
+ALTSOUNDAPI AltSoundContext* AltSoundContextCreate()
+{
+	return new AltSoundContext();
+}
+
+/******************************************************
+ * AltSoundContextDestroy
+ ******************************************************/
+
+ALTSOUNDAPI void AltSoundContextDestroy(AltSoundContext* ctx)
+{
+	if (!ctx)
+		return;
+
+	AltSoundContextShutdown(ctx);
+	delete ctx;
+}
+
+/******************************************************
+ * Default context
+ *
+ * The AltSound*() functions drive a context owned by
+ * the library, for hosts that run a single game
+ ******************************************************/
+
+ALTSOUNDAPI void AltSoundSetRenderMode(ALTSOUND_RENDER_MODE mode)
+{
+	AltSoundContextSetRenderMode(&g_defaultContext, mode);
+}
+
+ALTSOUNDAPI bool AltSoundInit(const string& pinmamePath, const string& gameName,
+                              uint32_t sampleRate, uint32_t channels, uint32_t bufferSizeFrames)
+{
+	return AltSoundContextInit(&g_defaultContext, pinmamePath, gameName, sampleRate, channels, bufferSizeFrames);
+}
+
+ALTSOUNDAPI void AltSoundSetHardwareGen(ALTSOUND_HARDWARE_GEN hardwareGen)
+{
+	AltSoundContextSetHardwareGen(&g_defaultContext, hardwareGen);
+}
+
+ALTSOUNDAPI void AltSoundSetAudioCallback(AltSoundAudioCallback callback, void* userData)
+{
+	AltSoundContextSetAudioCallback(&g_defaultContext, callback, userData);
+}
+
+ALTSOUNDAPI size_t AltSoundRender(float* out, size_t frameCount)
+{
+	return AltSoundContextRender(&g_defaultContext, out, frameCount);
+}
+
+ALTSOUNDAPI bool AltSoundProcessCommand(const unsigned int cmd, int attenuation)
+{
+	return AltSoundContextProcessCommand(&g_defaultContext, cmd, attenuation);
+}
+
+ALTSOUNDAPI bool AltSoundProcessCommandAt(const unsigned int cmd, int attenuation, uint64_t emuTimeNs)
+{
+	return AltSoundContextProcessCommandAt(&g_defaultContext, cmd, attenuation, emuTimeNs);
+}
+
+ALTSOUNDAPI void AltSoundPause(bool pause)
+{
+	AltSoundContextPause(&g_defaultContext, pause);
+}
+
+ALTSOUNDAPI bool AltSoundGetPreloadProgress(uint32_t& done, uint32_t& total)
+{
+	return AltSoundContextGetPreloadProgress(&g_defaultContext, done, total);
+}
+
+ALTSOUNDAPI bool AltSoundGetCommandQueueStats(uint32_t& depth, uint32_t& maxDepth, uint64_t& maxLatencyUs, uint64_t& overflows)
+{
+	return AltSoundContextGetCommandQueueStats(&g_defaultContext, depth, maxDepth, maxLatencyUs, overflows);
 }
 
+ALTSOUNDAPI bool AltSoundGetVoiceStats(uint32_t& voices, uint32_t& activeVoices, uint64_t& steals, uint64_t& drops)
+{
+	return AltSoundContextGetVoiceStats(&g_defaultContext, voices, activeVoices, steals, drops);
+}
+
+ALTSOUNDAPI bool AltSoundGetReadAheadStats(uint32_t& activeStreams, uint32_t& minFillMs, uint64_t& starvations, uint64_t& starvedFrames)
+{
+	return AltSoundContextGetReadAheadStats(&g_defaultContext, activeStreams, minFillMs, starvations, starvedFrames);
+}
+
+ALTSOUNDAPI void AltSoundGetStats(AltSoundStats& stats)
+{
+	AltSoundContextGetStats(&g_defaultContext, stats);
+}
+
+ALTSOUNDAPI void AltSoundResetStats()
+{
+	AltSoundContextResetStats(&g_defaultContext);
+}
+
+ALTSOUNDAPI bool AltSoundWriteTrace(const string& tracePath)
+{
+	return AltSoundContextWriteTrace(&g_defaultContext, tracePath);
+}
+
+ALTSOUNDAPI void AltSoundShutdown()
+{
+	AltSoundContextShutdown(&g_defaultContext);
+}
@@ -57,14 +57,80 @@ typedef enum {
 	ALTSOUND_LOG_LEVEL_UNDEFINED,
 } ALTSOUND_LOG_LEVEL;
 
+typedef enum {
+	ALTSOUND_RENDER_MODE_CALLBACK = 0, // internal audio thread pushes mixed buffers to AltSoundAudioCallback
+	ALTSOUND_RENDER_MODE_PULL,         // no internal thread; the host calls AltSoundRender() from its audio callback
+	ALTSOUND_RENDER_MODE_OFFLINE,      // as PULL, but deterministic: end-of-stream handling runs inside AltSoundRender()
+} ALTSOUND_RENDER_MODE;
+
+typedef enum {
+	ALTSOUND_STAGE_COMMAND = 0,       // whole command pipeline, from AltSoundProcessCommand() (or dequeue) to return
+	ALTSOUND_STAGE_QUEUE_WAIT,        // time a command waited in the asynchronous command queue
+	ALTSOUND_STAGE_PREPROCESS,        // hardware generation command preprocessing
+	ALTSOUND_STAGE_MUTEX_WAIT,        // waiting to acquire the processor mutex
+	ALTSOUND_STAGE_GET_SAMPLE,        // command to sample lookup
+	ALTSOUND_STAGE_STREAM_CREATE,     // stream creation, including decoder initialization
+	ALTSOUND_STAGE_ADJUST_VOLUMES,    // G-Sound ducking volume updates
+	ALTSOUND_STAGE_SYNCPROC_DELAY,    // stream end to end-of-stream handling
+	ALTSOUND_STAGE_COUNT,
+} ALTSOUND_STAGE;
+
+#define ALTSOUND_STATS_BUCKETS 32
+
+typedef struct {
+	uint64_t count;
+	uint64_t total_ns;
+	uint64_t max_ns;
+	uint64_t buckets[ALTSOUND_STATS_BUCKETS]; // bucket i counts durations of [2^i, 2^(i+1)) ns; the last bucket is open-ended
+} AltSoundStageStats;
+
+typedef struct {
+	AltSoundStageStats stages[ALTSOUND_STAGE_COUNT];
+} AltSoundStats;
+
 typedef void (*AltSoundAudioCallback)(const float* samples, size_t frameCount, uint32_t sampleRate, uint32_t channels, void* userData);
 
+// An independent AltSound engine: its own processor, streams, mixer and
+// threads.  Contexts share no locks, so several can run on different cores.
+// The AltSound*() functions below drive a default context
+typedef struct AltSoundContext AltSoundContext;
+
 ALTSOUNDAPI void AltSoundSetLogger(const string& logPath, ALTSOUND_LOG_LEVEL logLevel, bool console);
+ALTSOUNDAPI void AltSoundSetRenderMode(ALTSOUND_RENDER_MODE mode);
 ALTSOUNDAPI bool AltSoundInit(const string& pinmamePath, const string& gameName,
                               uint32_t sampleRate = 44100, uint32_t channels = 2, uint32_t bufferSizeFrames = 256);
 ALTSOUNDAPI void AltSoundSetHardwareGen(ALTSOUND_HARDWARE_GEN hardwareGen);
 ALTSOUNDAPI void AltSoundSetAudioCallback(AltSoundAudioCallback callback, void* userData);
+ALTSOUNDAPI size_t AltSoundRender(float* out, size_t frameCount);
 ALTSOUNDAPI bool AltSoundProcessCommand(const unsigned int cmd, int attenuation);
+ALTSOUNDAPI bool AltSoundProcessCommandAt(const unsigned int cmd, int attenuation, uint64_t emuTimeNs);
 ALTSOUNDAPI void AltSoundPause(bool pause);
+ALTSOUNDAPI bool AltSoundGetPreloadProgress(uint32_t& done, uint32_t& total);
+ALTSOUNDAPI bool AltSoundGetCommandQueueStats(uint32_t& depth, uint32_t& maxDepth, uint64_t& maxLatencyUs, uint64_t& overflows);
+ALTSOUNDAPI bool AltSoundGetVoiceStats(uint32_t& voices, uint32_t& activeVoices, uint64_t& steals, uint64_t& drops);
+ALTSOUNDAPI bool AltSoundGetReadAheadStats(uint32_t& activeStreams, uint32_t& minFillMs, uint64_t& starvations, uint64_t& starvedFrames);
+ALTSOUNDAPI void AltSoundGetStats(AltSoundStats& stats);
+ALTSOUNDAPI void AltSoundResetStats();
+ALTSOUNDAPI bool AltSoundWriteTrace(const string& tracePath = "");
 ALTSOUNDAPI void AltSoundShutdown();
 
+ALTSOUNDAPI AltSoundContext* AltSoundContextCreate();
+ALTSOUNDAPI void AltSoundContextDestroy(AltSoundContext* ctx);
+ALTSOUNDAPI void AltSoundContextSetRenderMode(AltSoundContext* ctx, ALTSOUND_RENDER_MODE mode);
+ALTSOUNDAPI bool AltSoundContextInit(AltSoundContext* ctx, const string& pinmamePath, const string& gameName,
+                                     uint32_t sampleRate = 44100, uint32_t channels = 2, uint32_t bufferSizeFrames = 256);
+ALTSOUNDAPI void AltSoundContextSetHardwareGen(AltSoundContext* ctx, ALTSOUND_HARDWARE_GEN hardwareGen);
+ALTSOUNDAPI void AltSoundContextSetAudioCallback(AltSoundContext* ctx, AltSoundAudioCallback callback, void* userData);
+ALTSOUNDAPI size_t AltSoundContextRender(AltSoundContext* ctx, float* out, size_t frameCount);
+ALTSOUNDAPI bool AltSoundContextProcessCommand(AltSoundContext* ctx, const unsigned int cmd, int attenuation);
+ALTSOUNDAPI bool AltSoundContextProcessCommandAt(AltSoundContext* ctx, const unsigned int cmd, int attenuation, uint64_t emuTimeNs);
+ALTSOUNDAPI void AltSoundContextPause(AltSoundContext* ctx, bool pause);
+ALTSOUNDAPI bool AltSoundContextGetPreloadProgress(AltSoundContext* ctx, uint32_t& done, uint32_t& total);
+ALTSOUNDAPI bool AltSoundContextGetCommandQueueStats(AltSoundContext* ctx, uint32_t& depth, uint32_t& maxDepth, uint64_t& maxLatencyUs, uint64_t& overflows);
+ALTSOUNDAPI bool AltSoundContextGetVoiceStats(AltSoundContext* ctx, uint32_t& voices, uint32_t& activeVoices, uint64_t& steals, uint64_t& drops);
+ALTSOUNDAPI bool AltSoundContextGetReadAheadStats(AltSoundContext* ctx, uint32_t& activeStreams, uint32_t& minFillMs, uint64_t& starvations, uint64_t& starvedFrames);
+ALTSOUNDAPI void AltSoundContextGetStats(AltSoundContext* ctx, AltSoundStats& stats);
+ALTSOUNDAPI void AltSoundContextResetStats(AltSoundContext* ctx);
+ALTSOUNDAPI bool AltSoundContextWriteTrace(AltSoundContext* ctx, const string& tracePath = "");
+ALTSOUNDAPI void AltSoundContextShutdown(AltSoundContext* ctx);
+
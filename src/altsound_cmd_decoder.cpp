@@ -0,0 +1,325 @@
+// ---------------------------------------------------------------------------
+// altsound_cmd_decoder.cpp
+//
+// Table-driven command preprocessing for each ROM hardware generation family
+// ---------------------------------------------------------------------------
+// license:BSD-3-Clause
+// ---------------------------------------------------------------------------
+
+#define NOMINMAX
+
+#include "altsound_cmd_decoder.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+
+// ----------------------------------------------------------------------------
+// Byte class tables
+//
+// Each family classifies the byte it switches on through a 256-entry table
+// generated at compile time, so a step is one table load plus the few
+// compares that depend on more than one byte
+// ----------------------------------------------------------------------------
+
+typedef std::array<uint8_t, 256> ByteClassTable;
+
+template<typename Classify>
+static constexpr ByteClassTable makeByteClassTable(Classify classify)
+{
+	ByteClassTable table{};
+	for (unsigned int b = 0; b < 256; ++b)
+		table[b] = classify(b);
+	return table;
+}
+
+// Class of a buffered value. Values outside a byte (e.g. a cleared slot)
+// have no class
+static inline uint8_t byteClass(const ByteClassTable& table, unsigned int value)
+{
+	return value < 256 ? table[value] : 0;
+}
+
+// DCS: class of cmd_buffer[2] in a "55 xx" special command
+enum : uint8_t {
+	DCS_FILTER         = 0x01, // always filtered
+	DCS_FILTER_CHECKED = 0x02, // filtered when followed by value, ~value
+	DCS_VOLUME_CHECKED = 0x04, // master volume change when followed by value, ~value
+};
+
+static constexpr ByteClassTable DCS_SPECIAL = makeByteClassTable([](unsigned int b) -> uint8_t {
+	if (b >= 0xAB && b <= 0xB0) // per-DCS-channel mixing level, but on our interpretation level we do not have any knowledge about the internal channel structures of DCS
+		return DCS_FILTER_CHECKED;
+	if (b == 0xC2 || b == 0xC3) // DCS software major/minor version number
+		return DCS_FILTER;
+	if (b >= 0xBA && b <= 0xC1) // mystery command, see http://mjrnet.org/pinscape/dcsref/DCS_format_reference.html#SpecialCommands
+		return DCS_FILTER_CHECKED;
+	if (b == 0xAA) // change master volume
+		return DCS_FILTER | DCS_VOLUME_CHECKED;
+	return 0;
+});
+
+// Whitestar: class of the new command byte
+enum : uint8_t {
+	WS_VOLUME = 0x01, // FE 10 ... FE 2F set the volume
+	WS_IGNORE = 0x02, // FE 01 ... FE 0F are ignored
+	WS_START  = 0x04, // start byte of a command will ALWAYS be FF, FE, FD, FC, and never the second byte!
+};
+
+static constexpr ByteClassTable WS_BYTE = makeByteClassTable([](unsigned int b) -> uint8_t {
+	uint8_t cls = 0;
+	if (b >= 0x10 && b <= 0x2F)
+		cls |= WS_VOLUME;
+	if (b >= 0x01 && b <= 0x0F)
+		cls |= WS_IGNORE;
+	if ((b & 0xFC) == 0xFC)
+		cls |= WS_START;
+	return cls;
+});
+
+// Data East: bytes that are not commands on their own
+static constexpr ByteClassTable DE_HOLD = makeByteClassTable([](unsigned int b) -> uint8_t {
+	return (b == 0x00 || b == 0xFF) ? 1 : 0;
+});
+
+// ----------------------------------------------------------------------------
+// Helper functions
+// ----------------------------------------------------------------------------
+
+// Clear the buffer after a consumed special command
+static inline void filterAndReset(CmdData& data)
+{
+	std::fill_n(data.cmd_buffer, ALT_MAX_CMDS, ~0u);
+	data.cmd_counter = 0;
+	data.cmd_filter = 1;
+}
+
+// cmd_buffer[0..1] hold value, ~value
+static inline bool isChecked(const CmdData& data)
+{
+	return data.cmd_buffer[1] == (data.cmd_buffer[0] ^ 0xFF);
+}
+
+// ----------------------------------------------------------------------------
+// Preprocessing steps
+// ----------------------------------------------------------------------------
+
+static void preprocessNone(CmdData&, unsigned int, AltsoundCmdAction&)
+{
+}
+
+// ----------------------------------------------------------------------------
+
+// WPCDCS, WPCSECURITY, WPC95DCS, WPC95
+//
+// For future improvements, also check https://github.com/mjrgh/DCSExplorer/ for a lot of new info on the DCS inner workings
+//
+// E.g.: One more note on command processing: each byte of a command sequence must be received on the DCS side within 100ms of the previous byte.
+//   The DCS software clears any buffered bytes if more than 100ms elapses between consecutive bytes.
+//   This implies that a sender can wait a little longer than 100ms before sending the first byte of a new command if it wants to essentially reset the network connection,
+//   ensuring that the DCS receiver doesn't think it's in the middle of some earlier partially-sent command sequence.
+static void preprocessDCS(CmdData& data, unsigned int, AltsoundCmdAction& action)
+{
+	const uint8_t cls = data.cmd_buffer[3] == 0x55 ? byteClass(DCS_SPECIAL, data.cmd_buffer[2]) : 0;
+	if (cls) {
+		const bool checked = isChecked(data);
+		if ((cls & DCS_FILTER) || checked) {
+			// DAR@20240208 A "glitch in command buffer" check for 55 00 00 00 used
+			//              to be here.  It is dangerous; if this is still a
+			//              problem, it would be better to revisit it when it
+			//              reappears to implement a more robust solution that
+			//              works for all systems
+			//              See https://github.com/vpinball/pinmame/issues/220
+			// Maybe implementing the 'nothing happened in >100ms' reset queue (see above) would also resolve this??
+			if ((cls & DCS_VOLUME_CHECKED) && checked) { // change volume op (following first byte = volume, second = ~volume, if these don't match: ignore)
+				//!! input is 0..255 (or ..248 in practice? BUT at least MM triggers 255 at max volume in the menu) though, not just 0..127!
+				const unsigned int vol = data.cmd_buffer[1];
+				action.set_volume = true;
+				action.volume = (vol == 0) ? 0.f : std::min(powf(0.981201f, (float)(255u - vol)) * 4.0f, 1.0f); //!! *4 is magic
+				action.raw = vol;
+			}
+
+			filterAndReset(data);
+			return;
+		}
+	}
+
+	data.cmd_filter = 0;
+}
+
+// ----------------------------------------------------------------------------
+
+// WPCALPHA_2, WPCDMD, WPCFLIPTRON: remaps everything to 16bit, a bit stupid maybe
+static void preprocessWPC(CmdData& data, unsigned int cmd, AltsoundCmdAction& action)
+{
+	data.cmd_filter = 0;
+	if (data.cmd_buffer[2] == 0x79 && isChecked(data)) { // change volume op (following first byte = volume, second = ~volume, if these don't match: ignore)
+		action.set_volume = true;
+		action.volume = std::min((float)data.cmd_buffer[1] / 127.f, 1.0f);
+		action.raw = data.cmd_buffer[1];
+
+		filterAndReset(data);
+	}
+	else if (data.cmd_buffer[1] == 0x7A) { // 16bit command second part //!! TZ triggers a 0xFF in the beginning -> check sequence and filter?
+		data.stored_command = data.cmd_buffer[1];
+		data.cmd_counter = 0;
+	}
+	else if (cmd != 0x7A) { // 8 bit command
+		data.stored_command = 0;
+		data.cmd_counter = 0;
+	}
+	else // 16bit command first part
+		data.cmd_counter = 1;
+}
+
+// ----------------------------------------------------------------------------
+
+// WPCALPHA_1, S11, S11X, S11B2, S11C //!! test all these generations!
+static void preprocessS11(CmdData& data, unsigned int cmd, AltsoundCmdAction&)
+{
+	if (cmd != data.cmd_buffer[1]) { //!! some stuff is doubled or tripled -> filter out?
+		data.stored_command = 0; // 8 bit command //!! 7F & 7E opcodes?
+		data.cmd_counter = 0;
+	}
+	else
+		data.cmd_counter = 1;
+}
+
+// ----------------------------------------------------------------------------
+
+// DEDMD16, DEDMD32, DEDMD64, DE: this one just tested with BTTF so far
+static void preprocessDE(CmdData& data, unsigned int cmd, AltsoundCmdAction&)
+{
+	if (!byteClass(DE_HOLD, cmd) || (cmd == 0x00 && data.cmd_buffer[1] == 0x00)) { // 8 bit command, or 0x0000 special //!! meh?
+		data.stored_command = 0;
+		data.cmd_counter = 0;
+	}
+	else // ignore
+		data.cmd_counter = 1;
+}
+
+// ----------------------------------------------------------------------------
+
+// WS, WS_1, WS_2
+static void preprocessWS(CmdData& data, unsigned int cmd, AltsoundCmdAction& action)
+{
+	const uint8_t cls = byteClass(WS_BYTE, cmd);
+
+	data.cmd_filter = 0;
+	if (data.cmd_buffer[1] == 0xFE) {
+		if (cls & WS_VOLUME) {
+			action.set_volume = true;
+			action.volume = (float)(0x2F - cmd) / 31.f;
+			action.raw = cmd;
+
+			filterAndReset(data);
+		}
+		else if (cls & WS_IGNORE) {
+			data.stored_command = 0;
+			data.cmd_counter = 0;
+			data.cmd_filter = 1;
+		}
+	}
+
+	if (WS_BYTE[cmd & 0xFF] & WS_START) // only the low byte matters
+		data.cmd_counter = 1;
+}
+
+// ----------------------------------------------------------------------------
+
+// GTS80A: seems to be 8-bit commands
+//
+// DAR@29249297 It appears that this system sends 0x00 commands as a clock
+//              signal, since we recieve a ridiculous number of them.
+//              Filter them out
+static void preprocessGTS80(CmdData& data, unsigned int cmd, AltsoundCmdAction&)
+{
+	data.stored_command = 0;
+	data.cmd_counter = 0;
+	data.cmd_filter = (cmd == 0x00) ? 1 : 0;
+}
+
+// ----------------------------------------------------------------------------
+// Music stop commands
+// ----------------------------------------------------------------------------
+
+static bool stopsMusicNone(unsigned int)
+{
+	return false;
+}
+
+static bool stopsMusicDCS(unsigned int combined_cmd)
+{
+	return combined_cmd == 0x03E3;
+}
+
+//!! old WPC machines music stop? -> 0x00 for SYS11?
+
+static bool stopsMusicDEDMD32(unsigned int combined_cmd)
+{
+	return combined_cmd == 0x0018 || combined_cmd == 0x0023; //!! ???? 0x0019??
+}
+
+static bool stopsMusicWS(unsigned int combined_cmd)
+{
+	return combined_cmd == 0x0000 || (combined_cmd & 0xf0ff) == 0xf000;
+}
+
+// ----------------------------------------------------------------------------
+// Decoders
+// ----------------------------------------------------------------------------
+
+static const AltsoundCmdDecoder DECODER_NONE    = { "NONE", preprocessNone, stopsMusicNone, "" };
+static const AltsoundCmdDecoder DECODER_DCS     = { "WPCDCS, WPCSECURITY, WPC95DCS, WPC95", preprocessDCS, stopsMusicDCS, "MUSIC(2)" };
+static const AltsoundCmdDecoder DECODER_WPC     = { "WPCALPHA_2, WPCDMD, WPCFLIPTRON", preprocessWPC, stopsMusicNone, "" };
+static const AltsoundCmdDecoder DECODER_S11     = { "WPCALPHA_1, S11, S11X, S11B2, S11C", preprocessS11, stopsMusicNone, "" };
+static const AltsoundCmdDecoder DECODER_DE      = { "DEDMD16, DEDMD64, DE", preprocessDE, stopsMusicNone, "" };
+static const AltsoundCmdDecoder DECODER_DEDMD32 = { "DEDMD32", preprocessDE, stopsMusicDEDMD32, "MUSIC(3)" };
+static const AltsoundCmdDecoder DECODER_WS      = { "WS, WS_1, WS_2", preprocessWS, stopsMusicWS, "MUSIC(4)" };
+static const AltsoundCmdDecoder DECODER_GTS80   = { "GTS80A", preprocessGTS80, stopsMusicNone, "" };
+
+// ----------------------------------------------------------------------------
+// Functional code
+// ----------------------------------------------------------------------------
+
+const AltsoundCmdDecoder& altsound_find_cmd_decoder(ALTSOUND_HARDWARE_GEN hardware_gen)
+{
+	switch (hardware_gen) {
+		case ALTSOUND_HARDWARE_GEN_WPCDCS:
+		case ALTSOUND_HARDWARE_GEN_WPCSECURITY:
+		case ALTSOUND_HARDWARE_GEN_WPC95DCS:
+		case ALTSOUND_HARDWARE_GEN_WPC95:
+			return DECODER_DCS;
+
+		case ALTSOUND_HARDWARE_GEN_WPCALPHA_2: //!! ?? test this gen actually
+		case ALTSOUND_HARDWARE_GEN_WPCDMD:
+		case ALTSOUND_HARDWARE_GEN_WPCFLIPTRON:
+			return DECODER_WPC;
+
+		case ALTSOUND_HARDWARE_GEN_WPCALPHA_1:
+		case ALTSOUND_HARDWARE_GEN_S11:
+		case ALTSOUND_HARDWARE_GEN_S11X:
+		case ALTSOUND_HARDWARE_GEN_S11B2:
+		case ALTSOUND_HARDWARE_GEN_S11C:
+			return DECODER_S11;
+
+		case ALTSOUND_HARDWARE_GEN_DEDMD16:
+		case ALTSOUND_HARDWARE_GEN_DEDMD64:
+		case ALTSOUND_HARDWARE_GEN_DE:
+			return DECODER_DE;
+
+		case ALTSOUND_HARDWARE_GEN_DEDMD32:
+			return DECODER_DEDMD32;
+
+		case ALTSOUND_HARDWARE_GEN_WS:
+		case ALTSOUND_HARDWARE_GEN_WS_1:
+		case ALTSOUND_HARDWARE_GEN_WS_2:
+			return DECODER_WS;
+
+		case ALTSOUND_HARDWARE_GEN_GTS80/*A*/: // Gottlieb System 80A
+			return DECODER_GTS80;
+
+		default:
+			return DECODER_NONE;
+	}
+}
@@ -0,0 +1,44 @@
+// ---------------------------------------------------------------------------
+// altsound_cmd_decoder.hpp
+//
+// Table-driven command preprocessing for each ROM hardware generation family
+// ---------------------------------------------------------------------------
+// license:BSD-3-Clause
+// ---------------------------------------------------------------------------
+
+#ifndef ALTSOUND_CMD_DECODER_HPP
+#define ALTSOUND_CMD_DECODER_HPP
+#if !defined(__GNUC__) || (__GNUC__ == 3 && __GNUC_MINOR__ >= 4) || (__GNUC__ >= 4)	// GCC supports "pragma once" correctly since 3.4
+#pragma once
+#endif
+
+#include "altsound.h"
+#include "altsound_data.hpp"
+
+// What a preprocessing step asks the caller to do besides updating CmdData
+struct AltsoundCmdAction {
+	bool set_volume = false; // the command sequence was a ROM volume change
+	float volume = 0.0f;     // new global volume when set_volume is true
+	unsigned int raw = 0;    // volume byte as sent by the ROM
+};
+
+// Update CmdData for a new command byte, already shifted into cmd_buffer[0].
+// Steps never log and never touch the processor, so they are safe to replay
+typedef void (*AltsoundPreprocessFn)(CmdData& data, unsigned int cmd, AltsoundCmdAction& action);
+
+// Determine if a complete command stops the music
+typedef bool (*AltsoundStopsMusicFn)(unsigned int combined_cmd);
+
+// Command handling for one hardware generation family
+struct AltsoundCmdDecoder {
+	const char* name;                 // family, for logging
+	AltsoundPreprocessFn preprocess;
+	AltsoundStopsMusicFn stops_music;
+	const char* stop_music_label;     // tag of the "Stopping MUSIC" log message
+};
+
+// Find the decoder for a hardware generation.  Unknown generations get a
+// decoder that passes commands through unchanged
+const AltsoundCmdDecoder& altsound_find_cmd_decoder(ALTSOUND_HARDWARE_GEN hardware_gen);
+
+#endif // ALTSOUND_CMD_DECODER_HPP
@@ -0,0 +1,138 @@
+// ---------------------------------------------------------------------------
+// altsound_command_queue.cpp
+//
+// Optional asynchronous ingestion of sound commands
+// ---------------------------------------------------------------------------
+// license:BSD-3-Clause
+// ---------------------------------------------------------------------------
+
+#include "altsound_command_queue.hpp"
+#include "altsound_metrics.hpp"
+#include "altsound_trace.hpp"
+
+#include <chrono>
+
+// ----------------------------------------------------------------------------
+// Helper function to read the monotonic clock in nanoseconds
+// ----------------------------------------------------------------------------
+
+static uint64_t commandQueueNow()
+{
+	return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+		std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+// ----------------------------------------------------------------------------
+// Functional code
+// ----------------------------------------------------------------------------
+
+AltsoundCommandQueue::AltsoundCommandQueue(AltsoundMetrics& metrics_in, AltsoundTrace& trace_in)
+: metrics(metrics_in),
+  trace(trace_in)
+{
+}
+
+// ----------------------------------------------------------------------------
+
+AltsoundCommandQueue::~AltsoundCommandQueue()
+{
+	stop();
+}
+
+// ----------------------------------------------------------------------------
+
+void AltsoundCommandQueue::start(CommandHandler handler_in, void* user_in)
+{
+	stop();
+
+	handler = handler_in;
+	user = user_in;
+	processed.store(0, std::memory_order_relaxed);
+	overflows.store(0, std::memory_order_relaxed);
+	max_depth.store(0, std::memory_order_relaxed);
+	max_latency_ns.store(0, std::memory_order_relaxed);
+	total_latency_ns.store(0, std::memory_order_relaxed);
+
+	running.store(true, std::memory_order_release);
+	thread = std::thread(&AltsoundCommandQueue::threadProc, this);
+}
+
+// ----------------------------------------------------------------------------
+
+void AltsoundCommandQueue::stop()
+{
+	if (!thread.joinable())
+		return;
+
+	running.store(false, std::memory_order_release);
+	wake_seq.fetch_add(1, std::memory_order_release);
+	wake_seq.notify_one();
+	thread.join();
+
+	QueuedCommand command;
+	while (queue.pop(command)) {}
+}
+
+// ----------------------------------------------------------------------------
+
+bool AltsoundCommandQueue::post(unsigned int cmd_in, int attenuation_in, uint64_t start_frame_in)
+{
+	QueuedCommand command;
+	command.cmd = cmd_in;
+	command.attenuation = attenuation_in;
+	command.start_frame = start_frame_in;
+	command.queued_ns = commandQueueNow();
+
+	if (!queue.push(command)) {
+		overflows.fetch_add(1, std::memory_order_relaxed);
+		return false;
+	}
+
+	const uint32_t depth = static_cast<uint32_t>(queue.size());
+	if (depth > max_depth.load(std::memory_order_relaxed))
+		max_depth.store(depth, std::memory_order_relaxed);
+
+	wake_seq.fetch_add(1, std::memory_order_release);
+	wake_seq.notify_one();
+	return true;
+}
+
+// ----------------------------------------------------------------------------
+
+CommandQueueStats AltsoundCommandQueue::getStats() const
+{
+	CommandQueueStats stats;
+	stats.processed = processed.load(std::memory_order_relaxed);
+	stats.overflows = overflows.load(std::memory_order_relaxed);
+	stats.depth = static_cast<uint32_t>(queue.size());
+	stats.max_depth = max_depth.load(std::memory_order_relaxed);
+	stats.max_latency_ns = max_latency_ns.load(std::memory_order_relaxed);
+	stats.total_latency_ns = total_latency_ns.load(std::memory_order_relaxed);
+	return stats;
+}
+
+// ----------------------------------------------------------------------------
+
+void AltsoundCommandQueue::threadProc()
+{
+	trace.setThreadName("command worker");
+	uint32_t seq = wake_seq.load(std::memory_order_acquire);
+
+	while (running.load(std::memory_order_acquire)) {
+		QueuedCommand command;
+		while (running.load(std::memory_order_acquire) && queue.pop(command)) {
+			const uint64_t latency = commandQueueNow() - command.queued_ns;
+			total_latency_ns.fetch_add(latency, std::memory_order_relaxed);
+			if (latency > max_latency_ns.load(std::memory_order_relaxed))
+				max_latency_ns.store(latency, std::memory_order_relaxed);
+			metrics.record(ALTSOUND_STAGE_QUEUE_WAIT, latency);
+
+			handler(command.cmd, command.attenuation, command.start_frame, user);
+			processed.fetch_add(1, std::memory_order_relaxed);
+		}
+
+		// sleep until post() or stop() bumps the sequence
+		wake_seq.wait(seq, std::memory_order_acquire);
+		seq = wake_seq.load(std::memory_order_acquire);
+	}
+}
@@ -0,0 +1,117 @@
+// ---------------------------------------------------------------------------
+// altsound_command_queue.hpp
+//
+// Optional asynchronous ingestion of sound commands.  The emulator thread
+// only queues commands; a worker thread runs the command pipeline
+// ---------------------------------------------------------------------------
+// license:BSD-3-Clause
+// ---------------------------------------------------------------------------
+
+#ifndef ALTSOUND_COMMAND_QUEUE_HPP
+#define ALTSOUND_COMMAND_QUEUE_HPP
+#if !defined(__GNUC__) || (__GNUC__ == 3 && __GNUC_MINOR__ >= 4) || (__GNUC__ >= 4)	// GCC supports "pragma once" correctly since 3.4
+#pragma once
+#endif
+
+#include "altsound_lockfree.hpp"
+
+#include <atomic>
+#include <cstdint>
+#include <thread>
+
+class AltsoundMetrics;
+class AltsoundTrace;
+
+// Maximum number of commands waiting for the worker
+#define ALT_CMD_QUEUE_SIZE 1024
+
+// A queued sound command
+struct QueuedCommand {
+	unsigned int cmd = 0;
+	int attenuation = 0;
+	uint64_t start_frame = 0; // engine frame to start its sounds at, 0 for at once
+	uint64_t queued_ns = 0;
+};
+
+// Queue statistics since start()
+struct CommandQueueStats {
+	uint64_t processed = 0;      // commands run by the worker
+	uint64_t overflows = 0;      // commands dropped because the queue was full
+	uint32_t depth = 0;          // commands currently waiting
+	uint32_t max_depth = 0;      // most commands waiting at once
+	uint64_t max_latency_ns = 0; // longest time from post() to processing start
+	uint64_t total_latency_ns = 0;
+};
+
+// Runs one command through the pipeline.  Returns the pipeline's result
+typedef bool (*CommandHandler)(unsigned int cmd, int attenuation, uint64_t start_frame, void* user);
+
+// ---------------------------------------------------------------------------
+// AltsoundCommandQueue class definition
+//
+// Commands are handled strictly in post() order.  post() must always be
+// called from the same thread (the emulator thread)
+// ---------------------------------------------------------------------------
+
+class AltsoundCommandQueue
+{
+public:
+
+	// Standard constructor
+	AltsoundCommandQueue(AltsoundMetrics& metrics_in, AltsoundTrace& trace_in);
+
+	// Copy constructor - NOT USED
+	AltsoundCommandQueue(AltsoundCommandQueue&) = delete;
+
+	// Destructor
+	~AltsoundCommandQueue();
+
+	// Start the worker and reset the statistics.  user is passed to the
+	// handler
+	void start(CommandHandler handler_in, void* user_in);
+
+	// Join the worker.  Commands still queued are discarded
+	void stop();
+
+	// Determine if commands are being queued
+	bool isRunning() const;
+
+	// Queue a command.  Returns false if the queue is full
+	bool post(unsigned int cmd_in, int attenuation_in, uint64_t start_frame_in = 0);
+
+	// Get queue statistics
+	CommandQueueStats getStats() const;
+
+private: // functions
+
+	// worker thread entry point
+	void threadProc();
+
+private: // data
+
+	AltsoundMetrics& metrics;
+	AltsoundTrace& trace;
+	AltsoundSPSCRing<QueuedCommand, ALT_CMD_QUEUE_SIZE> queue;
+	CommandHandler handler = nullptr;
+	void* user = nullptr;
+	std::thread thread;
+
+	std::atomic<uint32_t> wake_seq{ 0 };
+	std::atomic<bool> running{ false };
+
+	std::atomic<uint64_t> processed{ 0 };
+	std::atomic<uint64_t> overflows{ 0 };
+	std::atomic<uint32_t> max_depth{ 0 };
+	std::atomic<uint64_t> max_latency_ns{ 0 };
+	std::atomic<uint64_t> total_latency_ns{ 0 };
+};
+
+// ----------------------------------------------------------------------------
+// Inline functions
+// ----------------------------------------------------------------------------
+
+inline bool AltsoundCommandQueue::isRunning() const {
+	return running.load(std::memory_order_acquire);
+}
+
+#endif // ALTSOUND_COMMAND_QUEUE_HPP
@@ -0,0 +1,28 @@
+// ---------------------------------------------------------------------------
+// altsound_context.cpp
+//
+// State of one AltSound engine instance
+// ---------------------------------------------------------------------------
+// license:BSD-3-Clause
+// ---------------------------------------------------------------------------
+
+#include "altsound_context.hpp"
+
+// ----------------------------------------------------------------------------
+// Functional code
+// ----------------------------------------------------------------------------
+
+AltSoundContext::AltSoundContext()
+: cmd_decoder(&altsound_find_cmd_decoder(ALTSOUND_HARDWARE_GEN_NONE)),
+  read_ahead(trace),
+  housekeeper(metrics, trace),
+  preloader(*this),
+  cmd_queue(metrics, trace)
+{
+}
+
+// ----------------------------------------------------------------------------
+
+AltSoundContext::~AltSoundContext()
+{
+}
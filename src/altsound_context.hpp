@@ -0,0 +1,132 @@
+// ---------------------------------------------------------------------------
+// altsound_context.hpp
+//
+// State of one AltSound engine instance.  Every subsystem and stream of a
+// game lives in its context, so contexts running side by side share no
+// locks.  The AltSound*() API drives a default context
+// ---------------------------------------------------------------------------
+// license:BSD-3-Clause
+// ---------------------------------------------------------------------------
+
+#ifndef ALTSOUND_CONTEXT_HPP
+#define ALTSOUND_CONTEXT_HPP
+#if !defined(__GNUC__) || (__GNUC__ == 3 && __GNUC_MINOR__ >= 4) || (__GNUC__ >= 4)	// GCC supports "pragma once" correctly since 3.4
+#pragma once
+#endif
+
+#include "altsound.h"
+#include "altsound_cmd_decoder.hpp"
+#include "altsound_command_queue.hpp"
+#include "altsound_data.hpp"
+#include "altsound_housekeeper.hpp"
+#include "altsound_metrics.hpp"
+#include "altsound_mixer.hpp"
+#include "altsound_object_pool.hpp"
+#include "altsound_pack.hpp"
+#include "altsound_preloader.hpp"
+#include "altsound_read_ahead.hpp"
+#include "altsound_resampler.hpp"
+#include "altsound_sample_cache.hpp"
+#include "altsound_trace.hpp"
+#include "miniaudio_bass_compat.hpp"
+#include "miniaudio_private.h"
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <string>
+
+class AltsoundProcessorBase;
+
+// Host audio callback, published to the audio thread with an atomic pointer
+// swap. Bindings alternate between two buffers: a buffer is rewritten only
+// after the audio thread has been seen not using it
+struct AudioCallbackBinding {
+	AltSoundAudioCallback callback = nullptr;
+	void* userData = nullptr;
+};
+
+// Emulator time to mixer frame mapping for AltSoundProcessCommandAt().  Only
+// the emulator thread touches it
+struct ScheduleClock {
+	bool anchored = false;
+	uint64_t emu_ns = 0; // emulator time of the anchor
+	uint64_t frame = 0;  // mixer frame the anchor maps to
+};
+
+// ---------------------------------------------------------------------------
+// AltSoundContext definition
+//
+// Calls on one context follow the same threading rules as the AltSound*()
+// API.  Different contexts may be driven from different threads at once
+// ---------------------------------------------------------------------------
+
+struct AltSoundContext
+{
+	// Standard constructor
+	AltSoundContext();
+
+	// Copy constructor - NOT USED
+	AltSoundContext(AltSoundContext&) = delete;
+
+	// Destructor.  The context must be shut down
+	~AltSoundContext();
+
+	// output format and engine settings
+	ALTSOUND_RENDER_MODE render_mode = ALTSOUND_RENDER_MODE_CALLBACK;
+	uint32_t sample_rate = 44100;
+	uint32_t channels = 2;
+	uint32_t buffer_size_frames = 256;
+	AltsoundResampleQuality resample_quality = ALT_RESAMPLE_QUALITY_DEFAULT;
+	uint32_t read_ahead_threshold_ms = ALT_READ_AHEAD_THRESHOLD_DEFAULT_MS;
+
+	// command decoding for the ROM's hardware generation
+	ALTSOUND_HARDWARE_GEN hardware_gen = ALTSOUND_HARDWARE_GEN_NONE;
+	const AltsoundCmdDecoder* cmd_decoder;
+	CmdData cmd_data;
+
+	// the active processor and the streams it owns.  Stream handles and
+	// channel_stream are only modified under io_mutex
+	AltsoundProcessorBase* processor = nullptr;
+	std::mutex io_mutex;
+	StreamArray channel_stream;
+	AltsoundObjectPool<AltsoundStreamInfo> stream_info_pool;
+	MiniAudioStreamState streams;
+
+	// subsystems.  Threads are declared last, so they stop first
+	AltsoundMetrics metrics;
+	AltsoundTrace trace;
+	AltsoundSampleCache sample_cache;
+	AltsoundPack sample_pack;
+	AltsoundMixer mixer;
+	AltsoundReadAhead read_ahead;
+	AltsoundHousekeeper housekeeper;
+	AltsoundPreloader preloader;
+	AltsoundCommandQueue cmd_queue;
+
+	// callback mode output device
+	ma_device* device = nullptr;
+	ma_context* context = nullptr;
+	bool initialized = false;
+
+	// host audio callback
+	AudioCallbackBinding audio_bindings[2];
+	unsigned int audio_binding_next = 0;
+	std::atomic<const AudioCallbackBinding*> audio_binding{ nullptr };
+	std::atomic<const AudioCallbackBinding*> audio_binding_in_use{ nullptr };
+	std::mutex audio_binding_mutex; // serializes setters, never taken by the audio thread
+
+	// Pull mode: AltSoundRender() only runs the mixer while rendering is
+	// enabled, and shutdown waits for a render in flight before tearing down
+	std::atomic<bool> render_enabled{ false };
+	std::atomic<bool> render_in_flight{ false };
+
+	// where the event trace is written at shutdown, when tracing is enabled
+	std::string trace_path;
+
+	// timestamped command scheduling
+	ScheduleClock schedule_clock;
+	uint64_t schedule_latency_frames = 0;
+};
+
+#endif // ALTSOUND_CONTEXT_HPP
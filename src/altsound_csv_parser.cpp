@@ -191,7 +191,7 @@ bool AltsoundCsvParser::parse(std::vector<AltsoundSampleInfo>& samples_out)
 						 << ", NAME = " << entry.name
 						 << ", FNAME = " << entry.fname;
 
-			ALT_DEBUG(0, debug_stream.str().c_str());
+			ALT_DEBUG(0, "%s", debug_stream.str().c_str());
 		}
 	}
 	catch (std::exception& e) { // catch by reference
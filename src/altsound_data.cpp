@@ -14,6 +14,7 @@
 #include "altsound_logger.hpp"
 #include "miniaudio_bass_compat.hpp"
 
+#include <climits>
 #include <map>
 #include <sys/stat.h>
 
@@ -27,50 +28,110 @@ using std::string;
 
 extern AltsoundLogger alog;  // external global logger instance
 
+// ----------------------------------------------------------------------------
+// Helper function to reset a recycled _stream_info structure
+// ----------------------------------------------------------------------------
+
+void _stream_info::reset() {
+	hstream = 0;
+	hsync = 0;
+	stream_type = static_cast<AltsoundSampleType>(0);
+	channel_idx = 0;
+	sample_path.clear();
+	ducking_profile = 0;
+	ducking = 1.0f;
+	stop_music = false;
+	loop = false;
+	gain = 1.0f;
+	sample_data = nullptr;
+	sample_size = 0;
+	start_seq = 0;
+}
+
+// ----------------------------------------------------------------------------
+// StreamArray implementation
+// ----------------------------------------------------------------------------
+
+void StreamArray::init(unsigned int count_in, AltsoundObjectPool<AltsoundStreamInfo>& pool_in)
+{
+	pool = &pool_in;
+	streams.assign(count_in, nullptr);
+	free_pos.resize(count_in);
+	free_list.clear();
+	free_list.reserve(count_in);
+
+	// lowest channels are handed out first
+	for (unsigned int i = count_in; i > 0; --i) {
+		free_pos[i - 1] = static_cast<unsigned int>(free_list.size());
+		free_list.push_back(i - 1);
+	}
+	type_count.fill(0);
+}
+
+// ----------------------------------------------------------------------------
+
+void StreamArray::assign(unsigned int idx, AltsoundStreamInfo* stream)
+{
+	if (streams[idx] || !stream)
+		return;
+
+	// swap the channel with the last free entry and drop it
+	const unsigned int pos = free_pos[idx];
+	const unsigned int last = free_list.back();
+	free_list[pos] = last;
+	free_pos[last] = pos;
+	free_list.pop_back();
+	free_pos[idx] = UINT_MAX;
+
+	streams[idx] = stream;
+	++type_count[stream->stream_type];
+}
+
+// ----------------------------------------------------------------------------
+
+void StreamArray::release(unsigned int idx)
+{
+	AltsoundStreamInfo* stream = streams[idx];
+	if (!stream)
+		return;
+
+	--type_count[stream->stream_type];
+	streams[idx] = nullptr;
+	free_pos[idx] = static_cast<unsigned int>(free_list.size());
+	free_list.push_back(idx);
+
+	stream->hstream = MINIAUDIO_NO_STREAM;
+	pool->release(stream);
+}
+
 // ----------------------------------------------------------------------------
 // Helper function to print the ducking profiles in a _behavior_info structure
 // ----------------------------------------------------------------------------
 
+#if ALT_LOG_ENABLED(DEBUG)
 void _behavior_info::printDuckingProfiles() const {
-	for (const auto& profile : ducking_profiles) {
-		const DuckingProfile& dp = profile.second;
-		ALT_DEBUG(0, "Ducking %s, music_duck_vol: %f, callout_duck_vol: %f, sfx_duck_vol: %f, solo_duck_vol: %f, overlay_duck_vol: %f",
-			profile.first.c_str(), dp.music_duck_vol, dp.callout_duck_vol, dp.sfx_duck_vol, dp.solo_duck_vol, dp.overlay_duck_vol);
+	for (size_t num = 0; num < ducking_profiles.size(); ++num) {
+		const DuckingProfile& dp = ducking_profiles[num];
+		if (!dp.defined)
+			continue;
+
+		ALT_DEBUG(0, "Ducking profile%zu, music_duck_vol: %f, callout_duck_vol: %f, sfx_duck_vol: %f, solo_duck_vol: %f, overlay_duck_vol: %f",
+			num, dp.duck_vol[0], dp.duck_vol[1], dp.duck_vol[2], dp.duck_vol[3], dp.duck_vol[4]);
 	}
 }
+#endif
 
 // ---------------------------------------------------------------------------
 // Helper function to find ducking_profiles stored in the _behavior_info
 // structure
 // ---------------------------------------------------------------------------
 
-float _behavior_info::getDuckVolume(unsigned int profile_num, AltsoundSampleType type) const
+float _behavior_info::getDuckVolume(unsigned int profile_num, unsigned int type_idx) const
 {
-	const std::string profile_key = "profile" + std::to_string(profile_num);
-
-	const auto it = ducking_profiles.find(profile_key);
-	if (it != ducking_profiles.end()) {
-		const _ducking_profile& profile = it->second;
-
-		switch (type) {
-		case AltsoundSampleType::MUSIC:
-			return profile.music_duck_vol;
-		case AltsoundSampleType::CALLOUT:
-			return profile.callout_duck_vol;
-		case AltsoundSampleType::SFX:
-			return profile.sfx_duck_vol;
-		case AltsoundSampleType::SOLO:
-			return profile.solo_duck_vol;
-		case AltsoundSampleType::OVERLAY:
-			return profile.overlay_duck_vol;
-		default:
-			return 1.0f;
-		}
-	}
-	else {
-		ALT_ERROR(0, "Ducking Profile %s not found.  Using default", profile_key.c_str());
-	}
+	if (profile_num < ducking_profiles.size() && ducking_profiles[profile_num].defined && type_idx < 5)
+		return ducking_profiles[profile_num].duck_vol[type_idx];
 
+	ALT_ERROR(0, "Ducking Profile profile%u not found.  Using default", profile_num);
 	return 1.0f;
 }
 
@@ -92,6 +153,35 @@ const char* toString(AltsoundSampleType sampleType)
 	}
 }
 
+// ---------------------------------------------------------------------------
+// Helper functions to translate AltsoundStealPolicy constants to and from
+// strings
+// ---------------------------------------------------------------------------
+
+const char* toString(AltsoundStealPolicy policy)
+{
+	switch (policy) {
+	case ALT_STEAL_NONE:     return "none";
+	case ALT_STEAL_OLDEST:   return "oldest";
+	case ALT_STEAL_QUIETEST: return "quietest";
+	default:                 return "unknown";
+	}
+}
+
+bool toStealPolicy(const std::string& policy_in, AltsoundStealPolicy& policy_out)
+{
+	if (policy_in == "none")
+		policy_out = ALT_STEAL_NONE;
+	else if (policy_in == "oldest")
+		policy_out = ALT_STEAL_OLDEST;
+	else if (policy_in == "quietest")
+		policy_out = ALT_STEAL_QUIETEST;
+	else
+		return false;
+
+	return true;
+}
+
 // ---------------------------------------------------------------------------
 // Helper function to translate string reprsentation of AltsoundSampleType to
 // enum value
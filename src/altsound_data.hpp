@@ -1,10 +1,8 @@
 // ---------------------------------------------------------------------------
 // altsound_data.hpp
 //
-// Holds global variables and structures in support of AltSound processing.
-// This provides a cleaner separation between the legacy C code and the new C++
-// code, and is necessary to ensure that only one instance of these exist
-// across multiple compilation units
+// Holds structures in support of AltSound processing.  This provides a
+// cleaner separation between the legacy C code and the new C++ code
 // ---------------------------------------------------------------------------
 // license:BSD-3-Clause
 // copyright-holders:Dave Roscoe
@@ -28,15 +26,22 @@
  #endif
 #endif
 
+#include "altsound_object_pool.hpp"
+
 #include <array>
 #include <bitset>
+#include <string>
 #include <unordered_map>
 #include <vector>
 #include <cstdint>
 
 #define ALT_MAX_CMDS 4
 #define MINIAUDIO_NO_STREAM 0
-#define ALT_MAX_CHANNELS 16
+#define ALT_MAX_CHANNELS 256
+#define ALT_DEFAULT_CHANNELS 16
+#define ALT_STEAL_FADE_DEFAULT_MS 10
+#define ALT_NUM_SAMPLE_TYPES 7
+#define ALT_MAX_DUCKING_PROFILES 256
 
 #define LOG // DAR_TODO remove when logging converted
 
@@ -53,7 +58,6 @@ typedef struct _cmd_data {
 
 struct _stream_info;  // forward declaration for clarity
 typedef _stream_info AltsoundStreamInfo;
-typedef std::array<AltsoundStreamInfo*, ALT_MAX_CHANNELS> StreamArray;
 
 enum AltsoundSampleType {
 	UNDEFINED = 0,
@@ -77,15 +81,93 @@ struct _stream_info {
 	bool stop_music = false;
 	bool loop = false;
 	float gain = 1.0f;
+	const void* sample_data = nullptr; // encoded sample in a mapped .altpack
+	uint64_t sample_size = 0;
+	uint64_t start_seq = 0; // creation order, for voice stealing
+
+	// Restore defaults for a recycled object. Keeps the sample_path buffer
+	// so reuse does not allocate
+	void reset();
+};
+
+// How a channel is found for a new sample when none is free, or when its
+// sample type is at its cap
+enum AltsoundStealPolicy {
+	ALT_STEAL_NONE = 0, // drop the new sample
+	ALT_STEAL_OLDEST,   // stop the oldest SFX stream, else the oldest stream
+	ALT_STEAL_QUIETEST  // stop the stream playing at the lowest volume
+};
+
+// Voice allocation settings
+typedef struct _voice_policy {
+	unsigned int voices = ALT_DEFAULT_CHANNELS;
+	AltsoundStealPolicy steal = ALT_STEAL_OLDEST;
+	unsigned int fade_ms = ALT_STEAL_FADE_DEFAULT_MS; // fade-out of a stolen stream
+
+	// Most streams of each sample type at once, indexed by
+	// AltsoundSampleType.  0 = no cap
+	std::array<unsigned int, ALT_NUM_SAMPLE_TYPES> type_caps = {};
+} AltsoundVoicePolicy;
+
+// ---------------------------------------------------------------------------
+// StreamArray class definition
+//
+// Active streams by channel, sized at init.  Free channels are kept on a list,
+// so finding one takes constant time, and streams are counted by sample type
+// for the voice caps.  Only used on the command path, under the context's
+// io_mutex
+// ---------------------------------------------------------------------------
+
+class StreamArray
+{
+public:
+
+	using const_iterator = std::vector<AltsoundStreamInfo*>::const_iterator;
+
+	// Size the array to count_in free channels, returning released streams
+	// to pool_in.  Streams still stored are forgotten, not released
+	void init(unsigned int count_in, AltsoundObjectPool<AltsoundStreamInfo>& pool_in);
+
+	// Number of channels
+	size_t size() const;
+
+	// Stream on a channel, nullptr when free
+	AltsoundStreamInfo* operator[](size_t idx) const;
+
+	const_iterator begin() const;
+	const_iterator end() const;
+
+	// Get a free channel.  Returns false if all are in use
+	bool findFree(unsigned int& idx_out) const;
+
+	// Store a stream on a free channel
+	void assign(unsigned int idx, AltsoundStreamInfo* stream);
+
+	// Return a channel's stream to its pool and free the channel.
+	// The stream's handle is cleared, so a SYNCPROC still queued for it no
+	// longer matches
+	void release(unsigned int idx);
+
+	// Number of channels in use
+	unsigned int getActiveCount() const;
+
+	// Number of channels in use by a sample type
+	unsigned int getTypeCount(AltsoundSampleType type) const;
+
+private: // data
+
+	AltsoundObjectPool<AltsoundStreamInfo>* pool = nullptr;
+	std::vector<AltsoundStreamInfo*> streams;
+	std::vector<unsigned int> free_list;
+	std::vector<unsigned int> free_pos; // position in free_list, or UINT_MAX when in use
+	std::array<unsigned int, ALT_NUM_SAMPLE_TYPES> type_count = {};
 };
 
-// Structure for storing G-Sound ducking profiles
+// Structure for storing G-Sound ducking profiles.  Volumes are indexed by
+// BehaviorInfo::BehaviorBits
 typedef struct _ducking_profile {
-	float music_duck_vol = 1.0f;
-	float callout_duck_vol = 1.0f;
-	float sfx_duck_vol = 1.0f;
-	float solo_duck_vol = 1.0f;
-	float overlay_duck_vol = 1.0f;
+	bool defined = false;
+	std::array<float, 5> duck_vol = { 1.0f, 1.0f, 1.0f, 1.0f, 1.0f };
 } DuckingProfile;
 
 // Structure for managing G-Sound sample type behavior
@@ -98,16 +180,31 @@ typedef struct _behavior_info {
 		OVERLAY
 	};
 
+	// Compiled impacts on a sample type
+	enum Action : uint8_t {
+		ACTION_STOP  = 0x01,
+		ACTION_PAUSE = 0x02,
+		ACTION_DUCK  = 0x04
+	};
+
 	std::bitset<5> ducks = 0;
 	std::bitset<5> stops = 0;
 	std::bitset<5> pauses = 0;
 
 	float group_vol = 1.0f;
 
-	std::unordered_map<std::string, _ducking_profile> ducking_profiles;
+	// Ducking profiles, indexed by profile number
+	std::vector<_ducking_profile> ducking_profiles;
 
-	// For ducking volume for supplied sample type in supplied profile ID
-	float getDuckVolume(unsigned int profile_num, AltsoundSampleType type) const;
+	// Compiled from the bitsets by AltsoundIniProcessor at load time: the
+	// actions on each sample type, indexed by BehaviorBits, and a mask of the
+	// sample types with any action
+	std::array<uint8_t, 5> actions = {};
+	uint32_t action_mask = 0;
+
+	// For ducking volume for supplied sample type (BehaviorBits index) in
+	// supplied profile ID
+	float getDuckVolume(unsigned int profile_num, unsigned int type_idx) const;
 
 	// Debug helper to print contents of stored ducking profiles
 	void printDuckingProfiles() const;
@@ -124,6 +221,8 @@ typedef struct _altsound_sample_info {
 	bool stop;
 	std::string name;
 	std::string fname;
+	const void* data = nullptr; // encoded sample in a mapped .altpack
+	uint64_t data_size = 0;
 } AltsoundSampleInfo;
 
 // DAR_TODO do we need "duck" here?
@@ -136,6 +235,8 @@ typedef struct _gsound_sample_info {
 	std::string fname;
 	bool loop = false;
 	unsigned int ducking_profile = 0;
+	const void* data = nullptr; // encoded sample in a mapped .altpack
+	uint64_t data_size = 0;
 } GSoundSampleInfo;
 
 // ---------------------------------------------------------------------------
@@ -151,6 +252,13 @@ const char* toString(AltsoundSampleType sampleType);
 // tranlsate string representation of AltsoundSample to enum value
 AltsoundSampleType toSampleType(const std::string& type_in);
 
+// translate AltsoundStealPolicy enum values to strings
+const char* toString(AltsoundStealPolicy policy);
+
+// translate string representation of AltsoundStealPolicy to enum value.
+// Returns false for unknown names
+bool toStealPolicy(const std::string& policy_in, AltsoundStealPolicy& policy_out);
+
 // determine if the given path exists
 bool dir_exists(const std::string& path_in);
 
@@ -160,4 +268,52 @@ std::string trim(const std::string& str);
 // convert string to lowercase
 std::string toLowerCase(const std::string& str);
 
+// ----------------------------------------------------------------------------
+// Inline functions
+// ----------------------------------------------------------------------------
+
+inline size_t StreamArray::size() const {
+	return streams.size();
+}
+
+// ----------------------------------------------------------------------------
+
+inline AltsoundStreamInfo* StreamArray::operator[](size_t idx) const {
+	return streams[idx];
+}
+
+// ----------------------------------------------------------------------------
+
+inline StreamArray::const_iterator StreamArray::begin() const {
+	return streams.begin();
+}
+
+// ----------------------------------------------------------------------------
+
+inline StreamArray::const_iterator StreamArray::end() const {
+	return streams.end();
+}
+
+// ----------------------------------------------------------------------------
+
+inline bool StreamArray::findFree(unsigned int& idx_out) const {
+	if (free_list.empty())
+		return false;
+
+	idx_out = free_list.back();
+	return true;
+}
+
+// ----------------------------------------------------------------------------
+
+inline unsigned int StreamArray::getActiveCount() const {
+	return static_cast<unsigned int>(streams.size() - free_list.size());
+}
+
+// ----------------------------------------------------------------------------
+
+inline unsigned int StreamArray::getTypeCount(AltsoundSampleType type) const {
+	return type_count[type];
+}
+
 #endif // ALTSOUND_DATA_H
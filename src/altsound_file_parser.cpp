@@ -235,7 +235,7 @@ bool AltsoundFileParser::parse(std::vector<AltsoundSampleInfo>& samples_out)
 							<< ", LOOP = " << sample.loop
 							<< ", FNAME = " << sample.fname;
 
-						ALT_DEBUG(0, debug_stream.str().c_str());
+						ALT_DEBUG(0, "%s", debug_stream.str().c_str());
 					}
 					entry2 = readdir(dir2);
 				}
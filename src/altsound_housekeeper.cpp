@@ -0,0 +1,139 @@
+// ---------------------------------------------------------------------------
+// altsound_housekeeper.cpp
+//
+// Background thread that runs end-of-stream SYNCPROCs
+// ---------------------------------------------------------------------------
+// license:BSD-3-Clause
+// ---------------------------------------------------------------------------
+
+#include "altsound_housekeeper.hpp"
+#include "altsound_metrics.hpp"
+#include "altsound_trace.hpp"
+
+#include <chrono>
+
+// ----------------------------------------------------------------------------
+// Helper function to read the monotonic clock in nanoseconds
+// ----------------------------------------------------------------------------
+
+static uint64_t housekeeperNow()
+{
+	return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+		std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+// ----------------------------------------------------------------------------
+// Functional code
+// ----------------------------------------------------------------------------
+
+AltsoundHousekeeper::AltsoundHousekeeper(AltsoundMetrics& metrics_in, AltsoundTrace& trace_in)
+: metrics(metrics_in),
+  trace(trace_in)
+{
+}
+
+// ----------------------------------------------------------------------------
+
+AltsoundHousekeeper::~AltsoundHousekeeper()
+{
+	stop();
+}
+
+// ----------------------------------------------------------------------------
+
+void AltsoundHousekeeper::start(bool use_thread)
+{
+	stop();
+
+	dispatched.store(0, std::memory_order_relaxed);
+	dropped.store(0, std::memory_order_relaxed);
+	max_depth.store(0, std::memory_order_relaxed);
+	max_latency_ns.store(0, std::memory_order_relaxed);
+	total_latency_ns.store(0, std::memory_order_relaxed);
+
+	if (!use_thread)
+		return;
+
+	running.store(true, std::memory_order_release);
+	thread = std::thread(&AltsoundHousekeeper::threadProc, this);
+}
+
+// ----------------------------------------------------------------------------
+
+void AltsoundHousekeeper::stop()
+{
+	if (thread.joinable()) {
+		running.store(false, std::memory_order_release);
+		wake_seq.fetch_add(1, std::memory_order_release);
+		wake_seq.notify_one();
+		thread.join();
+	}
+
+	EndedStream ended;
+	while (queue.pop(ended)) {}
+}
+
+// ----------------------------------------------------------------------------
+
+void AltsoundHousekeeper::post(EndedStream ended_in)
+{
+	ended_in.queued_ns = housekeeperNow();
+	if (!queue.push(ended_in)) {
+		dropped.fetch_add(1, std::memory_order_relaxed);
+		return;
+	}
+
+	wake_seq.fetch_add(1, std::memory_order_release);
+	wake_seq.notify_one();
+}
+
+// ----------------------------------------------------------------------------
+
+HousekeeperStats AltsoundHousekeeper::getStats() const
+{
+	HousekeeperStats stats;
+	stats.dispatched = dispatched.load(std::memory_order_relaxed);
+	stats.dropped = dropped.load(std::memory_order_relaxed);
+	stats.max_depth = max_depth.load(std::memory_order_relaxed);
+	stats.max_latency_ns = max_latency_ns.load(std::memory_order_relaxed);
+	stats.total_latency_ns = total_latency_ns.load(std::memory_order_relaxed);
+	return stats;
+}
+
+// ----------------------------------------------------------------------------
+
+void AltsoundHousekeeper::threadProc()
+{
+	trace.setThreadName("housekeeping");
+	uint32_t seq = wake_seq.load(std::memory_order_acquire);
+
+	while (running.load(std::memory_order_acquire)) {
+		dispatch();
+
+		// sleep until post() or stop() bumps the sequence
+		wake_seq.wait(seq, std::memory_order_acquire);
+		seq = wake_seq.load(std::memory_order_acquire);
+	}
+}
+
+// ----------------------------------------------------------------------------
+
+void AltsoundHousekeeper::dispatch()
+{
+	const uint32_t depth = static_cast<uint32_t>(queue.size());
+	if (depth > max_depth.load(std::memory_order_relaxed))
+		max_depth.store(depth, std::memory_order_relaxed);
+
+	EndedStream ended;
+	while (queue.pop(ended)) {
+		const uint64_t latency = housekeeperNow() - ended.queued_ns;
+		total_latency_ns.fetch_add(latency, std::memory_order_relaxed);
+		if (latency > max_latency_ns.load(std::memory_order_relaxed))
+			max_latency_ns.store(latency, std::memory_order_relaxed);
+		metrics.record(ALTSOUND_STAGE_SYNCPROC_DELAY, latency);
+
+		AltsoundTraceScope trace_scope(trace, "SYNCPROC", "hstream", ended.hstream);
+		ended.callback(ended.hsync, ended.hstream, 0, ended.userdata);
+		dispatched.fetch_add(1, std::memory_order_relaxed);
+	}
+}
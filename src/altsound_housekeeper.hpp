@@ -0,0 +1,95 @@
+// ---------------------------------------------------------------------------
+// altsound_housekeeper.hpp
+//
+// Background thread that runs end-of-stream SYNCPROCs, so the audio thread
+// only mixes
+// ---------------------------------------------------------------------------
+// license:BSD-3-Clause
+// ---------------------------------------------------------------------------
+
+#ifndef ALTSOUND_HOUSEKEEPER_HPP
+#define ALTSOUND_HOUSEKEEPER_HPP
+#if !defined(__GNUC__) || (__GNUC__ == 3 && __GNUC_MINOR__ >= 4) || (__GNUC__ >= 4)	// GCC supports "pragma once" correctly since 3.4
+#pragma once
+#endif
+
+#include "miniaudio_bass_compat.hpp"
+
+#include <atomic>
+#include <cstdint>
+#include <thread>
+
+class AltsoundMetrics;
+class AltsoundTrace;
+
+// Queue statistics since start()
+struct HousekeeperStats {
+	uint64_t dispatched = 0;     // SYNCPROCs run
+	uint64_t dropped = 0;        // notifications lost to a full queue
+	uint32_t max_depth = 0;      // most notifications waiting at once
+	uint64_t max_latency_ns = 0; // longest time from stream end to SYNCPROC
+	uint64_t total_latency_ns = 0;
+};
+
+// ---------------------------------------------------------------------------
+// AltsoundHousekeeper class definition
+//
+// The miniaudio end callback post()s ended streams from the audio thread.
+// post() never blocks: it pushes onto a lock-free ring and wakes the thread
+// through an atomic wait
+// ---------------------------------------------------------------------------
+
+class AltsoundHousekeeper
+{
+public:
+
+	// Standard constructor
+	AltsoundHousekeeper(AltsoundMetrics& metrics_in, AltsoundTrace& trace_in);
+
+	// Copy constructor - NOT USED
+	AltsoundHousekeeper(AltsoundHousekeeper&) = delete;
+
+	// Destructor
+	~AltsoundHousekeeper();
+
+	// Reset the statistics and start the thread.  Without a thread, queued
+	// SYNCPROCs only run when dispatch() is called
+	void start(bool use_thread = true);
+
+	// Join the thread, if any.  Notifications still queued are discarded
+	void stop();
+
+	// Queue an ended stream.  Safe from any thread, including the audio thread
+	void post(EndedStream ended_in);
+
+	// Run every queued SYNCPROC on the calling thread.  Used instead of the
+	// thread for offline rendering, so end-of-stream handling happens at a
+	// deterministic point
+	void dispatch();
+
+	// Get queue statistics
+	HousekeeperStats getStats() const;
+
+private: // functions
+
+	// thread entry point
+	void threadProc();
+
+private: // data
+
+	AltsoundMetrics& metrics;
+	AltsoundTrace& trace;
+	EndedStreamQueue queue;
+	std::thread thread;
+
+	std::atomic<uint32_t> wake_seq{ 0 };
+	std::atomic<bool> running{ false };
+
+	std::atomic<uint64_t> dispatched{ 0 };
+	std::atomic<uint64_t> dropped{ 0 };
+	std::atomic<uint32_t> max_depth{ 0 };
+	std::atomic<uint64_t> max_latency_ns{ 0 };
+	std::atomic<uint64_t> total_latency_ns{ 0 };
+};
+
+#endif // ALTSOUND_HOUSEKEEPER_HPP
@@ -9,6 +9,7 @@
 
 #include "altsound_ini_processor.hpp"
 #include "altsound_logger.hpp"
+#include "altsound_pack.hpp"
 
 // ----------------------------------------------------------------------------
 // Global variables
@@ -17,13 +18,6 @@
 // reference to global AltSound logger
 extern AltsoundLogger alog;
 
-// references to global G-Sound behaviors
-extern BehaviorInfo music_behavior;
-extern BehaviorInfo callout_behavior;
-extern BehaviorInfo sfx_behavior;
-extern BehaviorInfo solo_behavior;
-extern BehaviorInfo overlay_behavior;
-
 // ----------------------------------------------------------------------------
 // Functional code
 // ----------------------------------------------------------------------------
@@ -99,6 +93,198 @@ bool AltsoundIniProcessor::parse_altsound_ini(const string& path_in)
 		return false;
 	}
 
+	// get sample cache budget
+	string cache_mb_str;
+	inipp::get_value(ini.sections["system"], "sample_cache_mb", cache_mb_str);
+	try {
+		if (!cache_mb_str.empty()) {
+			const int val = std::stoi(cache_mb_str);
+			sample_cache_mb = val < 0 ? 0 : val;
+			ALT_INFO(0, "Parsed \"sample_cache_mb\": %u", sample_cache_mb);
+		}
+	}
+	catch (const std::invalid_argument& e) {
+		ALT_ERROR(0, "Invalid number format while parsing sample_cache_mb value: %s\n", cache_mb_str.c_str());
+		return false;
+	}
+	catch (const std::out_of_range& e) {
+		ALT_ERROR(0, "Number out of range while parsing sample_cache_mb value: %s\n", cache_mb_str.c_str());
+		return false;
+	}
+
+	// get sample preload flag
+	string preload_str;
+	inipp::get_value(ini.sections["system"], "preload_samples", preload_str);
+	if (!preload_str.empty())
+		preload_samples = (preload_str == "1");
+	ALT_INFO(0, "Parsed \"preload_samples\": %s", preload_samples ? "true" : "false");
+
+	// get preload worker count
+	string preload_threads_str;
+	inipp::get_value(ini.sections["system"], "preload_threads", preload_threads_str);
+	try {
+		if (!preload_threads_str.empty()) {
+			const int val = std::stoi(preload_threads_str);
+			preload_threads = val < 0 ? 0 : val;
+			ALT_INFO(0, "Parsed \"preload_threads\": %u", preload_threads);
+		}
+	}
+	catch (const std::invalid_argument& e) {
+		ALT_ERROR(0, "Invalid number format while parsing preload_threads value: %s\n", preload_threads_str.c_str());
+		return false;
+	}
+	catch (const std::out_of_range& e) {
+		ALT_ERROR(0, "Number out of range while parsing preload_threads value: %s\n", preload_threads_str.c_str());
+		return false;
+	}
+
+	// get asynchronous command processing flag
+	string async_str;
+	inipp::get_value(ini.sections["system"], "async_commands", async_str);
+	if (!async_str.empty())
+		async_commands = (async_str == "1");
+	ALT_INFO(0, "Parsed \"async_commands\": %s", async_commands ? "true" : "false");
+
+	// get timestamped command latency
+	string schedule_latency_str;
+	inipp::get_value(ini.sections["system"], "schedule_latency_ms", schedule_latency_str);
+	try {
+		if (!schedule_latency_str.empty()) {
+			const int val = std::stoi(schedule_latency_str);
+			schedule_latency_ms = val < 0 ? 0 : val;
+			ALT_INFO(0, "Parsed \"schedule_latency_ms\": %u", schedule_latency_ms);
+		}
+	}
+	catch (const std::invalid_argument& e) {
+		ALT_ERROR(0, "Invalid number format while parsing schedule_latency_ms value: %s\n", schedule_latency_str.c_str());
+		return false;
+	}
+	catch (const std::out_of_range& e) {
+		ALT_ERROR(0, "Number out of range while parsing schedule_latency_ms value: %s\n", schedule_latency_str.c_str());
+		return false;
+	}
+
+	// get load-time resampling quality
+	string resample_quality_str;
+	inipp::get_value(ini.sections["system"], "resample_quality", resample_quality_str);
+	if (!resample_quality_str.empty()) {
+		if (!altsound_parse_resample_quality(normalizeString(resample_quality_str), resample_quality)) {
+			ALT_ERROR(0, "Unknown resample_quality value: %s", resample_quality_str.c_str());
+			return false;
+		}
+	}
+	ALT_INFO(0, "Parsed \"resample_quality\": %s", altsound_resample_quality_name(resample_quality));
+
+	// get length above which samples are decoded ahead
+	string read_ahead_threshold_ms_str;
+	inipp::get_value(ini.sections["system"], "read_ahead_threshold_ms", read_ahead_threshold_ms_str);
+	try {
+		if (!read_ahead_threshold_ms_str.empty()) {
+			const int val = std::stoi(read_ahead_threshold_ms_str);
+			read_ahead_threshold_ms = val < 0 ? 0 : val;
+			ALT_INFO(0, "Parsed \"read_ahead_threshold_ms\": %u", read_ahead_threshold_ms);
+		}
+	}
+	catch (const std::invalid_argument& e) {
+		ALT_ERROR(0, "Invalid number format while parsing read_ahead_threshold_ms value: %s\n", read_ahead_threshold_ms_str.c_str());
+		return false;
+	}
+	catch (const std::out_of_range& e) {
+		ALT_ERROR(0, "Number out of range while parsing read_ahead_threshold_ms value: %s\n", read_ahead_threshold_ms_str.c_str());
+		return false;
+	}
+
+	// get read-ahead buffer length
+	string read_ahead_buffer_ms_str;
+	inipp::get_value(ini.sections["system"], "read_ahead_buffer_ms", read_ahead_buffer_ms_str);
+	try {
+		if (!read_ahead_buffer_ms_str.empty()) {
+			const int val = std::stoi(read_ahead_buffer_ms_str);
+			read_ahead_buffer_ms = val < 0 ? 0 : val;
+			ALT_INFO(0, "Parsed \"read_ahead_buffer_ms\": %u", read_ahead_buffer_ms);
+		}
+	}
+	catch (const std::invalid_argument& e) {
+		ALT_ERROR(0, "Invalid number format while parsing read_ahead_buffer_ms value: %s\n", read_ahead_buffer_ms_str.c_str());
+		return false;
+	}
+	catch (const std::out_of_range& e) {
+		ALT_ERROR(0, "Number out of range while parsing read_ahead_buffer_ms value: %s\n", read_ahead_buffer_ms_str.c_str());
+		return false;
+	}
+
+	// get voice count
+	string voices_str;
+	inipp::get_value(ini.sections["system"], "voices", voices_str);
+	try {
+		if (!voices_str.empty()) {
+			const int val = std::stoi(voices_str);
+			voice_policy.voices = clamp(val, 1, ALT_MAX_CHANNELS);
+			ALT_INFO(0, "Parsed \"voices\": %u", voice_policy.voices);
+		}
+	}
+	catch (const std::invalid_argument& e) {
+		ALT_ERROR(0, "Invalid number format while parsing voices value: %s\n", voices_str.c_str());
+		return false;
+	}
+	catch (const std::out_of_range& e) {
+		ALT_ERROR(0, "Number out of range while parsing voices value: %s\n", voices_str.c_str());
+		return false;
+	}
+
+	// get voice steal policy
+	string voice_steal_str;
+	inipp::get_value(ini.sections["system"], "voice_steal", voice_steal_str);
+	if (!voice_steal_str.empty()) {
+		if (!toStealPolicy(normalizeString(voice_steal_str), voice_policy.steal)) {
+			ALT_ERROR(0, "Unknown voice_steal value: %s", voice_steal_str.c_str());
+			return false;
+		}
+	}
+	ALT_INFO(0, "Parsed \"voice_steal\": %s", toString(voice_policy.steal));
+
+	// get fade-out of stolen streams
+	string steal_fade_str;
+	inipp::get_value(ini.sections["system"], "steal_fade_ms", steal_fade_str);
+	try {
+		if (!steal_fade_str.empty()) {
+			const int val = std::stoi(steal_fade_str);
+			voice_policy.fade_ms = val < 0 ? 0 : val;
+			ALT_INFO(0, "Parsed \"steal_fade_ms\": %u", voice_policy.fade_ms);
+		}
+	}
+	catch (const std::invalid_argument& e) {
+		ALT_ERROR(0, "Invalid number format while parsing steal_fade_ms value: %s\n", steal_fade_str.c_str());
+		return false;
+	}
+	catch (const std::out_of_range& e) {
+		ALT_ERROR(0, "Number out of range while parsing steal_fade_ms value: %s\n", steal_fade_str.c_str());
+		return false;
+	}
+
+	// get per-sample-type voice caps
+	static const AltsoundSampleType capped_types[] = { MUSIC, JINGLE, SFX, CALLOUT, SOLO, OVERLAY };
+	for (const AltsoundSampleType type : capped_types) {
+		const string key = toLowerCase(toString(type));
+		string cap_str;
+		inipp::get_value(ini.sections["voice_limits"], key, cap_str);
+		try {
+			if (!cap_str.empty()) {
+				const int val = std::stoi(cap_str);
+				voice_policy.type_caps[type] = val < 0 ? 0 : val;
+				ALT_INFO(0, "Parsed voice limit \"%s\": %u", key.c_str(), voice_policy.type_caps[type]);
+			}
+		}
+		catch (const std::invalid_argument& e) {
+			ALT_ERROR(0, "Invalid number format while parsing %s voice limit: %s\n", key.c_str(), cap_str.c_str());
+			return false;
+		}
+		catch (const std::out_of_range& e) {
+			ALT_ERROR(0, "Number out of range while parsing %s voice limit: %s\n", key.c_str(), cap_str.c_str());
+			return false;
+		}
+	}
+
 	// get AltSound format type
 	inipp::get_value(ini.sections["format"], "format", altsound_format);
 	altsound_format = normalizeString(altsound_format);
@@ -113,15 +299,19 @@ bool AltsoundIniProcessor::parse_altsound_ini(const string& path_in)
 	string logging;
 	inipp::get_value(ini.sections["logging"], "logging_level", logging);
 	ALT_INFO(0, "Parsed \"logging_level\": %s", logging.c_str());
-	const AltsoundLogger::Level level = alog.toLogLevel(logging);
-	if (level == AltsoundLogger::UNDEFINED) {
+	log_level = alog.toLogLevel(logging);
+	if (log_level == AltsoundLogger::UNDEFINED) {
 		ALT_ERROR(0, "Unknown log level: %s. Defaulting to Error logging", logging.c_str());
-		alog.setLogLevel(AltsoundLogger::Level::Error);
-	}
-	else {
-		alog.setLogLevel(level);
+		log_level = AltsoundLogger::Level::Error;
 	}
 
+	// get event tracing flag
+	string trace_str;
+	inipp::get_value(ini.sections["logging"], "trace_events", trace_str);
+	if (!trace_str.empty())
+		trace_events = (trace_str == "1");
+	ALT_INFO(0, "Parsed \"trace_events\": %s", trace_events ? "true" : "false");
+
 	// ------------------------------------------------------------------------
 	// Behavior parsing
 	// ------------------------------------------------------------------------
@@ -129,6 +319,13 @@ bool AltsoundIniProcessor::parse_altsound_ini(const string& path_in)
 	using BB = BehaviorInfo::BehaviorBits;
 	bool success = true;
 
+	// start from defaults, in case a file was parsed before
+	music_behavior = BehaviorInfo();
+	callout_behavior = BehaviorInfo();
+	sfx_behavior = BehaviorInfo();
+	solo_behavior = BehaviorInfo();
+	overlay_behavior = BehaviorInfo();
+
 	// ------------------------------------------------------------------------
 	// MUSIC behavior parsing
 	// ------------------------------------------------------------------------
@@ -298,6 +495,16 @@ bool AltsoundIniProcessor::parse_altsound_ini(const string& path_in)
 	// Parse OVERLAY "GROUP_VOL" behavior
 	success &= parseVolumeValue(overlay_section, "group_vol", overlay_behavior.group_vol);
 
+	// ------------------------------------------------------------------------
+	// Compile behaviors into dense tables for stream start/stop processing
+	// ------------------------------------------------------------------------
+
+	compileBehavior(music_behavior, BB::MUSIC);
+	compileBehavior(callout_behavior, BB::CALLOUT);
+	compileBehavior(sfx_behavior, BB::SFX);
+	compileBehavior(solo_behavior, BB::SOLO);
+	compileBehavior(overlay_behavior, BB::OVERLAY);
+
 	// ------------------------------------------------------------------------
 
 	ALT_OUTDENT;
@@ -305,6 +512,22 @@ bool AltsoundIniProcessor::parse_altsound_ini(const string& path_in)
 	return success;
 }
 
+// ----------------------------------------------------------------------------
+
+const BehaviorInfo& AltsoundIniProcessor::getBehavior(AltsoundSampleType type) const
+{
+	static const BehaviorInfo default_behavior;
+
+	switch (type) {
+	case MUSIC:   return music_behavior;
+	case CALLOUT: return callout_behavior;
+	case SFX:     return sfx_behavior;
+	case SOLO:    return solo_behavior;
+	case OVERLAY: return overlay_behavior;
+	default:      return default_behavior;
+	}
+}
+
 // ---------------------------------------------------------------------------
 // Helper function to parse G-Sound behavior values
 // ---------------------------------------------------------------------------
@@ -371,7 +594,7 @@ bool AltsoundIniProcessor::parseVolumeValue(const IniSection& section, const str
 // Helper function to parse G-Sound ducking profiles
 // ---------------------------------------------------------------------------
 
-bool AltsoundIniProcessor::parseDuckingProfile(const IniSection& ducking_section, ProfileMap& profiles)
+bool AltsoundIniProcessor::parseDuckingProfile(const IniSection& ducking_section, ProfileTable& profiles)
 {
 	ALT_DEBUG(0, "BEGIN AltsoundIniProcessor::parseDuckingProfile()");
 	ALT_INDENT;
@@ -407,10 +630,20 @@ bool AltsoundIniProcessor::parseDuckingProfile(const IniSection& ducking_section
 			return false;
 		}
 
+		// Profiles are stored by number, so keep the table small
+		if (profile_number < 0 || profile_number >= ALT_MAX_DUCKING_PROFILES) {
+			ALT_ERROR(1, "Profile number out of range (0-%d): %d", ALT_MAX_DUCKING_PROFILES - 1, profile_number);
+
+			ALT_OUTDENT;
+			ALT_DEBUG(0, "END AltsoundIniProcessor::parseDuckingProfile()");
+			return false;
+		}
+
 		// Parse the value to extract the individual tokens and volume values
 		std::istringstream valueStream(value);
 		string token;
 		DuckingProfile profile;
+		profile.defined = true;
 
 		while (std::getline(valueStream, token, ',')) {
 			// Extract the label and volume value
@@ -440,19 +673,19 @@ bool AltsoundIniProcessor::parseDuckingProfile(const IniSection& ducking_section
 
 			// Set the corresponding volume based on the label
 			if (label == "music") {
-				profile.music_duck_vol = volume;
+				profile.duck_vol[static_cast<int>(BehaviorInfo::BehaviorBits::MUSIC)] = volume;
 			}
 			else if (label == "callout") {
-				profile.callout_duck_vol = volume;
+				profile.duck_vol[static_cast<int>(BehaviorInfo::BehaviorBits::CALLOUT)] = volume;
 			}
 			else if (label == "sfx") {
-				profile.sfx_duck_vol = volume;
+				profile.duck_vol[static_cast<int>(BehaviorInfo::BehaviorBits::SFX)] = volume;
 			}
 			else if (label == "solo") {
-				profile.solo_duck_vol = volume;
+				profile.duck_vol[static_cast<int>(BehaviorInfo::BehaviorBits::SOLO)] = volume;
 			}
 			else if (label == "overlay") {
-				profile.overlay_duck_vol = volume;
+				profile.duck_vol[static_cast<int>(BehaviorInfo::BehaviorBits::OVERLAY)] = volume;
 			}
 			else {
 				ALT_ERROR(1, "Unknown sample type label: %s", label.c_str());
@@ -463,9 +696,10 @@ bool AltsoundIniProcessor::parseDuckingProfile(const IniSection& ducking_section
 			}
 		}
 
-		// Store the parsed profile in the ducking_profiles map
-		string profileKey = "profile" + std::to_string(profile_number);
-		profiles[profileKey] = profile;
+		// Store the parsed profile in the ducking_profiles table
+		if (profiles.size() <= static_cast<size_t>(profile_number))
+			profiles.resize(profile_number + 1);
+		profiles[profile_number] = profile;
 	}
 
 	ALT_OUTDENT;
@@ -473,6 +707,45 @@ bool AltsoundIniProcessor::parseDuckingProfile(const IniSection& ducking_section
 	return true;
 }
 
+// ---------------------------------------------------------------------------
+// Helper function to compile G-Sound behavior bitsets into the action table.
+// STOP takes precedence over PAUSE, and a sample type can only stop itself,
+// so the invalid combinations are resolved once here instead of on every
+// stream start
+// ---------------------------------------------------------------------------
+
+void AltsoundIniProcessor::compileBehavior(BehaviorInfo& behavior, BehaviorInfo::BehaviorBits self)
+{
+	static const char* const type_names[] = { "MUSIC", "CALLOUT", "SFX", "SOLO", "OVERLAY" };
+	const size_t self_idx = static_cast<size_t>(self);
+
+	behavior.action_mask = 0;
+	for (size_t type_idx = 0; type_idx < behavior.actions.size(); ++type_idx) {
+		uint8_t action = 0;
+
+		if (behavior.stops.test(type_idx)) {
+			action |= BehaviorInfo::ACTION_STOP;
+		}
+		else if (behavior.pauses.test(type_idx)) {
+			if (type_idx != self_idx)
+				action |= BehaviorInfo::ACTION_PAUSE;
+			else
+				ALT_WARNING(1, "%s streams cannot pause another %s stream", type_names[self_idx], type_names[self_idx]);
+		}
+
+		if (behavior.ducks.test(type_idx)) {
+			if (type_idx != self_idx)
+				action |= BehaviorInfo::ACTION_DUCK;
+			else
+				ALT_WARNING(1, "%s streams cannot duck another %s stream", type_names[self_idx], type_names[self_idx]);
+		}
+
+		behavior.actions[type_idx] = action;
+		if (action)
+			behavior.action_mask |= 1u << type_idx;
+	}
+}
+
 
 // ---------------------------------------------------------------------------
 // Helper function to determine AltSound format
@@ -482,9 +755,10 @@ bool AltsoundIniProcessor::parseDuckingProfile(const IniSection& ducking_section
 // This is in support of altsound.ini file creation for packages that don't
 // already have one (legacy).  It works in order of precedence:
 //
-//  1. presence of g-sound.csv
-//  2. presence of altsound.csv
-//	3. presence of PinSound directory structure
+//  1. format recorded in altsound.altpack
+//  2. presence of g-sound.csv
+//  3. presence of altsound.csv
+//	4. presence of PinSound directory structure
 //
 // Once the .ini file is created, it can be modified to adjust preference.
 //
@@ -493,6 +767,18 @@ string AltsoundIniProcessor::get_altsound_format(const string& path_in)
 	ALT_DEBUG(0, "BEGIN get_altsound_format()");
 	ALT_INDENT;
 
+	// a sample pack records the format it was built from
+	if (std::ifstream(path_in + ALTPACK_FILENAME).good()) {
+		AltsoundPack pack;
+		if (pack.open(path_in + ALTPACK_FILENAME)) {
+			const string format = pack.getFormat();
+			ALT_INFO(0, "Using %s format from " ALTPACK_FILENAME, format.c_str());
+			ALT_OUTDENT;
+			ALT_DEBUG(0, "END get_altsound_format()");
+			return format;
+		}
+	}
+
 	const std::vector<std::pair<string, string>> filesAndFormats{
 		{ "g-sound.csv", "g-sound" },
 		{ "altsound.csv", "altsound" },
@@ -501,7 +787,7 @@ string AltsoundIniProcessor::get_altsound_format(const string& path_in)
 	for (const auto& fileAndFormat : filesAndFormats) {
 		std::ifstream ini(path_in + fileAndFormat.first);
 		if (ini) {
-			ALT_INFO(0, ("Using " + fileAndFormat.second + " format").c_str());
+			ALT_INFO(0, "Using %s format", fileAndFormat.second.c_str());
 			ALT_OUTDENT;
 			ALT_DEBUG(0, "END get_altsound_format()");
 			return fileAndFormat.second;
@@ -590,12 +876,93 @@ bool AltsoundIniProcessor::create_altsound_ini(const string& path_in)
 		";                     specify how many initial commands to ignore at startup.\n"
 		";                     NOTE:  If the record_sound_cmds flag is set, the skipped\n"
 		";                     commands will be included in the recording file.\n"
+		";\n"
+		"; sample_cache_mb   : memory budget (in MB) for keeping decoded samples in RAM.\n"
+		";                     Cached samples play without disk access or decoding,\n"
+		";                     which reduces the delay between a sound command and the\n"
+		";                     start of playback.  Least recently used samples are\n"
+		";                     dropped when the budget is exceeded.  Samples larger than\n"
+		";                     a quarter of the budget are always streamed from disk.\n"
+		";                     Samples longer than half a second are only cached by\n"
+		";                     preload_samples; otherwise they are streamed.\n"
+		";                     Set to 0 to disable caching.\n"
+		";\n"
+		"; preload_samples   : when set to 1, samples are decoded into the sample cache\n"
+		";                     in the background at startup, shortest sound effects and\n"
+		";                     callouts first.  Samples that are not loaded yet when\n"
+		";                     they are needed are streamed from disk as usual.\n"
+		";                     Off by default.\n"
+		";\n"
+		"; preload_threads   : number of background threads used to preload samples.\n"
+		";                     Set to 0 to use one thread per CPU core.\n"
+		";\n"
+		"; async_commands    : when set to 1, sound commands are queued and processed\n"
+		";                     in order on a background thread, so file access and\n"
+		";                     decoding never stall the emulator.  Commands arriving\n"
+		";                     while the queue is full are dropped.\n"
+		";\n"
+		"; schedule_latency_ms : delay from the emulator time of a command sent with\n"
+		";                       AltSoundProcessCommandAt() to the start of its sound.\n"
+		";                       Sounds then start with sample accuracy, independent of\n"
+		";                       audio period boundaries.  Raised to at least two audio\n"
+		";                       periods.\n"
+		";\n"
+		"; resample_quality : how samples recorded at another rate than the output\n"
+		";                    are converted when they are loaded into memory.\n"
+		";                    \"sinc\" uses a windowed-sinc filter, \"linear\" the\n"
+		";                    faster linear interpolation that streamed samples use.\n"
+		";                    The conversion runs once per sample, never during\n"
+		";                    playback.\n"
+		";\n"
+		"; read_ahead_threshold_ms : samples longer than this (music, long loops) are\n"
+		";                           not cached.  A background thread decodes them\n"
+		";                           ahead of playback instead, so a slow disk does\n"
+		";                           not interrupt the sound.  Set to 0 to decode\n"
+		";                           all streamed samples during mixing.\n"
+		";\n"
+		"; read_ahead_buffer_ms : how far ahead of playback long samples are decoded.\n"
+		";\n"
+		"; voices : number of samples that can play at once (1 to 256).\n"
+		";\n"
+		"; voice_steal : what happens to a new sample when all voices are in use, or\n"
+		";               its type is at its limit in [voice_limits].  \"oldest\"\n"
+		";               stops the oldest SFX sample (or the oldest sample, if no\n"
+		";               SFX is playing), \"quietest\" stops the sample playing at\n"
+		";               the lowest volume, and \"none\" drops the new sample.\n"
+		";\n"
+		"; steal_fade_ms : a stopped sample fades out over this time instead of\n"
+		";                 being cut off.\n"
 		"; ----------------------------------------------------------------------------\n"
 		"\n"
 		"[system]\n"
 		"record_sound_cmds = 0\n"
 		"rom_volume_ctrl = 1\n"
 		"cmd_skip_count = 0\n"
+		"sample_cache_mb = 64\n"
+		"preload_samples = 0\n"
+		"preload_threads = 0\n"
+		"async_commands = 0\n"
+		"schedule_latency_ms = 20\n"
+		"resample_quality = sinc\n"
+		"read_ahead_threshold_ms = 10000\n"
+		"read_ahead_buffer_ms = 500\n"
+		"voices = 16\n"
+		"voice_steal = oldest\n"
+		"steal_fade_ms = 10\n"
+		"\n"
+		"; ----------------------------------------------------------------------------\n"
+		"; Most samples of each type that can play at once.  A new sample of a type\n"
+		"; at its limit replaces one of the same type, chosen by voice_steal.  Set\n"
+		"; to 0 for no limit.\n"
+		"; ----------------------------------------------------------------------------\n"
+		"\n"
+		"[voice_limits]\n"
+		"music = 0\n"
+		"jingle = 0\n"
+		"sfx = 0\n"
+		"callout = 0\n"
+		"solo = 0\n"
+		"overlay = 0\n"
 		"\n"
 		"; ----------------------------------------------------------------------------\n"
 		"; There are three supported AltSound formats:\n"
@@ -638,11 +1005,20 @@ bool AltsoundIniProcessor::create_altsound_ini(const string& path_in)
 		"; example, setting logging level to \"Warning\" will also enable \"Info\" and\n"
 		"; \"Error\" logging.  By default, logging is set to \"Error\" which will also\n"
 		"; include \"Info\" log messages.  The log file will be overwritten each time a\n"
-		"; new table is loaded.\n"
+		"; new table is loaded.  With several AltSound instances in one process, only\n"
+		"; the default instance applies logging_level; AltSoundSetLogger() sets the\n"
+		"; level for all others.\n"
+		";\n"
+		"; trace_events : when set to 1, command processing, stream lifetimes,\n"
+		";                end-of-stream handling and audio periods are recorded on\n"
+		";                all threads and written to \"altsound_trace.json\" in this\n"
+		";                folder at shutdown. Open it in chrome://tracing or\n"
+		";                https://ui.perfetto.dev. Default is 0 (off)\n"
 		"; ----------------------------------------------------------------------------\n"
 		"\n"
 		"[logging]\n"
 		"logging_level = Error\n"
+		"trace_events = 0\n"
 		"\n"
 		"; ----------------------------------------------------------------------------\n"
 		"; The section below allows for tailoring of the G-Sound behaviors.\n"
@@ -20,6 +20,10 @@
 #endif
 
 #include "altsound_data.hpp"
+#include "altsound_logger.hpp"
+#include "altsound_read_ahead.hpp"
+#include "altsound_resampler.hpp"
+#include "altsound_sample_cache.hpp"
 
 #include "inipp.h"
 
@@ -27,13 +31,16 @@
 
 using std::string;
 
+// Default delay from a timestamped command to the start of its sound
+#define ALT_SCHEDULE_LATENCY_DEFAULT_MS 20
+
 class AltsoundIniProcessor
 {
 public:
 
 	// syntactic candy
 	using IniSection = std::map<inipp::Ini<char>::String, inipp::Ini<char>::String>;
-	using ProfileMap = std::unordered_map<string, DuckingProfile>;
+	using ProfileTable = std::vector<DuckingProfile>;
 
 	// Default constructor
 	AltsoundIniProcessor() = default;
@@ -59,6 +66,46 @@ public:
 	// Return parsed skip count value
 	unsigned int getSkipCount() const;
 
+	// Return parsed sample cache budget in megabytes
+	unsigned int getSampleCacheMB() const;
+
+	// Return parsed flag indicating whether to preload samples at startup
+	bool preloadSamples() const;
+
+	// Return parsed preload worker count (0 = one per core)
+	unsigned int getPreloadThreads() const;
+
+	// Return parsed flag indicating whether commands are processed on a
+	// worker thread
+	bool asyncCommands() const;
+
+	// Return parsed delay, in milliseconds, from a timestamped command to the
+	// start of its sound
+	unsigned int getScheduleLatencyMs() const;
+
+	// Return parsed quality of the load-time conversion to the output rate
+	AltsoundResampleQuality getResampleQuality() const;
+
+	// Return parsed length, in milliseconds, above which samples are decoded
+	// ahead on the read-ahead thread (0 = never)
+	unsigned int getReadAheadThresholdMs() const;
+
+	// Return parsed read-ahead buffer length per stream, in milliseconds
+	unsigned int getReadAheadBufferMs() const;
+
+	// Return parsed voice count, steal policy and sample type caps
+	const AltsoundVoicePolicy& getVoicePolicy() const;
+
+	// Return parsed log level
+	AltsoundLogger::Level getLogLevel() const;
+
+	// Return parsed flag indicating whether events are traced to a file
+	bool traceEvents() const;
+
+	// Return parsed G-Sound behavior of a sample type.  Types without
+	// behaviors get the defaults
+	const BehaviorInfo& getBehavior(AltsoundSampleType type) const;
+
 private: // functions
 
 	// helper function to parse behavior variable values
@@ -68,7 +115,10 @@ private: // functions
 	bool parseVolumeValue(const IniSection& section, const string& key, float& volume);
 
 	// helper function to parse ducking profiles
-	bool parseDuckingProfile(const IniSection& ducking_section, ProfileMap& profiles);
+	bool parseDuckingProfile(const IniSection& ducking_section, ProfileTable& profiles);
+
+	// compile parsed behavior bitsets into the per-sample-type action table
+	void compileBehavior(BehaviorInfo& behavior, BehaviorInfo::BehaviorBits self);
 
 	// determine altsound format from installed data
 	string get_altsound_format(const string& path_in);
@@ -93,6 +143,24 @@ private: // data
 	bool rom_volume_control = true;
 	string altsound_format;
 	unsigned int skip_count = 0;
+	unsigned int sample_cache_mb = ALT_SAMPLE_CACHE_DEFAULT_MB;
+	bool preload_samples = false;
+	unsigned int preload_threads = 0;
+	bool async_commands = false;
+	unsigned int schedule_latency_ms = ALT_SCHEDULE_LATENCY_DEFAULT_MS;
+	AltsoundResampleQuality resample_quality = ALT_RESAMPLE_QUALITY_DEFAULT;
+	unsigned int read_ahead_threshold_ms = ALT_READ_AHEAD_THRESHOLD_DEFAULT_MS;
+	unsigned int read_ahead_buffer_ms = ALT_READ_AHEAD_BUFFER_DEFAULT_MS;
+	AltsoundVoicePolicy voice_policy;
+	AltsoundLogger::Level log_level = AltsoundLogger::Level::Error;
+	bool trace_events = false;
+
+	// G-Sound sample type behaviors
+	BehaviorInfo music_behavior;
+	BehaviorInfo callout_behavior;
+	BehaviorInfo sfx_behavior;
+	BehaviorInfo solo_behavior;
+	BehaviorInfo overlay_behavior;
 };
 
 // ----------------------------------------------------------------------------
@@ -122,4 +190,70 @@ inline unsigned int AltsoundIniProcessor::getSkipCount() const {
 	return skip_count;
 }
 
+// ----------------------------------------------------------------------------
+
+inline unsigned int AltsoundIniProcessor::getSampleCacheMB() const {
+	return sample_cache_mb;
+}
+
+// ----------------------------------------------------------------------------
+
+inline bool AltsoundIniProcessor::preloadSamples() const {
+	return preload_samples;
+}
+
+// ----------------------------------------------------------------------------
+
+inline unsigned int AltsoundIniProcessor::getPreloadThreads() const {
+	return preload_threads;
+}
+
+// ----------------------------------------------------------------------------
+
+inline bool AltsoundIniProcessor::asyncCommands() const {
+	return async_commands;
+}
+
+// ----------------------------------------------------------------------------
+
+inline unsigned int AltsoundIniProcessor::getScheduleLatencyMs() const {
+	return schedule_latency_ms;
+}
+
+// ----------------------------------------------------------------------------
+
+inline AltsoundResampleQuality AltsoundIniProcessor::getResampleQuality() const {
+	return resample_quality;
+}
+
+// ----------------------------------------------------------------------------
+
+inline unsigned int AltsoundIniProcessor::getReadAheadThresholdMs() const {
+	return read_ahead_threshold_ms;
+}
+
+// ----------------------------------------------------------------------------
+
+inline unsigned int AltsoundIniProcessor::getReadAheadBufferMs() const {
+	return read_ahead_buffer_ms;
+}
+
+// ----------------------------------------------------------------------------
+
+inline const AltsoundVoicePolicy& AltsoundIniProcessor::getVoicePolicy() const {
+	return voice_policy;
+}
+
+// ----------------------------------------------------------------------------
+
+inline AltsoundLogger::Level AltsoundIniProcessor::getLogLevel() const {
+	return log_level;
+}
+
+// ----------------------------------------------------------------------------
+
+inline bool AltsoundIniProcessor::traceEvents() const {
+	return trace_events;
+}
+
 #endif // ALTSOUND_INI_PROCESSOR_H
@@ -0,0 +1,214 @@
+// ---------------------------------------------------------------------------
+// altsound_lockfree.hpp
+//
+// Fixed-size lock-free queues for handing data between threads (audio,
+// housekeeping, command) without blocking or allocating
+// ---------------------------------------------------------------------------
+// license:BSD-3-Clause
+// ---------------------------------------------------------------------------
+
+#ifndef ALTSOUND_LOCKFREE_HPP
+#define ALTSOUND_LOCKFREE_HPP
+#if !defined(__GNUC__) || (__GNUC__ == 3 && __GNUC_MINOR__ >= 4) || (__GNUC__ >= 4)	// GCC supports "pragma once" correctly since 3.4
+#pragma once
+#endif
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+// ---------------------------------------------------------------------------
+// AltsoundMPSCRing class definition
+//
+// Bounded multi-producer/single-consumer ring.  Each cell carries a sequence
+// number that tells producers and the consumer whether it is free or filled,
+// so push() never waits on a slow consumer: it fails when the ring is full.
+// N must be a power of two.  T must be default constructible and copyable
+// ---------------------------------------------------------------------------
+
+template<typename T, size_t N>
+class AltsoundMPSCRing
+{
+	static_assert(N >= 2 && (N & (N - 1)) == 0, "ring size must be a power of two");
+
+public:
+
+	// Standard constructor
+	AltsoundMPSCRing();
+
+	// Copy constructor - NOT USED
+	AltsoundMPSCRing(AltsoundMPSCRing&) = delete;
+
+	// Add an item.  Safe from any thread.  Returns false if the ring is full
+	bool push(const T& item_in);
+
+	// Remove the oldest item.  Consumer thread only.  Returns false if empty
+	bool pop(T& item_out);
+
+	// Approximate number of queued items
+	size_t size() const;
+
+	// Ring capacity
+	static constexpr size_t capacity() { return N; }
+
+private: // data
+
+	struct Cell {
+		std::atomic<size_t> seq;
+		T item;
+	};
+
+	alignas(64) Cell cells[N];
+	alignas(64) std::atomic<size_t> head{ 0 }; // next push position
+	alignas(64) std::atomic<size_t> tail{ 0 }; // next pop position
+};
+
+// ---------------------------------------------------------------------------
+// AltsoundSPSCRing class definition
+//
+// Bounded single-producer/single-consumer ring.  Each side owns one index,
+// so push() and pop() are wait-free.  N must be a power of two
+// ---------------------------------------------------------------------------
+
+template<typename T, size_t N>
+class AltsoundSPSCRing
+{
+	static_assert(N >= 2 && (N & (N - 1)) == 0, "ring size must be a power of two");
+
+public:
+
+	// Standard constructor
+	AltsoundSPSCRing() = default;
+
+	// Copy constructor - NOT USED
+	AltsoundSPSCRing(AltsoundSPSCRing&) = delete;
+
+	// Add an item.  Producer thread only.  Returns false if the ring is full
+	bool push(const T& item_in);
+
+	// Remove the oldest item.  Consumer thread only.  Returns false if empty
+	bool pop(T& item_out);
+
+	// Approximate number of queued items
+	size_t size() const;
+
+	// Ring capacity
+	static constexpr size_t capacity() { return N; }
+
+private: // data
+
+	T items[N];
+	alignas(64) std::atomic<size_t> head{ 0 }; // next push position
+	alignas(64) std::atomic<size_t> tail{ 0 }; // next pop position
+};
+
+// ----------------------------------------------------------------------------
+// Inline functions
+// ----------------------------------------------------------------------------
+
+template<typename T, size_t N>
+inline AltsoundMPSCRing<T, N>::AltsoundMPSCRing()
+{
+	for (size_t i = 0; i < N; ++i)
+		cells[i].seq.store(i, std::memory_order_relaxed);
+}
+
+// ----------------------------------------------------------------------------
+
+template<typename T, size_t N>
+inline bool AltsoundMPSCRing<T, N>::push(const T& item_in)
+{
+	size_t pos = head.load(std::memory_order_relaxed);
+	Cell* cell;
+
+	for (;;) {
+		cell = &cells[pos & (N - 1)];
+		const size_t seq = cell->seq.load(std::memory_order_acquire);
+		const intptr_t diff = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos);
+
+		if (diff == 0) {
+			// cell is free: claim it
+			if (head.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+				break;
+		}
+		else if (diff < 0) {
+			// cell still holds an item from the previous lap
+			return false;
+		}
+		else {
+			// another producer claimed it first
+			pos = head.load(std::memory_order_relaxed);
+		}
+	}
+
+	cell->item = item_in;
+	cell->seq.store(pos + 1, std::memory_order_release);
+	return true;
+}
+
+// ----------------------------------------------------------------------------
+
+template<typename T, size_t N>
+inline bool AltsoundMPSCRing<T, N>::pop(T& item_out)
+{
+	const size_t pos = tail.load(std::memory_order_relaxed);
+	Cell& cell = cells[pos & (N - 1)];
+
+	if (cell.seq.load(std::memory_order_acquire) != pos + 1)
+		return false;
+
+	item_out = cell.item;
+	cell.seq.store(pos + N, std::memory_order_release);
+	tail.store(pos + 1, std::memory_order_release);
+	return true;
+}
+
+// ----------------------------------------------------------------------------
+
+template<typename T, size_t N>
+inline size_t AltsoundMPSCRing<T, N>::size() const
+{
+	const size_t t = tail.load(std::memory_order_acquire);
+	const size_t h = head.load(std::memory_order_acquire);
+	return h > t ? h - t : 0;
+}
+
+// ----------------------------------------------------------------------------
+
+template<typename T, size_t N>
+inline bool AltsoundSPSCRing<T, N>::push(const T& item_in)
+{
+	const size_t pos = head.load(std::memory_order_relaxed);
+	if (pos - tail.load(std::memory_order_acquire) == N)
+		return false;
+
+	items[pos & (N - 1)] = item_in;
+	head.store(pos + 1, std::memory_order_release);
+	return true;
+}
+
+// ----------------------------------------------------------------------------
+
+template<typename T, size_t N>
+inline bool AltsoundSPSCRing<T, N>::pop(T& item_out)
+{
+	const size_t pos = tail.load(std::memory_order_relaxed);
+	if (pos == head.load(std::memory_order_acquire))
+		return false;
+
+	item_out = items[pos & (N - 1)];
+	tail.store(pos + 1, std::memory_order_release);
+	return true;
+}
+
+// ----------------------------------------------------------------------------
+
+template<typename T, size_t N>
+inline size_t AltsoundSPSCRing<T, N>::size() const
+{
+	const size_t t = tail.load(std::memory_order_acquire);
+	const size_t h = head.load(std::memory_order_acquire);
+	return h > t ? h - t : 0;
+}
+
+#endif // ALTSOUND_LOCKFREE_HPP
@@ -10,6 +10,9 @@
 #include "altsound_logger.hpp"
 
 #include <algorithm>
+#include <chrono>
+#include <cctype>
+#include <cstring>
 #include <map>
 
 // DAR@20230706
@@ -18,18 +21,426 @@
 // the compilation unit they are declared in
 //
 thread_local int AltsoundLogger::base_indent = 0;
+thread_local uint32_t AltsoundLogger::thread_id = 0;
+std::atomic<uint32_t> AltsoundLogger::next_thread_id{ 0 };
+
+// ----------------------------------------------------------------------------
+// Argument packing support
+// ----------------------------------------------------------------------------
+
+// How an argument travels through the variadic call
+enum LogArgType {
+	ARG_NONE = 0,
+	ARG_INT,
+	ARG_LONG,
+	ARG_LLONG,
+	ARG_SIZE,
+	ARG_INTMAX,
+	ARG_PTRDIFF,
+	ARG_DOUBLE,
+	ARG_LDOUBLE,
+	ARG_STRING,
+	ARG_POINTER
+};
+
+// A parsed printf conversion specification
+struct LogSpec {
+	const char* end = nullptr;   // one past the conversion character
+	bool star_width = false;     // width passed as an int argument
+	bool star_precision = false; // precision passed as an int argument
+	LogArgType type = ARG_NONE;
+};
+
+// Parse the conversion specification that follows a '%'
+static LogSpec parseSpec(const char* p)
+{
+	LogSpec spec;
+
+	while (*p && strchr("-+ #0'", *p))
+		++p;
+
+	if (*p == '*') {
+		spec.star_width = true;
+		++p;
+	}
+	while (isdigit(static_cast<unsigned char>(*p)))
+		++p;
+
+	if (*p == '.') {
+		++p;
+		if (*p == '*') {
+			spec.star_precision = true;
+			++p;
+		}
+		while (isdigit(static_cast<unsigned char>(*p)))
+			++p;
+	}
+
+	int longs = 0;
+	bool size = false, intmax = false, ptrdiff = false, long_double = false;
+	for (;; ++p) {
+		if (*p == 'h') {}
+		else if (*p == 'l') ++longs;
+		else if (*p == 'z') size = true;
+		else if (*p == 'j') intmax = true;
+		else if (*p == 't') ptrdiff = true;
+		else if (*p == 'L') long_double = true;
+		else break;
+	}
+
+	const char conv = *p;
+	if (conv)
+		++p;
+	spec.end = p;
+
+	switch (conv) {
+	case 'd': case 'i': case 'u': case 'o': case 'x': case 'X': case 'c':
+		spec.type = size ? ARG_SIZE : intmax ? ARG_INTMAX : ptrdiff ? ARG_PTRDIFF :
+		            longs >= 2 ? ARG_LLONG : longs == 1 ? ARG_LONG : ARG_INT;
+		break;
+	case 'e': case 'E': case 'f': case 'F': case 'g': case 'G': case 'a': case 'A':
+		spec.type = long_double ? ARG_LDOUBLE : ARG_DOUBLE;
+		break;
+	case 's':
+		spec.type = ARG_STRING;
+		break;
+	case 'p': case 'n':
+		spec.type = ARG_POINTER;
+		break;
+	default: // '%' or unsupported
+		break;
+	}
+	return spec;
+}
+
+// Append a fixed-size value.  Returns false if it does not fit
+template<typename T>
+static bool packValue(LogRecord& record, T value)
+{
+	if (record.args_size + sizeof(T) > ALT_LOG_ARG_BYTES)
+		return false;
+
+	memcpy(record.args + record.args_size, &value, sizeof(T));
+	record.args_size += static_cast<uint16_t>(sizeof(T));
+	return true;
+}
+
+// Read back a value packed by packValue().  Returns false past the end
+template<typename T>
+static bool unpackValue(const LogRecord& record, size_t& pos, T& value)
+{
+	if (pos + sizeof(T) > record.args_size)
+		return false;
+
+	memcpy(&value, record.args + pos, sizeof(T));
+	pos += sizeof(T);
+	return true;
+}
+
+// Copy the arguments named by format into the record
+static void packArgs(LogRecord& record, const char* format, va_list args)
+{
+	bool ok = true;
+	for (const char* p = format; ok && *p; ) {
+		if (*p++ != '%')
+			continue;
+
+		const LogSpec spec = parseSpec(p);
+		p = spec.end;
+
+		if (spec.star_width)
+			ok = packValue(record, va_arg(args, int));
+		if (ok && spec.star_precision)
+			ok = packValue(record, va_arg(args, int));
+		if (!ok)
+			break;
+
+		switch (spec.type) {
+		case ARG_INT:     ok = packValue(record, va_arg(args, int)); break;
+		case ARG_LONG:    ok = packValue(record, va_arg(args, long)); break;
+		case ARG_LLONG:   ok = packValue(record, va_arg(args, long long)); break;
+		case ARG_SIZE:    ok = packValue(record, va_arg(args, size_t)); break;
+		case ARG_INTMAX:  ok = packValue(record, va_arg(args, intmax_t)); break;
+		case ARG_PTRDIFF: ok = packValue(record, va_arg(args, ptrdiff_t)); break;
+		case ARG_DOUBLE:  ok = packValue(record, va_arg(args, double)); break;
+		case ARG_LDOUBLE: ok = packValue(record, static_cast<double>(va_arg(args, long double))); break;
+		case ARG_POINTER: ok = packValue(record, va_arg(args, void*)); break;
+		case ARG_STRING: {
+			const char* str = va_arg(args, const char*);
+			if (!str)
+				str = "(null)";
+
+			// copied inline, NUL-terminated, clipped to the space left
+			const size_t room = ALT_LOG_ARG_BYTES - record.args_size;
+			if (room == 0) {
+				ok = false;
+				break;
+			}
+			size_t len = strlen(str);
+			if (len >= room) {
+				len = room - 1;
+				ok = false;
+			}
+			memcpy(record.args + record.args_size, str, len);
+			record.args[record.args_size + len] = '\0';
+			record.args_size += static_cast<uint16_t>(len + 1);
+			break;
+		}
+		default:
+			break;
+		}
+	}
+
+	record.truncated = ok ? 0 : 1;
+}
+
+// ----------------------------------------------------------------------------
+// Helper function to read the monotonic clock in nanoseconds
+// ----------------------------------------------------------------------------
+
+static uint64_t loggerNow()
+{
+	return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+		std::chrono::steady_clock::now().time_since_epoch()).count());
+}
 
 // ----------------------------------------------------------------------------
 // CTOR/DTOR
 // ----------------------------------------------------------------------------
 
 AltsoundLogger::AltsoundLogger()
+: start_ns(loggerNow())
 {
 }
 
 AltsoundLogger::AltsoundLogger(const string& filename)
-: log_level(Debug), console(true), out(filename)
+: log_level(Debug), console(true), out(filename), start_ns(loggerNow())
+{
+	has_sink.store(true, std::memory_order_release);
+	startWriter();
+}
+
+AltsoundLogger::~AltsoundLogger()
+{
+	stopWriter();
+}
+
+// ----------------------------------------------------------------------------
+// Logging functions
+// ----------------------------------------------------------------------------
+
+void AltsoundLogger::log(int indentLevel, Level lvl, const char* format, va_list args)
+{
+	if (!has_sink.load(std::memory_order_acquire))
+		return;
+
+	if (thread_id == 0)
+		thread_id = next_thread_id.fetch_add(1, std::memory_order_relaxed) + 1;
+
+	LogRecord record;
+	record.format = format;
+	record.timestamp_ns = loggerNow();
+	record.thread_id = thread_id;
+	record.indent = static_cast<int16_t>(indentLevel);
+	record.level = static_cast<uint8_t>(lvl);
+	packArgs(record, format, args);
+
+	if (!queue.push(record))
+		dropped.fetch_add(1, std::memory_order_relaxed);
+}
+
+// ----------------------------------------------------------------------------
+
+void AltsoundLogger::setLogPath(const string& logPath)
+{
+	// the writer thread owns the file while it runs
+	stopWriter();
+
+	if (out.is_open())
+		out.close();
+
+	string full_path;
+	if (!logPath.empty()) {
+		full_path = logPath;
+		std::replace(full_path.begin(), full_path.end(), '\\', '/');
+
+		if (full_path.back() != '/')
+			full_path += '/';
+
+		full_path += "altsound.log";
+
+		out.open(full_path.c_str());
+	}
+
+	has_sink.store(console.load(std::memory_order_acquire) || out.is_open(), std::memory_order_release);
+	startWriter();
+
+	if (!full_path.empty())
+		none(0, "path set: %s", full_path.c_str());
+}
+
+// ----------------------------------------------------------------------------
+// Writer thread
+// ----------------------------------------------------------------------------
+
+void AltsoundLogger::startWriter()
 {
+	if (writer.joinable() || !has_sink.load(std::memory_order_acquire))
+		return;
+
+	running.store(true, std::memory_order_release);
+	writer = std::thread(&AltsoundLogger::writerProc, this);
+}
+
+// ----------------------------------------------------------------------------
+
+void AltsoundLogger::stopWriter()
+{
+	if (writer.joinable()) {
+		{
+			std::lock_guard<std::mutex> lock(writer_mutex);
+			running.store(false, std::memory_order_release);
+		}
+		writer_cv.notify_one();
+		writer.join();
+	}
+
+	// write out whatever the writer had not picked up yet
+	string batch;
+	drain(batch);
+}
+
+// ----------------------------------------------------------------------------
+
+void AltsoundLogger::writerProc()
+{
+	string batch;
+	std::unique_lock<std::mutex> lock(writer_mutex);
+
+	while (running.load(std::memory_order_acquire)) {
+		lock.unlock();
+		drain(batch);
+		lock.lock();
+
+		writer_cv.wait_for(lock, std::chrono::milliseconds(ALT_LOG_FLUSH_MSEC),
+			[this] { return !running.load(std::memory_order_acquire); });
+	}
+}
+
+// ----------------------------------------------------------------------------
+
+void AltsoundLogger::drain(string& batch)
+{
+	batch.clear();
+
+	// bounded, so a busy producer cannot keep the writer from writing
+	LogRecord record;
+	for (size_t i = 0; i < ALT_LOG_QUEUE_SIZE && queue.pop(record); ++i)
+		formatRecord(record, batch);
+
+	const uint64_t lost = dropped.load(std::memory_order_relaxed);
+	if (lost != dropped_reported) {
+		batch += "NONE: " + std::to_string(lost - dropped_reported) + " log messages dropped (queue full)\n";
+		dropped_reported = lost;
+	}
+
+	if (batch.empty())
+		return;
+
+	if (out.is_open()) {
+		out << batch;
+		out.flush();
+	}
+
+	if (console.load(std::memory_order_acquire))
+		std::cout << batch << std::flush;
+}
+
+// ----------------------------------------------------------------------------
+
+void AltsoundLogger::formatRecord(const LogRecord& record, string& batch)
+{
+	char buffer[512];
+
+	snprintf(buffer, sizeof(buffer), "%11.6f [%u] ",
+		(record.timestamp_ns - start_ns) / 1.0e9, record.thread_id);
+	batch += buffer;
+	batch.append(record.indent * indentWidth, ' ');
+	batch += toString(static_cast<Level>(record.level));
+	batch += ": ";
+
+	size_t pos = 0;
+	bool ok = true;
+	for (const char* p = record.format; ok && *p; ) {
+		if (*p != '%') {
+			const char* next = strchr(p, '%');
+			const size_t len = next ? static_cast<size_t>(next - p) : strlen(p);
+			batch.append(p, len);
+			p += len;
+			continue;
+		}
+
+		const char* spec_start = p++;
+		const LogSpec spec = parseSpec(p);
+		p = spec.end;
+
+		if (*(p - 1) == '%') {
+			batch += '%';
+			continue;
+		}
+
+		// rebuild the specification with '*' replaced by the packed values
+		// and 'L' dropped (long doubles travel as double)
+		string spec_str;
+		for (const char* c = spec_start; c < p; ++c) {
+			if (*c == '*') {
+				int value = 0;
+				ok = unpackValue(record, pos, value);
+				spec_str += std::to_string(value);
+			}
+			else if (*c != 'L') {
+				spec_str += *c;
+			}
+		}
+		if (!ok)
+			break;
+
+		switch (spec.type) {
+		case ARG_INT:     { int v;       if ((ok = unpackValue(record, pos, v))) snprintf(buffer, sizeof(buffer), spec_str.c_str(), v); break; }
+		case ARG_LONG:    { long v;      if ((ok = unpackValue(record, pos, v))) snprintf(buffer, sizeof(buffer), spec_str.c_str(), v); break; }
+		case ARG_LLONG:   { long long v; if ((ok = unpackValue(record, pos, v))) snprintf(buffer, sizeof(buffer), spec_str.c_str(), v); break; }
+		case ARG_SIZE:    { size_t v;    if ((ok = unpackValue(record, pos, v))) snprintf(buffer, sizeof(buffer), spec_str.c_str(), v); break; }
+		case ARG_INTMAX:  { intmax_t v;  if ((ok = unpackValue(record, pos, v))) snprintf(buffer, sizeof(buffer), spec_str.c_str(), v); break; }
+		case ARG_PTRDIFF: { ptrdiff_t v; if ((ok = unpackValue(record, pos, v))) snprintf(buffer, sizeof(buffer), spec_str.c_str(), v); break; }
+		case ARG_DOUBLE:
+		case ARG_LDOUBLE: { double v;    if ((ok = unpackValue(record, pos, v))) snprintf(buffer, sizeof(buffer), spec_str.c_str(), v); break; }
+		case ARG_POINTER: {
+			void* v;
+			if ((ok = unpackValue(record, pos, v)))
+				snprintf(buffer, sizeof(buffer), "%p", v);
+			break;
+		}
+		case ARG_STRING: {
+			ok = pos < record.args_size;
+			if (ok) {
+				const char* str = reinterpret_cast<const char*>(record.args + pos);
+				pos += strlen(str) + 1;
+				snprintf(buffer, sizeof(buffer), spec_str.c_str(), str);
+			}
+			break;
+		}
+		default:
+			buffer[0] = '\0';
+			break;
+		}
+
+		if (ok)
+			batch += buffer;
+	}
+
+	if (record.truncated)
+		batch += "...";
+	batch += '\n';
 }
 
 // ----------------------------------------------------------------------------
@@ -1,7 +1,9 @@
 // ---------------------------------------------------------------------------
 // altsound_logger.hpp
 //
-// Runtime and debug logger for AltSound
+// Runtime and debug logger for AltSound.  Callers only pack their arguments
+// into a fixed-size record on a lock-free ring; a writer thread formats and
+// writes the records in batches
 // ---------------------------------------------------------------------------
 // license:BSD-3-Clause
 // copyright-holders: Dave Roscoe
@@ -19,26 +21,111 @@
  #endif
 #endif
 
+#include "altsound_lockfree.hpp"
+
 #include <fstream>
 #include <sstream>
 #include <iostream>
 #include <cstdarg>
+#include <cstdint>
 #include <cstdlib>
 #include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
 
 using std::string;
 
-// convenience macros
+// Log levels for ALTSOUND_MIN_LOG_LEVEL, matching AltsoundLogger::Level
+#define ALT_LOG_LEVEL_NONE 0
+#define ALT_LOG_LEVEL_INFO 1
+#define ALT_LOG_LEVEL_ERROR 2
+#define ALT_LOG_LEVEL_WARNING 3
+#define ALT_LOG_LEVEL_DEBUG 4
+
+// Most verbose level compiled in.  Messages that would only appear at a more
+// verbose logging_level are removed at compile time, arguments included
+#ifndef ALTSOUND_MIN_LOG_LEVEL
+#define ALTSOUND_MIN_LOG_LEVEL ALT_LOG_LEVEL_DEBUG
+#endif
+
+// Determine if a level is compiled in.  Usable in #if
+#define ALT_LOG_ENABLED(level) (ALTSOUND_MIN_LOG_LEVEL >= ALT_LOG_LEVEL_##level)
+
+// Compiled-out messages keep their arguments type-checked in a dead branch,
+// so they generate no code and don't leave variables unused
+#define ALT_LOG_STRIPPED(call) (false ? (call) : (void)0)
+
+// convenience macros.  msg must be a string literal: records keep the pointer
+#if ALT_LOG_ENABLED(INFO)
 #define ALT_INFO(indent, msg, ...) alog.info(indent, msg, ##__VA_ARGS__)
+#else
+#define ALT_INFO(indent, msg, ...) ALT_LOG_STRIPPED(alog.info(indent, msg, ##__VA_ARGS__))
+#endif
+#if ALT_LOG_ENABLED(ERROR)
 #define ALT_ERROR(indent, msg, ...) alog.error(indent, msg, ##__VA_ARGS__)
+#else
+#define ALT_ERROR(indent, msg, ...) ALT_LOG_STRIPPED(alog.error(indent, msg, ##__VA_ARGS__))
+#endif
+#if ALT_LOG_ENABLED(WARNING)
 #define ALT_WARNING(indent, msg, ...) alog.warning(indent, msg, ##__VA_ARGS__)
+#else
+#define ALT_WARNING(indent, msg, ...) ALT_LOG_STRIPPED(alog.warning(indent, msg, ##__VA_ARGS__))
+#endif
+#if ALT_LOG_ENABLED(DEBUG)
 #define ALT_DEBUG(indent, msg, ...) alog.debug(indent, msg, ##__VA_ARGS__)
+#else
+#define ALT_DEBUG(indent, msg, ...) ALT_LOG_STRIPPED(alog.debug(indent, msg, ##__VA_ARGS__))
+#endif
 //#define ALT_INDENT alog.indent()
 #define ALT_INDENT
 //#define ALT_OUTDENT alog.outdent()
 #define ALT_OUTDENT
+
+// Call indentation only shapes debug traces, so without DEBUG compiled in
+// ALT_CALL is a plain call
+#if ALT_LOG_ENABLED(DEBUG)
 #define ALT_CALL(func) ([&]() { alog.indent(); auto ret = func; alog.outdent(); return ret; }())
 #define ALT_RETURN(retval) do { alog.outdent(); return retval; } while (0)
+#else
+#define ALT_CALL(func) (func)
+#define ALT_RETURN(retval) return retval
+#endif
+
+// Run debug-only bookkeeping, such as dumping internal tables, when DEBUG is
+// compiled in and enabled
+#if ALT_LOG_ENABLED(DEBUG)
+#define ALT_DEBUG_ONLY(stmt) do { if (alog.isEnabled(AltsoundLogger::Level::Debug)) { stmt; } } while (0)
+#else
+#define ALT_DEBUG_ONLY(stmt) do {} while (0)
+#endif
+
+// Number of records the ring holds before messages are dropped
+#define ALT_LOG_QUEUE_SIZE 1024
+
+// Bytes available for packed arguments in one record.  Longer string
+// arguments are truncated
+#define ALT_LOG_ARG_BYTES 224
+
+// How often the writer thread drains the ring
+#define ALT_LOG_FLUSH_MSEC 20
+
+// A log message as queued by the caller: the format string pointer (format
+// strings are literals, so the pointer outlives the record) and the
+// arguments packed in format order.  Numbers take 8 bytes; strings are
+// copied inline, since the caller's buffer may be gone by the time the
+// writer runs
+struct LogRecord {
+	const char* format = nullptr;
+	uint64_t timestamp_ns = 0;
+	uint32_t thread_id = 0;
+	int16_t indent = 0;
+	uint8_t level = 0;
+	uint8_t truncated = 0;     // arguments did not fit
+	uint16_t args_size = 0;    // bytes of args in use
+	unsigned char args[ALT_LOG_ARG_BYTES];
+};
 
 class AltsoundLogger
 {
@@ -55,7 +142,8 @@ public:
 	explicit AltsoundLogger();
 	explicit AltsoundLogger(const string& filename);
 
-	~AltsoundLogger() = default;
+	// Destructor: writes out anything still queued
+	~AltsoundLogger();
 
 	// DAR@20230706
 	// Because these are variadic template functions, their definitions must
@@ -64,7 +152,7 @@ public:
 	// Log INFO level messages
 	void info(int rel_indent, const char* format, ...)
 	{
-		if (log_level >= Level::Info) {
+		if (log_level.load(std::memory_order_relaxed) >= Level::Info) {
 			va_list args;
 			va_start(args, format);
 			log(base_indent + rel_indent, Level::Info, format, args);
@@ -75,7 +163,7 @@ public:
 	// Log ERROR level messages
 	void error(int rel_indent, const char* format, ...)
 	{
-		if (log_level >= Level::Error) {
+		if (log_level.load(std::memory_order_relaxed) >= Level::Error) {
 			va_list args;
 			va_start(args, format);
 			log(base_indent + rel_indent, Level::Error, format, args);
@@ -86,7 +174,7 @@ public:
 	// Log WARNING level messages
 	void warning(int rel_indent, const char* format, ...)
 	{
-		if (log_level >= Level::Warning) {
+		if (log_level.load(std::memory_order_relaxed) >= Level::Warning) {
 			va_list args;
 			va_start(args, format);
 			log(base_indent + rel_indent, Level::Warning, format, args);
@@ -97,7 +185,7 @@ public:
 	// Log DEBUG level messages
 	void debug(int rel_indent, const char* format, ...)
 	{
-		if (log_level >= Level::Debug) {
+		if (log_level.load(std::memory_order_relaxed) >= Level::Debug) {
 			va_list args;
 			va_start(args, format);
 			log(base_indent + rel_indent, Level::Debug, format, args);
@@ -109,6 +197,9 @@ public:
 	void setLogLevel(Level level);
 	void enableConsole(const bool enable);
 
+	// Get the number of messages lost to a full ring
+	uint64_t getDroppedCount() const;
+
 	// increase base indent
 	static void indent();
 
@@ -118,49 +209,21 @@ public:
 	// convert string to Level enum value
 	Level toLogLevel(const string& lvl_in);
 
+	// Determine if messages of a level are currently written
+	bool isEnabled(Level lvl) const;
+
 private:  // methods
 
-	// DAR@20230706
-	// Because this is a variadic template function, it must remain in the header
-	//
-	// main logging method
-	void log(int indentLevel, Level lvl, const char* format, va_list args) {
-		va_list args_copy;
-		va_copy(args_copy, args);
-		int size = vsnprintf(nullptr, 0, format, args_copy);
-		va_end(args_copy);
-
-		if (size >= 0) {
-			char* buffer = nullptr;
-			if (size > 0) {
-				buffer = static_cast<char*>(malloc(size + 1));
-				vsnprintf(buffer, size + 1, format, args);
-			}
-
-			std::stringstream message;
-			message << string(indentLevel * indentWidth, ' ')
-				<< toString(lvl) << ": " << (buffer ? buffer : "") << "\n";
-			const string finalMessage = message.str();
-
-			if (out.is_open()) {
-				out << finalMessage;
-				out.flush();
-			}
-
-			if (console)
-				std::cout << finalMessage;
-
-			if (buffer)
-				free(buffer);
-		}
-	}
+	// main logging method.  Packs the message into a record and queues it.
+	// Never blocks: if the ring is full the message is counted and dropped
+	void log(int indentLevel, Level lvl, const char* format, va_list args);
 
 	// DAR@20230706
 	// This is only used for logging message within the logger class
 	//
 	void none(int rel_indent, const char* format, ...)
 	{
-		if (log_level >= Level::None) {
+		if (log_level.load(std::memory_order_relaxed) >= Level::None) {
 			va_list args;
 			va_start(args, format);
 			log(base_indent + rel_indent, Level::None, format, args);
@@ -171,50 +234,70 @@ private:  // methods
 	// convert Level enum value to a string
 	const char* toString(Level lvl);
 
+	// start the writer thread if there is anywhere to write to
+	void startWriter();
+
+	// join the writer thread and write out anything it left behind
+	void stopWriter();
+
+	// writer thread entry point
+	void writerProc();
+
+	// format and write every queued record
+	void drain(string& batch);
+
+	// format one record onto the end of batch
+	void formatRecord(const LogRecord& record, string& batch);
+
 private: // data
 
 	// Thread-local storage for the base indentation level
 	static thread_local int base_indent;
-	Level log_level = None;
-	bool console = false;
+	// Thread-local storage for the small id logged with each message
+	static thread_local uint32_t thread_id;
+	static std::atomic<uint32_t> next_thread_id;
+
+	std::atomic<Level> log_level{ None }; // set from any thread, read by every log call
+	std::atomic<bool> console{ false };
+	std::atomic<bool> has_sink{ false }; // log file open or console enabled
 	static constexpr int indentWidth = 4;
 	std::ofstream out;
+
+	AltsoundMPSCRing<LogRecord, ALT_LOG_QUEUE_SIZE> queue;
+	std::thread writer;
+	std::atomic<bool> running{ false };
+	std::mutex writer_mutex;                  // writer thread and stopWriter() only
+	std::condition_variable writer_cv;
+	std::atomic<uint64_t> dropped{ 0 };
+	uint64_t dropped_reported = 0; // writer thread only
+	uint64_t start_ns = 0;
 };
 
 // ----------------------------------------------------------------------------
 // Inline methods
 // ----------------------------------------------------------------------------
 
-inline void AltsoundLogger::setLogPath(const string& logPath)
+inline void AltsoundLogger::setLogLevel(Level level)
 {
-	if (out.is_open())
-		out.close();
-
-	if (logPath.empty())
-		return;
-
-	string full_path = logPath;
-	std::replace(full_path.begin(), full_path.end(), '\\', '/');
-
-	if (full_path.back() != '/')
-		full_path += '/';
-
-	full_path += "altsound.log";
-
-	out.open(full_path.c_str());
+	log_level.store(level, std::memory_order_relaxed);
+	none(0, "New log level set: %s", toString(level));
+}
 
-	none(0, "path set: %s", full_path.c_str());
+inline void AltsoundLogger::enableConsole(const bool enable)
+{
+	console.store(enable, std::memory_order_release);
+	has_sink.store(enable || out.is_open(), std::memory_order_release);
+	startWriter();
 }
 
-inline void AltsoundLogger::setLogLevel(Level level)
+inline bool AltsoundLogger::isEnabled(Level lvl) const
 {
-	log_level = level;
-	none(0, "New log level set: %s", toString(log_level));
+	return log_level.load(std::memory_order_relaxed) >= lvl;
 }
 
-inline void AltsoundLogger::enableConsole(const bool enable)
+inline uint64_t AltsoundLogger::getDroppedCount() const
 {
-	console = enable;
+	return dropped.load(std::memory_order_relaxed);
 }
 
 // ----------------------------------------------------------------------------
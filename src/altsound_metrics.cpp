@@ -0,0 +1,40 @@
+// ---------------------------------------------------------------------------
+// altsound_metrics.cpp
+//
+// Always-on per-stage latency histograms for the command pipeline
+// ---------------------------------------------------------------------------
+// license:BSD-3-Clause
+// ---------------------------------------------------------------------------
+
+#include "altsound_metrics.hpp"
+
+// ----------------------------------------------------------------------------
+// Functional code
+// ----------------------------------------------------------------------------
+
+void AltsoundMetrics::snapshot(AltSoundStats& stats_out) const
+{
+	for (int i = 0; i < ALTSOUND_STAGE_COUNT; ++i) {
+		const Stage& s = stages[i];
+		AltSoundStageStats& out = stats_out.stages[i];
+
+		out.count = s.count.load(std::memory_order_relaxed);
+		out.total_ns = s.total_ns.load(std::memory_order_relaxed);
+		out.max_ns = s.max_ns.load(std::memory_order_relaxed);
+		for (int b = 0; b < ALTSOUND_STATS_BUCKETS; ++b)
+			out.buckets[b] = s.buckets[b].load(std::memory_order_relaxed);
+	}
+}
+
+// ----------------------------------------------------------------------------
+
+void AltsoundMetrics::reset()
+{
+	for (Stage& s : stages) {
+		s.count.store(0, std::memory_order_relaxed);
+		s.total_ns.store(0, std::memory_order_relaxed);
+		s.max_ns.store(0, std::memory_order_relaxed);
+		for (auto& bucket : s.buckets)
+			bucket.store(0, std::memory_order_relaxed);
+	}
+}
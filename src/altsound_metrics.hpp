@@ -0,0 +1,132 @@
+// ---------------------------------------------------------------------------
+// altsound_metrics.hpp
+//
+// Always-on per-stage latency histograms for the command pipeline
+// ---------------------------------------------------------------------------
+// license:BSD-3-Clause
+// ---------------------------------------------------------------------------
+
+#ifndef ALTSOUND_METRICS_HPP
+#define ALTSOUND_METRICS_HPP
+#if !defined(__GNUC__) || (__GNUC__ == 3 && __GNUC_MINOR__ >= 4) || (__GNUC__ >= 4)	// GCC supports "pragma once" correctly since 3.4
+#pragma once
+#endif
+
+#include "altsound.h"
+
+#include <atomic>
+#include <bit>
+#include <chrono>
+#include <cstdint>
+
+// ---------------------------------------------------------------------------
+// AltsoundMetrics class definition
+//
+// Each stage keeps a count, a total, a maximum and a log2 histogram of
+// durations in nanoseconds.  Recording is a handful of relaxed atomic adds,
+// so it is safe from any thread, including the audio thread
+// ---------------------------------------------------------------------------
+
+class AltsoundMetrics
+{
+public:
+
+	// Standard constructor
+	AltsoundMetrics() = default;
+
+	// Copy constructor - NOT USED
+	AltsoundMetrics(AltsoundMetrics&) = delete;
+
+	// Read the monotonic clock in nanoseconds
+	static uint64_t now();
+
+	// Add one duration to a stage
+	void record(ALTSOUND_STAGE stage, uint64_t duration_ns);
+
+	// Add the time elapsed since start_ns to a stage
+	void recordSince(ALTSOUND_STAGE stage, uint64_t start_ns);
+
+	// Copy all stages.  Stages are read one counter at a time, so a snapshot
+	// taken while commands are running may be off by the in-flight samples
+	void snapshot(AltSoundStats& stats_out) const;
+
+	// Clear all stages
+	void reset();
+
+private: // data
+
+	struct Stage {
+		std::atomic<uint64_t> count{ 0 };
+		std::atomic<uint64_t> total_ns{ 0 };
+		std::atomic<uint64_t> max_ns{ 0 };
+		std::atomic<uint64_t> buckets[ALTSOUND_STATS_BUCKETS] = {};
+	};
+
+	Stage stages[ALTSOUND_STAGE_COUNT];
+};
+
+// ---------------------------------------------------------------------------
+// AltsoundStageTimer class definition
+//
+// Records the lifetime of the timer to a stage
+// ---------------------------------------------------------------------------
+
+class AltsoundStageTimer
+{
+public:
+
+	AltsoundStageTimer(AltsoundMetrics& metrics_in, ALTSOUND_STAGE stage_in);
+
+	// Copy constructor - NOT USED
+	AltsoundStageTimer(AltsoundStageTimer&) = delete;
+
+	~AltsoundStageTimer();
+
+private: // data
+
+	AltsoundMetrics& metrics;
+	ALTSOUND_STAGE stage;
+	uint64_t start_ns;
+};
+
+// ----------------------------------------------------------------------------
+// Inline functions
+// ----------------------------------------------------------------------------
+
+inline uint64_t AltsoundMetrics::now() {
+	return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+		std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+inline void AltsoundMetrics::record(ALTSOUND_STAGE stage, uint64_t duration_ns) {
+	Stage& s = stages[stage];
+
+	// bucket i holds [2^i, 2^(i+1)) ns; the last bucket holds everything longer
+	unsigned int bucket = duration_ns ? static_cast<unsigned int>(std::bit_width(duration_ns)) - 1 : 0;
+	if (bucket >= ALTSOUND_STATS_BUCKETS)
+		bucket = ALTSOUND_STATS_BUCKETS - 1;
+
+	s.buckets[bucket].fetch_add(1, std::memory_order_relaxed);
+	s.count.fetch_add(1, std::memory_order_relaxed);
+	s.total_ns.fetch_add(duration_ns, std::memory_order_relaxed);
+
+	uint64_t max_ns = s.max_ns.load(std::memory_order_relaxed);
+	while (duration_ns > max_ns && !s.max_ns.compare_exchange_weak(max_ns, duration_ns, std::memory_order_relaxed)) {}
+}
+
+inline void AltsoundMetrics::recordSince(ALTSOUND_STAGE stage, uint64_t start_ns) {
+	record(stage, now() - start_ns);
+}
+
+inline AltsoundStageTimer::AltsoundStageTimer(AltsoundMetrics& metrics_in, ALTSOUND_STAGE stage_in)
+: metrics(metrics_in),
+  stage(stage_in),
+  start_ns(AltsoundMetrics::now())
+{
+}
+
+inline AltsoundStageTimer::~AltsoundStageTimer() {
+	metrics.recordSince(stage, start_ns);
+}
+
+#endif // ALTSOUND_METRICS_HPP
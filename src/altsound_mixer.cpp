@@ -0,0 +1,610 @@
+// ---------------------------------------------------------------------------
+// altsound_mixer.cpp
+//
+// Voice mixer and its per-instruction-set kernels
+// ---------------------------------------------------------------------------
+// license:BSD-3-Clause
+// ---------------------------------------------------------------------------
+
+#include "altsound_mixer.hpp"
+#include "altsound_read_ahead.hpp"
+#include "miniaudio_private.h"
+
+#include <algorithm>
+#include <bit>
+#include <thread>
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+#define ALT_MIX_X86 1
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+#endif
+
+#if defined(__aarch64__) || defined(_M_ARM64) || (defined(__ARM_NEON) && defined(__arm__))
+#define ALT_MIX_NEON 1
+#include <arm_neon.h>
+#endif
+
+// GCC and Clang only emit AVX2 instructions in functions that ask for them.
+// MSVC always does
+#if defined(ALT_MIX_X86) && (defined(__GNUC__) || defined(__clang__))
+#define ALT_TARGET_AVX2 __attribute__((target("avx2")))
+#define ALT_TARGET_SSE2 __attribute__((target("sse2")))
+#else
+#define ALT_TARGET_AVX2
+#define ALT_TARGET_SSE2
+#endif
+
+// 16-bit PCM to float, as miniaudio converts it
+static const float S16_TO_F32 = 1.0f / 32768.0f;
+
+// fade_start values other than a mixer frame
+static const uint64_t FADE_NONE = UINT64_MAX;
+static const uint64_t FADE_PENDING = UINT64_MAX - 1; // starts with the next pass
+
+// ---------------------------------------------------------------------------
+// Portable kernels
+// ---------------------------------------------------------------------------
+
+static void mixF32Scalar(float* out, const float* in, size_t samples, float gain)
+{
+	for (size_t i = 0; i < samples; ++i)
+		out[i] += in[i] * gain;
+}
+
+static void mixF32MonoToStereoScalar(float* out, const float* in, size_t frames, float gain)
+{
+	for (size_t i = 0; i < frames; ++i) {
+		const float s = in[i] * gain;
+		out[i * 2] += s;
+		out[i * 2 + 1] += s;
+	}
+}
+
+static void mixS16Scalar(float* out, const int16_t* in, size_t samples, float gain)
+{
+	const float scale = gain * S16_TO_F32;
+	for (size_t i = 0; i < samples; ++i)
+		out[i] += static_cast<float>(in[i]) * scale;
+}
+
+static const AltsoundMixKernels KERNELS_SCALAR = {
+	"scalar", mixF32Scalar, mixF32MonoToStereoScalar, mixS16Scalar
+};
+
+// ---------------------------------------------------------------------------
+// SSE2 kernels
+// ---------------------------------------------------------------------------
+
+#if defined(ALT_MIX_X86)
+
+ALT_TARGET_SSE2 static void mixF32SSE2(float* out, const float* in, size_t samples, float gain)
+{
+	const __m128 g = _mm_set1_ps(gain);
+	size_t i = 0;
+	for (; i + 4 <= samples; i += 4)
+		_mm_storeu_ps(out + i, _mm_add_ps(_mm_loadu_ps(out + i), _mm_mul_ps(_mm_loadu_ps(in + i), g)));
+
+	mixF32Scalar(out + i, in + i, samples - i, gain);
+}
+
+ALT_TARGET_SSE2 static void mixF32MonoToStereoSSE2(float* out, const float* in, size_t frames, float gain)
+{
+	const __m128 g = _mm_set1_ps(gain);
+	size_t i = 0;
+	for (; i + 4 <= frames; i += 4) {
+		const __m128 s = _mm_mul_ps(_mm_loadu_ps(in + i), g);
+		float* dst = out + i * 2;
+		_mm_storeu_ps(dst, _mm_add_ps(_mm_loadu_ps(dst), _mm_unpacklo_ps(s, s)));
+		_mm_storeu_ps(dst + 4, _mm_add_ps(_mm_loadu_ps(dst + 4), _mm_unpackhi_ps(s, s)));
+	}
+
+	mixF32MonoToStereoScalar(out + i * 2, in + i, frames - i, gain);
+}
+
+ALT_TARGET_SSE2 static void mixS16SSE2(float* out, const int16_t* in, size_t samples, float gain)
+{
+	const __m128 scale = _mm_set1_ps(gain * S16_TO_F32);
+	size_t i = 0;
+	for (; i + 8 <= samples; i += 8) {
+		const __m128i s16 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i));
+		// sign-extend by placing each sample in the high half and shifting down
+		const __m128i lo = _mm_srai_epi32(_mm_unpacklo_epi16(s16, s16), 16);
+		const __m128i hi = _mm_srai_epi32(_mm_unpackhi_epi16(s16, s16), 16);
+		_mm_storeu_ps(out + i, _mm_add_ps(_mm_loadu_ps(out + i), _mm_mul_ps(_mm_cvtepi32_ps(lo), scale)));
+		_mm_storeu_ps(out + i + 4, _mm_add_ps(_mm_loadu_ps(out + i + 4), _mm_mul_ps(_mm_cvtepi32_ps(hi), scale)));
+	}
+
+	mixS16Scalar(out + i, in + i, samples - i, gain);
+}
+
+static const AltsoundMixKernels KERNELS_SSE2 = {
+	"sse2", mixF32SSE2, mixF32MonoToStereoSSE2, mixS16SSE2
+};
+
+// ---------------------------------------------------------------------------
+// AVX2 kernels
+// ---------------------------------------------------------------------------
+
+ALT_TARGET_AVX2 static void mixF32AVX2(float* out, const float* in, size_t samples, float gain)
+{
+	const __m256 g = _mm256_set1_ps(gain);
+	size_t i = 0;
+	for (; i + 8 <= samples; i += 8)
+		_mm256_storeu_ps(out + i, _mm256_add_ps(_mm256_loadu_ps(out + i), _mm256_mul_ps(_mm256_loadu_ps(in + i), g)));
+
+	mixF32Scalar(out + i, in + i, samples - i, gain);
+}
+
+ALT_TARGET_AVX2 static void mixF32MonoToStereoAVX2(float* out, const float* in, size_t frames, float gain)
+{
+	const __m256 g = _mm256_set1_ps(gain);
+	size_t i = 0;
+	for (; i + 8 <= frames; i += 8) {
+		const __m256 s = _mm256_mul_ps(_mm256_loadu_ps(in + i), g);
+		// unpack works within 128-bit lanes: [0 0 1 1 | 4 4 5 5] and [2 2 3 3 | 6 6 7 7]
+		const __m256 lo = _mm256_unpacklo_ps(s, s);
+		const __m256 hi = _mm256_unpackhi_ps(s, s);
+		float* dst = out + i * 2;
+		_mm256_storeu_ps(dst, _mm256_add_ps(_mm256_loadu_ps(dst), _mm256_permute2f128_ps(lo, hi, 0x20)));
+		_mm256_storeu_ps(dst + 8, _mm256_add_ps(_mm256_loadu_ps(dst + 8), _mm256_permute2f128_ps(lo, hi, 0x31)));
+	}
+
+	mixF32MonoToStereoScalar(out + i * 2, in + i, frames - i, gain);
+}
+
+ALT_TARGET_AVX2 static void mixS16AVX2(float* out, const int16_t* in, size_t samples, float gain)
+{
+	const __m256 scale = _mm256_set1_ps(gain * S16_TO_F32);
+	size_t i = 0;
+	for (; i + 8 <= samples; i += 8) {
+		const __m128i s16 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i));
+		const __m256 s = _mm256_cvtepi32_ps(_mm256_cvtepi16_epi32(s16));
+		_mm256_storeu_ps(out + i, _mm256_add_ps(_mm256_loadu_ps(out + i), _mm256_mul_ps(s, scale)));
+	}
+
+	mixS16Scalar(out + i, in + i, samples - i, gain);
+}
+
+static const AltsoundMixKernels KERNELS_AVX2 = {
+	"avx2", mixF32AVX2, mixF32MonoToStereoAVX2, mixS16AVX2
+};
+
+// Determine if the CPU and OS support AVX2
+static bool cpuHasAVX2()
+{
+#if defined(_MSC_VER) && !defined(__clang__)
+	int info[4];
+	__cpuid(info, 0);
+	if (info[0] < 7)
+		return false;
+
+	// AVX enabled by the OS (OSXSAVE, AVX and the YMM state in XCR0)
+	__cpuid(info, 1);
+	if ((info[2] & (1 << 27)) == 0 || (info[2] & (1 << 28)) == 0 || (_xgetbv(0) & 6) != 6)
+		return false;
+
+	__cpuidex(info, 7, 0);
+	return (info[1] & (1 << 5)) != 0;
+#else
+	return __builtin_cpu_supports("avx2");
+#endif
+}
+
+// Determine if the CPU supports SSE2.  Always true on x86-64
+static bool cpuHasSSE2()
+{
+#if defined(__x86_64__) || defined(_M_X64)
+	return true;
+#elif defined(_MSC_VER) && !defined(__clang__)
+	int info[4];
+	__cpuid(info, 1);
+	return (info[3] & (1 << 26)) != 0;
+#else
+	return __builtin_cpu_supports("sse2");
+#endif
+}
+
+#endif // ALT_MIX_X86
+
+// ---------------------------------------------------------------------------
+// NEON kernels
+// ---------------------------------------------------------------------------
+
+#if defined(ALT_MIX_NEON)
+
+static void mixF32NEON(float* out, const float* in, size_t samples, float gain)
+{
+	const float32x4_t g = vdupq_n_f32(gain);
+	size_t i = 0;
+	for (; i + 4 <= samples; i += 4)
+		vst1q_f32(out + i, vaddq_f32(vld1q_f32(out + i), vmulq_f32(vld1q_f32(in + i), g)));
+
+	mixF32Scalar(out + i, in + i, samples - i, gain);
+}
+
+static void mixF32MonoToStereoNEON(float* out, const float* in, size_t frames, float gain)
+{
+	const float32x4_t g = vdupq_n_f32(gain);
+	size_t i = 0;
+	for (; i + 4 <= frames; i += 4) {
+		const float32x4_t s = vmulq_f32(vld1q_f32(in + i), g);
+		float* dst = out + i * 2;
+		float32x4x2_t lr = vld2q_f32(dst);
+		lr.val[0] = vaddq_f32(lr.val[0], s);
+		lr.val[1] = vaddq_f32(lr.val[1], s);
+		vst2q_f32(dst, lr);
+	}
+
+	mixF32MonoToStereoScalar(out + i * 2, in + i, frames - i, gain);
+}
+
+static void mixS16NEON(float* out, const int16_t* in, size_t samples, float gain)
+{
+	const float32x4_t scale = vdupq_n_f32(gain * S16_TO_F32);
+	size_t i = 0;
+	for (; i + 8 <= samples; i += 8) {
+		const int16x8_t s16 = vld1q_s16(in + i);
+		const float32x4_t lo = vcvtq_f32_s32(vmovl_s16(vget_low_s16(s16)));
+		const float32x4_t hi = vcvtq_f32_s32(vmovl_s16(vget_high_s16(s16)));
+		vst1q_f32(out + i, vaddq_f32(vld1q_f32(out + i), vmulq_f32(lo, scale)));
+		vst1q_f32(out + i + 4, vaddq_f32(vld1q_f32(out + i + 4), vmulq_f32(hi, scale)));
+	}
+
+	mixS16Scalar(out + i, in + i, samples - i, gain);
+}
+
+static const AltsoundMixKernels KERNELS_NEON = {
+	"neon", mixF32NEON, mixF32MonoToStereoNEON, mixS16NEON
+};
+
+#endif // ALT_MIX_NEON
+
+// ----------------------------------------------------------------------------
+
+std::vector<const AltsoundMixKernels*> altsound_get_mix_kernels()
+{
+	std::vector<const AltsoundMixKernels*> kernels;
+
+#if defined(ALT_MIX_X86)
+	if (cpuHasAVX2())
+		kernels.push_back(&KERNELS_AVX2);
+	if (cpuHasSSE2())
+		kernels.push_back(&KERNELS_SSE2);
+#endif
+#if defined(ALT_MIX_NEON)
+	kernels.push_back(&KERNELS_NEON);
+#endif
+
+	kernels.push_back(&KERNELS_SCALAR);
+	return kernels;
+}
+
+// ---------------------------------------------------------------------------
+// AltsoundMixer implementation
+// ---------------------------------------------------------------------------
+
+bool AltsoundMixer::init(uint32_t channels_in, unsigned int voice_count_in, AltsoundVoiceEndProc end_proc_in, void* end_user_in)
+{
+	if (channels_in == 0)
+		return false;
+
+	channels = channels_in;
+	voice_count = voice_count_in;
+	end_proc = end_proc_in;
+	end_user = end_user_in;
+	kernels = altsound_get_mix_kernels().front();
+
+	pcm.reset(new const void*[voice_count]());
+	decoder.reset(new ma_decoder*[voice_count]());
+	read_ahead.reset(new ReadAheadStream*[voice_count]());
+	frame_count.reset(new uint64_t[voice_count]());
+	cursor.reset(new uint64_t[voice_count]());
+	start_frame.reset(new std::atomic<uint64_t>[voice_count]);
+	volume.reset(new std::atomic<float>[voice_count]);
+	fade_start.reset(new std::atomic<uint64_t>[voice_count]);
+	fade_frames.reset(new uint32_t[voice_count]());
+	source.reset(new uint8_t[voice_count]());
+	voice_channels.reset(new uint8_t[voice_count]());
+	looping.reset(new bool[voice_count]());
+	for (unsigned int i = 0; i < voice_count; ++i) {
+		start_frame[i].store(0, std::memory_order_relaxed);
+		volume[i].store(1.0f, std::memory_order_relaxed);
+		fade_start[i].store(FADE_NONE, std::memory_order_relaxed);
+	}
+
+	active_words = (voice_count + 63) / 64;
+	active.reset(new std::atomic<uint64_t>[active_words]);
+	for (unsigned int i = 0; i < active_words; ++i)
+		active[i].store(0, std::memory_order_relaxed);
+
+	scratch.assign(static_cast<size_t>(ALT_MIX_CHUNK_FRAMES) * channels, 0.0f);
+	mix_seq.store(0);
+	clock.store(0);
+	return true;
+}
+
+// ----------------------------------------------------------------------------
+
+void AltsoundMixer::setKernels(const AltsoundMixKernels& kernels_in)
+{
+	kernels = &kernels_in;
+}
+
+// ----------------------------------------------------------------------------
+
+bool AltsoundMixer::setVoice(unsigned int voice, const AltsoundVoiceDesc& desc)
+{
+	if (voice >= voice_count || (desc.channels != channels && desc.channels != 1)
+	    || (desc.source == ALT_VOICE_S16 && desc.channels != channels)
+	    || (desc.source == ALT_VOICE_DECODER && !desc.decoder)
+	    || (desc.source == ALT_VOICE_READ_AHEAD && !desc.read_ahead)
+	    || (desc.source <= ALT_VOICE_S16 && !desc.pcm))
+		return false;
+
+	pcm[voice] = desc.pcm;
+	decoder[voice] = desc.decoder;
+	read_ahead[voice] = desc.read_ahead;
+	frame_count[voice] = desc.frame_count;
+	cursor[voice] = 0;
+	start_frame[voice].store(0, std::memory_order_relaxed);
+	volume[voice].store(1.0f, std::memory_order_relaxed);
+	fade_start[voice].store(FADE_NONE, std::memory_order_relaxed);
+	source[voice] = static_cast<uint8_t>(desc.source);
+	voice_channels[voice] = static_cast<uint8_t>(desc.channels);
+	looping[voice] = desc.looping;
+	return true;
+}
+
+// ----------------------------------------------------------------------------
+
+void AltsoundMixer::clearVoice(unsigned int voice)
+{
+	deactivate(voice);
+	waitForMix();
+
+	pcm[voice] = nullptr;
+	decoder[voice] = nullptr;
+	read_ahead[voice] = nullptr;
+	frame_count[voice] = 0;
+}
+
+// ----------------------------------------------------------------------------
+
+void AltsoundMixer::play(unsigned int voice, uint64_t start_frame_in)
+{
+	// publishes the voice's source to the mixing thread
+	start_frame[voice].store(start_frame_in, std::memory_order_relaxed);
+	active[voice / 64].fetch_or(uint64_t(1) << (voice % 64));
+}
+
+// ----------------------------------------------------------------------------
+
+void AltsoundMixer::fadeOut(unsigned int voice, uint32_t frames)
+{
+	// published with the start sentinel
+	fade_frames[voice] = std::max<uint32_t>(frames, 1);
+	fade_start[voice].store(FADE_PENDING, std::memory_order_release);
+}
+
+// ----------------------------------------------------------------------------
+
+void AltsoundMixer::pause(unsigned int voice)
+{
+	deactivate(voice);
+}
+
+// ----------------------------------------------------------------------------
+
+void AltsoundMixer::rewind(unsigned int voice)
+{
+	deactivate(voice);
+	waitForMix();
+
+	cursor[voice] = 0;
+	if (decoder[voice])
+		altsound_ma_decoder_seek_to_pcm_frame(decoder[voice], 0);
+}
+
+// ----------------------------------------------------------------------------
+
+void AltsoundMixer::mix(float* out, size_t frames)
+{
+	// voices cleared before this point are not read by this pass
+	mix_seq.fetch_add(1);
+
+	std::fill(out, out + frames * channels, 0.0f);
+	const uint64_t pass_time = clock.load(std::memory_order_relaxed);
+
+	for (unsigned int word = 0; word < active_words; ++word) {
+		uint64_t bits = active[word].load();
+		while (bits) {
+			const unsigned int voice = word * 64 + static_cast<unsigned int>(std::countr_zero(bits));
+			bits &= bits - 1;
+			mixVoice(voice, out, frames, pass_time);
+		}
+	}
+
+	clock.store(pass_time + frames, std::memory_order_release);
+	mix_seq.fetch_add(1);
+}
+
+// ----------------------------------------------------------------------------
+
+void AltsoundMixer::mixVoice(unsigned int voice, float* out, size_t frames, uint64_t pass_time)
+{
+	// a scheduled start within or after this pass
+	const uint64_t start = start_frame[voice].load(std::memory_order_relaxed);
+	if (start > pass_time) {
+		if (start >= pass_time + frames)
+			return;
+
+		const size_t skip = static_cast<size_t>(start - pass_time);
+		out += skip * channels;
+		frames -= skip;
+	}
+
+	const float gain = volume[voice].load(std::memory_order_relaxed);
+	uint64_t fade = fade_start[voice].load(std::memory_order_acquire);
+	if (fade == FADE_NONE) {
+		if (mixSource(voice, out, frames, gain) && deactivate(voice) && end_proc)
+			end_proc(voice, end_user);
+		return;
+	}
+
+	// fading out: step the gain down in short blocks, from the first frame
+	// mixed after the fade was requested
+	const uint64_t now = pass_time + (start > pass_time ? start - pass_time : 0);
+	if (fade == FADE_PENDING) {
+		fade = now;
+		fade_start[voice].store(fade, std::memory_order_relaxed);
+	}
+
+	const uint32_t length = fade_frames[voice];
+	uint64_t pos = now - fade;
+	bool ended = false;
+	while (frames > 0 && pos < length && !ended) {
+		const size_t step = static_cast<size_t>(std::min<uint64_t>({ frames, ALT_MIX_FADE_STEP_FRAMES, length - pos }));
+		const float ramp = 1.0f - (static_cast<float>(pos) + step * 0.5f) / length;
+		ended = mixSource(voice, out, step, gain * ramp);
+		out += step * channels;
+		frames -= step;
+		pos += step;
+	}
+
+	// a faded voice just goes quiet: whoever stole it frees it
+	if (ended || pos >= length)
+		deactivate(voice);
+}
+
+// ----------------------------------------------------------------------------
+
+bool AltsoundMixer::mixSource(unsigned int voice, float* out, size_t frames, float gain)
+{
+	const AltsoundVoiceSource src = static_cast<AltsoundVoiceSource>(source[voice]);
+	const uint32_t in_channels = voice_channels[voice];
+	bool ended = false;
+
+	if (src == ALT_VOICE_READ_AHEAD) {
+		ReadAheadStream* stream = read_ahead[voice];
+		while (frames > 0) {
+			const float* ready_pcm;
+			bool at_end;
+			const size_t ready = std::min(frames, stream->peek(ready_pcm, at_end));
+			if (ready == 0) {
+				// silence until the read-ahead thread catches up
+				if (at_end)
+					ended = true;
+				else
+					stream->starved(frames);
+				break;
+			}
+
+			mixBlock(out, ready_pcm, ALT_VOICE_F32, in_channels, ready, gain);
+			stream->consume(ready);
+			out += ready * channels;
+			frames -= ready;
+		}
+	}
+	else if (src == ALT_VOICE_DECODER) {
+		bool wrapped = false;
+		while (frames > 0) {
+			const size_t chunk = std::min<size_t>(frames, ALT_MIX_CHUNK_FRAMES);
+			ma_uint64 frames_read = 0;
+			altsound_ma_decoder_read_pcm_frames(decoder[voice], scratch.data(), chunk, &frames_read);
+
+			if (frames_read > 0) {
+				mixBlock(out, scratch.data(), src, in_channels, static_cast<size_t>(frames_read), gain);
+				out += frames_read * channels;
+				frames -= static_cast<size_t>(frames_read);
+				wrapped = false;
+			}
+
+			if (frames_read < chunk) {
+				// stop on a decoder that returns nothing right after a rewind
+				if (!looping[voice] || wrapped) {
+					ended = true;
+					break;
+				}
+				altsound_ma_decoder_seek_to_pcm_frame(decoder[voice], 0);
+				wrapped = true;
+			}
+		}
+	}
+	else {
+		const uint64_t length = frame_count[voice];
+		const size_t frame_bytes = in_channels * (src == ALT_VOICE_S16 ? sizeof(int16_t) : sizeof(float));
+		const uint8_t* base = static_cast<const uint8_t*>(pcm[voice]);
+
+		while (frames > 0) {
+			if (cursor[voice] >= length) {
+				if (!looping[voice] || length == 0) {
+					ended = true;
+					break;
+				}
+				cursor[voice] = 0;
+			}
+
+			const size_t count = static_cast<size_t>(std::min<uint64_t>(frames, length - cursor[voice]));
+			mixBlock(out, base + cursor[voice] * frame_bytes, src, in_channels, count, gain);
+			cursor[voice] += count;
+			out += count * channels;
+			frames -= count;
+		}
+
+		// report the end as soon as the last frame is mixed
+		if (!looping[voice] && cursor[voice] >= length)
+			ended = true;
+	}
+
+	return ended;
+}
+
+// ----------------------------------------------------------------------------
+
+void AltsoundMixer::mixBlock(float* out, const void* in, AltsoundVoiceSource src, uint32_t in_channels,
+                             size_t frames, float gain) const
+{
+	if (in_channels == channels) {
+		if (src == ALT_VOICE_S16)
+			kernels->mix_s16(out, static_cast<const int16_t*>(in), frames * channels, gain);
+		else
+			kernels->mix_f32(out, static_cast<const float*>(in), frames * channels, gain);
+		return;
+	}
+
+	// mono: the same signal on every output channel
+	const float* mono = static_cast<const float*>(in);
+	if (channels == 2) {
+		kernels->mix_f32_mono_to_stereo(out, mono, frames, gain);
+		return;
+	}
+
+	for (size_t i = 0; i < frames; ++i) {
+		const float s = mono[i] * gain;
+		for (uint32_t c = 0; c < channels; ++c)
+			out[i * channels + c] += s;
+	}
+}
+
+// ----------------------------------------------------------------------------
+
+bool AltsoundMixer::deactivate(unsigned int voice)
+{
+	const uint64_t bit = uint64_t(1) << (voice % 64);
+	return (active[voice / 64].fetch_and(~bit) & bit) != 0;
+}
+
+// ----------------------------------------------------------------------------
+
+void AltsoundMixer::waitForMix() const
+{
+	const uint64_t seq = mix_seq.load();
+	if ((seq & 1) == 0)
+		return;
+
+	while (mix_seq.load() == seq)
+		std::this_thread::yield();
+}
@@ -0,0 +1,213 @@
+// ---------------------------------------------------------------------------
+// altsound_mixer.hpp
+//
+// Voice mixer: adds every playing stream, scaled by its volume, into the
+// output buffer with SIMD kernels selected for the CPU at runtime
+// ---------------------------------------------------------------------------
+// license:BSD-3-Clause
+// ---------------------------------------------------------------------------
+
+#ifndef ALTSOUND_MIXER_HPP
+#define ALTSOUND_MIXER_HPP
+#if !defined(__GNUC__) || (__GNUC__ == 3 && __GNUC_MINOR__ >= 4) || (__GNUC__ >= 4)	// GCC supports "pragma once" correctly since 3.4
+#pragma once
+#endif
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+struct ma_decoder;
+class ReadAheadStream;
+
+// Streamed voices are decoded in chunks of this many frames
+#define ALT_MIX_CHUNK_FRAMES 512
+
+// Fades step their gain every this many frames
+#define ALT_MIX_FADE_STEP_FRAMES 16
+
+// Mixing kernels for one instruction set.  Every kernel adds gain * input to
+// the output, with a separate multiply and add per sample, so all kernel sets
+// produce identical output
+struct AltsoundMixKernels {
+	const char* name;
+
+	// float input in the output channel layout
+	void (*mix_f32)(float* out, const float* in, size_t samples, float gain);
+
+	// mono float input into stereo output
+	void (*mix_f32_mono_to_stereo)(float* out, const float* in, size_t frames, float gain);
+
+	// 16-bit input in the output channel layout
+	void (*mix_s16)(float* out, const int16_t* in, size_t samples, float gain);
+};
+
+// Kernel sets this CPU supports, fastest first.  The portable set is last
+std::vector<const AltsoundMixKernels*> altsound_get_mix_kernels();
+
+// Where a voice's PCM comes from
+enum AltsoundVoiceSource {
+	ALT_VOICE_F32 = 0,   // float PCM in memory
+	ALT_VOICE_S16,       // 16-bit PCM in memory
+	ALT_VOICE_DECODER,   // float PCM read from a decoder on the mixing thread
+	ALT_VOICE_READ_AHEAD // float PCM decoded ahead by the read-ahead thread
+};
+
+// A voice's source, at the output sample rate.  Its channel count must be 1
+// or the output channel count; 16-bit PCM must be in the output layout
+struct AltsoundVoiceDesc {
+	AltsoundVoiceSource source = ALT_VOICE_F32;
+	const void* pcm = nullptr;             // ALT_VOICE_F32 and ALT_VOICE_S16
+	uint64_t frame_count = 0;              // ALT_VOICE_F32 and ALT_VOICE_S16
+	ma_decoder* decoder = nullptr;         // ALT_VOICE_DECODER
+	ReadAheadStream* read_ahead = nullptr; // ALT_VOICE_READ_AHEAD
+	uint32_t channels = 2;
+	bool looping = false;
+};
+
+// Called on the mixing thread when a non-looping voice reaches its end
+typedef void (*AltsoundVoiceEndProc)(unsigned int voice, void* user);
+
+// ---------------------------------------------------------------------------
+// AltsoundMixer class definition
+//
+// Voices are kept in structure-of-arrays form and indexed by stream slot, and
+// a bitmask of playing voices is all the mixing thread scans.  Control calls
+// come from one thread at a time (the processors serialize them with
+// io_mutex) and never block the mixing thread.  Calls that must know the
+// mixing thread is done with a voice wait for a mix in progress to finish
+// ---------------------------------------------------------------------------
+
+class AltsoundMixer
+{
+public:
+
+	// Standard constructor
+	AltsoundMixer() = default;
+
+	// Copy constructor - NOT USED
+	AltsoundMixer(AltsoundMixer&) = delete;
+
+	// Allocate voices and reset the clock.  Must not run while mixing
+	bool init(uint32_t channels_in, unsigned int voice_count_in, AltsoundVoiceEndProc end_proc_in, void* end_user_in);
+
+	// Use a kernel set instead of the fastest one.  Must not run while mixing
+	void setKernels(const AltsoundMixKernels& kernels_in);
+
+	// Name of the kernel set in use
+	const char* getKernelName() const;
+
+	// Frames mixed since init()
+	uint64_t getTime() const;
+
+	// Assign a source to a stopped voice.  Returns false if the channel
+	// layout is not supported
+	bool setVoice(unsigned int voice, const AltsoundVoiceDesc& desc);
+
+	// Stop a voice and forget its source.  On return the mixing thread no
+	// longer reads it
+	void clearVoice(unsigned int voice);
+
+	// Start or resume a voice.  A start_frame ahead of the mixer clock
+	// delays its start to that exact frame
+	void play(unsigned int voice, uint64_t start_frame = 0);
+
+	// Stop mixing a voice, keeping its position
+	void pause(unsigned int voice);
+
+	// Stop a voice and move it back to its first frame
+	void rewind(unsigned int voice);
+
+	// Set a voice's gain.  Takes effect on the next pass
+	void setVolume(unsigned int voice, float volume);
+
+	// Ramp a playing voice down to silence over frames, from the next pass,
+	// then stop it without calling the end proc
+	void fadeOut(unsigned int voice, uint32_t frames);
+
+	// Determine if a voice is playing (or fading out)
+	bool isPlaying(unsigned int voice) const;
+
+	// Mix the playing voices into frames of interleaved output.  Called by
+	// the audio thread, or by the host in pull and offline mode
+	void mix(float* out, size_t frames);
+
+private: // functions
+
+	// mix frames of one voice, starting at the mixer time of the pass
+	void mixVoice(unsigned int voice, float* out, size_t frames, uint64_t pass_time);
+
+	// mix frames of a voice's source at a fixed gain.  Returns true when a
+	// non-looping source ran out
+	bool mixSource(unsigned int voice, float* out, size_t frames, float gain);
+
+	// add frames of source PCM to the output
+	void mixBlock(float* out, const void* in, AltsoundVoiceSource source, uint32_t in_channels,
+	              size_t frames, float gain) const;
+
+	// clear a voice's playing bit.  Returns true if it was set
+	bool deactivate(unsigned int voice);
+
+	// wait for a mix in progress to finish
+	void waitForMix() const;
+
+private: // data
+
+	uint32_t channels = 2;
+	unsigned int voice_count = 0;
+	AltsoundVoiceEndProc end_proc = nullptr;
+	void* end_user = nullptr;
+	const AltsoundMixKernels* kernels = nullptr;
+
+	// voice state, indexed by voice
+	std::unique_ptr<const void*[]> pcm;
+	std::unique_ptr<ma_decoder*[]> decoder;
+	std::unique_ptr<ReadAheadStream*[]> read_ahead;
+	std::unique_ptr<uint64_t[]> frame_count;
+	std::unique_ptr<uint64_t[]> cursor;        // owned by the mixing thread while playing
+	std::unique_ptr<std::atomic<uint64_t>[]> start_frame;
+	std::unique_ptr<std::atomic<float>[]> volume;
+	std::unique_ptr<std::atomic<uint64_t>[]> fade_start; // mixer frame, or a sentinel
+	std::unique_ptr<uint32_t[]> fade_frames;
+	std::unique_ptr<uint8_t[]> source;
+	std::unique_ptr<uint8_t[]> voice_channels;
+	std::unique_ptr<bool[]> looping;
+
+	// one bit per playing voice
+	std::unique_ptr<std::atomic<uint64_t>[]> active;
+	unsigned int active_words = 0;
+
+	std::atomic<uint64_t> mix_seq{ 0 }; // odd while a mix is in progress
+	std::atomic<uint64_t> clock{ 0 };
+	std::vector<float> scratch;         // decoded chunk of a streamed voice
+};
+
+// ----------------------------------------------------------------------------
+// Inline functions
+// ----------------------------------------------------------------------------
+
+inline const char* AltsoundMixer::getKernelName() const {
+	return kernels ? kernels->name : "none";
+}
+
+// ----------------------------------------------------------------------------
+
+inline uint64_t AltsoundMixer::getTime() const {
+	return clock.load(std::memory_order_acquire);
+}
+
+// ----------------------------------------------------------------------------
+
+inline void AltsoundMixer::setVolume(unsigned int voice, float volume_in) {
+	volume[voice].store(volume_in, std::memory_order_relaxed);
+}
+
+// ----------------------------------------------------------------------------
+
+inline bool AltsoundMixer::isPlaying(unsigned int voice) const {
+	return (active[voice / 64].load(std::memory_order_acquire) >> (voice % 64)) & 1;
+}
+
+#endif // ALTSOUND_MIXER_HPP
@@ -0,0 +1,164 @@
+// ---------------------------------------------------------------------------
+// altsound_object_pool.hpp
+//
+// Fixed-capacity object pool used to recycle per-voice objects instead of
+// allocating them for every sound command
+// ---------------------------------------------------------------------------
+// license:BSD-3-Clause
+// ---------------------------------------------------------------------------
+
+#ifndef ALTSOUND_OBJECT_POOL_HPP
+#define ALTSOUND_OBJECT_POOL_HPP
+#if !defined(__GNUC__) || (__GNUC__ == 3 && __GNUC_MINOR__ >= 4) || (__GNUC__ >= 4)	// GCC supports "pragma once" correctly since 3.4
+#pragma once
+#endif
+
+#include <cassert>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+// Extra objects beyond the channel count.  Processors acquire stream info
+// before they know whether a channel is free
+#define ALT_VOICE_POOL_HEADROOM 2
+
+// ---------------------------------------------------------------------------
+// AltsoundObjectPool class definition
+//
+// Objects are handed out as-is: they keep whatever state the previous user
+// left, so callers must (re)initialize them.  When the pool is exhausted,
+// acquire() falls back to the heap and counts it, so a non-zero
+// getHeapAllocCount() means the pool is undersized
+// ---------------------------------------------------------------------------
+
+template<typename T>
+class AltsoundObjectPool
+{
+public:
+
+	// Standard constructor
+	AltsoundObjectPool() = default;
+
+	// Copy constructor - NOT USED
+	AltsoundObjectPool(AltsoundObjectPool&) = delete;
+
+	// (Re)allocate storage for capacity_in objects.  All objects must have
+	// been released
+	void reserve(size_t capacity_in);
+
+	// Get an object from the pool, or from the heap if the pool is empty
+	T* acquire();
+
+	// Return an object obtained from acquire()
+	void release(T* obj_in);
+
+	// Pool statistics
+	size_t getCapacity() const;
+	size_t getInUseCount() const;
+	uint64_t getHeapAllocCount() const;
+
+private: // functions
+
+	// determine if obj_in lives in the pool storage
+	bool owns(const T* obj_in) const;
+
+private: // data
+
+	mutable std::mutex mutex;
+	std::unique_ptr<T[]> storage;
+	size_t capacity = 0;
+	std::vector<T*> free_list;
+	uint64_t heap_allocs = 0;
+};
+
+// ----------------------------------------------------------------------------
+// Inline functions
+// ----------------------------------------------------------------------------
+
+template<typename T>
+inline void AltsoundObjectPool<T>::reserve(size_t capacity_in)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	assert(free_list.size() == capacity);
+
+	if (capacity_in != capacity) {
+		storage.reset(capacity_in ? new T[capacity_in]() : nullptr);
+		capacity = capacity_in;
+	}
+
+	free_list.clear();
+	free_list.reserve(capacity);
+	for (size_t i = capacity; i > 0; --i)
+		free_list.push_back(&storage[i - 1]);
+
+	heap_allocs = 0;
+}
+
+// ----------------------------------------------------------------------------
+
+template<typename T>
+inline T* AltsoundObjectPool<T>::acquire()
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		if (!free_list.empty()) {
+			T* obj = free_list.back();
+			free_list.pop_back();
+			return obj;
+		}
+		++heap_allocs;
+	}
+	return new T();
+}
+
+// ----------------------------------------------------------------------------
+
+template<typename T>
+inline void AltsoundObjectPool<T>::release(T* obj_in)
+{
+	if (!obj_in)
+		return;
+
+	if (!owns(obj_in)) {
+		delete obj_in;
+		return;
+	}
+
+	std::lock_guard<std::mutex> lock(mutex);
+	free_list.push_back(obj_in);
+}
+
+// ----------------------------------------------------------------------------
+
+template<typename T>
+inline size_t AltsoundObjectPool<T>::getCapacity() const {
+	std::lock_guard<std::mutex> lock(mutex);
+	return capacity;
+}
+
+// ----------------------------------------------------------------------------
+
+template<typename T>
+inline size_t AltsoundObjectPool<T>::getInUseCount() const {
+	std::lock_guard<std::mutex> lock(mutex);
+	return capacity - free_list.size();
+}
+
+// ----------------------------------------------------------------------------
+
+template<typename T>
+inline uint64_t AltsoundObjectPool<T>::getHeapAllocCount() const {
+	std::lock_guard<std::mutex> lock(mutex);
+	return heap_allocs;
+}
+
+// ----------------------------------------------------------------------------
+
+template<typename T>
+inline bool AltsoundObjectPool<T>::owns(const T* obj_in) const {
+	// storage only changes in reserve(), when nothing is in use
+	return storage && obj_in >= &storage[0] && obj_in < &storage[0] + capacity;
+}
+
+#endif // ALTSOUND_OBJECT_POOL_HPP
@@ -0,0 +1,380 @@
+// ---------------------------------------------------------------------------
+// altsound_pack.cpp
+//
+// Memory-mapped reader for AltSound sample packs (.altpack)
+// ---------------------------------------------------------------------------
+// license:BSD-3-Clause
+// ---------------------------------------------------------------------------
+
+#include "altsound_pack.hpp"
+#include "altsound_logger.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+extern AltsoundLogger alog;
+
+// ----------------------------------------------------------------------------
+// CTOR/DTOR
+// ----------------------------------------------------------------------------
+
+AltsoundPack::~AltsoundPack()
+{
+	close();
+}
+
+// ----------------------------------------------------------------------------
+// Functional code
+// ----------------------------------------------------------------------------
+
+bool AltsoundPack::open(const std::string& path_in)
+{
+	ALT_DEBUG(0, "BEGIN AltsoundPack::open()");
+	ALT_INDENT;
+
+	close();
+
+#ifdef _WIN32
+	HANDLE file = CreateFileA(path_in.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING,
+	                          FILE_ATTRIBUTE_NORMAL | FILE_FLAG_RANDOM_ACCESS, NULL);
+	if (file == INVALID_HANDLE_VALUE) {
+		ALT_ERROR(0, "Unable to open pack: %s", path_in.c_str());
+
+		ALT_OUTDENT;
+		ALT_DEBUG(0, "END AltsoundPack::open()");
+		return false;
+	}
+
+	LARGE_INTEGER file_size;
+	HANDLE mapping = NULL;
+	const void* view = NULL;
+	if (GetFileSizeEx(file, &file_size) && file_size.QuadPart > 0)
+		mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+	if (mapping)
+		view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+
+	if (!view) {
+		ALT_ERROR(0, "Unable to map pack: %s", path_in.c_str());
+		if (mapping)
+			CloseHandle(mapping);
+		CloseHandle(file);
+
+		ALT_OUTDENT;
+		ALT_DEBUG(0, "END AltsoundPack::open()");
+		return false;
+	}
+
+	file_handle = file;
+	mapping_handle = mapping;
+	base = static_cast<const uint8_t*>(view);
+	size = static_cast<uint64_t>(file_size.QuadPart);
+#else
+	const int fd = ::open(path_in.c_str(), O_RDONLY);
+	if (fd < 0) {
+		ALT_ERROR(0, "Unable to open pack: %s", path_in.c_str());
+
+		ALT_OUTDENT;
+		ALT_DEBUG(0, "END AltsoundPack::open()");
+		return false;
+	}
+
+	struct stat info;
+	void* view = MAP_FAILED;
+	if (fstat(fd, &info) == 0 && info.st_size > 0)
+		view = mmap(nullptr, static_cast<size_t>(info.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+
+	// the mapping keeps its own reference to the file
+	::close(fd);
+
+	if (view == MAP_FAILED) {
+		ALT_ERROR(0, "Unable to map pack: %s", path_in.c_str());
+
+		ALT_OUTDENT;
+		ALT_DEBUG(0, "END AltsoundPack::open()");
+		return false;
+	}
+
+	base = static_cast<const uint8_t*>(view);
+	size = static_cast<uint64_t>(info.st_size);
+#endif
+
+	if (!validate()) {
+		ALT_ERROR(0, "Invalid or corrupt pack: %s", path_in.c_str());
+		close();
+
+		ALT_OUTDENT;
+		ALT_DEBUG(0, "END AltsoundPack::open()");
+		return false;
+	}
+
+	header = reinterpret_cast<const AltpackHeader*>(base);
+	index = reinterpret_cast<const AltpackIndexEntry*>(base + header->index_offset);
+	records = reinterpret_cast<const AltpackSampleRecord*>(base + header->sample_offset);
+	files = reinterpret_cast<const AltpackFileRecord*>(base + header->file_offset);
+	strings = reinterpret_cast<const char*>(base + header->string_offset);
+	payload = base + header->payload_offset;
+
+	ALT_INFO(0, "Mapped pack: %s (%s format, %u samples, %u files, %u PCM rates)", path_in.c_str(),
+	         toFormatName(header->format), header->sample_count, header->file_count, header->pcm_rate_count);
+
+	ALT_OUTDENT;
+	ALT_DEBUG(0, "END AltsoundPack::open()");
+	return true;
+}
+
+// ----------------------------------------------------------------------------
+
+void AltsoundPack::close()
+{
+	if (base) {
+#ifdef _WIN32
+		UnmapViewOfFile(base);
+		CloseHandle(static_cast<HANDLE>(mapping_handle));
+		CloseHandle(static_cast<HANDLE>(file_handle));
+		mapping_handle = nullptr;
+		file_handle = nullptr;
+#else
+		munmap(const_cast<uint8_t*>(base), static_cast<size_t>(size));
+#endif
+	}
+
+	base = nullptr;
+	size = 0;
+	header = nullptr;
+	index = nullptr;
+	records = nullptr;
+	files = nullptr;
+	strings = nullptr;
+	payload = nullptr;
+}
+
+// ----------------------------------------------------------------------------
+
+std::string AltsoundPack::getFormat() const
+{
+	return header ? toFormatName(header->format) : std::string();
+}
+
+// ----------------------------------------------------------------------------
+
+bool AltsoundPack::getIndex(std::vector<SampleIndexEntry>& entries_out) const
+{
+	if (!header)
+		return false;
+
+	entries_out.clear();
+	entries_out.reserve(header->index_count);
+
+	for (uint32_t i = 0; i < header->index_count; ++i) {
+		SampleIndexEntry entry;
+		entry.id = index[i].id;
+		entry.range.first = index[i].first_sample;
+		entry.range.count = index[i].sample_count;
+		entries_out.push_back(entry);
+	}
+	return true;
+}
+
+// ----------------------------------------------------------------------------
+
+bool AltsoundPack::getSamples(const std::string& altsound_path, std::vector<AltsoundSampleInfo>& samples_out) const
+{
+	if (!header || header->format == ALTPACK_FORMAT_GSOUND) {
+		ALT_ERROR(0, "Pack does not contain AltSound format samples");
+		return false;
+	}
+
+	samples_out.clear();
+	samples_out.reserve(header->sample_count);
+
+	for (uint32_t i = 0; i < header->sample_count; ++i) {
+		const AltpackSampleRecord& record = records[i];
+		const AltpackFileRecord& file = files[record.file_index];
+
+		AltsoundSampleInfo entry;
+		entry.id = record.id;
+		entry.channel = record.channel;
+		entry.gain = record.gain;
+		entry.ducking = record.ducking;
+		entry.loop = (record.flags & ALTPACK_SAMPLE_LOOP) != 0;
+		entry.stop = (record.flags & ALTPACK_SAMPLE_STOP) != 0;
+		entry.name = getString(record.name_offset);
+		entry.fname = altsound_path + getString(record.path_offset);
+		entry.data = payload + file.data_offset;
+		entry.data_size = file.data_size;
+		samples_out.push_back(entry);
+	}
+	return true;
+}
+
+// ----------------------------------------------------------------------------
+
+bool AltsoundPack::getSamples(const std::string& altsound_path, std::vector<GSoundSampleInfo>& samples_out) const
+{
+	if (!header || header->format != ALTPACK_FORMAT_GSOUND) {
+		ALT_ERROR(0, "Pack does not contain G-Sound format samples");
+		return false;
+	}
+
+	samples_out.clear();
+	samples_out.reserve(header->sample_count);
+
+	for (uint32_t i = 0; i < header->sample_count; ++i) {
+		const AltpackSampleRecord& record = records[i];
+		const AltpackFileRecord& file = files[record.file_index];
+
+		GSoundSampleInfo entry;
+		entry.id = record.id;
+		entry.type = toString(static_cast<AltsoundSampleType>(record.type));
+		std::transform(entry.type.begin(), entry.type.end(), entry.type.begin(), ::tolower);
+		entry.gain = record.gain;
+		entry.duck = record.ducking;
+		entry.loop = (record.flags & ALTPACK_SAMPLE_LOOP) != 0;
+		entry.ducking_profile = record.ducking_profile;
+		entry.fname = altsound_path + getString(record.path_offset);
+		entry.data = payload + file.data_offset;
+		entry.data_size = file.data_size;
+		samples_out.push_back(entry);
+	}
+	return true;
+}
+
+// ----------------------------------------------------------------------------
+
+const int16_t* AltsoundPack::findPCM(const void* data_in, uint32_t sample_rate, uint32_t channels, uint64_t& frames_out) const
+{
+	if (!header || header->pcm_channels != channels)
+		return nullptr;
+
+	const uint8_t* data = static_cast<const uint8_t*>(data_in);
+	if (data < payload || data >= payload + header->payload_size)
+		return nullptr;
+
+	unsigned int rate_idx = 0;
+	while (rate_idx < header->pcm_rate_count && header->pcm_rates[rate_idx] != sample_rate)
+		++rate_idx;
+	if (rate_idx == header->pcm_rate_count)
+		return nullptr;
+
+	// file records are written in payload order
+	const uint64_t offset = static_cast<uint64_t>(data - payload);
+	const AltpackFileRecord* end = files + header->file_count;
+	const AltpackFileRecord* it = std::lower_bound(files, end, offset,
+		[](const AltpackFileRecord& file, uint64_t off) { return file.data_offset < off; });
+
+	if (it == end || it->data_offset != offset || it->pcm_frames[rate_idx] == 0)
+		return nullptr;
+
+	frames_out = it->pcm_frames[rate_idx];
+	return reinterpret_cast<const int16_t*>(payload + it->pcm_offset[rate_idx]);
+}
+
+// ----------------------------------------------------------------------------
+
+const char* AltsoundPack::toFormatName(uint32_t format_in)
+{
+	switch (format_in) {
+	case ALTPACK_FORMAT_LEGACY:   return "legacy";
+	case ALTPACK_FORMAT_ALTSOUND: return "altsound";
+	case ALTPACK_FORMAT_GSOUND:   return "g-sound";
+	default:                      return "";
+	}
+}
+
+// ----------------------------------------------------------------------------
+// Helper function to bounds-check all tables against the mapping, so the
+// accessors can trust the data
+// ----------------------------------------------------------------------------
+
+bool AltsoundPack::validate() const
+{
+	if (size < sizeof(AltpackHeader))
+		return false;
+
+	const AltpackHeader& hdr = *reinterpret_cast<const AltpackHeader*>(base);
+	if (memcmp(hdr.magic, ALTPACK_MAGIC, sizeof(ALTPACK_MAGIC)) != 0 || hdr.version != ALTPACK_VERSION)
+		return false;
+
+	if (toFormatName(hdr.format)[0] == '\0' || hdr.pcm_rate_count > ALTPACK_MAX_PCM_RATES)
+		return false;
+
+	// tables are read in place, so they must be naturally aligned
+	if (hdr.payload_offset % ALTPACK_ALIGNMENT != 0 || hdr.index_offset % alignof(AltpackIndexEntry) != 0
+	 || hdr.sample_offset % alignof(AltpackSampleRecord) != 0 || hdr.file_offset % alignof(AltpackFileRecord) != 0)
+		return false;
+
+	const auto in_bounds = [this](uint64_t offset, uint64_t count, uint64_t elem_size) {
+		return offset <= size && count <= (size - offset) / elem_size;
+	};
+
+	if (!in_bounds(hdr.payload_offset, hdr.payload_size, 1)
+	 || !in_bounds(hdr.index_offset, hdr.index_count, sizeof(AltpackIndexEntry))
+	 || !in_bounds(hdr.sample_offset, hdr.sample_count, sizeof(AltpackSampleRecord))
+	 || !in_bounds(hdr.file_offset, hdr.file_count, sizeof(AltpackFileRecord))
+	 || !in_bounds(hdr.string_offset, hdr.string_size, 1))
+		return false;
+
+	// string table must be NUL-terminated
+	if (hdr.string_size == 0 || base[hdr.string_offset + hdr.string_size - 1] != '\0')
+		return false;
+
+	const AltpackSampleRecord* recs = reinterpret_cast<const AltpackSampleRecord*>(base + hdr.sample_offset);
+	for (uint32_t i = 0; i < hdr.sample_count; ++i) {
+		if (recs[i].file_index >= hdr.file_count || recs[i].name_offset >= hdr.string_size
+		 || recs[i].path_offset >= hdr.string_size)
+			return false;
+	}
+
+	// the index is used in place of rebuilding one from the sample table, so
+	// IDs must be unique and each range must hold only samples of its ID
+	const AltpackIndexEntry* idx = reinterpret_cast<const AltpackIndexEntry*>(base + hdr.index_offset);
+	for (uint32_t i = 0; i < hdr.index_count; ++i) {
+		if (idx[i].first_sample > hdr.sample_count || idx[i].sample_count > hdr.sample_count - idx[i].first_sample)
+			return false;
+		if (i > 0 && idx[i].id <= idx[i - 1].id)
+			return false;
+		for (uint32_t s = idx[i].first_sample; s < idx[i].first_sample + idx[i].sample_count; ++s) {
+			if (recs[s].id != idx[i].id)
+				return false;
+		}
+	}
+
+	const AltpackFileRecord* fls = reinterpret_cast<const AltpackFileRecord*>(base + hdr.file_offset);
+	const uint64_t frame_bytes = static_cast<uint64_t>(hdr.pcm_channels) * sizeof(int16_t);
+	for (uint32_t i = 0; i < hdr.file_count; ++i) {
+		if (fls[i].data_offset > hdr.payload_size || fls[i].data_size > hdr.payload_size - fls[i].data_offset)
+			return false;
+
+		// findPCM() binary searches the file records by data offset
+		if (i > 0 && fls[i].data_offset <= fls[i - 1].data_offset)
+			return false;
+
+		for (uint32_t r = 0; r < hdr.pcm_rate_count; ++r) {
+			if (fls[i].pcm_frames[r] == 0)
+				continue;
+			if (frame_bytes == 0 || fls[i].pcm_offset[r] % ALTPACK_ALIGNMENT != 0
+			 || fls[i].pcm_offset[r] > hdr.payload_size
+			 || fls[i].pcm_frames[r] > (hdr.payload_size - fls[i].pcm_offset[r]) / frame_bytes)
+				return false;
+		}
+	}
+
+	return true;
+}
+
+// ----------------------------------------------------------------------------
+
+const char* AltsoundPack::getString(uint32_t offset_in) const
+{
+	return strings + offset_in;
+}
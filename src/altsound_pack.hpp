@@ -0,0 +1,189 @@
+// ---------------------------------------------------------------------------
+// altsound_pack.hpp
+//
+// Single-file, memory-mappable AltSound sample pack (.altpack).  A pack holds
+// the parsed sample table of an AltSound package plus the encoded sample
+// files, and optionally pre-decoded PCM at common output rates.  Packs are
+// built with the altsound_pack tool.
+//
+// File layout (all integers little-endian, offsets from start of file):
+//
+//   AltpackHeader
+//   payload        encoded files and PCM blocks, each 16-byte aligned
+//   index          AltpackIndexEntry[index_count], sorted by id
+//   samples        AltpackSampleRecord[sample_count], sorted by id
+//   files          AltpackFileRecord[file_count]
+//   strings        NUL-terminated names and package-relative paths
+// ---------------------------------------------------------------------------
+// license:BSD-3-Clause
+// ---------------------------------------------------------------------------
+
+#ifndef ALTSOUND_PACK_HPP
+#define ALTSOUND_PACK_HPP
+#if !defined(__GNUC__) || (__GNUC__ == 3 && __GNUC_MINOR__ >= 4) || (__GNUC__ >= 4)	// GCC supports "pragma once" correctly since 3.4
+#pragma once
+#endif
+
+#include "altsound_data.hpp"
+#include "altsound_sample_index.hpp"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#define ALTPACK_FILENAME "altsound.altpack"
+#define ALTPACK_VERSION 1
+#define ALTPACK_MAX_PCM_RATES 4
+#define ALTPACK_ALIGNMENT 16
+
+static const char ALTPACK_MAGIC[8] = { 'A', 'L', 'T', 'P', 'A', 'C', 'K', '\0' };
+
+// AltSound format the pack was built from
+enum AltpackFormat : uint32_t {
+	ALTPACK_FORMAT_LEGACY = 0,
+	ALTPACK_FORMAT_ALTSOUND,
+	ALTPACK_FORMAT_GSOUND
+};
+
+// AltpackSampleRecord flags
+enum AltpackSampleFlags : uint32_t {
+	ALTPACK_SAMPLE_LOOP = 0x1,
+	ALTPACK_SAMPLE_STOP = 0x2
+};
+
+struct AltpackHeader {
+	char magic[8];
+	uint32_t version;
+	uint32_t format;                           // AltpackFormat
+	uint32_t index_count;
+	uint32_t sample_count;
+	uint32_t file_count;
+	uint32_t pcm_channels;                     // 0 if no pre-decoded PCM
+	uint32_t pcm_rate_count;
+	uint32_t pcm_rates[ALTPACK_MAX_PCM_RATES];
+	uint32_t reserved;
+	uint64_t payload_offset;
+	uint64_t payload_size;
+	uint64_t index_offset;
+	uint64_t sample_offset;
+	uint64_t file_offset;
+	uint64_t string_offset;
+	uint64_t string_size;
+};
+
+// All samples for one command ID
+struct AltpackIndexEntry {
+	uint32_t id;
+	uint32_t first_sample;
+	uint32_t sample_count;
+	uint32_t reserved;
+};
+
+// Union of AltsoundSampleInfo and GSoundSampleInfo metadata
+struct AltpackSampleRecord {
+	uint32_t id;
+	uint32_t file_index;
+	int32_t channel;                           // AltSound/Legacy only
+	uint32_t type;                             // AltsoundSampleType, G-Sound only
+	float gain;
+	float ducking;
+	uint32_t ducking_profile;
+	uint32_t flags;                            // AltpackSampleFlags
+	uint32_t name_offset;                      // into string table
+	uint32_t path_offset;                      // into string table
+};
+
+// One sample file.  PCM blocks are interleaved s16 at header.pcm_channels,
+// one per header.pcm_rates entry.  Offsets are relative to the payload
+struct AltpackFileRecord {
+	uint64_t data_offset;
+	uint64_t data_size;
+	uint64_t pcm_offset[ALTPACK_MAX_PCM_RATES];
+	uint64_t pcm_frames[ALTPACK_MAX_PCM_RATES];
+};
+
+static_assert(sizeof(AltpackHeader) == 112, "AltpackHeader layout changed");
+static_assert(sizeof(AltpackIndexEntry) == 16, "AltpackIndexEntry layout changed");
+static_assert(sizeof(AltpackSampleRecord) == 40, "AltpackSampleRecord layout changed");
+static_assert(sizeof(AltpackFileRecord) == 80, "AltpackFileRecord layout changed");
+
+// ---------------------------------------------------------------------------
+// AltsoundPack class definition
+// ---------------------------------------------------------------------------
+
+class AltsoundPack
+{
+public:
+
+	// Standard constructor
+	AltsoundPack() = default;
+
+	// Copy constructor - NOT USED
+	AltsoundPack(AltsoundPack&) = delete;
+
+	// Destructor
+	~AltsoundPack();
+
+	// Map and validate the pack at the provided path
+	bool open(const std::string& path_in);
+
+	// Unmap the pack.  Pointers handed out by this object become invalid
+	void close();
+
+	// Determine if a pack is mapped
+	bool isOpen() const;
+
+	// Return AltSound format name ("legacy", "altsound", "g-sound")
+	std::string getFormat() const;
+
+	// Return the pack index: the range of the sample table for each command
+	// ID, for AltsoundSampleIndex::assign()
+	bool getIndex(std::vector<SampleIndexEntry>& entries_out) const;
+
+	// Populate the sample table from the pack. Sample paths are prefixed with
+	// altsound_path so logging matches loose packages
+	bool getSamples(const std::string& altsound_path, std::vector<AltsoundSampleInfo>& samples_out) const;
+	bool getSamples(const std::string& altsound_path, std::vector<GSoundSampleInfo>& samples_out) const;
+
+	// Find pre-decoded PCM for the encoded file data at data_in, as returned
+	// in the sample table
+	const int16_t* findPCM(const void* data_in, uint32_t sample_rate, uint32_t channels, uint64_t& frames_out) const;
+
+	// Convert a pack format value to its AltSound format name
+	static const char* toFormatName(uint32_t format_in);
+
+private: // functions
+
+	// validate the mapped header and tables
+	bool validate() const;
+
+	// return string table entry
+	const char* getString(uint32_t offset_in) const;
+
+private: // data
+
+	const uint8_t* base = nullptr;
+	uint64_t size = 0;
+
+	const AltpackHeader* header = nullptr;
+	const AltpackIndexEntry* index = nullptr;
+	const AltpackSampleRecord* records = nullptr;
+	const AltpackFileRecord* files = nullptr;
+	const char* strings = nullptr;
+	const uint8_t* payload = nullptr;
+
+#ifdef _WIN32
+	void* file_handle = nullptr;
+	void* mapping_handle = nullptr;
+#endif
+};
+
+// ----------------------------------------------------------------------------
+// Inline functions
+// ----------------------------------------------------------------------------
+
+inline bool AltsoundPack::isOpen() const {
+	return base != nullptr;
+}
+
+#endif // ALTSOUND_PACK_HPP
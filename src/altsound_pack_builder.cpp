@@ -0,0 +1,405 @@
+// ---------------------------------------------------------------------------
+// altsound_pack_builder.cpp
+//
+// Command line tool that builds a single-file sample pack (.altpack) from an
+// existing AltSound package directory.  The package is parsed with the same
+// parsers used at runtime, every referenced sample file is copied into the
+// pack once, and optionally pre-decoded to s16 PCM at one or more output
+// rates so the runtime can play it without decoding.  Samples are resampled
+// to those rates with the same load-time conversion the runtime uses.
+//
+// Usage:
+//   altsound_pack <altsound dir> [-o <output file>] [-r <rate>[,<rate>...]]
+//                 [-c <channels>] [-q linear|sinc]
+//
+// The pack is written to <altsound dir>/altsound.altpack by default.
+// ---------------------------------------------------------------------------
+// license:BSD-3-Clause
+// ---------------------------------------------------------------------------
+
+#ifdef _WIN32
+#define NOMINMAX
+#endif
+
+#include "altsound.h"
+#include "altsound_csv_parser.hpp"
+#include "altsound_file_parser.hpp"
+#include "altsound_pack.hpp"
+#include "altsound_resampler.hpp"
+#include "gsound_csv_parser.hpp"
+#include "miniaudio_private.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+using std::string;
+
+// Sample metadata common to both sample info types
+struct PackSample {
+	AltpackSampleRecord record;
+	string name;
+	string path; // package-relative
+};
+
+// ---------------------------------------------------------------------------
+// Helper functions
+// ---------------------------------------------------------------------------
+
+static string relativePath(const string& altsound_path, const string& fname)
+{
+	if (fname.compare(0, altsound_path.size(), altsound_path) == 0)
+		return fname.substr(altsound_path.size());
+	return fname;
+}
+
+// ---------------------------------------------------------------------------
+
+static void padTo(std::ofstream& out, uint64_t alignment)
+{
+	static const char zeros[ALTPACK_ALIGNMENT] = {};
+	const uint64_t pos = static_cast<uint64_t>(out.tellp());
+	const uint64_t pad = (alignment - pos % alignment) % alignment;
+	out.write(zeros, static_cast<std::streamsize>(pad));
+}
+
+// ---------------------------------------------------------------------------
+
+static bool readFile(const string& path, std::vector<char>& data_out)
+{
+	std::ifstream in(path, std::ios::binary | std::ios::ate);
+	if (!in)
+		return false;
+
+	data_out.resize(static_cast<size_t>(in.tellg()));
+	in.seekg(0);
+	return static_cast<bool>(in.read(data_out.data(), static_cast<std::streamsize>(data_out.size())));
+}
+
+// ---------------------------------------------------------------------------
+
+// Decode a sample to float at its own rate
+static bool decodePCM(const std::vector<char>& data, uint32_t channels, std::vector<float>& pcm_out, uint32_t& rate_out)
+{
+	ma_decoder_config config = altsound_ma_decoder_config_init(ma_format_f32, channels, 0);
+	ma_decoder decoder;
+	if (altsound_ma_decoder_init_memory(data.data(), data.size(), &config, &decoder) != MA_SUCCESS)
+		return false;
+
+	// length is only an estimate for some formats, so read until the end
+	pcm_out.clear();
+	float chunk[4096];
+	const ma_uint64 chunk_frames = sizeof(chunk) / sizeof(chunk[0]) / channels;
+	ma_uint64 frames_read = 0;
+	do {
+		frames_read = 0;
+		const ma_result result = altsound_ma_decoder_read_pcm_frames(&decoder, chunk, chunk_frames, &frames_read);
+		pcm_out.insert(pcm_out.end(), chunk, chunk + frames_read * channels);
+		if (result != MA_SUCCESS)
+			break;
+	} while (frames_read == chunk_frames);
+
+	rate_out = decoder.outputSampleRate;
+	altsound_ma_decoder_uninit(&decoder);
+	return !pcm_out.empty();
+}
+
+// ---------------------------------------------------------------------------
+
+// Resample decoded PCM to an output rate and quantize it to s16
+static bool convertPCM(const std::vector<float>& pcm, uint32_t channels, uint32_t in_rate, uint32_t rate,
+                       AltsoundResampleQuality quality, std::vector<int16_t>& pcm_out)
+{
+	std::vector<float> resampled;
+	if (!altsound_resample(pcm.data(), pcm.size() / channels, channels, in_rate, rate, quality, resampled))
+		return false;
+
+	pcm_out.resize(resampled.size());
+	for (size_t i = 0; i < resampled.size(); ++i)
+		pcm_out[i] = static_cast<int16_t>(std::lrint(std::min(std::max(resampled[i], -1.0f), 1.0f) * 32767.0f));
+	return true;
+}
+
+// ---------------------------------------------------------------------------
+
+static bool parsePackage(const string& altsound_path, uint32_t& format_out, std::vector<PackSample>& samples_out)
+{
+	if (std::ifstream(altsound_path + "g-sound.csv").good()) {
+		std::vector<GSoundSampleInfo> samples;
+		if (!GSoundCsvParser(altsound_path).parse(samples))
+			return false;
+
+		format_out = ALTPACK_FORMAT_GSOUND;
+		for (const GSoundSampleInfo& sample : samples) {
+			PackSample entry = {};
+			entry.record.id = sample.id;
+			entry.record.channel = -1;
+			entry.record.type = toSampleType(sample.type);
+			entry.record.gain = sample.gain;
+			entry.record.ducking = sample.duck;
+			entry.record.ducking_profile = sample.ducking_profile;
+			entry.record.flags = sample.loop ? static_cast<uint32_t>(ALTPACK_SAMPLE_LOOP) : 0u;
+			entry.path = relativePath(altsound_path, sample.fname);
+			samples_out.push_back(entry);
+		}
+		return true;
+	}
+
+	std::vector<AltsoundSampleInfo> samples;
+	if (std::ifstream(altsound_path + "altsound.csv").good()) {
+		if (!AltsoundCsvParser(altsound_path).parse(samples))
+			return false;
+		format_out = ALTPACK_FORMAT_ALTSOUND;
+	}
+	else {
+		if (!AltsoundFileParser(altsound_path).parse(samples))
+			return false;
+		format_out = ALTPACK_FORMAT_LEGACY;
+	}
+
+	for (const AltsoundSampleInfo& sample : samples) {
+		PackSample entry = {};
+		entry.record.id = sample.id;
+		entry.record.channel = sample.channel;
+		entry.record.type = UNDEFINED;
+		entry.record.gain = sample.gain;
+		entry.record.ducking = sample.ducking;
+		entry.record.flags = (sample.loop ? static_cast<uint32_t>(ALTPACK_SAMPLE_LOOP) : 0u)
+		                   | (sample.stop ? static_cast<uint32_t>(ALTPACK_SAMPLE_STOP) : 0u);
+		entry.name = sample.name;
+		entry.path = relativePath(altsound_path, sample.fname);
+		samples_out.push_back(entry);
+	}
+	return true;
+}
+
+// ---------------------------------------------------------------------------
+// Pack writer
+// ---------------------------------------------------------------------------
+
+static bool writePack(const string& altsound_path, const string& out_path, const std::vector<uint32_t>& rates,
+                      uint32_t channels, AltsoundResampleQuality quality)
+{
+	uint32_t format = ALTPACK_FORMAT_LEGACY;
+	std::vector<PackSample> samples;
+	if (!parsePackage(altsound_path, format, samples) || samples.empty()) {
+		std::cout << "Unable to parse AltSound package: " << altsound_path << std::endl;
+		return false;
+	}
+
+	// sorted ID order; keep CSV order within an ID
+	std::stable_sort(samples.begin(), samples.end(), [](const PackSample& a, const PackSample& b) {
+		return a.record.id < b.record.id;
+	});
+
+	std::ofstream out(out_path, std::ios::binary | std::ios::trunc);
+	if (!out) {
+		std::cout << "Unable to create " << out_path << std::endl;
+		return false;
+	}
+
+	AltpackHeader header = {};
+	memcpy(header.magic, ALTPACK_MAGIC, sizeof(header.magic));
+	header.version = ALTPACK_VERSION;
+	header.format = format;
+	header.pcm_channels = rates.empty() ? 0 : channels;
+	header.pcm_rate_count = static_cast<uint32_t>(rates.size());
+	std::copy(rates.begin(), rates.end(), header.pcm_rates);
+
+	// placeholder, rewritten once all offsets are known
+	out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+	padTo(out, ALTPACK_ALIGNMENT);
+	header.payload_offset = static_cast<uint64_t>(out.tellp());
+
+	// payload: each distinct file once, followed by its PCM blocks
+	std::vector<AltpackFileRecord> files;
+	std::map<string, uint32_t> file_index;
+	std::vector<char> data;
+	std::vector<float> decoded;
+	std::vector<int16_t> pcm;
+
+	for (PackSample& sample : samples) {
+		const auto it = file_index.find(sample.path);
+		if (it != file_index.end()) {
+			sample.record.file_index = it->second;
+			continue;
+		}
+
+		if (!readFile(altsound_path + sample.path, data)) {
+			std::cout << "Unable to read sample: " << sample.path << std::endl;
+			return false;
+		}
+
+		AltpackFileRecord file = {};
+		padTo(out, ALTPACK_ALIGNMENT);
+		file.data_offset = static_cast<uint64_t>(out.tellp()) - header.payload_offset;
+		file.data_size = data.size();
+		out.write(data.data(), static_cast<std::streamsize>(data.size()));
+
+		// data offsets must be unique, so an empty file still takes a byte
+		if (data.empty())
+			out.put('\0');
+
+		uint32_t decoded_rate = 0;
+		if (!rates.empty() && !decodePCM(data, channels, decoded, decoded_rate)) {
+			std::cout << "WARNING: unable to decode " << sample.path << ", stored encoded only" << std::endl;
+			decoded_rate = 0;
+		}
+
+		for (size_t r = 0; r < rates.size() && decoded_rate; ++r) {
+			if (!convertPCM(decoded, channels, decoded_rate, rates[r], quality, pcm)) {
+				std::cout << "WARNING: unable to resample " << sample.path << ", stored encoded only" << std::endl;
+				break;
+			}
+			padTo(out, ALTPACK_ALIGNMENT);
+			file.pcm_offset[r] = static_cast<uint64_t>(out.tellp()) - header.payload_offset;
+			file.pcm_frames[r] = pcm.size() / channels;
+			out.write(reinterpret_cast<const char*>(pcm.data()), static_cast<std::streamsize>(pcm.size() * sizeof(int16_t)));
+		}
+
+		sample.record.file_index = static_cast<uint32_t>(files.size());
+		file_index[sample.path] = sample.record.file_index;
+		files.push_back(file);
+	}
+
+	padTo(out, ALTPACK_ALIGNMENT);
+	header.payload_size = static_cast<uint64_t>(out.tellp()) - header.payload_offset;
+
+	// string table; offset 0 is the empty string
+	string strings(1, '\0');
+	const auto addString = [&strings](const string& str) {
+		if (str.empty())
+			return 0u;
+		const uint32_t offset = static_cast<uint32_t>(strings.size());
+		strings.append(str).push_back('\0');
+		return offset;
+	};
+
+	std::vector<AltpackSampleRecord> records;
+	std::vector<AltpackIndexEntry> index;
+	for (const PackSample& sample : samples) {
+		AltpackSampleRecord record = sample.record;
+		record.name_offset = addString(sample.name);
+		record.path_offset = addString(sample.path);
+
+		if (index.empty() || index.back().id != record.id)
+			index.push_back({ record.id, static_cast<uint32_t>(records.size()), 0, 0 });
+		++index.back().sample_count;
+
+		records.push_back(record);
+	}
+
+	header.index_count = static_cast<uint32_t>(index.size());
+	header.index_offset = static_cast<uint64_t>(out.tellp());
+	out.write(reinterpret_cast<const char*>(index.data()), static_cast<std::streamsize>(index.size() * sizeof(AltpackIndexEntry)));
+
+	header.sample_count = static_cast<uint32_t>(records.size());
+	header.sample_offset = static_cast<uint64_t>(out.tellp());
+	out.write(reinterpret_cast<const char*>(records.data()), static_cast<std::streamsize>(records.size() * sizeof(AltpackSampleRecord)));
+
+	header.file_count = static_cast<uint32_t>(files.size());
+	header.file_offset = static_cast<uint64_t>(out.tellp());
+	out.write(reinterpret_cast<const char*>(files.data()), static_cast<std::streamsize>(files.size() * sizeof(AltpackFileRecord)));
+
+	header.string_offset = static_cast<uint64_t>(out.tellp());
+	header.string_size = strings.size();
+	out.write(strings.data(), static_cast<std::streamsize>(strings.size()));
+
+	out.seekp(0);
+	out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+	if (!out.good()) {
+		std::cout << "Error writing " << out_path << std::endl;
+		return false;
+	}
+	out.close();
+
+	std::cout << "Wrote " << out_path << ": " << AltsoundPack::toFormatName(format) << " format, "
+	          << records.size() << " samples, " << index.size() << " IDs, " << files.size() << " files, "
+	          << rates.size() << " PCM rate(s)" << std::endl;
+
+	// round-trip through the runtime reader
+	AltsoundPack pack;
+	if (!pack.open(out_path)) {
+		std::cout << "Verification of " << out_path << " failed" << std::endl;
+		return false;
+	}
+	return true;
+}
+
+// ---------------------------------------------------------------------------
+
+int main(int argc, const char* argv[])
+{
+	if (argc < 2) {
+		std::cout << "Usage: " << argv[0] << " <altsound dir> [-o <output file>] [-r <rate>[,<rate>...]] [-c <channels>] [-q linear|sinc]" << std::endl;
+		std::cout << "  -o  output file (default: <altsound dir>/" ALTPACK_FILENAME ")" << std::endl;
+		std::cout << "  -r  also store pre-decoded PCM at these output rates (max "
+		          << ALTPACK_MAX_PCM_RATES << "), e.g. -r 44100,48000" << std::endl;
+		std::cout << "  -c  channel count of pre-decoded PCM (default: 2)" << std::endl;
+		std::cout << "  -q  resampling quality of pre-decoded PCM (default: "
+		          << altsound_resample_quality_name(ALT_RESAMPLE_QUALITY_DEFAULT) << ")" << std::endl;
+		return 1;
+	}
+
+	string altsound_path = argv[1];
+	std::replace(altsound_path.begin(), altsound_path.end(), '\\', '/');
+	if (altsound_path.back() != '/')
+		altsound_path += '/';
+
+	string out_path = altsound_path + ALTPACK_FILENAME;
+	std::vector<uint32_t> rates;
+	uint32_t channels = 2;
+	AltsoundResampleQuality quality = ALT_RESAMPLE_QUALITY_DEFAULT;
+
+	for (int i = 2; i < argc; ++i) {
+		const string arg = argv[i];
+		if (i + 1 >= argc) {
+			std::cout << "Missing value for " << arg << std::endl;
+			return 1;
+		}
+
+		if (arg == "-o") {
+			out_path = argv[++i];
+		}
+		else if (arg == "-r") {
+			std::stringstream ss(argv[++i]);
+			string rate;
+			while (std::getline(ss, rate, ',')) {
+				const unsigned long val = std::strtoul(rate.c_str(), nullptr, 10);
+				if (val == 0 || rates.size() == ALTPACK_MAX_PCM_RATES) {
+					std::cout << "Invalid rate list: " << argv[i] << std::endl;
+					return 1;
+				}
+				rates.push_back(static_cast<uint32_t>(val));
+			}
+		}
+		else if (arg == "-c") {
+			channels = static_cast<uint32_t>(std::strtoul(argv[++i], nullptr, 10));
+			if (channels == 0 || channels > 8) {
+				std::cout << "Invalid channel count: " << argv[i] << std::endl;
+				return 1;
+			}
+		}
+		else if (arg == "-q") {
+			if (!altsound_parse_resample_quality(argv[++i], quality)) {
+				std::cout << "Invalid resampling quality: " << argv[i] << std::endl;
+				return 1;
+			}
+		}
+		else {
+			std::cout << "Unknown option: " << arg << std::endl;
+			return 1;
+		}
+	}
+
+	AltSoundSetLogger(altsound_path, ALTSOUND_LOG_LEVEL_ERROR, true);
+
+	return writePack(altsound_path, out_path, rates, channels, quality) ? 0 : 1;
+}
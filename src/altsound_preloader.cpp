@@ -0,0 +1,144 @@
+// ---------------------------------------------------------------------------
+// altsound_preloader.cpp
+//
+// Background worker pool that decodes the parsed sample table into the
+// sample cache at startup
+// ---------------------------------------------------------------------------
+// license:BSD-3-Clause
+// ---------------------------------------------------------------------------
+
+#include "altsound_preloader.hpp"
+#include "altsound_context.hpp"
+
+#include <algorithm>
+#include <sys/stat.h>
+#include <unordered_set>
+
+// ----------------------------------------------------------------------------
+// Helper function to rank sample types for preload order.  Short, frequently
+// retriggered samples go first; music is usually too long to cache and goes
+// last
+// ----------------------------------------------------------------------------
+
+static int preloadRank(AltsoundSampleType type_in)
+{
+	switch (type_in) {
+	case SFX:
+	case CALLOUT:
+		return 0;
+	case JINGLE:
+	case SOLO:
+	case OVERLAY:
+		return 1;
+	case MUSIC:
+		return 3;
+	default:
+		return 2;
+	}
+}
+
+// ----------------------------------------------------------------------------
+// Functional code
+// ----------------------------------------------------------------------------
+
+AltsoundPreloader::AltsoundPreloader(AltSoundContext& ctx_in)
+: ctx(ctx_in)
+{
+}
+
+// ----------------------------------------------------------------------------
+
+AltsoundPreloader::~AltsoundPreloader()
+{
+	stop();
+}
+
+// ----------------------------------------------------------------------------
+
+void AltsoundPreloader::start(std::vector<PreloadItem> items_in, unsigned int num_threads)
+{
+	stop();
+
+	// the same file is often mapped to several IDs
+	std::unordered_set<std::string> seen;
+	items.reserve(items_in.size());
+	for (PreloadItem& item : items_in) {
+		if (item.path.empty() || !seen.insert(AltsoundSampleCache::normalizePath(item.path)).second)
+			continue;
+
+		struct stat info;
+		if (item.data)
+			item.file_size = item.data_size;
+		else
+			item.file_size = stat(item.path.c_str(), &info) == 0 ? static_cast<uint64_t>(info.st_size) : 0;
+		items.push_back(std::move(item));
+	}
+
+	// within a type, smaller files first
+	std::stable_sort(items.begin(), items.end(), [](const PreloadItem& a, const PreloadItem& b) {
+		const int rank_a = preloadRank(a.type);
+		const int rank_b = preloadRank(b.type);
+		return rank_a != rank_b ? rank_a < rank_b : a.file_size < b.file_size;
+	});
+
+	if (items.empty())
+		return;
+
+	if (num_threads == 0)
+		num_threads = std::max(1u, std::thread::hardware_concurrency());
+	num_threads = std::min(num_threads, static_cast<unsigned int>(items.size()));
+
+	workers.reserve(num_threads);
+	for (unsigned int i = 0; i < num_threads; ++i)
+		workers.emplace_back(&AltsoundPreloader::workerProc, this);
+}
+
+// ----------------------------------------------------------------------------
+
+void AltsoundPreloader::stop()
+{
+	cancel.store(true, std::memory_order_release);
+
+	for (std::thread& worker : workers) {
+		if (worker.joinable())
+			worker.join();
+	}
+	workers.clear();
+	items.clear();
+
+	next_item.store(0);
+	done.store(0);
+	loaded.store(0);
+	cancel.store(false);
+}
+
+// ----------------------------------------------------------------------------
+
+void AltsoundPreloader::workerProc()
+{
+	while (!cancel.load(std::memory_order_acquire)) {
+		const size_t idx = next_item.fetch_add(1, std::memory_order_relaxed);
+		if (idx >= items.size())
+			break;
+
+		const PreloadItem& item = items[idx];
+		const bool mem = item.data != nullptr;
+		const void* file = mem ? item.data : item.path.c_str();
+		const std::string key = MiniAudio_SampleKey(mem, file, item.data_size);
+		uint64_t pcm_frames;
+
+		// a stream may already have cached it during gameplay, or the pack
+		// may already hold PCM at the output format.  Never evict to make
+		// room: once the budget is full, everything else streams
+		if (ctx.sample_cache.contains(key) || (mem && ctx.sample_pack.findPCM(item.data, ctx.sample_rate, ctx.channels, pcm_frames))) {
+			loaded.fetch_add(1, std::memory_order_relaxed);
+		}
+		else {
+			CachedSamplePtr sample = MiniAudio_SampleDecode(ctx, mem, file, item.data_size);
+			if (sample && ctx.sample_cache.insert(key, sample, false))
+				loaded.fetch_add(1, std::memory_order_relaxed);
+		}
+
+		done.fetch_add(1, std::memory_order_acq_rel);
+	}
+}
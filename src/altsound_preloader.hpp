@@ -0,0 +1,110 @@
+// ---------------------------------------------------------------------------
+// altsound_preloader.hpp
+//
+// Background worker pool that decodes the parsed sample table into the
+// sample cache at startup, so first plays don't pay for a cold decode
+// ---------------------------------------------------------------------------
+// license:BSD-3-Clause
+// ---------------------------------------------------------------------------
+
+#ifndef ALTSOUND_PRELOADER_HPP
+#define ALTSOUND_PRELOADER_HPP
+#if !defined(__GNUC__) || (__GNUC__ == 3 && __GNUC_MINOR__ >= 4) || (__GNUC__ >= 4)	// GCC supports "pragma once" correctly since 3.4
+#pragma once
+#endif
+
+#include "altsound_data.hpp"
+
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+
+struct AltSoundContext;
+
+// A sample to preload, as reported by the active processor
+struct PreloadItem {
+	std::string path;
+	AltsoundSampleType type = UNDEFINED;
+	const void* data = nullptr; // encoded sample in a mapped .altpack
+	uint64_t data_size = 0;
+	uint64_t file_size = 0;
+};
+
+// ---------------------------------------------------------------------------
+// AltsoundPreloader class definition
+// ---------------------------------------------------------------------------
+
+class AltsoundPreloader
+{
+public:
+
+	// Standard constructor.  Samples are decoded into the context's cache
+	explicit AltsoundPreloader(AltSoundContext& ctx_in);
+
+	// Copy constructor - NOT USED
+	AltsoundPreloader(AltsoundPreloader&) = delete;
+
+	// Destructor
+	~AltsoundPreloader();
+
+	// Start decoding the provided samples on num_threads workers. 0 threads
+	// uses one worker per core
+	void start(std::vector<PreloadItem> items_in, unsigned int num_threads);
+
+	// Cancel outstanding work and join the workers
+	void stop();
+
+	// Determine if workers are still decoding
+	bool isRunning() const;
+
+	// Progress counters. An item counts as done when it was decoded, was
+	// already cached, or was skipped (too large, no room, decode failure)
+	unsigned int getDoneCount() const;
+	unsigned int getTotalCount() const;
+	unsigned int getLoadedCount() const;
+
+private: // functions
+
+	// worker thread entry point
+	void workerProc();
+
+private: // data
+
+	AltSoundContext& ctx;
+	std::vector<PreloadItem> items;
+	std::vector<std::thread> workers;
+
+	std::atomic<size_t> next_item{ 0 };
+	std::atomic<unsigned int> done{ 0 };
+	std::atomic<unsigned int> loaded{ 0 };
+	std::atomic<bool> cancel{ false };
+};
+
+// ----------------------------------------------------------------------------
+// Inline functions
+// ----------------------------------------------------------------------------
+
+inline bool AltsoundPreloader::isRunning() const {
+	return done.load(std::memory_order_acquire) < items.size();
+}
+
+// ----------------------------------------------------------------------------
+
+inline unsigned int AltsoundPreloader::getDoneCount() const {
+	return done.load(std::memory_order_acquire);
+}
+
+// ----------------------------------------------------------------------------
+
+inline unsigned int AltsoundPreloader::getTotalCount() const {
+	return static_cast<unsigned int>(items.size());
+}
+
+// ----------------------------------------------------------------------------
+
+inline unsigned int AltsoundPreloader::getLoadedCount() const {
+	return loaded.load(std::memory_order_acquire);
+}
+
+#endif // ALTSOUND_PRELOADER_HPP
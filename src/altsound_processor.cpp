@@ -11,27 +11,13 @@
 #define NOMINMAX
 
 #include "altsound_processor.hpp"
+#include "altsound_context.hpp"
 #include "altsound_csv_parser.hpp"
 #include "altsound_file_parser.hpp"
 #include "altsound_logger.hpp"
-#include "miniaudio_bass_compat.hpp"
 
 #include <limits>
 
-// NOTE:
-// - SFX streams don't require tracking since multiple can play,
-//   simultaneously, and other than adjusting ducking, have no other
-//   impacts on active streams
-//
-static AltsoundStreamInfo* cur_mus_stream = nullptr;
-static AltsoundStreamInfo* cur_jin_stream = nullptr;
-
-// Instance of global thread synchronization mutex
-extern std::mutex io_mutex;
-
-// Instance of global array of miniaudio channels
-extern StreamArray channel_stream;
-
 // Reference to global logger instance
 extern AltsoundLogger alog;
 
@@ -41,13 +27,15 @@ constexpr unsigned int UNSET_IDX = std::numeric_limits<unsigned int>::max();
 // CTOR/DTOR
 // ---------------------------------------------------------------------------
 
-AltsoundProcessor::AltsoundProcessor(const string& game_name_in,
+AltsoundProcessor::AltsoundProcessor(AltSoundContext& ctx_in,
+	                                 const string& game_name_in,
 	                                 const string& vpm_path_in,
 	                                 const string& format_in)
-:AltsoundProcessorBase(game_name_in, vpm_path_in),
+:AltsoundProcessorBase(ctx_in, game_name_in, vpm_path_in),
   format(format_in),
   is_initialized(false),
-  is_stable(true) // future use
+  is_stable(true), // future use
+  generator(std::random_device()()) // seed random number generator
 {
 }
 
@@ -76,7 +64,10 @@ bool AltsoundProcessor::handleCmd(const unsigned int cmd_combined_in)
 	ALT_INDENT;
 
 	ALT_DEBUG(0, "Acquiring mutex");
-	std::lock_guard<std::mutex> guard(io_mutex);
+	const uint64_t wait_start = AltsoundMetrics::now();
+	std::lock_guard<std::mutex> guard(ctx.io_mutex);
+	ctx.metrics.recordSince(ALTSOUND_STAGE_MUTEX_WAIT, wait_start);
+	AltsoundTraceScope trace_scope(ctx.trace, "handleCmd", "cmd", cmd_combined_in);
 
 	// Pass command to base class for processing
 	AltsoundProcessorBase::handleCmd(cmd_combined_in);
@@ -120,7 +111,8 @@ bool AltsoundProcessor::handleCmd(const unsigned int cmd_combined_in)
 	bool play_jingle = false;
 	bool play_sfx = false;
 
-	AltsoundStreamInfo* new_stream = new AltsoundStreamInfo();
+	AltsoundStreamInfo* new_stream = ctx.stream_info_pool.acquire();
+	new_stream->reset();
 	unsigned int stream = MINIAUDIO_NO_STREAM;
 
 	// pre-populate stream info
@@ -129,6 +121,8 @@ bool AltsoundProcessor::handleCmd(const unsigned int cmd_combined_in)
 	new_stream->ducking     = samples[sample_idx].ducking;
 	new_stream->loop        = samples[sample_idx].loop;
 	new_stream->gain        = samples[sample_idx].gain;
+	new_stream->sample_data = samples[sample_idx].data;
+	new_stream->sample_size = samples[sample_idx].data_size;
 
 	const int sample_channel = samples[sample_idx].channel;
 
@@ -140,7 +134,7 @@ bool AltsoundProcessor::handleCmd(const unsigned int cmd_combined_in)
 			ALT_INFO(0, "SUCCESS AltsoundProcessor::process_jingle()");
 
 			// update stream storage
-			channel_stream[new_stream->channel_idx] = new_stream;
+			ctx.channel_stream.assign(new_stream->channel_idx, new_stream);
 
 			play_jingle = true; // Defer playback until the end
 			cur_jin_stream = new_stream;
@@ -160,7 +154,7 @@ bool AltsoundProcessor::handleCmd(const unsigned int cmd_combined_in)
 			ALT_INFO(0, "SUCCESS AltsoundProcessor::process_music()");
 
 			// update stream storage
-			channel_stream[new_stream->channel_idx] = new_stream;
+			ctx.channel_stream.assign(new_stream->channel_idx, new_stream);
 
 			play_music = true; // Defer playback until the end
 			cur_mus_stream = new_stream;
@@ -180,7 +174,7 @@ bool AltsoundProcessor::handleCmd(const unsigned int cmd_combined_in)
 			ALT_INFO(0, "SUCCESS AltsoundProcessor::process_sfx()");
 
 			// update stream storage
-			channel_stream[new_stream->channel_idx] = new_stream;
+			ctx.channel_stream.assign(new_stream->channel_idx, new_stream);
 
 			play_sfx = true;// Defer playback until the end
 			stream = new_stream->hstream;
@@ -193,6 +187,7 @@ bool AltsoundProcessor::handleCmd(const unsigned int cmd_combined_in)
 
 	if (!play_music && !play_jingle && !play_sfx) {
 		ALT_ERROR(0, "FAILED AltsoundProcessor::alt_sound_handle()");
+		ctx.stream_info_pool.release(new_stream);
 
 		ALT_OUTDENT;
 		ALT_DEBUG(0, "END AltsoundProcessor::process_cmd()");
@@ -217,7 +212,7 @@ bool AltsoundProcessor::handleCmd(const unsigned int cmd_combined_in)
 
 	// Play pending sound determined above, if any
 	if (new_stream->hstream != MINIAUDIO_NO_STREAM) {
-		if (!MiniAudio_ChannelPlay(stream, false)) {
+		if (!MiniAudio_ChannelPlay(ctx, stream, false)) {
 			// Sound playback failed
 			ALT_ERROR(0, "FAILED MiniAudio_ChannelPlay(%u): %s", new_stream->hstream, get_miniaudio_err());
 		}
@@ -268,10 +263,10 @@ void AltsoundProcessor::init()
 
 void AltsoundProcessorBase::setGlobalVol(const float vol_in)
 {
-	std::vector<float> vol(channel_stream.size());
+	std::vector<float> vol(ctx.channel_stream.size());
 
-	for (size_t index = 0; index < channel_stream.size(); ++index) {
-		const auto stream = channel_stream[index];
+	for (size_t index = 0; index < ctx.channel_stream.size(); ++index) {
+		const auto stream = ctx.channel_stream[index];
 		if (stream) {
 			vol[index] = getStreamVolume(stream->hstream);
 		}
@@ -279,8 +274,8 @@ void AltsoundProcessorBase::setGlobalVol(const float vol_in)
 
 	global_vol = vol_in;
 
-	for (size_t index = 0; index < channel_stream.size(); ++index) {
-		const auto stream = channel_stream[index];
+	for (size_t index = 0; index < ctx.channel_stream.size(); ++index) {
+		const auto stream = ctx.channel_stream[index];
 		if (stream) {
 			setStreamVolume(stream->hstream, vol[index]);
 		}
@@ -299,7 +294,21 @@ bool AltsoundProcessor::loadSamples()
 		altsound_path += "altsound/" + game_name + '/';
 	}
 
-	if (format == "altsound") {
+	if (ctx.sample_pack.isOpen()) {
+		std::vector<SampleIndexEntry> index_entries;
+		if (!ctx.sample_pack.getSamples(altsound_path, samples) || !ctx.sample_pack.getIndex(index_entries)) {
+			ALT_ERROR(0, "FAILED AltsoundPack::getSamples()");
+
+			ALT_OUTDENT;
+			ALT_DEBUG(0, "END AltsoundProcessor::loadSamples()");
+			return false;
+		}
+		ALT_INFO(0, "SUCCESS AltsoundPack::getSamples()");
+
+		// pack samples are stored sorted by ID, so use the pack index as is
+		sample_index.assign(index_entries);
+	}
+	else if (format == "altsound") {
 		AltsoundCsvParser csv_parser(altsound_path);
 
 		if (!csv_parser.parse(samples)) {
@@ -323,6 +332,10 @@ bool AltsoundProcessor::loadSamples()
 		ALT_INFO(0, "SUCCESS AltsoundFileParser::parse()");
 	}
 
+	if (!ctx.sample_pack.isOpen())
+		sample_index.build(samples);
+	ALT_INFO(0, "Indexed %zu samples for %zu commands", samples.size(), sample_index.size());
+
 	ALT_OUTDENT;
 	ALT_DEBUG(0, "END AltsoundProcessor::loadSamples");
 	return true;
@@ -335,30 +348,17 @@ unsigned int AltsoundProcessor::getSample(const unsigned int cmd_combined_in)
 	ALT_DEBUG(0, "BEGIN AltsoundProcessor::getSample()");
 	ALT_INDENT;
 
+	AltsoundStageTimer timer(ctx.metrics, ALTSOUND_STAGE_GET_SAMPLE);
+
 	unsigned int sample_idx = UNSET_IDX;
 
-	// Look for sample that matches the current command
-	for (size_t i = 0; i < samples.size(); ++i) {
-		if (samples[i].id == cmd_combined_in) {
-			// Current ID matches the command. Check if there are more samples for this
-			// command and randomly pick one
-			unsigned int num_samples = 0;
-			do {
-				num_samples++;
-
-				if (i + num_samples >= samples.size())
-					// sample index exceeds the number of samples
-					break;
-
-				// Loop while the next sample ID matches the command
-			} while (samples[i + num_samples].id == cmd_combined_in);
-			ALT_INFO(0, "SUCCESS Found %d sample(s) for ID: %04X", num_samples, cmd_combined_in);
-
-			// num_samples now contains the number of samples with the same ID
-			// pick one to play at random
-			sample_idx = static_cast<unsigned int>(i) + rand() % num_samples;
-			break;
-		}
+	// Samples are sorted by ID, so all samples for the command are adjacent.
+	// Pick one to play at random
+	const SampleRange range = sample_index.find(cmd_combined_in);
+	if (range.count > 0) {
+		ALT_INFO(0, "SUCCESS Found %u sample(s) for ID: %04X", range.count, cmd_combined_in);
+		std::uniform_int_distribution<unsigned int> distribution(0, range.count - 1);
+		sample_idx = range.first + distribution(generator);
 	}
 
 	if (sample_idx == UNSET_IDX) {
@@ -432,7 +432,7 @@ bool AltsoundProcessor::process_jingle(AltsoundStreamInfo* stream_out)
 		}
 		else if (stream_out->ducking < 0.0f) {
 			// Pause current music stream
-			if (!MiniAudio_ChannelPause(cur_mus_stream->hstream)) {
+			if (!MiniAudio_ChannelPause(ctx, cur_mus_stream->hstream)) {
 				ALT_WARNING(0, "FAILED MiniAudio_ChannelPause(): %s", get_miniaudio_err());
 			}
 		}
@@ -504,6 +504,46 @@ bool AltsoundProcessor::stopMusic()
 	return true;
 }
 
+// ---------------------------------------------------------------------------
+
+std::vector<PreloadItem> AltsoundProcessor::getPreloadItems() const
+{
+	std::vector<PreloadItem> items;
+	items.reserve(samples.size());
+
+	for (const AltsoundSampleInfo& sample : samples) {
+		PreloadItem item;
+		item.path = sample.fname;
+		item.type = sample.channel == 0 ? MUSIC : sample.channel == 1 ? JINGLE : SFX;
+		item.data = sample.data;
+		item.data_size = sample.data_size;
+		items.push_back(item);
+	}
+	return items;
+}
+
+// ---------------------------------------------------------------------------
+
+void AltsoundProcessor::forgetStream(const AltsoundStreamInfo& stream)
+{
+	if (&stream == cur_mus_stream) {
+		cur_mus_stream = nullptr;
+	}
+	else if (&stream == cur_jin_stream) {
+		cur_jin_stream = nullptr;
+
+		// a jingle that paused the music hands it back, as when it ends
+		if (stream.ducking < 0.0f && cur_mus_stream
+		    && MiniAudio_ChannelIsActive(ctx, cur_mus_stream->hstream) == MINIAUDIO_ACTIVE_PAUSED) {
+			ALT_INFO(0, "Resuming MUSIC playback");
+
+			if (!MiniAudio_ChannelPlay(ctx, cur_mus_stream->hstream, false)) {
+				ALT_ERROR(0, "FAILED MiniAudio_ChannelPlay(%u): %s", cur_mus_stream->hstream, get_miniaudio_err());
+			}
+		}
+	}
+}
+
 // ---------------------------------------------------------------------------
 bool AltsoundProcessor::stopMusicStream()
 {
@@ -521,8 +561,7 @@ bool AltsoundProcessor::stopMusicStream()
 
 		if (stopStream(hstream)) {
 			ALT_INFO(0, "Stopped MUSIC stream: %u  Chan: %02d", hstream, ch_idx);
-			delete channel_stream[ch_idx];
-			channel_stream[ch_idx] = nullptr;
+			ctx.channel_stream.release(ch_idx);
 			cur_mus_stream = nullptr;
 		}
 		else {
@@ -551,8 +590,7 @@ bool AltsoundProcessor::stopJingleStream()
 
 		if (stopStream(hstream)) {
 			ALT_INFO(0, "Stopped JINGLE stream: %u  Chan: %02d", hstream, ch_idx);
-			delete channel_stream[ch_idx];
-			channel_stream[ch_idx] = nullptr;
+			ctx.channel_stream.release(ch_idx);
 			cur_jin_stream = nullptr;
 			success = true;
 		}
@@ -569,6 +607,13 @@ bool AltsoundProcessor::stopJingleStream()
 // ---------------------------------------------------------------------------
 
 void ALTSOUNDCALLBACK AltsoundProcessor::jingle_callback(unsigned int handle, unsigned int channel, unsigned int data, void* user)
+{
+	static_cast<AltsoundProcessor*>(user)->jingleEnded(handle, channel);
+}
+
+// ---------------------------------------------------------------------------
+
+void AltsoundProcessor::jingleEnded(unsigned int hsync, unsigned int hstream_in)
 {
 	// All SYNCPROC functions run on the same thread, and will block other
 	// sync processes, so these should be fast.  The SYNCPROC thread is
@@ -576,12 +621,19 @@ void ALTSOUNDCALLBACK AltsoundProcessor::jingle_callback(unsigned int handle, un
 	ALT_DEBUG(0, "BEGIN AltsoundProcessor::jingle_callback()");
 	ALT_INDENT;
 
-	ALT_INFO(0, "HSYNC: %u  HSTREAM: %u", handle, channel);
+	ALT_INFO(0, "HSYNC: %u  HSTREAM: %u", hsync, hstream_in);
 	ALT_DEBUG(0, "Acquiring mutex");
-	std::lock_guard<std::mutex> guard(io_mutex);
+	std::lock_guard<std::mutex> guard(ctx.io_mutex);
 
-	unsigned int hstream_in = channel;
-	const AltsoundStreamInfo* stream_inst = static_cast<AltsoundStreamInfo*>(user);
+	// a stream stopped or stolen after it ended no longer owns its channel
+	const AltsoundStreamInfo* stream_inst = findStream(hstream_in);
+	if (!stream_inst) {
+		ALT_WARNING(0, "Callback HSTREAM no longer owns a channel. Ignoring");
+
+		ALT_OUTDENT;
+		ALT_DEBUG(0, "END AltsoundProcessor::jingle_callback()");
+		return;
+	}
 
 	// DAR@20230621
 	// The following is not strictly necessary, but I'm keeping it here until
@@ -589,9 +641,6 @@ void ALTSOUNDCALLBACK AltsoundProcessor::jingle_callback(unsigned int handle, un
 	if (!cur_jin_stream) {
 		ALT_WARNING(0, "Jingle callback hit, but no jingle stream set");
 	}
-	else if (stream_inst->hstream != hstream_in) {
-		ALT_WARNING(0, "Callback HSTREAM != instance HSTREAM");
-	}
 	else if (stream_inst->stream_type != JINGLE) {
 		ALT_WARNING(0, "Instance HSTREAM is NOT a JINGLE stream");
 	}
@@ -607,8 +656,7 @@ void ALTSOUNDCALLBACK AltsoundProcessor::jingle_callback(unsigned int handle, un
 	}
 
 	// reset tracking variables
-	delete channel_stream[inst_ch_idx];
-	channel_stream[inst_ch_idx] = nullptr;
+	ctx.channel_stream.release(inst_ch_idx);
 	cur_jin_stream = nullptr;
 
 	if (cur_mus_stream) {
@@ -626,10 +674,10 @@ void ALTSOUNDCALLBACK AltsoundProcessor::jingle_callback(unsigned int handle, un
 		// DAR@20230622
 		// This is a kludgy way to make sure we only resume paused playback
 		// when the stream that paused it ends
-		if (stream_inst->ducking < 0.0f && MiniAudio_ChannelIsActive(mus_hstream) == MINIAUDIO_ACTIVE_PAUSED) {
+		if (stream_inst->ducking < 0.0f && MiniAudio_ChannelIsActive(ctx, mus_hstream) == MINIAUDIO_ACTIVE_PAUSED) {
 			ALT_INFO(0, "Resuming MUSIC playback");
 
-			if (!MiniAudio_ChannelPlay(mus_hstream, false)) {
+			if (!MiniAudio_ChannelPlay(ctx, mus_hstream, false)) {
 				ALT_ERROR(0, "FAILED MiniAudio_ChannelPlay(%u): %s", mus_hstream, get_miniaudio_err());
 			}
 		}
@@ -642,6 +690,13 @@ void ALTSOUNDCALLBACK AltsoundProcessor::jingle_callback(unsigned int handle, un
 // ---------------------------------------------------------------------------
 
 void ALTSOUNDCALLBACK AltsoundProcessor::sfx_callback(unsigned int handle, unsigned int channel, unsigned int data, void* user)
+{
+	static_cast<AltsoundProcessor*>(user)->sfxEnded(handle, channel);
+}
+
+// ---------------------------------------------------------------------------
+
+void AltsoundProcessor::sfxEnded(unsigned int hsync, unsigned int hstream_in)
 {
 	// All SYNCPROC functions run on the same thread, and will block other
 	// sync processes, so these should be fast.  The SYNCPROC thread is
@@ -649,20 +704,24 @@ void ALTSOUNDCALLBACK AltsoundProcessor::sfx_callback(unsigned int handle, unsig
 	ALT_DEBUG(0, "BEGIN: AltsoundProcessor::sfx_callback()");
 	ALT_INDENT;
 
-	ALT_INFO(0, "HSYNC: %u  HSTREAM: %u", handle, channel);
+	ALT_INFO(0, "HSYNC: %u  HSTREAM: %u", hsync, hstream_in);
 	ALT_DEBUG(0, "Acquiring mutex");
-	std::lock_guard<std::mutex> guard(io_mutex);
+	std::lock_guard<std::mutex> guard(ctx.io_mutex);
 
-	unsigned int hstream_in = channel;
-	const AltsoundStreamInfo* stream_inst = static_cast<AltsoundStreamInfo*>(user);
+	// a stream stopped or stolen after it ended no longer owns its channel
+	const AltsoundStreamInfo* stream_inst = findStream(hstream_in);
+	if (!stream_inst) {
+		ALT_WARNING(0, "Callback HSTREAM no longer owns a channel. Ignoring");
+
+		ALT_OUTDENT;
+		ALT_DEBUG(0, "END: AltsoundProcessor::sfx_callback()");
+		return;
+	}
 
 	// DAR@20230621
 	// The following is not strictly necessary, but I'm keeping it here until
 	// I'm comfortable these situations don't/can't happen
-	if (stream_inst->hstream != hstream_in) {
-		ALT_WARNING(0, "Callback HSTREAM != instance HSTREAM");
-	}
-	else if (stream_inst->stream_type != SFX) {
+	if (stream_inst->stream_type != SFX) {
 		ALT_WARNING(0, "instance HSTREAM is NOT a SFX stream");
 	}
 
@@ -677,8 +736,7 @@ void ALTSOUNDCALLBACK AltsoundProcessor::sfx_callback(unsigned int handle, unsig
 	}
 
 	// reset tracking variables
-	delete channel_stream[inst_ch_idx];
-	channel_stream[inst_ch_idx] = nullptr;
+	ctx.channel_stream.release(inst_ch_idx);
 
 	if (cur_mus_stream) {
 		unsigned int mus_hstream = cur_mus_stream->hstream;
@@ -700,6 +758,13 @@ void ALTSOUNDCALLBACK AltsoundProcessor::sfx_callback(unsigned int handle, unsig
 // ---------------------------------------------------------------------------
 
 void ALTSOUNDCALLBACK AltsoundProcessor::music_callback(unsigned int handle, unsigned int channel, unsigned int data, void* user)
+{
+	static_cast<AltsoundProcessor*>(user)->musicEnded(handle, channel);
+}
+
+// ---------------------------------------------------------------------------
+
+void AltsoundProcessor::musicEnded(unsigned int hsync, unsigned int hstream_in)
 {
 	// All SYNCPROC functions run on the same thread, and will block other
 	// sync processes, so these should be fast.  The SYNCPROC thread is
@@ -707,12 +772,19 @@ void ALTSOUNDCALLBACK AltsoundProcessor::music_callback(unsigned int handle, uns
 	ALT_DEBUG(0, "BEGIN AltsoundProcessor::music_callback()");
 	ALT_INDENT;
 
-	ALT_INFO(0, "HSYNC: %u  HSTREAM: %u", handle, channel);
+	ALT_INFO(0, "HSYNC: %u  HSTREAM: %u", hsync, hstream_in);
 	ALT_DEBUG(0, "Acquiring mutex");
-	std::lock_guard<std::mutex> guard(io_mutex);
+	std::lock_guard<std::mutex> guard(ctx.io_mutex);
 
-	unsigned int hstream_in = channel;
-	const AltsoundStreamInfo* stream_inst = static_cast<AltsoundStreamInfo*>(user);
+	// a stream stopped or stolen after it ended no longer owns its channel
+	const AltsoundStreamInfo* stream_inst = findStream(hstream_in);
+	if (!stream_inst) {
+		ALT_WARNING(0, "Callback HSTREAM no longer owns a channel. Ignoring");
+
+		ALT_OUTDENT;
+		ALT_DEBUG(0, "END AltsoundProcessor::music_callback()");
+		return;
+	}
 
 	// DAR@20230621
 	// The following is not strictly necessary, but I'm keeping it here until
@@ -720,9 +792,6 @@ void ALTSOUNDCALLBACK AltsoundProcessor::music_callback(unsigned int handle, uns
 	if (!cur_jin_stream) {
 		ALT_WARNING(0, "MUSIC callback hit, but no MUSIC stream set");
 	}
-	else if (stream_inst->hstream != hstream_in) {
-		ALT_WARNING(0, "callback HSTREAM != instance HSTREAM");
-	}
 	else if (stream_inst->stream_type != MUSIC) {
 		ALT_WARNING(0, "instance HSTREAM is NOT a MUSIC stream");
 	}
@@ -738,8 +807,7 @@ void ALTSOUNDCALLBACK AltsoundProcessor::music_callback(unsigned int handle, uns
 	}
 
 	// reset tracking variables
-	delete channel_stream[inst_ch_idx];
-	channel_stream[inst_ch_idx] = nullptr;
+	ctx.channel_stream.release(inst_ch_idx);
 	cur_mus_stream = nullptr;
 
 	ALT_OUTDENT;
@@ -748,7 +816,7 @@ void ALTSOUNDCALLBACK AltsoundProcessor::music_callback(unsigned int handle, uns
 
 // ---------------------------------------------------------------------------
 
-float AltsoundProcessor::getMinDucking()
+float AltsoundProcessor::getMinDucking() const
 {
 	ALT_DEBUG(0, "BEGIN: AltsoundProcessor::getMinDucking()");
 	ALT_INDENT;
@@ -756,8 +824,8 @@ float AltsoundProcessor::getMinDucking()
 	float min_ducking = 1.0f;
 	int num_x_streams = 0;
 
-	for (size_t index = 0; index < channel_stream.size(); ++index) {
-		const auto stream = channel_stream[index];
+	for (size_t index = 0; index < ctx.channel_stream.size(); ++index) {
+		const auto stream = ctx.channel_stream[index];
 		if (stream) {
 			// stream defined on the channel
 			ALT_INFO(1, "Channel_stream[%u]: STREAM: %u  DUCKING: %0.02f", index, stream->hstream, stream->ducking);
@@ -21,6 +21,9 @@
 #endif
 
 #include "altsound_processor_base.hpp"
+#include "altsound_sample_index.hpp"
+
+#include <random>
 
 // ---------------------------------------------------------------------------
 // AltsoundProcessor class definition
@@ -37,7 +40,8 @@ public:
 	AltsoundProcessor(AltsoundProcessor&) = delete;
 
 	// Standard constructor
-	AltsoundProcessor(const string& game_name_in,
+	AltsoundProcessor(AltSoundContext& ctx_in,
+	                  const string& game_name_in,
 	                  const string& vpm_path_in,
 	                  const string& format_in);
 
@@ -50,7 +54,11 @@ public:
 	// External interface to stop currently-playing MUSIC stream
 	bool stopMusic() override;
 
-	// miniaudio SYNCPROC callback when jingle samples end
+	// List of parsed samples for the background preloader
+	std::vector<PreloadItem> getPreloadItems() const override;
+
+	// miniaudio SYNCPROC callback when jingle samples end.  user is the
+	// processor
 	static void ALTSOUNDCALLBACK jingle_callback(unsigned int handle, unsigned int channel, unsigned int data, void *user);
 
 	// miniaudio SYNCPROC callback when sfx samples end
@@ -72,6 +80,9 @@ private: // functions
 	// find sample matching provided command
 	unsigned int getSample(const unsigned int cmd_combined_in) override;
 
+	// drop MUSIC/JINGLE tracking of a stream that is being stolen
+	void forgetStream(const AltsoundStreamInfo& stream) override;
+
 	//
 	bool stopMusicStream();
 
@@ -79,7 +90,16 @@ private: // functions
 	bool stopJingleStream();
 
 	// get lowest ducking value of all active streams
-	static float getMinDucking();
+	float getMinDucking() const;
+
+	// handle the end of a jingle stream
+	void jingleEnded(unsigned int hsync, unsigned int hstream_in);
+
+	// handle the end of a sfx stream
+	void sfxEnded(unsigned int hsync, unsigned int hstream_in);
+
+	// handle the end of a music stream
+	void musicEnded(unsigned int hsync, unsigned int hstream_in);
 
 	// process music commands
 	bool process_music(AltsoundStreamInfo* stream_out);
@@ -95,7 +115,17 @@ private: // data
 	std::string format;
 	bool is_initialized;
 	bool is_stable; // future use
-	std::vector<AltsoundSampleInfo> samples;
+	std::vector<AltsoundSampleInfo> samples; // sorted by ID
+	AltsoundSampleIndex sample_index;
+	std::mt19937 generator; // mersenne twister
+
+	// NOTE:
+	// - SFX streams don't require tracking since multiple can play,
+	//   simultaneously, and other than adjusting ducking, have no other
+	//   impacts on active streams
+	//
+	AltsoundStreamInfo* cur_mus_stream = nullptr;
+	AltsoundStreamInfo* cur_jin_stream = nullptr;
 };
 
 // ---------------------------------------------------------------------------
@@ -9,8 +9,8 @@
 // ---------------------------------------------------------------------------
 
 #include "altsound_processor_base.hpp"
+#include "altsound_context.hpp"
 #include "altsound_logger.hpp"
-#include "miniaudio_bass_compat.hpp"
 
 #include <iomanip>
 #include <chrono>
@@ -18,33 +18,16 @@
 #include <fstream>
 
 extern AltsoundLogger alog;
-extern StreamArray channel_stream;
-
-// initialize static data members
-float AltsoundProcessorBase::global_vol = 1.0f;
-float AltsoundProcessorBase::master_vol = 1.0f;
-
-// reference to sound command recording status
-extern bool rec_snd_cmds;
-
-// DAR@20230721
-// ALTSOUND_STANDALONE is a compile-time flag set only when building the
-// altsound processor as an executable.  It prevents the executable from
-// trying to record a cmdlog.txt during playback, corrupting the source
-// file
-//
-#ifndef ALTSOUND_STANDALONE
-	std::ofstream logFile;
-	std::chrono::high_resolution_clock::time_point lastCmdTime;
-#endif
 
 // ---------------------------------------------------------------------------
 // CTOR/DTOR
 // ---------------------------------------------------------------------------
 
-AltsoundProcessorBase::AltsoundProcessorBase(const std::string& _game_name,
+AltsoundProcessorBase::AltsoundProcessorBase(AltSoundContext& ctx_in,
+	                                         const std::string& _game_name,
 	                                         const std::string& _vpm_path)
-: game_name(_game_name),
+: ctx(ctx_in),
+  game_name(_game_name),
   vpm_path(_vpm_path),
   skip_count(0)
 {
@@ -61,10 +44,8 @@ AltsoundProcessorBase::~AltsoundProcessorBase()
 #endif
 
 	// clean up stored steam objects
-	for (auto& stream : channel_stream) {
-		delete stream;
-		stream = nullptr;
-	}
+	for (unsigned int idx = 0; idx < ctx.channel_stream.size(); ++idx)
+		ctx.channel_stream.release(idx);
 }
 
 // ---------------------------------------------------------------------------
@@ -154,21 +135,41 @@ bool AltsoundProcessorBase::startLogging(const std::string& gameName) {
 
 // ---------------------------------------------------------------------------
 
-bool AltsoundProcessorBase::findFreeChannel(unsigned int& channel_out)
+bool AltsoundProcessorBase::findFreeChannel(AltsoundSampleType type, unsigned int& channel_out)
 {
 	ALT_INFO(0, "BEGIN: AltsoundProcessorBase::findFreeChannel()");
 	ALT_INDENT;
 
-	const auto it = std::find(channel_stream.begin(), channel_stream.end(), nullptr);
-	if (it != channel_stream.end()) {
-		channel_out = static_cast<unsigned int>(std::distance(channel_stream.begin(), it));
+	// a sample type at its cap replaces one of its own streams, even if
+	// other channels are free
+	const unsigned int cap = voice_policy.type_caps[type];
+	const bool capped = cap > 0 && ctx.channel_stream.getTypeCount(type) >= cap;
+
+	if (!capped && ctx.channel_stream.findFree(channel_out)) {
 		ALT_INFO(1, "Found free channel: %02u", channel_out);
 
 		ALT_OUTDENT;
 		ALT_DEBUG(0, "END: AltsoundProcessorBase::findFreeChannel()");
 		return true;
 	}
-	ALT_ERROR(1, "No free channels available!");
+
+	if (findVictim(type, capped, channel_out)) {
+		stealChannel(channel_out);
+		ALT_INFO(1, "Stole channel: %02u", channel_out);
+
+		ALT_OUTDENT;
+		ALT_DEBUG(0, "END: AltsoundProcessorBase::findFreeChannel()");
+		return true;
+	}
+
+	drop_count.fetch_add(1, std::memory_order_relaxed);
+	ctx.trace.instant("VoiceDrop", "type", static_cast<uint32_t>(type));
+	if (capped) {
+		ALT_ERROR(1, "%s streams at their cap of %u!", toString(type), cap);
+	}
+	else {
+		ALT_ERROR(1, "No free channels available!");
+	}
 
 	ALT_OUTDENT;
 	ALT_DEBUG(0, "END AltsoundProcessorBase::findFreeChannel()");
@@ -177,6 +178,64 @@ bool AltsoundProcessorBase::findFreeChannel(unsigned int& channel_out)
 
 // ----------------------------------------------------------------------------
 
+bool AltsoundProcessorBase::findVictim(AltsoundSampleType type, bool same_type, unsigned int& channel_out) const
+{
+	if (voice_policy.steal == ALT_STEAL_NONE)
+		return false;
+
+	bool found = false;
+	bool best_sfx = false;
+	float best_vol = 0.0f;
+	uint64_t best_seq = 0;
+
+	for (unsigned int idx = 0; idx < ctx.channel_stream.size(); ++idx) {
+		const AltsoundStreamInfo* stream = ctx.channel_stream[idx];
+		if (!stream || (same_type && stream->stream_type != type))
+			continue;
+
+		bool better;
+		if (voice_policy.steal == ALT_STEAL_QUIETEST) {
+			// the older of equally quiet streams
+			const float vol = getStreamVolume(stream->hstream);
+			better = !found || vol < best_vol || (vol == best_vol && stream->start_seq < best_seq);
+			best_vol = better ? vol : best_vol;
+		}
+		else {
+			// any SFX stream before other types
+			const bool sfx = stream->stream_type == SFX;
+			better = !found || (sfx && !best_sfx) || (sfx == best_sfx && stream->start_seq < best_seq);
+			best_sfx = better ? sfx : best_sfx;
+		}
+
+		if (better) {
+			found = true;
+			best_seq = stream->start_seq;
+			channel_out = idx;
+		}
+	}
+	return found;
+}
+
+// ----------------------------------------------------------------------------
+
+void AltsoundProcessorBase::stealChannel(unsigned int channel)
+{
+	AltsoundStreamInfo* victim = ctx.channel_stream[channel];
+	const unsigned int hstream = victim->hstream;
+	ALT_INFO(1, "Stealing %s stream(%u) on channel(%02u)", toString(victim->stream_type), hstream, channel);
+
+	forgetStream(*victim);
+	if (!MiniAudio_StreamFadeOut(ctx, hstream, voice_policy.fade_ms)) {
+		ALT_ERROR(1, "FAILED MiniAudio_StreamFadeOut(%u): %s", hstream, get_miniaudio_err());
+	}
+	ctx.channel_stream.release(channel);
+
+	steal_count.fetch_add(1, std::memory_order_relaxed);
+	ctx.trace.instant("VoiceSteal", "hstream", hstream);
+}
+
+// ----------------------------------------------------------------------------
+
 bool AltsoundProcessorBase::setStreamVolume(unsigned int stream_in, const float vol_in)
 {
 	ALT_DEBUG(0, "BEGIN: AltsoundProcessorBase::setVolume()");
@@ -189,7 +248,7 @@ bool AltsoundProcessorBase::setStreamVolume(unsigned int stream_in, const float
 	ALT_INFO(1, "Setting volume for stream %u", stream_in);
 	ALT_DEBUG(1, "SAMPLE_VOL:%.02f  GLOBAL_VOL:%.02f  MASTER_VOL:%.02f", vol_in,
 	          global_vol, master_vol);
-	const bool success = MiniAudio_ChannelSetVolume(stream_in, new_vol);
+	const bool success = MiniAudio_ChannelSetVolume(ctx, stream_in, new_vol);
 
 	if (!success) {
 		ALT_ERROR(1, "FAILED MiniAudio_ChannelSetVolume()");
@@ -205,13 +264,13 @@ bool AltsoundProcessorBase::setStreamVolume(unsigned int stream_in, const float
 
 // ----------------------------------------------------------------------------
 
-float AltsoundProcessorBase::getStreamVolume(unsigned int stream_in)
+float AltsoundProcessorBase::getStreamVolume(unsigned int stream_in) const
 {
 	if (stream_in == MINIAUDIO_NO_STREAM)
 		return -FLT_MAX;
 
 	float vol;
-	if (!MiniAudio_ChannelGetVolume(stream_in, vol))
+	if (!MiniAudio_ChannelGetVolume(ctx, stream_in, vol))
 		return -FLT_MAX;
 	else
 		return vol/(global_vol * master_vol);
@@ -227,7 +286,7 @@ bool AltsoundProcessorBase::createStream(void* syncproc_in, AltsoundStreamInfo*
 	const std::string short_path = getShortPath(stream_out->sample_path);
 	unsigned int ch_idx;
 
-	if (!ALT_CALL(findFreeChannel(ch_idx))) {
+	if (!ALT_CALL(findFreeChannel(stream_out->stream_type, ch_idx))) {
 		ALT_ERROR(1, "FAILED AltsoundProcessorBase::findFreeChannel()");
 
 		ALT_OUTDENT;
@@ -236,10 +295,13 @@ bool AltsoundProcessorBase::createStream(void* syncproc_in, AltsoundStreamInfo*
 	}
 
 	stream_out->channel_idx = ch_idx; // store channel assignment
+	stream_out->start_seq = ++stream_seq;
 	const bool loop = stream_out->loop;
 
-	// Create playback stream
-	unsigned int hstream = MiniAudio_StreamCreateFile(false, stream_out->sample_path, 0, loop);
+	// Create playback stream, from the mapped .altpack if the sample has one
+	const bool mem = stream_out->sample_data != nullptr;
+	const void* file = mem ? stream_out->sample_data : stream_out->sample_path.c_str();
+	unsigned int hstream = MiniAudio_StreamCreateFile(ctx, mem, file, stream_out->sample_size, loop);
 
 	if (hstream == MINIAUDIO_NO_STREAM) {
 		// Failed to create stream
@@ -250,14 +312,17 @@ bool AltsoundProcessorBase::createStream(void* syncproc_in, AltsoundStreamInfo*
 		return false;
 	}
 
+	// Record the owning channel, so freeing the stream can clear it directly
+	MiniAudio_StreamSetChannel(ctx, hstream, ch_idx);
+
 	// Set callback to execute when sample playback ends
 	SYNCPROC* callback = reinterpret_cast<SYNCPROC*>(syncproc_in);
 	unsigned int hsync = 0;
 
 	if (callback) {
 		// Set sync to execute callback when sample playback ends
-		hsync = MiniAudio_ChannelSetSync(hstream, MINIAUDIO_SYNC_END | MINIAUDIO_SYNC_ONETIME,
-		                                 callback, stream_out);
+		hsync = MiniAudio_ChannelSetSync(ctx, hstream, MINIAUDIO_SYNC_END | MINIAUDIO_SYNC_ONETIME,
+		                                 callback, this);
 		if (!hsync) {
 			// Failed to set sync
 			ALT_ERROR(1, "FAILED MiniAudio_ChannelSetSync(): STREAM: %u ERROR: %s", hstream, get_miniaudio_err());
@@ -285,7 +350,7 @@ bool AltsoundProcessorBase::freeStream(const unsigned int hstream_in)
 	ALT_INFO(0, "BEGIN AltsoundProcessorBase::freeStream()");
 	ALT_INDENT;
 
-	const bool success = MiniAudio_StreamFree(hstream_in);
+	const bool success = MiniAudio_StreamFree(ctx, hstream_in);
 	if (!success) {
 		ALT_ERROR(1, "Failed to free stream(%u)", hstream_in);
 	} else {
@@ -299,6 +364,18 @@ bool AltsoundProcessorBase::freeStream(const unsigned int hstream_in)
 
 // ----------------------------------------------------------------------------
 
+AltsoundStreamInfo* AltsoundProcessorBase::findStream(unsigned int hstream) const
+{
+	unsigned int ch_idx;
+	if (!MiniAudio_StreamGetChannel(ctx, hstream, ch_idx))
+		return nullptr;
+
+	AltsoundStreamInfo* stream = ctx.channel_stream[ch_idx];
+	return stream && stream->hstream == hstream ? stream : nullptr;
+}
+
+// ----------------------------------------------------------------------------
+
 bool AltsoundProcessorBase::stopStream(unsigned int hstream_in)
 {
 	ALT_DEBUG(0, "BEGIN: AltsoundProcessorBase::stopStream()");
@@ -307,7 +384,7 @@ bool AltsoundProcessorBase::stopStream(unsigned int hstream_in)
 	bool success = false;
 
 	if (hstream_in != MINIAUDIO_NO_STREAM) {
-		if (MiniAudio_ChannelStop(hstream_in)) {
+		if (MiniAudio_ChannelStop(ctx, hstream_in)) {
 			success = freeStream(hstream_in);
 			if (!success) {
 				ALT_ERROR(0, "FAILED AltsoundProcessorBase::freeStream()");
@@ -335,7 +412,7 @@ bool AltsoundProcessorBase::stopAllStreams()
 
 	bool success = true;
 
-	for (auto stream : channel_stream) {
+	for (auto stream : ctx.channel_stream) {
 		if (!stream)
 			continue;
 
@@ -21,13 +21,19 @@
 #endif
 
 #include "altsound_data.hpp"
+#include "altsound_preloader.hpp"
 
 #include "miniaudio_private.h"
 
+#include <atomic>
+#include <chrono>
+#include <fstream>
 #include <mutex>
 
 using std::string;
 
+struct AltSoundContext;
+
 // ---------------------------------------------------------------------------
 // AltsoundProcessorBase class definition
 // ---------------------------------------------------------------------------
@@ -41,8 +47,8 @@ public:
 	// Copy constructor
 	AltsoundProcessorBase(AltsoundProcessorBase&) = delete;
 
-	// Standard constructor
-	AltsoundProcessorBase(const string& game_name, const string& vpm_path);
+	// Standard constructor.  The processor plays its streams in ctx_in
+	AltsoundProcessorBase(AltSoundContext& ctx_in, const string& game_name, const string& vpm_path);
 
 	// Destructor
 	virtual ~AltsoundProcessorBase();
@@ -53,6 +59,9 @@ public:
 	// external interface to stop playback of the current music stream
 	virtual bool stopMusic() = 0;
 
+	// list of parsed samples for the background preloader
+	virtual std::vector<PreloadItem> getPreloadItems() const = 0;
+
 	// ROM volume control accessor/mutator
 	void romControlsVol(const bool use_rom_vol);
 	bool romControlsVol();
@@ -65,16 +74,25 @@ public:
 
 	// master volume accessor/mutator
 	void setMasterVol(const float vol_in);
-	static float getMasterVol();
+	float getMasterVol() const;
 
 	// global accessor/mutator
 	void setGlobalVol(const float vol_in);
-	static float getGlobalVol();
+	float getGlobalVol() const;
 
 	// command skip count accessor/mutator
 	void setSkipCount(const unsigned int skip_count_in);
 	unsigned int getSkipCount() const;
 
+	// voice allocation accessor/mutator.  Setting it resets the counts below
+	void setVoicePolicy(const AltsoundVoicePolicy& policy_in);
+	const AltsoundVoicePolicy& getVoicePolicy() const;
+
+	// number of streams stopped to make room for new ones, and of samples
+	// dropped for lack of a channel
+	uint64_t getStealCount() const;
+	uint64_t getDropCount() const;
+
 public: // data
 
 protected: // functions
@@ -95,19 +113,28 @@ protected: // functions
 	bool stopAllStreams();
 
 	// stop playback of provided stream handle
-	static bool stopStream(unsigned int hstream);
+	bool stopStream(unsigned int hstream);
 
 	// free miniaudio resources of provided stream handle
-	static bool freeStream(unsigned int hstream);
+	bool freeStream(unsigned int hstream);
 
-	// find available sound channel for sample playback
-	static bool findFreeChannel(unsigned int& channel_out);
+	// find the stream that owns a channel by its handle.  Returns nullptr
+	// once the stream was freed or lost its channel
+	AltsoundStreamInfo* findStream(unsigned int hstream) const;
+
+	// find available sound channel for sample playback, stealing one under
+	// the voice policy when none is free or the sample type is at its cap
+	bool findFreeChannel(AltsoundSampleType type, unsigned int& channel_out);
+
+	// drop the processor's tracking of a stream that is being stolen.  The
+	// stream is freed by the caller
+	virtual void forgetStream(const AltsoundStreamInfo& stream) = 0;
 
 	// set volume on provided stream
-	static bool setStreamVolume(unsigned int hstream, const float vol_in);
+	bool setStreamVolume(unsigned int hstream, const float vol_in);
 
 	// get volume on provided stream, -FLT_MAX on error
-	static float getStreamVolume(unsigned int hstream);
+	float getStreamVolume(unsigned int hstream) const;
 
 	// Return ROM shortname
 	const string& getGameName();
@@ -120,18 +147,38 @@ protected: // functions
 
 protected: // data
 
+	AltSoundContext& ctx;
 	string game_name;
 	string vpm_path;
 
 private: // functions
 
+	// pick the channel whose stream gives way under the steal policy.  Only
+	// streams of the given type are candidates when same_type is set
+	bool findVictim(AltsoundSampleType type, bool same_type, unsigned int& channel_out) const;
+
+	// fade out and free the stream on a channel, leaving the channel free
+	void stealChannel(unsigned int channel);
+
 private: // data
 
+	AltsoundVoicePolicy voice_policy;
+	std::atomic<uint64_t> steal_count{ 0 };
+	std::atomic<uint64_t> drop_count{ 0 };
+	uint64_t stream_seq = 0;
+
 	bool rec_snd_cmds = false;
 	bool use_rom_ctrl = true;
-	static float global_vol;
-	static float master_vol;
+	float global_vol = 1.0f;
+	float master_vol = 1.0f;
 	unsigned int skip_count;
+
+	// sound command recording.  DAR@20230721: ALTSOUND_STANDALONE is a
+	// compile-time flag set only when building the altsound processor as an
+	// executable.  It prevents the executable from trying to record a
+	// cmdlog.txt during playback, corrupting the source file
+	std::ofstream logFile;
+	std::chrono::high_resolution_clock::time_point lastCmdTime;
 };
 
 // ----------------------------------------------------------------------------
@@ -174,13 +221,13 @@ inline void AltsoundProcessorBase::setMasterVol(const float vol_in) {
 
 // ----------------------------------------------------------------------------
 
-inline float AltsoundProcessorBase::getMasterVol() {
+inline float AltsoundProcessorBase::getMasterVol() const {
 	return master_vol;
 }
 
 // ----------------------------------------------------------------------------
 
-inline float AltsoundProcessorBase::getGlobalVol() {
+inline float AltsoundProcessorBase::getGlobalVol() const {
 	return global_vol;
 }
 
@@ -196,4 +243,30 @@ inline void AltsoundProcessorBase::setSkipCount(const unsigned int skip_count_in
 	skip_count = skip_count_in;
 }
 
+// ----------------------------------------------------------------------------
+
+inline void AltsoundProcessorBase::setVoicePolicy(const AltsoundVoicePolicy& policy_in) {
+	voice_policy = policy_in;
+	steal_count.store(0, std::memory_order_relaxed);
+	drop_count.store(0, std::memory_order_relaxed);
+}
+
+// ----------------------------------------------------------------------------
+
+inline const AltsoundVoicePolicy& AltsoundProcessorBase::getVoicePolicy() const {
+	return voice_policy;
+}
+
+// ----------------------------------------------------------------------------
+
+inline uint64_t AltsoundProcessorBase::getStealCount() const {
+	return steal_count.load(std::memory_order_relaxed);
+}
+
+// ----------------------------------------------------------------------------
+
+inline uint64_t AltsoundProcessorBase::getDropCount() const {
+	return drop_count.load(std::memory_order_relaxed);
+}
+
 #endif // ALTSOUND_PROCESSOR_BASE_HPP
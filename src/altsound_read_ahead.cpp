@@ -0,0 +1,308 @@
+// ---------------------------------------------------------------------------
+// altsound_read_ahead.cpp
+//
+// Background decoding of long samples
+// ---------------------------------------------------------------------------
+// license:BSD-3-Clause
+// ---------------------------------------------------------------------------
+
+#include "altsound_read_ahead.hpp"
+#include "altsound_trace.hpp"
+#include "miniaudio_private.h"
+
+#include <algorithm>
+
+// ---------------------------------------------------------------------------
+// ReadAheadStream implementation
+// ---------------------------------------------------------------------------
+
+size_t ReadAheadStream::peek(const float*& frames_out, bool& at_end) const
+{
+	// eof is published after the last write, so read it first
+	const bool end = eof.load(std::memory_order_acquire);
+	const uint64_t w = write_pos.load(std::memory_order_acquire);
+	const uint64_t r = read_pos.load(std::memory_order_relaxed);
+
+	at_end = end && r == w;
+	const uint64_t index = r % capacity;
+	frames_out = &ring[static_cast<size_t>(index * channels)];
+	return static_cast<size_t>(std::min(w - r, capacity - index));
+}
+
+// ----------------------------------------------------------------------------
+
+void ReadAheadStream::consume(size_t frames)
+{
+	const uint64_t r = read_pos.load(std::memory_order_relaxed) + frames;
+	read_pos.store(r, std::memory_order_release);
+
+	if (eof.load(std::memory_order_acquire))
+		return;
+
+	const uint64_t fill = write_pos.load(std::memory_order_acquire) - r;
+	if (fill < owner->min_fill_frames.load(std::memory_order_relaxed))
+		owner->min_fill_frames.store(fill, std::memory_order_relaxed);
+
+	// refill from half empty, waking the thread once per refill
+	if (fill < capacity / 2 && !wake_pending.exchange(true, std::memory_order_acq_rel))
+		owner->wake();
+}
+
+// ----------------------------------------------------------------------------
+
+void ReadAheadStream::starved(size_t frames)
+{
+	owner->starvations.fetch_add(1, std::memory_order_relaxed);
+	owner->starved_frames.fetch_add(frames, std::memory_order_relaxed);
+	owner->min_fill_frames.store(0, std::memory_order_relaxed);
+	owner->trace.instant("ReadAheadStarved", "frames", static_cast<uint32_t>(frames));
+
+	if (!wake_pending.exchange(true, std::memory_order_acq_rel))
+		owner->wake();
+}
+
+// ----------------------------------------------------------------------------
+
+size_t ReadAheadStream::fill(size_t max_frames)
+{
+	if (eof.load(std::memory_order_relaxed))
+		return 0;
+
+	uint64_t w = write_pos.load(std::memory_order_relaxed);
+	const uint64_t space = capacity - (w - read_pos.load(std::memory_order_acquire));
+	const size_t want = static_cast<size_t>(std::min<uint64_t>(space, max_frames));
+
+	size_t total = 0;
+	bool wrapped = false;
+	while (total < want) {
+		const uint64_t index = w % capacity;
+		const ma_uint64 chunk = std::min<uint64_t>(want - total, capacity - index);
+		ma_uint64 frames_read = 0;
+		altsound_ma_decoder_read_pcm_frames(decoder, &ring[static_cast<size_t>(index * channels)], chunk, &frames_read);
+
+		if (frames_read > 0) {
+			w += frames_read;
+			total += static_cast<size_t>(frames_read);
+			write_pos.store(w, std::memory_order_release);
+			wrapped = false;
+		}
+
+		if (frames_read < chunk) {
+			// stop on a decoder that returns nothing right after a rewind
+			if (!looping || wrapped) {
+				eof.store(true, std::memory_order_release);
+				break;
+			}
+			altsound_ma_decoder_seek_to_pcm_frame(decoder, 0);
+			wrapped = true;
+		}
+	}
+	return total;
+}
+
+// ---------------------------------------------------------------------------
+// AltsoundReadAhead implementation
+// ---------------------------------------------------------------------------
+
+AltsoundReadAhead::AltsoundReadAhead(AltsoundTrace& trace_in)
+: trace(trace_in)
+{
+}
+
+// ----------------------------------------------------------------------------
+
+AltsoundReadAhead::~AltsoundReadAhead()
+{
+	stop();
+}
+
+// ----------------------------------------------------------------------------
+
+void AltsoundReadAhead::start(uint32_t sample_rate_in, uint32_t buffer_ms, unsigned int stream_count)
+{
+	stop();
+
+	// room to prime a stream and keep decoding while it plays
+	capacity_frames = std::max<uint64_t>(static_cast<uint64_t>(sample_rate_in) * buffer_ms / 1000,
+		ALT_READ_AHEAD_PRIME_FRAMES * 2);
+	pool.reserve(stream_count);
+	streams.reserve(stream_count);
+	pass_streams.reserve(stream_count);
+
+	opened.store(0, std::memory_order_relaxed);
+	decoded_frames.store(0, std::memory_order_relaxed);
+	min_fill_frames.store(UINT64_MAX, std::memory_order_relaxed);
+	starvations.store(0, std::memory_order_relaxed);
+	starved_frames.store(0, std::memory_order_relaxed);
+
+	running.store(true, std::memory_order_release);
+	thread = std::thread(&AltsoundReadAhead::threadProc, this);
+}
+
+// ----------------------------------------------------------------------------
+
+void AltsoundReadAhead::stop()
+{
+	if (thread.joinable()) {
+		running.store(false, std::memory_order_release);
+		wake_seq.fetch_add(1, std::memory_order_release);
+		wake_seq.notify_one();
+		thread.join();
+	}
+
+	std::lock_guard<std::mutex> lock(mutex);
+	streams.clear();
+}
+
+// ----------------------------------------------------------------------------
+
+ReadAheadStream* AltsoundReadAhead::open(ma_decoder* decoder_in, uint32_t channels_in, bool looping_in)
+{
+	ReadAheadStream* stream = pool.acquire();
+	stream->owner = this;
+	stream->decoder = decoder_in;
+	stream->channels = channels_in;
+	stream->looping = looping_in;
+	stream->capacity = capacity_frames;
+	stream->write_pos.store(0, std::memory_order_relaxed);
+	stream->read_pos.store(0, std::memory_order_relaxed);
+	stream->eof.store(false, std::memory_order_relaxed);
+	stream->wake_pending.store(false, std::memory_order_relaxed);
+
+	// only allocates the first time a pooled stream is used
+	const size_t samples = static_cast<size_t>(capacity_frames * channels_in);
+	if (stream->ring.size() < samples)
+		stream->ring.resize(samples);
+
+	// not yet visible to the decode thread
+	decoded_frames.fetch_add(stream->fill(ALT_READ_AHEAD_PRIME_FRAMES), std::memory_order_relaxed);
+	opened.fetch_add(1, std::memory_order_relaxed);
+
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		streams.push_back(stream);
+	}
+	wake();
+	return stream;
+}
+
+// ----------------------------------------------------------------------------
+
+void AltsoundReadAhead::rewind(ReadAheadStream* stream)
+{
+	std::unique_lock<std::mutex> lock(mutex);
+	waitNotFilling(lock, stream);
+
+	// the decode thread cannot pick the stream while we hold the lock
+	altsound_ma_decoder_seek_to_pcm_frame(stream->decoder, 0);
+	stream->write_pos.store(0, std::memory_order_relaxed);
+	stream->read_pos.store(0, std::memory_order_relaxed);
+	stream->eof.store(false, std::memory_order_relaxed);
+	stream->wake_pending.store(false, std::memory_order_relaxed);
+	decoded_frames.fetch_add(stream->fill(ALT_READ_AHEAD_PRIME_FRAMES), std::memory_order_relaxed);
+	lock.unlock();
+
+	wake();
+}
+
+// ----------------------------------------------------------------------------
+
+void AltsoundReadAhead::close(ReadAheadStream* stream)
+{
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+		streams.erase(std::remove(streams.begin(), streams.end(), stream), streams.end());
+		waitNotFilling(lock, stream);
+	}
+
+	stream->decoder = nullptr;
+	pool.release(stream);
+}
+
+// ----------------------------------------------------------------------------
+
+ReadAheadStats AltsoundReadAhead::getStats() const
+{
+	ReadAheadStats stats;
+	stats.opened = opened.load(std::memory_order_relaxed);
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stats.active = static_cast<uint32_t>(streams.size());
+	}
+	stats.decoded_frames = decoded_frames.load(std::memory_order_relaxed);
+	stats.capacity_frames = capacity_frames;
+	const uint64_t min_fill = min_fill_frames.load(std::memory_order_relaxed);
+	stats.min_fill_frames = min_fill == UINT64_MAX ? capacity_frames : min_fill;
+	stats.starvations = starvations.load(std::memory_order_relaxed);
+	stats.starved_frames = starved_frames.load(std::memory_order_relaxed);
+	return stats;
+}
+
+// ----------------------------------------------------------------------------
+
+void AltsoundReadAhead::threadProc()
+{
+	trace.setThreadName("read-ahead");
+	uint32_t seq = wake_seq.load(std::memory_order_acquire);
+
+	while (running.load(std::memory_order_acquire)) {
+		while (running.load(std::memory_order_acquire) && fillPass()) {}
+
+		// sleep until a stream runs low, opens or stop() bumps the sequence
+		wake_seq.wait(seq, std::memory_order_acquire);
+		seq = wake_seq.load(std::memory_order_acquire);
+	}
+}
+
+// ----------------------------------------------------------------------------
+
+bool AltsoundReadAhead::fillPass()
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		pass_streams = streams;
+	}
+
+	bool decoded = false;
+	for (ReadAheadStream* stream : pass_streams) {
+		{
+			// skip streams closed since the pass began
+			std::lock_guard<std::mutex> lock(mutex);
+			if (std::find(streams.begin(), streams.end(), stream) == streams.end())
+				continue;
+			filling = stream;
+		}
+
+		stream->wake_pending.store(false, std::memory_order_release);
+		size_t frames;
+		{
+			AltsoundTraceScope trace_scope(trace, "ReadAhead");
+			frames = stream->fill(ALT_READ_AHEAD_CHUNK_FRAMES);
+			trace_scope.setArg("frames", static_cast<uint32_t>(frames));
+		}
+		decoded_frames.fetch_add(frames, std::memory_order_relaxed);
+		decoded |= frames > 0;
+
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			filling = nullptr;
+		}
+		filled_cv.notify_all();
+	}
+	return decoded;
+}
+
+// ----------------------------------------------------------------------------
+
+void AltsoundReadAhead::wake()
+{
+	wake_seq.fetch_add(1, std::memory_order_release);
+	wake_seq.notify_one();
+}
+
+// ----------------------------------------------------------------------------
+
+void AltsoundReadAhead::waitNotFilling(std::unique_lock<std::mutex>& lock, const ReadAheadStream* stream)
+{
+	filled_cv.wait(lock, [this, stream] { return filling != stream; });
+}
@@ -0,0 +1,198 @@
+// ---------------------------------------------------------------------------
+// altsound_read_ahead.hpp
+//
+// Background decoding of long samples.  A decode thread keeps a ring buffer
+// per stream filled ahead of playback, so the mixing thread only copies PCM
+// and a disk stall drains the buffer instead of causing a dropout
+// ---------------------------------------------------------------------------
+// license:BSD-3-Clause
+// ---------------------------------------------------------------------------
+
+#ifndef ALTSOUND_READ_AHEAD_HPP
+#define ALTSOUND_READ_AHEAD_HPP
+#if !defined(__GNUC__) || (__GNUC__ == 3 && __GNUC_MINOR__ >= 4) || (__GNUC__ >= 4)	// GCC supports "pragma once" correctly since 3.4
+#pragma once
+#endif
+
+#include "altsound_object_pool.hpp"
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+struct ma_decoder;
+class AltsoundReadAhead;
+class AltsoundTrace;
+
+// Defaults used when altsound.ini does not specify them
+#define ALT_READ_AHEAD_THRESHOLD_DEFAULT_MS 10000
+#define ALT_READ_AHEAD_BUFFER_DEFAULT_MS 500
+
+// Frames decoded on the command path when a stream opens or rewinds, so it
+// can start before the decode thread first runs
+#define ALT_READ_AHEAD_PRIME_FRAMES 2048
+
+// Most frames the decode thread decodes for one stream before moving on
+#define ALT_READ_AHEAD_CHUNK_FRAMES 4096
+
+// Counters since start()
+struct ReadAheadStats {
+	uint64_t opened = 0;          // streams opened
+	uint32_t active = 0;          // streams open now
+	uint64_t decoded_frames = 0;  // frames decoded ahead of playback
+	uint64_t capacity_frames = 0; // ring buffer size of each stream
+	uint64_t min_fill_frames = 0; // lowest fill left after a mix pass
+	uint64_t starvations = 0;     // mix passes that ran dry before a stream's end
+	uint64_t starved_frames = 0;  // frames of silence those passes produced
+};
+
+// ---------------------------------------------------------------------------
+// ReadAheadStream class definition
+//
+// A decoder and its ring buffer.  The decode thread (or the command path,
+// while priming) is the only writer and the mixing thread the only reader,
+// each owning one position
+// ---------------------------------------------------------------------------
+
+class ReadAheadStream
+{
+public:
+
+	// Standard constructor
+	ReadAheadStream() = default;
+
+	// Copy constructor - NOT USED
+	ReadAheadStream(ReadAheadStream&) = delete;
+
+	// Contiguous decoded frames ready to mix.  Mixing thread only.  Sets
+	// at_end when the stream has no more frames to come
+	size_t peek(const float*& frames_out, bool& at_end) const;
+
+	// Mark frames returned by peek() as mixed, waking the decode thread when
+	// the buffer runs low.  Mixing thread only
+	void consume(size_t frames);
+
+	// Count a mix pass that wanted more frames than were ready
+	void starved(size_t frames);
+
+private: // functions
+
+	friend class AltsoundReadAhead;
+
+	// decode up to max_frames into free space.  Returns the frames decoded
+	size_t fill(size_t max_frames);
+
+private: // data
+
+	AltsoundReadAhead* owner = nullptr;
+	ma_decoder* decoder = nullptr;
+	uint32_t channels = 0;
+	bool looping = false;
+
+	std::vector<float> ring;
+	uint64_t capacity = 0; // in frames
+
+	std::atomic<uint64_t> write_pos{ 0 }; // frames decoded, owned by the writer
+	std::atomic<uint64_t> read_pos{ 0 };  // frames mixed, owned by the mixing thread
+	std::atomic<bool> eof{ false };       // no frames after write_pos
+	std::atomic<bool> wake_pending{ false };
+};
+
+// ---------------------------------------------------------------------------
+// AltsoundReadAhead class definition
+//
+// Owns the decode thread and the pool of streams.  open(), rewind() and
+// close() come from the command path, which the processors serialize
+// ---------------------------------------------------------------------------
+
+class AltsoundReadAhead
+{
+public:
+
+	// Standard constructor
+	explicit AltsoundReadAhead(AltsoundTrace& trace_in);
+
+	// Copy constructor - NOT USED
+	AltsoundReadAhead(AltsoundReadAhead&) = delete;
+
+	// Destructor
+	~AltsoundReadAhead();
+
+	// Reset the counters, size the stream pool and ring buffers and start the
+	// decode thread
+	void start(uint32_t sample_rate_in, uint32_t buffer_ms, unsigned int stream_count);
+
+	// Join the decode thread.  All streams must be closed
+	void stop();
+
+	// Determine if the decode thread is running
+	bool isRunning() const;
+
+	// Stream an open decoder, positioned at its first frame.  The stream is
+	// primed before this returns
+	ReadAheadStream* open(ma_decoder* decoder_in, uint32_t channels_in, bool looping_in);
+
+	// Move a stream back to its first frame.  Its voice must not be playing
+	void rewind(ReadAheadStream* stream);
+
+	// Stop streaming and return the stream to the pool.  Its voice must be
+	// cleared first.  The decoder stays open
+	void close(ReadAheadStream* stream);
+
+	// Get the counters
+	ReadAheadStats getStats() const;
+
+private: // functions
+
+	friend class ReadAheadStream;
+
+	// thread entry point
+	void threadProc();
+
+	// give every stream with free space one chunk. Returns true if any was
+	// decoded
+	bool fillPass();
+
+	// wake the decode thread.  Safe from the mixing thread
+	void wake();
+
+	// wait until the decode thread is not filling a stream.  Holds lock
+	void waitNotFilling(std::unique_lock<std::mutex>& lock, const ReadAheadStream* stream);
+
+private: // data
+
+	AltsoundTrace& trace;
+	AltsoundObjectPool<ReadAheadStream> pool;
+	uint64_t capacity_frames = 0;
+
+	// streams the decode thread fills, and the one it is filling now
+	mutable std::mutex mutex;
+	std::condition_variable filled_cv;
+	std::vector<ReadAheadStream*> streams;
+	std::vector<ReadAheadStream*> pass_streams;
+	const ReadAheadStream* filling = nullptr;
+
+	std::thread thread;
+	std::atomic<uint32_t> wake_seq{ 0 };
+	std::atomic<bool> running{ false };
+
+	std::atomic<uint64_t> opened{ 0 };
+	std::atomic<uint64_t> decoded_frames{ 0 };
+	std::atomic<uint64_t> min_fill_frames{ UINT64_MAX };
+	std::atomic<uint64_t> starvations{ 0 };
+	std::atomic<uint64_t> starved_frames{ 0 };
+};
+
+// ----------------------------------------------------------------------------
+// Inline functions
+// ----------------------------------------------------------------------------
+
+inline bool AltsoundReadAhead::isRunning() const {
+	return running.load(std::memory_order_acquire);
+}
+
+#endif // ALTSOUND_READ_AHEAD_HPP
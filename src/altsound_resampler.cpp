@@ -0,0 +1,177 @@
+// ---------------------------------------------------------------------------
+// altsound_resampler.cpp
+//
+// Load-time sample rate conversion
+// ---------------------------------------------------------------------------
+// license:BSD-3-Clause
+// ---------------------------------------------------------------------------
+
+#include "altsound_resampler.hpp"
+#include "miniaudio_private.h"
+
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+
+// Windowed-sinc filter shape.  16 zero crossings per side with a Kaiser beta
+// of 8 attenuate the stopband by about 80 dB, and the passband ends at 95% of
+// the lower Nyquist frequency
+#define SINC_ZERO_CROSSINGS 16
+#define SINC_MAX_PHASES 1024
+static const double SINC_KAISER_BETA = 8.0;
+static const double SINC_PASSBAND = 0.95;
+static const double PI = 3.14159265358979323846;
+
+// Polyphase windowed-sinc filter: one row of taps per output phase
+struct SincFilter {
+	uint64_t up = 1;       // output rate / gcd
+	uint64_t down = 1;     // input rate / gcd
+	unsigned int half = 0; // taps on each side of the output position
+	unsigned int phases = 0;
+	std::vector<float> coeffs;
+};
+
+// ---------------------------------------------------------------------------
+// Helper functions
+// ---------------------------------------------------------------------------
+
+// Modified Bessel function of the first kind, order 0
+static double besselI0(double x)
+{
+	double sum = 1.0;
+	double term = 1.0;
+	for (int k = 1; k < 64; ++k) {
+		const double f = x / (2.0 * k);
+		term *= f * f;
+		sum += term;
+		if (term < sum * 1e-12)
+			break;
+	}
+	return sum;
+}
+
+// ---------------------------------------------------------------------------
+
+static void buildSincFilter(uint32_t in_rate, uint32_t out_rate, SincFilter& filter)
+{
+	const uint64_t g = std::gcd(in_rate, out_rate);
+	filter.up = out_rate / g;
+	filter.down = in_rate / g;
+
+	// below the output Nyquist frequency when downsampling
+	const double cutoff = SINC_PASSBAND * std::min(1.0, static_cast<double>(out_rate) / in_rate);
+	filter.half = static_cast<unsigned int>(std::ceil(SINC_ZERO_CROSSINGS / cutoff));
+
+	// exact phases for common rate pairs, else the nearest of SINC_MAX_PHASES
+	filter.phases = static_cast<unsigned int>(std::min<uint64_t>(filter.up, SINC_MAX_PHASES));
+
+	const unsigned int taps = filter.half * 2;
+	const double i0_beta = besselI0(SINC_KAISER_BETA);
+	filter.coeffs.resize(static_cast<size_t>(filter.phases) * taps);
+	std::vector<double> h(taps);
+
+	for (unsigned int p = 0; p < filter.phases; ++p) {
+		float* row = &filter.coeffs[static_cast<size_t>(p) * taps];
+		const double frac = static_cast<double>(p) / filter.phases;
+		double sum = 0.0;
+
+		for (unsigned int t = 0; t < taps; ++t) {
+			// distance from the output position to input frame first + t
+			const double x = static_cast<double>(t) - (filter.half - 1) - frac;
+			const double r = x / filter.half;
+			const double window = r * r < 1.0 ? besselI0(SINC_KAISER_BETA * std::sqrt(1.0 - r * r)) / i0_beta : 0.0;
+			const double y = cutoff * x;
+			const double sinc = y == 0.0 ? 1.0 : std::sin(PI * y) / (PI * y);
+			h[t] = cutoff * sinc * window;
+			sum += h[t];
+		}
+
+		// unity gain at DC for every phase
+		for (unsigned int t = 0; t < taps; ++t)
+			row[t] = static_cast<float>(h[t] / sum);
+	}
+}
+
+// ---------------------------------------------------------------------------
+
+static void resampleSinc(const float* in, uint64_t in_frames, uint32_t channels, const SincFilter& filter,
+                         std::vector<float>& out)
+{
+	const uint64_t out_frames = (in_frames * filter.up + filter.down - 1) / filter.down;
+	const unsigned int taps = filter.half * 2;
+	out.assign(static_cast<size_t>(out_frames * channels), 0.0f);
+
+	for (uint64_t n = 0; n < out_frames; ++n) {
+		const uint64_t pos = n * filter.down;
+		const uint64_t i = pos / filter.up;
+		const uint64_t rem = pos % filter.up;
+		const uint64_t phase = filter.phases == filter.up ? rem : rem * filter.phases / filter.up;
+		const float* row = &filter.coeffs[static_cast<size_t>(phase) * taps];
+		float* dst = &out[static_cast<size_t>(n * channels)];
+
+		// input frames the taps cover, clipped to the sample
+		const int64_t first = static_cast<int64_t>(i) - (filter.half - 1);
+		const unsigned int t_begin = first < 0 ? static_cast<unsigned int>(-first) : 0;
+		const unsigned int t_end = static_cast<unsigned int>(std::min<int64_t>(taps, static_cast<int64_t>(in_frames) - first));
+
+		for (uint32_t c = 0; c < channels; ++c) {
+			const float* src = in + (first + t_begin) * static_cast<int64_t>(channels) + c;
+			float acc = 0.0f;
+			for (unsigned int t = t_begin; t < t_end; ++t, src += channels)
+				acc += *src * row[t];
+			dst[c] = acc;
+		}
+	}
+}
+
+// ---------------------------------------------------------------------------
+// Resampling
+// ---------------------------------------------------------------------------
+
+const char* altsound_resample_quality_name(AltsoundResampleQuality quality)
+{
+	return quality == ALT_RESAMPLE_SINC ? "sinc" : "linear";
+}
+
+// ---------------------------------------------------------------------------
+
+bool altsound_parse_resample_quality(const std::string& name, AltsoundResampleQuality& quality_out)
+{
+	if (name == "linear")
+		quality_out = ALT_RESAMPLE_LINEAR;
+	else if (name == "sinc")
+		quality_out = ALT_RESAMPLE_SINC;
+	else
+		return false;
+
+	return true;
+}
+
+// ---------------------------------------------------------------------------
+
+bool altsound_resample(const float* in, uint64_t in_frames, uint32_t channels, uint32_t in_rate,
+                       uint32_t out_rate, AltsoundResampleQuality quality, std::vector<float>& out)
+{
+	if (!in || in_frames == 0 || channels == 0 || in_rate == 0 || out_rate == 0)
+		return false;
+
+	if (in_rate == out_rate) {
+		out.assign(in, in + in_frames * channels);
+		return true;
+	}
+
+	if (quality == ALT_RESAMPLE_SINC) {
+		SincFilter filter;
+		buildSincFilter(in_rate, out_rate, filter);
+		resampleSinc(in, in_frames, channels, filter, out);
+		return !out.empty();
+	}
+
+	ma_uint64 out_frames = (in_frames * out_rate + in_rate - 1) / in_rate + 1;
+	out.resize(static_cast<size_t>(out_frames * channels));
+	if (altsound_ma_resample_linear_f32(channels, in_rate, out_rate, in, in_frames, out.data(), &out_frames) != MA_SUCCESS)
+		return false;
+
+	out.resize(static_cast<size_t>(out_frames * channels));
+	return out_frames > 0;
+}
@@ -0,0 +1,39 @@
+// ---------------------------------------------------------------------------
+// altsound_resampler.hpp
+//
+// Load-time sample rate conversion.  Samples are converted once to the output
+// rate as they enter memory, so playback never resamples
+// ---------------------------------------------------------------------------
+// license:BSD-3-Clause
+// ---------------------------------------------------------------------------
+
+#ifndef ALTSOUND_RESAMPLER_HPP
+#define ALTSOUND_RESAMPLER_HPP
+#if !defined(__GNUC__) || (__GNUC__ == 3 && __GNUC_MINOR__ >= 4) || (__GNUC__ >= 4)	// GCC supports "pragma once" correctly since 3.4
+#pragma once
+#endif
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+enum AltsoundResampleQuality {
+	ALT_RESAMPLE_LINEAR = 0, // miniaudio's linear resampler, as streamed samples use
+	ALT_RESAMPLE_SINC        // Kaiser-windowed sinc, 16 zero crossings per side
+};
+
+// Quality used when altsound.ini does not specify one
+#define ALT_RESAMPLE_QUALITY_DEFAULT ALT_RESAMPLE_SINC
+
+// Name of a quality, as written in altsound.ini
+const char* altsound_resample_quality_name(AltsoundResampleQuality quality);
+
+// Parse a quality name. Returns false for unknown names
+bool altsound_parse_resample_quality(const std::string& name, AltsoundResampleQuality& quality_out);
+
+// Convert interleaved float frames from in_rate to out_rate. Returns false
+// on failure.  Equal rates copy the input
+bool altsound_resample(const float* in, uint64_t in_frames, uint32_t channels, uint32_t in_rate,
+                       uint32_t out_rate, AltsoundResampleQuality quality, std::vector<float>& out);
+
+#endif // ALTSOUND_RESAMPLER_HPP
@@ -0,0 +1,161 @@
+// ---------------------------------------------------------------------------
+// altsound_sample_cache.cpp
+//
+// Process-wide, byte-budgeted LRU cache of fully decoded sample PCM
+// ---------------------------------------------------------------------------
+// license:BSD-3-Clause
+// ---------------------------------------------------------------------------
+
+#include "altsound_sample_cache.hpp"
+
+#include <algorithm>
+
+// ----------------------------------------------------------------------------
+// Functional code
+// ----------------------------------------------------------------------------
+
+void AltsoundSampleCache::setBudget(size_t bytes_in)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+
+	budget = bytes_in;
+	evict(0);
+}
+
+// ----------------------------------------------------------------------------
+
+CachedSamplePtr AltsoundSampleCache::find(const std::string& path_in)
+{
+	const std::string key = normalizePath(path_in);
+
+	std::lock_guard<std::mutex> lock(mutex);
+
+	const auto it = index.find(key);
+	if (it == index.end()) {
+		++misses;
+		return nullptr;
+	}
+
+	// move to the front of the LRU list
+	lru.splice(lru.begin(), lru, it->second);
+	++hits;
+
+	return it->second->sample;
+}
+
+// ----------------------------------------------------------------------------
+
+bool AltsoundSampleCache::contains(const std::string& path_in) const
+{
+	const std::string key = normalizePath(path_in);
+
+	std::lock_guard<std::mutex> lock(mutex);
+	return index.find(key) != index.end();
+}
+
+// ----------------------------------------------------------------------------
+
+bool AltsoundSampleCache::insert(const std::string& path_in, CachedSamplePtr sample_in, bool allow_evict)
+{
+	if (!sample_in)
+		return false;
+
+	const std::string key = normalizePath(path_in);
+	const size_t sample_bytes = sample_in->bytes();
+
+	std::lock_guard<std::mutex> lock(mutex);
+
+	if (sample_bytes > budget)
+		return false;
+
+	if (!allow_evict && bytes + sample_bytes > budget)
+		return false;
+
+	// replace an existing entry for the same sample
+	const auto it = index.find(key);
+	if (it != index.end()) {
+		bytes -= it->second->sample->bytes();
+		lru.erase(it->second);
+		index.erase(it);
+	}
+
+	evict(sample_bytes);
+
+	lru.push_front({ key, std::move(sample_in) });
+	index[key] = lru.begin();
+	bytes += sample_bytes;
+	++insertions;
+
+	return true;
+}
+
+// ----------------------------------------------------------------------------
+
+void AltsoundSampleCache::clear()
+{
+	std::lock_guard<std::mutex> lock(mutex);
+
+	index.clear();
+	lru.clear();
+	bytes = 0;
+	hits = 0;
+	misses = 0;
+	insertions = 0;
+	evictions = 0;
+}
+
+// ----------------------------------------------------------------------------
+
+SampleCacheStats AltsoundSampleCache::getStats() const
+{
+	std::lock_guard<std::mutex> lock(mutex);
+
+	SampleCacheStats stats;
+	stats.hits = hits;
+	stats.misses = misses;
+	stats.insertions = insertions;
+	stats.evictions = evictions;
+	stats.entries = index.size();
+	stats.bytes = bytes;
+	stats.budget = budget;
+	return stats;
+}
+
+// ----------------------------------------------------------------------------
+// Helper function to normalize sample paths used as cache keys.  The CSV
+// parsers already convert to forward slashes, so in the common case this is
+// just a copy
+// ----------------------------------------------------------------------------
+
+std::string AltsoundSampleCache::normalizePath(const std::string& path_in)
+{
+	std::string key = path_in;
+	std::replace(key.begin(), key.end(), '\\', '/');
+
+	// collapse duplicate separators
+	key.erase(std::unique(key.begin(), key.end(), [](char a, char b) {
+		return a == '/' && b == '/';
+	}), key.end());
+
+	// drop "./" path segments
+	size_t pos;
+	while ((pos = key.find("/./")) != std::string::npos)
+		key.erase(pos, 2);
+
+	return key;
+}
+
+// ----------------------------------------------------------------------------
+// Must be called with the mutex held
+// ----------------------------------------------------------------------------
+
+void AltsoundSampleCache::evict(size_t bytes_needed)
+{
+	while (!lru.empty() && bytes + bytes_needed > budget) {
+		const Entry& victim = lru.back();
+		bytes -= victim.sample->bytes();
+		index.erase(victim.key);
+		lru.pop_back();
+		++evictions;
+	}
+}
@@ -0,0 +1,140 @@
+// ---------------------------------------------------------------------------
+// altsound_sample_cache.hpp
+//
+// Byte-budgeted LRU cache of fully decoded sample PCM, one per context.
+// Entries are converted once to the context's output format (f32 at its
+// sample rate, mono or its channel count) so a cache hit plays straight from
+// memory without file I/O, decoding or resampling
+// ---------------------------------------------------------------------------
+// license:BSD-3-Clause
+// ---------------------------------------------------------------------------
+
+#ifndef ALTSOUND_SAMPLE_CACHE_HPP
+#define ALTSOUND_SAMPLE_CACHE_HPP
+#if !defined(__GNUC__) || (__GNUC__ == 3 && __GNUC_MINOR__ >= 4) || (__GNUC__ >= 4)	// GCC supports "pragma once" correctly since 3.4
+#pragma once
+#endif
+
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Default cache budget, used when altsound.ini does not specify one
+#define ALT_SAMPLE_CACHE_DEFAULT_MB 64
+
+// Longest sample decoded into the cache on the command path, when it is
+// first played.  Longer samples are only cached by the preloader
+#define ALT_SAMPLE_CACHE_ON_PLAY_MAX_MS 500
+
+// Fully decoded sample data in interleaved f32 frames
+struct CachedSample {
+	std::vector<float> pcm;
+	uint64_t frame_count = 0;
+	uint32_t channels = 0;
+	uint32_t sample_rate = 0;
+
+	size_t bytes() const { return pcm.size() * sizeof(float); }
+};
+
+// Entries are shared with the streams playing them, so an evicted entry stays
+// alive until the last stream using it is freed
+typedef std::shared_ptr<const CachedSample> CachedSamplePtr;
+
+struct SampleCacheStats {
+	uint64_t hits = 0;
+	uint64_t misses = 0;
+	uint64_t insertions = 0;
+	uint64_t evictions = 0;
+	uint64_t entries = 0;
+	uint64_t bytes = 0;
+	uint64_t budget = 0;
+};
+
+// ---------------------------------------------------------------------------
+// AltsoundSampleCache class definition
+// ---------------------------------------------------------------------------
+
+class AltsoundSampleCache
+{
+public:
+
+	// Standard constructor
+	AltsoundSampleCache() = default;
+
+	// Copy constructor - NOT USED
+	AltsoundSampleCache(AltsoundSampleCache&) = delete;
+
+	// Set the byte budget, evicting entries as needed. 0 disables the cache
+	void setBudget(size_t bytes_in);
+	size_t getBudget() const;
+
+	// Largest single entry accepted. Anything bigger is streamed from disk
+	size_t getMaxEntryBytes() const;
+
+	// Look up decoded PCM for the provided sample path. Counts a hit or miss
+	CachedSamplePtr find(const std::string& path_in);
+
+	// Determine if the provided sample path is cached. Does not affect LRU
+	// order or hit/miss counters
+	bool contains(const std::string& path_in) const;
+
+	// Store decoded PCM for the provided sample path. When allow_evict is
+	// false, the insert fails instead of evicting other entries
+	bool insert(const std::string& path_in, CachedSamplePtr sample_in, bool allow_evict = true);
+
+	// Drop all entries and reset counters
+	void clear();
+
+	// Snapshot of the cache counters
+	SampleCacheStats getStats() const;
+
+	// Convert a sample path to the form used as a cache key
+	static std::string normalizePath(const std::string& path_in);
+
+private: // functions
+
+	// evict least-recently-used entries until bytes_needed fit in the budget
+	void evict(size_t bytes_needed);
+
+private: // data
+
+	struct Entry {
+		std::string key;
+		CachedSamplePtr sample;
+	};
+
+	mutable std::mutex mutex;
+	std::list<Entry> lru; // front is most recently used
+	std::unordered_map<std::string, std::list<Entry>::iterator> index;
+
+	size_t budget = 0;
+	size_t bytes = 0;
+
+	uint64_t hits = 0;
+	uint64_t misses = 0;
+	uint64_t insertions = 0;
+	uint64_t evictions = 0;
+};
+
+// ----------------------------------------------------------------------------
+// Inline functions
+// ----------------------------------------------------------------------------
+
+inline size_t AltsoundSampleCache::getBudget() const {
+	std::lock_guard<std::mutex> lock(mutex);
+	return budget;
+}
+
+// ----------------------------------------------------------------------------
+
+inline size_t AltsoundSampleCache::getMaxEntryBytes() const {
+	// Keep long music tracks out of the cache.  A single entry may use at
+	// most a quarter of the budget
+	return getBudget() / 4;
+}
+
+#endif // ALTSOUND_SAMPLE_CACHE_HPP
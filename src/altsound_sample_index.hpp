@@ -0,0 +1,154 @@
+// ---------------------------------------------------------------------------
+// altsound_sample_index.hpp
+//
+// Constant-time lookup from a sound command ID to the samples it can play
+// ---------------------------------------------------------------------------
+// license:BSD-3-Clause
+// ---------------------------------------------------------------------------
+
+#ifndef ALTSOUND_SAMPLE_INDEX_HPP
+#define ALTSOUND_SAMPLE_INDEX_HPP
+#if !defined(__GNUC__) || (__GNUC__ == 3 && __GNUC_MINOR__ >= 4) || (__GNUC__ >= 4)	// GCC supports "pragma once" correctly since 3.4
+#pragma once
+#endif
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+// Samples for one command ID: sample array indices [first, first + count)
+struct SampleRange {
+	unsigned int first = 0;
+	unsigned int count = 0;
+};
+
+// One command ID and its samples
+struct SampleIndexEntry {
+	unsigned int id = 0;
+	SampleRange range; // empty slot when count is 0
+};
+
+// ---------------------------------------------------------------------------
+// AltsoundSampleIndex class definition
+//
+// Open-addressing hash table (linear probing, at most half full) from command
+// ID to a contiguous range of a sample array sorted by ID.  Built once at
+// load time; lookups do not allocate
+// ---------------------------------------------------------------------------
+
+class AltsoundSampleIndex
+{
+public:
+
+	// Standard constructor
+	AltsoundSampleIndex() = default;
+
+	// Sort samples by ID, keeping the file order of samples that share an
+	// ID, and index the result.  SampleInfo needs an unsigned int "id" member
+	template<typename SampleInfo>
+	void build(std::vector<SampleInfo>& samples_in);
+
+	// Index ranges of a sample array that is already sorted by ID, such as
+	// the index table of a sample pack.  IDs must be unique
+	void assign(const std::vector<SampleIndexEntry>& entries_in);
+
+	// Find the samples for a command ID.  count is 0 if there are none
+	SampleRange find(unsigned int id_in) const;
+
+	// Number of distinct command IDs
+	size_t size() const;
+
+private: // functions
+
+	// home slot for an ID
+	size_t slot(unsigned int id_in) const;
+
+private: // data
+
+	std::vector<SampleIndexEntry> table;
+	size_t mask = 0;
+	unsigned int shift = 32;
+	size_t id_count = 0;
+};
+
+// ----------------------------------------------------------------------------
+// Inline functions
+// ----------------------------------------------------------------------------
+
+template<typename SampleInfo>
+inline void AltsoundSampleIndex::build(std::vector<SampleInfo>& samples_in) {
+	std::stable_sort(samples_in.begin(), samples_in.end(),
+		[](const SampleInfo& a, const SampleInfo& b) { return a.id < b.id; });
+
+	// collect the run of each ID
+	std::vector<SampleIndexEntry> runs;
+	for (size_t i = 0; i < samples_in.size(); ) {
+		size_t end = i + 1;
+		while (end < samples_in.size() && samples_in[end].id == samples_in[i].id)
+			++end;
+
+		SampleIndexEntry run;
+		run.id = samples_in[i].id;
+		run.range.first = static_cast<unsigned int>(i);
+		run.range.count = static_cast<unsigned int>(end - i);
+		runs.push_back(run);
+		i = end;
+	}
+
+	assign(runs);
+}
+
+// ----------------------------------------------------------------------------
+
+inline void AltsoundSampleIndex::assign(const std::vector<SampleIndexEntry>& entries_in) {
+	unsigned int bits = 4;
+	while ((size_t(1) << bits) < entries_in.size() * 2)
+		++bits;
+
+	table.assign(size_t(1) << bits, SampleIndexEntry());
+	mask = table.size() - 1;
+	shift = 32 - bits;
+	id_count = 0;
+
+	for (const SampleIndexEntry& entry : entries_in) {
+		if (entry.range.count == 0)
+			continue;
+
+		size_t pos = slot(entry.id);
+		while (table[pos].range.count != 0)
+			pos = (pos + 1) & mask;
+		table[pos] = entry;
+		++id_count;
+	}
+}
+
+// ----------------------------------------------------------------------------
+
+inline SampleRange AltsoundSampleIndex::find(unsigned int id_in) const {
+	if (table.empty())
+		return SampleRange();
+
+	for (size_t pos = slot(id_in); ; pos = (pos + 1) & mask) {
+		const SampleIndexEntry& entry = table[pos];
+		if (entry.range.count == 0)
+			return SampleRange();
+		if (entry.id == id_in)
+			return entry.range;
+	}
+}
+
+// ----------------------------------------------------------------------------
+
+inline size_t AltsoundSampleIndex::size() const {
+	return id_count;
+}
+
+// ----------------------------------------------------------------------------
+
+inline size_t AltsoundSampleIndex::slot(unsigned int id_in) const {
+	// Fibonacci hashing: the top bits of the product spread the clustered
+	// command IDs over the table
+	return static_cast<size_t>((static_cast<uint32_t>(id_in) * 2654435769u) >> shift) & mask;
+}
+
+#endif // ALTSOUND_SAMPLE_INDEX_HPP
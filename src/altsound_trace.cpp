@@ -0,0 +1,187 @@
+// ---------------------------------------------------------------------------
+// altsound_trace.cpp
+//
+// Opt-in event tracing in the Chrome trace event format
+// ---------------------------------------------------------------------------
+// license:BSD-3-Clause
+// ---------------------------------------------------------------------------
+
+#include "altsound_trace.hpp"
+
+#include <algorithm>
+#include <cstdio>
+
+// Sessions are numbered across all traces, so a thread's buffers are told
+// apart when it records into more than one context's trace
+static std::atomic<uint32_t> g_lastSession{ 0 };
+
+// The calling thread's buffers, valid while their session is current.  A
+// thread driving several contexts keeps one per trace
+struct ThreadBufferCache {
+	uint32_t session = 0;
+	TraceThreadBuffer* buffer = nullptr;
+};
+static thread_local ThreadBufferCache tl_buffers[ALT_TRACE_THREAD_CACHE];
+static thread_local uint32_t tl_next_entry = 0;
+
+// Identifies the calling thread as a buffer owner.  0 means not assigned yet
+static std::atomic<uint32_t> g_lastThreadId{ 0 };
+static thread_local uint32_t tl_thread_id = 0;
+
+// ----------------------------------------------------------------------------
+// Functional code
+// ----------------------------------------------------------------------------
+
+void AltsoundTrace::start()
+{
+	enabled.store(false, std::memory_order_release);
+
+	for (uint32_t i = 0; i < ALT_TRACE_MAX_THREADS; ++i) {
+		TraceThreadBuffer& buffer = buffers[i];
+		if (!buffer.events)
+			buffer.events.reset(new TraceEvent[ALT_TRACE_EVENTS_PER_THREAD]);
+
+		buffer.count.store(0, std::memory_order_relaxed);
+		buffer.dropped.store(0, std::memory_order_relaxed);
+		buffer.name.store(nullptr, std::memory_order_relaxed);
+		buffer.owner.store(0, std::memory_order_relaxed);
+		buffer.tid = i + 1;
+	}
+
+	next_buffer.store(0, std::memory_order_relaxed);
+	start_ns = now();
+
+	// session 0 is never current, so fresh threads always claim a buffer
+	uint32_t next_session;
+	do {
+		next_session = g_lastSession.fetch_add(1, std::memory_order_relaxed) + 1;
+	} while (next_session == 0);
+	session.store(next_session, std::memory_order_release);
+
+	enabled.store(true, std::memory_order_release);
+}
+
+// ----------------------------------------------------------------------------
+
+void AltsoundTrace::stop()
+{
+	enabled.store(false, std::memory_order_release);
+}
+
+// ----------------------------------------------------------------------------
+
+TraceThreadBuffer* AltsoundTrace::threadBuffer()
+{
+	const uint32_t current = session.load(std::memory_order_acquire);
+	for (const ThreadBufferCache& entry : tl_buffers) {
+		if (entry.session == current)
+			return entry.buffer;
+	}
+
+	if (tl_thread_id == 0)
+		tl_thread_id = g_lastThreadId.fetch_add(1, std::memory_order_relaxed) + 1;
+
+	// replace the oldest entry
+	ThreadBufferCache& entry = tl_buffers[tl_next_entry];
+	tl_next_entry = (tl_next_entry + 1) % ALT_TRACE_THREAD_CACHE;
+	entry.session = current;
+
+	// the entry may have been evicted by other traces: reuse the buffer this
+	// thread already claimed in the session instead of claiming another
+	const uint32_t claimed = std::min<uint32_t>(next_buffer.load(std::memory_order_acquire), ALT_TRACE_MAX_THREADS);
+	for (uint32_t i = 0; i < claimed; ++i) {
+		if (buffers[i].owner.load(std::memory_order_relaxed) == tl_thread_id) {
+			entry.buffer = &buffers[i];
+			return entry.buffer;
+		}
+	}
+
+	const uint32_t index = next_buffer.fetch_add(1, std::memory_order_relaxed);
+	entry.buffer = index < ALT_TRACE_MAX_THREADS ? &buffers[index] : nullptr;
+	if (entry.buffer)
+		entry.buffer->owner.store(tl_thread_id, std::memory_order_relaxed);
+	return entry.buffer;
+}
+
+// ----------------------------------------------------------------------------
+
+void AltsoundTrace::record(const TraceEvent& event)
+{
+	TraceThreadBuffer* buffer = threadBuffer();
+	if (!buffer)
+		return;
+
+	const uint32_t count = buffer->count.load(std::memory_order_relaxed);
+	if (count >= ALT_TRACE_EVENTS_PER_THREAD) {
+		buffer->dropped.fetch_add(1, std::memory_order_relaxed);
+		return;
+	}
+
+	buffer->events[count] = event;
+	buffer->count.store(count + 1, std::memory_order_release);
+}
+
+// ----------------------------------------------------------------------------
+
+void AltsoundTrace::setThreadName(const char* name)
+{
+	if (!isEnabled())
+		return;
+
+	TraceThreadBuffer* buffer = threadBuffer();
+	if (buffer && !buffer->name.load(std::memory_order_relaxed))
+		buffer->name.store(name, std::memory_order_release);
+}
+
+// ----------------------------------------------------------------------------
+
+bool AltsoundTrace::write(const string& path) const
+{
+	FILE* out = fopen(path.c_str(), "w");
+	if (!out)
+		return false;
+
+	fprintf(out, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+	fprintf(out, "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"args\":{\"name\":\"altsound\"}}");
+
+	const uint32_t claimed = next_buffer.load(std::memory_order_acquire);
+	for (uint32_t i = 0; i < claimed && i < ALT_TRACE_MAX_THREADS; ++i) {
+		const TraceThreadBuffer& buffer = buffers[i];
+
+		const char* name = buffer.name.load(std::memory_order_acquire);
+		if (name) {
+			fprintf(out, ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":\"%s\"}}",
+				buffer.tid, name);
+		}
+
+		const uint32_t count = buffer.count.load(std::memory_order_acquire);
+		for (uint32_t e = 0; e < count; ++e) {
+			const TraceEvent& event = buffer.events[e];
+			const double ts_us = static_cast<double>(event.ts_ns - start_ns) / 1000.0;
+
+			fprintf(out, ",\n{\"name\":\"%s\",\"ph\":\"%c\",\"pid\":1,\"tid\":%u,\"ts\":%.3f",
+				event.name, event.phase, buffer.tid, ts_us);
+
+			if (event.phase == 'X')
+				fprintf(out, ",\"dur\":%.3f", static_cast<double>(event.dur_ns) / 1000.0);
+			else
+				fprintf(out, ",\"s\":\"t\"");
+
+			if (event.arg_name)
+				fprintf(out, ",\"args\":{\"%s\":%u}", event.arg_name, event.arg);
+
+			fprintf(out, "}");
+		}
+
+		const uint32_t dropped = buffer.dropped.load(std::memory_order_relaxed);
+		if (dropped) {
+			fprintf(out, ",\n{\"name\":\"events dropped\",\"ph\":\"i\",\"s\":\"t\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"args\":{\"count\":%u}}",
+				buffer.tid, count ? static_cast<double>(buffer.events[count - 1].ts_ns - start_ns) / 1000.0 : 0.0, dropped);
+		}
+	}
+
+	fprintf(out, "\n]}\n");
+	const bool ok = !ferror(out);
+	fclose(out);
+	return ok;
+}
@@ -0,0 +1,205 @@
+// ---------------------------------------------------------------------------
+// altsound_trace.hpp
+//
+// Opt-in event tracing.  Spans and instant events are recorded per thread
+// and written in the Chrome trace event format, which chrome://tracing and
+// Perfetto load directly
+// ---------------------------------------------------------------------------
+// license:BSD-3-Clause
+// ---------------------------------------------------------------------------
+
+#ifndef ALTSOUND_TRACE_HPP
+#define ALTSOUND_TRACE_HPP
+#if !defined(__GNUC__) || (__GNUC__ == 3 && __GNUC_MINOR__ >= 4) || (__GNUC__ >= 4)	// GCC supports "pragma once" correctly since 3.4
+#pragma once
+#endif
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+using std::string;
+
+// Most threads that can record events in one session
+#define ALT_TRACE_MAX_THREADS 16
+
+// Traces a thread remembers its buffer for.  Beyond that, its buffer is
+// looked up in the trace by thread id
+#define ALT_TRACE_THREAD_CACHE 4
+
+// Events each thread can record before further events are dropped
+#define ALT_TRACE_EVENTS_PER_THREAD 32768
+
+// A recorded event.  Names are string literals
+struct TraceEvent {
+	const char* name = nullptr;
+	const char* arg_name = nullptr; // nullptr when the event has no argument
+	uint64_t ts_ns = 0;
+	uint64_t dur_ns = 0;            // spans only
+	uint32_t arg = 0;
+	char phase = 'X';               // 'X' complete span, 'i' instant
+};
+
+// Events recorded by one thread.  Only the owning thread appends; count is
+// published with release ordering, so write() can run at any time
+struct TraceThreadBuffer {
+	std::atomic<uint32_t> count{ 0 };
+	std::atomic<uint32_t> dropped{ 0 };
+	std::atomic<const char*> name{ nullptr };
+	std::atomic<uint32_t> owner{ 0 }; // id of the claiming thread, 0 when unclaimed
+	uint32_t tid = 0;
+	std::unique_ptr<TraceEvent[]> events;
+};
+
+// ---------------------------------------------------------------------------
+// AltsoundTrace class definition
+//
+// Recording never blocks or allocates: buffers are allocated by start() and
+// a thread claims one with an atomic increment on its first event.  A thread
+// keeps its buffer for the session, however many traces it alternates
+// between.  When tracing is off, recording is a single relaxed load
+// ---------------------------------------------------------------------------
+
+class AltsoundTrace
+{
+public:
+
+	// Standard constructor
+	AltsoundTrace() = default;
+
+	// Copy constructor - NOT USED
+	AltsoundTrace(AltsoundTrace&) = delete;
+
+	// Read the monotonic clock in nanoseconds
+	static uint64_t now();
+
+	// Clear previous events and start recording.  Must not be called while
+	// other threads record
+	void start();
+
+	// Stop recording.  Recorded events are kept for write()
+	void stop();
+
+	// Determine if events are being recorded
+	bool isEnabled() const;
+
+	// Record a span from start_ns until now
+	void span(const char* name, uint64_t start_ns, const char* arg_name = nullptr, uint32_t arg = 0);
+
+	// Record an instant event
+	void instant(const char* name, const char* arg_name = nullptr, uint32_t arg = 0);
+
+	// Label the calling thread on the timeline, unless it already has a label
+	void setThreadName(const char* name);
+
+	// Write everything recorded so far as a JSON trace file
+	bool write(const string& path) const;
+
+private: // functions
+
+	// get the calling thread's buffer for this session, claiming one if needed
+	TraceThreadBuffer* threadBuffer();
+
+	// append an event to the calling thread's buffer
+	void record(const TraceEvent& event);
+
+private: // data
+
+	std::atomic<bool> enabled{ false };
+	std::atomic<uint32_t> session{ 0 };
+	std::atomic<uint32_t> next_buffer{ 0 };
+	uint64_t start_ns = 0;
+	TraceThreadBuffer buffers[ALT_TRACE_MAX_THREADS];
+};
+
+// ---------------------------------------------------------------------------
+// AltsoundTraceScope class definition
+//
+// Records its lifetime as a span, if tracing was on when it was created
+// ---------------------------------------------------------------------------
+
+class AltsoundTraceScope
+{
+public:
+
+	AltsoundTraceScope(AltsoundTrace& trace_in, const char* name_in, const char* arg_name_in = nullptr, uint32_t arg_in = 0);
+
+	// Copy constructor - NOT USED
+	AltsoundTraceScope(AltsoundTraceScope&) = delete;
+
+	~AltsoundTraceScope();
+
+	// Set the argument once it is known, e.g. a created stream handle
+	void setArg(const char* arg_name_in, uint32_t arg_in);
+
+private: // data
+
+	AltsoundTrace& trace;
+	const char* name;
+	const char* arg_name;
+	uint32_t arg;
+	uint64_t start_ns;
+};
+
+// ----------------------------------------------------------------------------
+// Inline functions
+// ----------------------------------------------------------------------------
+
+inline uint64_t AltsoundTrace::now() {
+	return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+		std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+inline bool AltsoundTrace::isEnabled() const {
+	return enabled.load(std::memory_order_relaxed);
+}
+
+inline void AltsoundTrace::span(const char* name, uint64_t start_ns_in, const char* arg_name, uint32_t arg) {
+	if (!isEnabled())
+		return;
+
+	TraceEvent event;
+	event.name = name;
+	event.arg_name = arg_name;
+	event.ts_ns = start_ns_in;
+	event.dur_ns = now() - start_ns_in;
+	event.arg = arg;
+	event.phase = 'X';
+	record(event);
+}
+
+inline void AltsoundTrace::instant(const char* name, const char* arg_name, uint32_t arg) {
+	if (!isEnabled())
+		return;
+
+	TraceEvent event;
+	event.name = name;
+	event.arg_name = arg_name;
+	event.ts_ns = now();
+	event.arg = arg;
+	event.phase = 'i';
+	record(event);
+}
+
+inline AltsoundTraceScope::AltsoundTraceScope(AltsoundTrace& trace_in, const char* name_in, const char* arg_name_in, uint32_t arg_in)
+: trace(trace_in),
+  name(name_in),
+  arg_name(arg_name_in),
+  arg(arg_in),
+  start_ns(trace_in.isEnabled() ? AltsoundTrace::now() : 0)
+{
+}
+
+inline AltsoundTraceScope::~AltsoundTraceScope() {
+	if (start_ns)
+		trace.span(name, start_ns, arg_name, arg);
+}
+
+inline void AltsoundTraceScope::setArg(const char* arg_name_in, uint32_t arg_in) {
+	arg_name = arg_name_in;
+	arg = arg_in;
+}
+
+#endif // ALTSOUND_TRACE_HPP
@@ -0,0 +1,1103 @@
+// ---------------------------------------------------------------------------
+// bench.cpp
+//
+// End-to-end command-to-sound latency benchmark.  Generates synthetic
+// AltSound and G-Sound packages of short tones in a temporary directory,
+// triggers them through AltSoundProcessCommand(), and measures the time from
+// command submission until the first non-silent frame reaches the audio
+// callback.  Latency percentiles are reported per package format, sample
+// cache state (cold/warm) and hardware generation preprocessing path.
+//
+// Microbenchmarks time internal building blocks in isolation instead (among
+// them the voice mixer against the ma_engine node graph it replaced, and
+// streamed against pre-resampled playback), and
+// --verify-preprocess replays recorded cmdlogs (plus a random byte stream)
+// through the table-driven command preprocessing and the switch-based
+// implementation it replaced, for every hardware generation, and reports any
+// difference in the decoder state, volume changes or emitted commands.
+//
+// Usage:
+//   altsound_bench [-n <triggers per run>] [-b <buffer frames>] [-k]
+//   altsound_bench --micro
+//   altsound_bench --verify-preprocess [<cmdlog.txt> ...]
+//
+//   -k keeps the generated packages instead of deleting them
+// ---------------------------------------------------------------------------
+// license:BSD-3-Clause
+// ---------------------------------------------------------------------------
+
+#ifdef _WIN32
+#define NOMINMAX
+#endif
+
+#include "altsound.h"
+#include "altsound_cmd_decoder.hpp"
+#include "altsound_mixer.hpp"
+#include "altsound_resampler.hpp"
+#include "altsound_sample_index.hpp"
+#include "miniaudio_private.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#if defined(__linux__)
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+using std::string;
+namespace fs = std::filesystem;
+
+// ---------------------------------------------------------------------------
+// Benchmark settings
+// ---------------------------------------------------------------------------
+
+static const uint32_t BENCH_SAMPLE_RATE = 44100;
+static const uint32_t BENCH_CHANNELS = 2;
+static const unsigned int TONE_COUNT = 32;      // distinct sample files
+static const unsigned int TONE_FIRST_ID = 0x10; // low byte of the first tone ID
+static const unsigned int TONE_MSEC = 10;
+static const float SILENCE_THRESHOLD = 1.0e-4f;
+static const auto TRIGGER_TIMEOUT = std::chrono::milliseconds(1000);
+
+// A hardware generation and how its command bytes form a sample ID
+struct BenchGen {
+	const char* name;
+	ALTSOUND_HARDWARE_GEN gen;
+	int prefix; // first byte of a two-byte command, or -1 for 8-bit commands
+};
+
+static const BenchGen BENCH_GENS[] = {
+	{ "WPCDCS",  ALTSOUND_HARDWARE_GEN_WPCDCS,  0x01 },
+	{ "WPCDMD",  ALTSOUND_HARDWARE_GEN_WPCDMD,  -1 },
+	{ "S11",     ALTSOUND_HARDWARE_GEN_S11,     -1 },
+	{ "DEDMD32", ALTSOUND_HARDWARE_GEN_DEDMD32, -1 },
+	{ "WS",      ALTSOUND_HARDWARE_GEN_WS,      0xFF },
+	{ "GTS80",   ALTSOUND_HARDWARE_GEN_GTS80,   -1 },
+};
+
+// One benchmark run
+struct BenchRun {
+	const char* format;  // "altsound" or "g-sound"
+	const BenchGen* gen;
+	bool warm;
+};
+
+// ---------------------------------------------------------------------------
+// Audio callback: timestamps the first non-silent period after arming
+// ---------------------------------------------------------------------------
+
+static std::atomic<bool> g_armed{ false };
+static std::atomic<uint64_t> g_soundNs{ 0 };
+static std::atomic<uint32_t> g_silentPeriods{ 0 };
+
+static uint64_t benchNow()
+{
+	return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+		std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+static void benchAudioCallback(const float* samples, size_t frameCount, uint32_t sampleRate, uint32_t channels, void* userData)
+{
+	(void)sampleRate;
+	(void)userData;
+
+	const uint64_t now = benchNow();
+
+	bool silent = true;
+	for (size_t i = 0; i < frameCount * channels; ++i) {
+		if (std::fabs(samples[i]) > SILENCE_THRESHOLD) {
+			silent = false;
+			break;
+		}
+	}
+
+	if (silent) {
+		g_silentPeriods.fetch_add(1, std::memory_order_relaxed);
+		return;
+	}
+
+	g_silentPeriods.store(0, std::memory_order_relaxed);
+	if (g_armed.exchange(false))
+		g_soundNs.store(now, std::memory_order_release);
+}
+
+// ---------------------------------------------------------------------------
+// Package generation
+// ---------------------------------------------------------------------------
+
+static string toneFile(unsigned int index)
+{
+	char name[32];
+	snprintf(name, sizeof(name), "snd/tone%02u.wav", index);
+	return name;
+}
+
+// A 16-bit PCM stereo sine tone as a WAV file image
+static std::vector<char> makeToneWav(uint32_t frames, float freq)
+{
+	std::vector<int16_t> pcm(frames * BENCH_CHANNELS);
+	for (uint32_t i = 0; i < frames; ++i) {
+		const float v = 0.5f * std::sin(2.0f * 3.14159265f * freq * i / BENCH_SAMPLE_RATE);
+		for (uint32_t c = 0; c < BENCH_CHANNELS; ++c)
+			pcm[i * BENCH_CHANNELS + c] = static_cast<int16_t>(v * 32767.0f);
+	}
+
+	std::vector<char> wav;
+	auto put = [&wav](const void* p, size_t n) { wav.insert(wav.end(), static_cast<const char*>(p), static_cast<const char*>(p) + n); };
+	auto put32 = [&put](uint32_t v) { put(&v, 4); };
+	auto put16 = [&put](uint16_t v) { put(&v, 2); };
+
+	const uint32_t data_bytes = static_cast<uint32_t>(pcm.size() * sizeof(int16_t));
+	wav.reserve(44 + data_bytes);
+	put("RIFF", 4);
+	put32(36 + data_bytes);
+	put("WAVEfmt ", 8);
+	put32(16);
+	put16(1); // PCM
+	put16(BENCH_CHANNELS);
+	put32(BENCH_SAMPLE_RATE);
+	put32(BENCH_SAMPLE_RATE * BENCH_CHANNELS * sizeof(int16_t));
+	put16(BENCH_CHANNELS * sizeof(int16_t));
+	put16(16);
+	put("data", 4);
+	put32(data_bytes);
+	put(pcm.data(), data_bytes);
+	return wav;
+}
+
+// Write a 16-bit PCM stereo sine tone
+static bool writeTone(const fs::path& path, float freq)
+{
+	const std::vector<char> wav = makeToneWav(BENCH_SAMPLE_RATE * TONE_MSEC / 1000, freq);
+	std::ofstream out(path, std::ios::binary);
+	if (!out)
+		return false;
+
+	out.write(wav.data(), static_cast<std::streamsize>(wav.size()));
+	return out.good();
+}
+
+// Create <vpm>/altsound/<game>/ with tones and a CSV in the requested format.
+// Every tone is mapped under each ID prefix the benchmarked generations use
+static bool writePackage(const fs::path& game_dir, const string& format)
+{
+	std::error_code ec;
+	fs::create_directories(game_dir / "snd", ec);
+	if (ec)
+		return false;
+
+	for (unsigned int i = 0; i < TONE_COUNT; ++i) {
+		if (!writeTone(game_dir / toneFile(i), 220.0f + 40.0f * i))
+			return false;
+	}
+
+	const bool gsound = format == "g-sound";
+	std::ofstream csv(game_dir / (gsound ? "g-sound.csv" : "altsound.csv"));
+	if (gsound)
+		csv << "ID,TYPE,GAIN,DUCKING_PROFILE,FNAME\n";
+	else
+		csv << "ID,CHANNEL,DUCK,GAIN,LOOP,STOP,NAME,FNAME\n";
+
+	const unsigned int prefixes[] = { 0x00, 0x01, 0xFF };
+	for (unsigned int prefix : prefixes) {
+		for (unsigned int i = 0; i < TONE_COUNT; ++i) {
+			char id[16];
+			snprintf(id, sizeof(id), "0x%04X", (prefix << 8) | (TONE_FIRST_ID + i));
+			if (gsound)
+				csv << id << ",sfx,100,0," << toneFile(i) << "\n";
+			else
+				csv << id << ",-1,100,100,0,0,tone" << i << "," << toneFile(i) << "\n";
+		}
+	}
+	return csv.good();
+}
+
+// Set a [system] value in a generated altsound.ini
+static bool setIniValue(const fs::path& ini_path, const string& key, const string& value)
+{
+	std::ifstream in(ini_path);
+	if (!in)
+		return false;
+
+	std::stringstream out;
+	string line;
+	bool found = false;
+	while (std::getline(in, line)) {
+		if (line.compare(0, key.size(), key) == 0 && line.find('=') != string::npos) {
+			line = key + " = " + value;
+			found = true;
+		}
+		out << line << "\n";
+	}
+	in.close();
+
+	std::ofstream(ini_path) << out.str();
+	return found;
+}
+
+// Drop a sample file from the OS page cache, so the next read goes to disk
+static void evictFromPageCache(const fs::path& path)
+{
+#if defined(__linux__)
+	const int fd = open(path.string().c_str(), O_RDONLY);
+	if (fd >= 0) {
+		posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+		close(fd);
+	}
+#else
+	(void)path;
+#endif
+}
+
+// ---------------------------------------------------------------------------
+// Measurement
+// ---------------------------------------------------------------------------
+
+static double percentile(const std::vector<double>& sorted, double p)
+{
+	if (sorted.empty())
+		return 0.0;
+	const size_t idx = static_cast<size_t>(p * (sorted.size() - 1) + 0.5);
+	return sorted[std::min(idx, sorted.size() - 1)];
+}
+
+// Wait until the output has been silent for a few periods
+static void waitForSilence()
+{
+	const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(2);
+	while (g_silentPeriods.load(std::memory_order_relaxed) < 3 && std::chrono::steady_clock::now() < deadline)
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+}
+
+static bool runBenchmark(const fs::path& vpm_path, const BenchRun& run, unsigned int triggers,
+                         uint32_t buffer_frames, std::vector<double>& latencies_out, unsigned int& timeouts_out)
+{
+	const string game = run.format == string("g-sound") ? "bench_gs" : "bench_as";
+	const fs::path game_dir = vpm_path / "altsound" / game;
+	const fs::path ini_path = game_dir / "altsound.ini";
+
+	setIniValue(ini_path, "sample_cache_mb", run.warm ? "64" : "0");
+	setIniValue(ini_path, "preload_samples", run.warm ? "1" : "0");
+
+	if (!AltSoundInit(vpm_path.string(), game, BENCH_SAMPLE_RATE, BENCH_CHANNELS, buffer_frames)) {
+		std::cout << "AltSoundInit failed for " << game_dir.string() << std::endl;
+		return false;
+	}
+	AltSoundSetHardwareGen(run.gen->gen);
+	AltSoundSetAudioCallback(benchAudioCallback, nullptr);
+
+	if (run.warm) {
+		uint32_t done, total;
+		while (!AltSoundGetPreloadProgress(done, total))
+			std::this_thread::sleep_for(std::chrono::milliseconds(10));
+	}
+
+	latencies_out.clear();
+	latencies_out.reserve(triggers);
+	timeouts_out = 0;
+
+	for (unsigned int i = 0; i < triggers; ++i) {
+		const unsigned int tone = i % TONE_COUNT;
+		const unsigned int low = TONE_FIRST_ID + tone;
+
+		waitForSilence();
+		if (!run.warm)
+			evictFromPageCache(game_dir / toneFile(tone));
+
+		g_soundNs.store(0, std::memory_order_relaxed);
+		g_armed.store(true, std::memory_order_release);
+
+		const uint64_t start = benchNow();
+		if (run.gen->prefix >= 0)
+			AltSoundProcessCommand(run.gen->prefix, 0);
+		AltSoundProcessCommand(low, 0);
+
+		const auto deadline = std::chrono::steady_clock::now() + TRIGGER_TIMEOUT;
+		uint64_t sound_ns = 0;
+		while ((sound_ns = g_soundNs.load(std::memory_order_acquire)) == 0 && std::chrono::steady_clock::now() < deadline)
+			std::this_thread::yield();
+
+		if (sound_ns == 0) {
+			g_armed.store(false);
+			++timeouts_out;
+			continue;
+		}
+		latencies_out.push_back((sound_ns - start) / 1.0e6);
+	}
+
+	AltSoundShutdown();
+	return true;
+}
+
+// ---------------------------------------------------------------------------
+// Command preprocessing reference
+// ---------------------------------------------------------------------------
+
+// Every hardware generation, to cover each decoder family
+static const ALTSOUND_HARDWARE_GEN ALL_GENS[] = {
+	ALTSOUND_HARDWARE_GEN_NONE, ALTSOUND_HARDWARE_GEN_WPCALPHA_1, ALTSOUND_HARDWARE_GEN_WPCALPHA_2,
+	ALTSOUND_HARDWARE_GEN_WPCDMD, ALTSOUND_HARDWARE_GEN_WPCFLIPTRON, ALTSOUND_HARDWARE_GEN_WPCDCS,
+	ALTSOUND_HARDWARE_GEN_WPCSECURITY, ALTSOUND_HARDWARE_GEN_WPC95DCS, ALTSOUND_HARDWARE_GEN_WPC95,
+	ALTSOUND_HARDWARE_GEN_S11, ALTSOUND_HARDWARE_GEN_S11X, ALTSOUND_HARDWARE_GEN_S11B2,
+	ALTSOUND_HARDWARE_GEN_S11C, ALTSOUND_HARDWARE_GEN_DE, ALTSOUND_HARDWARE_GEN_DEDMD16,
+	ALTSOUND_HARDWARE_GEN_DEDMD32, ALTSOUND_HARDWARE_GEN_DEDMD64, ALTSOUND_HARDWARE_GEN_GTS80,
+	ALTSOUND_HARDWARE_GEN_WS, ALTSOUND_HARDWARE_GEN_WS_1, ALTSOUND_HARDWARE_GEN_WS_2,
+};
+
+// Preprocessing as the switch over the hardware generation did it before it
+// became table-driven, with logging removed and volume changes recorded
+// instead of applied
+static void legacyPreprocess(ALTSOUND_HARDWARE_GEN gen, CmdData& d, int cmd, AltsoundCmdAction& action)
+{
+	switch (gen) {
+		case ALTSOUND_HARDWARE_GEN_WPCDCS:
+		case ALTSOUND_HARDWARE_GEN_WPCSECURITY:
+		case ALTSOUND_HARDWARE_GEN_WPC95DCS:
+		case ALTSOUND_HARDWARE_GEN_WPC95: {
+			if ((d.cmd_buffer[3] == 0x55) && (d.cmd_buffer[2] >= 0xAB) && (d.cmd_buffer[2] <= 0xB0) && (d.cmd_buffer[1] == (d.cmd_buffer[0] ^ 0xFF))) {
+				for (int i = 0; i < ALT_MAX_CMDS; ++i)
+					d.cmd_buffer[i] = ~0;
+				d.cmd_counter = 0;
+				d.cmd_filter = 1;
+			}
+			else if ((d.cmd_buffer[3] == 0x55) && (d.cmd_buffer[2] == 0xC2)) {
+				for (int i = 0; i < ALT_MAX_CMDS; ++i)
+					d.cmd_buffer[i] = ~0;
+				d.cmd_counter = 0;
+				d.cmd_filter = 1;
+			}
+			else if ((d.cmd_buffer[3] == 0x55) && (d.cmd_buffer[2] == 0xC3)) {
+				for (int i = 0; i < ALT_MAX_CMDS; ++i)
+					d.cmd_buffer[i] = ~0;
+				d.cmd_counter = 0;
+				d.cmd_filter = 1;
+			}
+			else if ((d.cmd_buffer[3] == 0x55) && (d.cmd_buffer[2] >= 0xBA) && (d.cmd_buffer[2] <= 0xC1) && (d.cmd_buffer[1] == (d.cmd_buffer[0] ^ 0xFF))) {
+				for (int i = 0; i < ALT_MAX_CMDS; ++i)
+					d.cmd_buffer[i] = ~0;
+				d.cmd_counter = 0;
+				d.cmd_filter = 1;
+			}
+			else if ((d.cmd_buffer[3] == 0x55) && (d.cmd_buffer[2] == 0xAA)) {
+				if ((d.cmd_buffer[3] == 0x55) && (d.cmd_buffer[2] == 0xAA) && (d.cmd_buffer[1] == (d.cmd_buffer[0] ^ 0xFF))) {
+					action.set_volume = true;
+					action.volume = (d.cmd_buffer[1] == 0) ? 0.f : std::min(powf(0.981201f, (float)(255u - d.cmd_buffer[1])) * 4.0f, 1.0f);
+				}
+				for (int i = 0; i < ALT_MAX_CMDS; ++i)
+					d.cmd_buffer[i] = ~0;
+				d.cmd_counter = 0;
+				d.cmd_filter = 1;
+			}
+			else
+				d.cmd_filter = 0;
+			break;
+		}
+
+		case ALTSOUND_HARDWARE_GEN_WPCALPHA_2:
+		case ALTSOUND_HARDWARE_GEN_WPCDMD:
+		case ALTSOUND_HARDWARE_GEN_WPCFLIPTRON: {
+			d.cmd_filter = 0;
+			if ((d.cmd_buffer[2] == 0x79) && (d.cmd_buffer[1] == (d.cmd_buffer[0] ^ 0xFF))) {
+				action.set_volume = true;
+				action.volume = std::min((float)d.cmd_buffer[1] / 127.f, 1.0f);
+				for (int i = 0; i < ALT_MAX_CMDS; ++i)
+					d.cmd_buffer[i] = ~0;
+				d.cmd_counter = 0;
+				d.cmd_filter = 1;
+			}
+			else if (d.cmd_buffer[1] == 0x7A) {
+				d.stored_command = d.cmd_buffer[1];
+				d.cmd_counter = 0;
+			}
+			else if (cmd != 0x7A) {
+				d.stored_command = 0;
+				d.cmd_counter = 0;
+			}
+			else
+				d.cmd_counter = 1;
+			break;
+		}
+
+		case ALTSOUND_HARDWARE_GEN_WPCALPHA_1:
+		case ALTSOUND_HARDWARE_GEN_S11:
+		case ALTSOUND_HARDWARE_GEN_S11X:
+		case ALTSOUND_HARDWARE_GEN_S11B2:
+		case ALTSOUND_HARDWARE_GEN_S11C: {
+			if (static_cast<unsigned int>(cmd) != d.cmd_buffer[1]) {
+				d.stored_command = 0;
+				d.cmd_counter = 0;
+			}
+			else
+				d.cmd_counter = 1;
+			break;
+		}
+
+		case ALTSOUND_HARDWARE_GEN_DEDMD16:
+		case ALTSOUND_HARDWARE_GEN_DEDMD32:
+		case ALTSOUND_HARDWARE_GEN_DEDMD64:
+		case ALTSOUND_HARDWARE_GEN_DE: {
+			if (cmd != 0xFF && cmd != 0x00) {
+				d.stored_command = 0;
+				d.cmd_counter = 0;
+			}
+			else
+				d.cmd_counter = 1;
+
+			if (d.cmd_buffer[1] == 0x00 && cmd == 0x00) {
+				d.stored_command = 0;
+				d.cmd_counter = 0;
+			}
+			break;
+		}
+
+		case ALTSOUND_HARDWARE_GEN_WS:
+		case ALTSOUND_HARDWARE_GEN_WS_1:
+		case ALTSOUND_HARDWARE_GEN_WS_2: {
+			d.cmd_filter = 0;
+			if (d.cmd_buffer[1] == 0xFE) {
+				if (cmd >= 0x10 && cmd <= 0x2F) {
+					action.set_volume = true;
+					action.volume = (float)(0x2F - cmd) / 31.f;
+					for (int i = 0; i < ALT_MAX_CMDS; ++i)
+						d.cmd_buffer[i] = ~0;
+					d.cmd_counter = 0;
+					d.cmd_filter = 1;
+				}
+				else if (cmd >= 0x01 && cmd <= 0x0F) {
+					d.stored_command = 0;
+					d.cmd_counter = 0;
+					d.cmd_filter = 1;
+				}
+			}
+
+			if ((cmd & 0xFC) == 0xFC)
+				d.cmd_counter = 1;
+			break;
+		}
+
+		case ALTSOUND_HARDWARE_GEN_GTS80: {
+			if (cmd == 0x00) {
+				d.stored_command = 0;
+				d.cmd_counter = 0;
+				d.cmd_filter = 1;
+			}
+			else {
+				d.stored_command = 0;
+				d.cmd_counter = 0;
+				d.cmd_filter = 0;
+			}
+			break;
+		}
+
+		default: break;
+	}
+}
+
+static bool legacyStopsMusic(ALTSOUND_HARDWARE_GEN gen, unsigned int combined_cmd)
+{
+	switch (gen) {
+		case ALTSOUND_HARDWARE_GEN_WPCDCS:
+		case ALTSOUND_HARDWARE_GEN_WPCSECURITY:
+		case ALTSOUND_HARDWARE_GEN_WPC95DCS:
+		case ALTSOUND_HARDWARE_GEN_WPC95:
+			return combined_cmd == 0x03E3;
+
+		case ALTSOUND_HARDWARE_GEN_DEDMD32:
+			return combined_cmd == 0x0018 || combined_cmd == 0x0023;
+
+		case ALTSOUND_HARDWARE_GEN_WS:
+		case ALTSOUND_HARDWARE_GEN_WS_1:
+		case ALTSOUND_HARDWARE_GEN_WS_2:
+			return combined_cmd == 0x0000 || (combined_cmd & 0xf0ff) == 0xf000;
+
+		default:
+			return false;
+	}
+}
+
+// Everything one command byte produces
+struct PreprocessOutcome {
+	CmdData data;
+	AltsoundCmdAction action;
+	bool complete = false;
+	unsigned int combined = 0;
+	bool stops_music = false;
+};
+
+// The bookkeeping AltSoundProcessCommand() does around preprocessing
+template<typename Preprocess, typename StopsMusic>
+static void preprocessByte(CmdData& data, unsigned int cmd, PreprocessOutcome& out, Preprocess preprocess, StopsMusic stops_music)
+{
+	data.cmd_counter++;
+	for (int i = ALT_MAX_CMDS - 1; i > 0; --i)
+		data.cmd_buffer[i] = data.cmd_buffer[i - 1];
+	data.cmd_buffer[0] = cmd;
+
+	out.action = AltsoundCmdAction();
+	preprocess(data, cmd, out.action);
+
+	out.complete = !data.cmd_filter && (data.cmd_counter & 1) == 0;
+	if (out.complete) {
+		out.combined = (data.stored_command << 8) | cmd;
+		out.stops_music = stops_music(out.combined);
+	}
+	else
+		data.stored_command = cmd;
+
+	out.data = data;
+}
+
+static bool sameOutcome(const PreprocessOutcome& a, const PreprocessOutcome& b)
+{
+	return a.data.cmd_counter == b.data.cmd_counter && a.data.stored_command == b.data.stored_command
+		&& a.data.cmd_filter == b.data.cmd_filter
+		&& std::equal(a.data.cmd_buffer, a.data.cmd_buffer + ALT_MAX_CMDS, b.data.cmd_buffer)
+		&& a.action.set_volume == b.action.set_volume
+		&& std::memcmp(&a.action.volume, &b.action.volume, sizeof(float)) == 0
+		&& a.complete == b.complete && a.combined == b.combined && a.stops_music == b.stops_music;
+}
+
+// Read the command bytes of a cmdlog, as altsound_test replays them
+static bool readCmdlogBytes(const string& path, std::vector<unsigned int>& bytes_out)
+{
+	std::ifstream in(path);
+	if (!in)
+		return false;
+
+	string line;
+	for (int header = 0; header < 2; ++header) {
+		if (!std::getline(in, line))
+			return false;
+	}
+
+	while (std::getline(in, line)) {
+		const size_t hex = line.find("0x");
+		if (hex == string::npos)
+			continue;
+
+		const unsigned long cmd = std::strtoul(line.c_str() + hex + 2, nullptr, 16);
+		bytes_out.push_back(static_cast<unsigned int>((cmd >> 8) & 0xFF));
+		bytes_out.push_back(static_cast<unsigned int>(cmd & 0xFF));
+	}
+	return true;
+}
+
+// Random bytes, biased toward the values the preprocessors look for
+static std::vector<unsigned int> makeFuzzBytes(size_t count)
+{
+	static const unsigned int special[] = { 0x00, 0x01, 0x0F, 0x10, 0x2F, 0x55, 0x79, 0x7A, 0x85,
+		0xAA, 0xAB, 0xB0, 0xBA, 0xC1, 0xC2, 0xC3, 0xFC, 0xFD, 0xFE, 0xFF };
+	std::mt19937 rng(42);
+	std::vector<unsigned int> bytes(count);
+	for (unsigned int& b : bytes) {
+		const unsigned int r = rng();
+		b = (r & 1) ? special[(r >> 1) % (sizeof(special) / sizeof(special[0]))] : (r >> 8) & 0xFF;
+	}
+
+	// a valid volume sequence for each family now and then
+	for (size_t i = 0; i + 4 < count; i += 97) {
+		const unsigned int vol = (rng() >> 8) & 0xFF;
+		switch ((i / 97) % 3) {
+			case 0: bytes[i] = 0x55; bytes[i + 1] = 0xAA; bytes[i + 2] = vol; bytes[i + 3] = vol ^ 0xFF; break;
+			case 1: bytes[i] = 0x79; bytes[i + 1] = vol; bytes[i + 2] = vol ^ 0xFF; break;
+			default: bytes[i] = 0xFE; bytes[i + 1] = 0x10 + (vol & 0x1F); break;
+		}
+	}
+	return bytes;
+}
+
+// Replay bytes through both implementations for every generation.  Returns
+// the number of bytes whose outcome differed
+static size_t verifyBytes(const string& label, const std::vector<unsigned int>& bytes)
+{
+	size_t mismatches = 0;
+	size_t volume_changes = 0;
+	size_t completes = 0;
+
+	for (ALTSOUND_HARDWARE_GEN gen : ALL_GENS) {
+		const AltsoundCmdDecoder& decoder = altsound_find_cmd_decoder(gen);
+		CmdData legacy_data{}, table_data{};
+		PreprocessOutcome legacy, table;
+
+		for (size_t i = 0; i < bytes.size(); ++i) {
+			preprocessByte(legacy_data, bytes[i], legacy,
+				[gen](CmdData& d, unsigned int cmd, AltsoundCmdAction& a) { legacyPreprocess(gen, d, static_cast<int>(cmd), a); },
+				[gen](unsigned int c) { return legacyStopsMusic(gen, c); });
+			preprocessByte(table_data, bytes[i], table, decoder.preprocess, decoder.stops_music);
+
+			volume_changes += legacy.action.set_volume;
+			completes += legacy.complete;
+
+			if (!sameOutcome(legacy, table)) {
+				if (mismatches < 10) {
+					std::cout << "  MISMATCH " << label << " gen 0x" << std::hex << static_cast<uint64_t>(gen)
+						<< " byte " << std::dec << i << " (0x" << std::hex << bytes[i] << std::dec << ")" << std::endl;
+				}
+				++mismatches;
+				table_data = legacy_data; // resynchronize to report independent differences
+			}
+		}
+	}
+
+	std::cout << std::left << std::setw(40) << label << std::right << std::setw(10) << bytes.size()
+		<< std::setw(12) << completes << std::setw(10) << volume_changes << std::setw(12) << mismatches << std::endl;
+	return mismatches;
+}
+
+static int verifyPreprocess(const std::vector<string>& cmdlogs)
+{
+	std::cout << "Preprocessing, table-driven vs. previous switch, over " << (sizeof(ALL_GENS) / sizeof(ALL_GENS[0]))
+		<< " hardware generations" << std::endl;
+	std::cout << std::left << std::setw(40) << "input" << std::right << std::setw(10) << "bytes"
+		<< std::setw(12) << "commands" << std::setw(10) << "volume" << std::setw(12) << "mismatches" << std::endl;
+
+	size_t mismatches = 0;
+	for (const string& path : cmdlogs) {
+		std::vector<unsigned int> bytes;
+		if (!readCmdlogBytes(path, bytes)) {
+			std::cout << "Unable to read cmdlog: " << path << std::endl;
+			return 1;
+		}
+		mismatches += verifyBytes(fs::path(path).filename().string(), bytes);
+	}
+	mismatches += verifyBytes("random", makeFuzzBytes(1000000));
+
+	std::cout << (mismatches ? "FAILED" : "OK: bit-for-bit identical") << std::endl;
+	return mismatches ? 1 : 0;
+}
+
+// ---------------------------------------------------------------------------
+// Microbenchmarks
+// ---------------------------------------------------------------------------
+
+struct MicroSample {
+	unsigned int id = 0;
+};
+
+// Time fn over count iterations and return nanoseconds per iteration
+static double timePerCall(size_t count, const std::function<void(size_t)>& fn)
+{
+	const uint64_t start = benchNow();
+	for (size_t i = 0; i < count; ++i)
+		fn(i);
+	return static_cast<double>(benchNow() - start) / count;
+}
+
+// Command-to-sample lookup: the linear scan getSample() used to do against
+// the load-time index, for tables of 10k and 100k samples
+static void microSampleLookup()
+{
+	std::mt19937 rng(1234);
+	const size_t sizes[] = { 10000, 100000 };
+
+	std::cout << "Sample lookup (ns per command, 1-4 samples per ID, 10% unknown IDs)" << std::endl;
+	std::cout << std::left << std::setw(10) << "samples" << std::right << std::setw(12) << "linear"
+		<< std::setw(12) << "index" << std::endl;
+
+	for (size_t size : sizes) {
+		// distinct scrambled 16-bit IDs with a few samples each, in file order
+		std::vector<MicroSample> samples;
+		std::vector<unsigned int> ids;
+		std::uniform_int_distribution<unsigned int> dup_dist(1, 4);
+		for (unsigned int k = 0; samples.size() < size; ++k) {
+			const unsigned int id = (k * 7919u) & 0xFFFF;
+			ids.push_back(id);
+			for (unsigned int d = dup_dist(rng); d > 0 && samples.size() < size; --d)
+				samples.push_back({ id });
+		}
+		std::shuffle(samples.begin(), samples.end(), rng);
+
+		std::vector<unsigned int> lookups(4096);
+		std::uniform_int_distribution<size_t> id_dist(0, ids.size() - 1);
+		for (size_t i = 0; i < lookups.size(); ++i)
+			lookups[i] = (i % 10 == 0) ? 0x10000 + static_cast<unsigned int>(i) : ids[id_dist(rng)];
+
+		// previous getSample(): scan every entry, drawing for each match
+		std::uniform_int_distribution<int> distribution(0, std::numeric_limits<int>::max());
+		volatile unsigned int sink = 0;
+		const size_t linear_count = std::max<size_t>(1000, 200000000 / size);
+		const double linear_ns = timePerCall(linear_count, [&](size_t i) {
+			const unsigned int id = lookups[i & (lookups.size() - 1)];
+			unsigned int matches = 0, picked = ~0u;
+			for (size_t s = 0; s < samples.size(); ++s) {
+				if (samples[s].id == id && distribution(rng) % ++matches == 0)
+					picked = static_cast<unsigned int>(s);
+			}
+			sink = picked;
+		});
+
+		AltsoundSampleIndex index;
+		index.build(samples);
+		const double index_ns = timePerCall(10000000, [&](size_t i) {
+			const SampleRange range = index.find(lookups[i & (lookups.size() - 1)]);
+			sink = range.count ? range.first + static_cast<unsigned int>(rng() % range.count) : ~0u;
+		});
+		(void)sink;
+
+		std::cout << std::left << std::setw(10) << size << std::right << std::fixed << std::setprecision(1)
+			<< std::setw(12) << linear_ns << std::setw(12) << index_ns << std::endl;
+	}
+}
+
+// Command preprocessing: the previous switch over the hardware generation
+// against the decoder selected once per generation
+static void microPreprocess()
+{
+	const std::vector<unsigned int> bytes = makeFuzzBytes(1 << 16);
+	const size_t count = 20000000;
+
+	std::cout << "Command preprocessing (ns per byte)" << std::endl;
+	std::cout << std::left << std::setw(10) << "gen" << std::right << std::setw(12) << "switch"
+		<< std::setw(12) << "table" << std::endl;
+
+	for (const BenchGen& bench_gen : BENCH_GENS) {
+		const ALTSOUND_HARDWARE_GEN gen = bench_gen.gen;
+		const AltsoundCmdDecoder* decoder = &altsound_find_cmd_decoder(gen);
+		CmdData data{};
+		PreprocessOutcome out;
+		volatile unsigned int sink = 0;
+
+		const double switch_ns = timePerCall(count, [&](size_t i) {
+			preprocessByte(data, bytes[i & (bytes.size() - 1)], out,
+				[gen](CmdData& d, unsigned int cmd, AltsoundCmdAction& a) { legacyPreprocess(gen, d, static_cast<int>(cmd), a); },
+				[gen](unsigned int c) { return legacyStopsMusic(gen, c); });
+			sink = out.combined;
+		});
+
+		data = CmdData{};
+		const double table_ns = timePerCall(count, [&](size_t i) {
+			preprocessByte(data, bytes[i & (bytes.size() - 1)], out, decoder->preprocess, decoder->stops_music);
+			sink = out.combined;
+		});
+		(void)sink;
+
+		std::cout << std::left << std::setw(10) << bench_gen.name << std::right << std::fixed << std::setprecision(2)
+			<< std::setw(12) << switch_ns << std::setw(12) << table_ns << std::endl;
+	}
+}
+
+// Voice mixing: the ma_engine node graph against the mixer with each kernel
+// set this CPU supports, for 16, 64 and 256 looping voices of half stereo,
+// half mono PCM.  Also checks that every kernel set mixes the same output
+static void microMixer()
+{
+	const uint32_t block_frames = 256;
+	const uint64_t voice_frames = 4410;
+	const unsigned int voice_counts[] = { 16, 64, 256 };
+	const std::vector<const AltsoundMixKernels*> kernel_sets = altsound_get_mix_kernels();
+
+	// one stereo and one mono source, at slightly different lengths per voice
+	std::mt19937 rng(99);
+	std::uniform_real_distribution<float> dist(-1.0f, 1.0f);
+	std::vector<float> stereo(voice_frames * 2), mono(voice_frames);
+	for (float& v : stereo)
+		v = dist(rng);
+	for (float& v : mono)
+		v = dist(rng);
+
+	std::cout << "Voice mixing (ns per output frame, " << block_frames << "-frame blocks)" << std::endl;
+	std::cout << std::left << std::setw(10) << "voices" << std::right << std::setw(12) << "ma_engine";
+	for (const AltsoundMixKernels* kernels : kernel_sets)
+		std::cout << std::setw(12) << kernels->name;
+	std::cout << std::endl;
+
+	bool identical = true;
+	for (unsigned int voices : voice_counts) {
+		const size_t blocks = std::max<size_t>(50, 400000 / voices);
+		std::vector<float> out(block_frames * BENCH_CHANNELS);
+		volatile float sink = 0.0f;
+
+		auto voiceFrames = [&](unsigned int v) { return voice_frames - (v % 64) * 8; };
+		auto voiceVolume = [&](unsigned int v) { return 0.25f + (v % 7) * 0.05f; };
+
+		// ma_engine reference, as voices were played before the mixer
+		ma_engine engine;
+		double engine_ns = 0.0;
+		if (altsound_ma_engine_init_no_device(BENCH_CHANNELS, BENCH_SAMPLE_RATE, &engine) == MA_SUCCESS) {
+			std::vector<ma_audio_buffer> buffers(voices);
+			std::vector<ma_sound> sounds(voices);
+			for (unsigned int v = 0; v < voices; ++v) {
+				const bool is_mono = v & 1;
+				altsound_ma_audio_buffer_init(ma_format_f32, is_mono ? 1 : 2, BENCH_SAMPLE_RATE, voiceFrames(v),
+					is_mono ? mono.data() : stereo.data(), &buffers[v]);
+				altsound_ma_sound_init_from_audio_buffer(&engine, &buffers[v],
+					MA_SOUND_FLAG_NO_SPATIALIZATION | MA_SOUND_FLAG_NO_PITCH, &sounds[v]);
+				altsound_ma_sound_set_looping(&sounds[v], MA_TRUE);
+				altsound_ma_sound_set_volume(&sounds[v], voiceVolume(v));
+				altsound_ma_sound_start(&sounds[v]);
+			}
+			engine_ns = timePerCall(blocks, [&](size_t) {
+				altsound_ma_engine_read_pcm_frames(&engine, out.data(), block_frames, nullptr);
+				sink = out[0];
+			}) / block_frames;
+			for (unsigned int v = 0; v < voices; ++v) {
+				altsound_ma_sound_uninit(&sounds[v]);
+				altsound_ma_audio_buffer_uninit(&buffers[v]);
+			}
+			altsound_ma_engine_uninit(&engine);
+		}
+
+		std::cout << std::left << std::setw(10) << voices << std::right << std::fixed << std::setprecision(2)
+			<< std::setw(12) << engine_ns;
+
+		std::vector<float> first_output;
+		for (const AltsoundMixKernels* kernels : kernel_sets) {
+			AltsoundMixer mixer;
+			mixer.init(BENCH_CHANNELS, voices, nullptr, nullptr);
+			mixer.setKernels(*kernels);
+			for (unsigned int v = 0; v < voices; ++v) {
+				AltsoundVoiceDesc desc;
+				desc.source = ALT_VOICE_F32;
+				desc.channels = (v & 1) ? 1 : 2;
+				desc.pcm = (v & 1) ? mono.data() : stereo.data();
+				desc.frame_count = voiceFrames(v);
+				desc.looping = true;
+				mixer.setVoice(v, desc);
+				mixer.setVolume(v, voiceVolume(v));
+				mixer.play(v);
+			}
+
+			// compare a few seconds of output before timing
+			std::vector<float> output;
+			for (int i = 0; i < 512; ++i) {
+				mixer.mix(out.data(), block_frames);
+				output.insert(output.end(), out.begin(), out.end());
+			}
+			if (first_output.empty())
+				first_output = output;
+			else if (std::memcmp(first_output.data(), output.data(), output.size() * sizeof(float)) != 0)
+				identical = false;
+
+			const double mixer_ns = timePerCall(blocks, [&](size_t) {
+				mixer.mix(out.data(), block_frames);
+				sink = out[0];
+			}) / block_frames;
+			std::cout << std::setw(12) << mixer_ns;
+		}
+		(void)sink;
+		std::cout << std::endl;
+	}
+
+	std::cout << "Kernel sets: " << (identical ? "bit-for-bit identical output" : "OUTPUT DIFFERS") << std::endl;
+}
+
+// Samples at another rate than the output: per-voice playback cost of
+// streaming them through a resampling decoder against playing PCM converted
+// once at load time, and the cost of that conversion per quality
+static void microResample()
+{
+	const uint32_t out_rate = 48000;
+	const uint32_t block_frames = 256;
+	const unsigned int voices = 16;
+	const size_t blocks = 4000;
+	const std::vector<char> wav = makeToneWav(BENCH_SAMPLE_RATE, 440.0f);
+
+	std::cout << "Resampling " << BENCH_SAMPLE_RATE << " Hz samples for " << out_rate << " Hz output" << std::endl;
+
+	// decoded at the sample's own rate, as the cache loads it
+	ma_decoder_config native_config = altsound_ma_decoder_config_init(ma_format_f32, BENCH_CHANNELS, 0);
+	ma_decoder native;
+	if (altsound_ma_decoder_init_memory(wav.data(), wav.size(), &native_config, &native) != MA_SUCCESS) {
+		std::cout << "  unable to decode the test tone" << std::endl;
+		return;
+	}
+	std::vector<float> decoded(BENCH_SAMPLE_RATE * BENCH_CHANNELS);
+	ma_uint64 decoded_frames = 0;
+	altsound_ma_decoder_read_pcm_frames(&native, decoded.data(), BENCH_SAMPLE_RATE, &decoded_frames);
+	altsound_ma_decoder_uninit(&native);
+
+	// load-time conversion per quality
+	const AltsoundResampleQuality qualities[] = { ALT_RESAMPLE_LINEAR, ALT_RESAMPLE_SINC };
+	std::vector<float> converted;
+	std::cout << "  load-time conversion (ns per output frame):";
+	for (AltsoundResampleQuality quality : qualities) {
+		const double ns = timePerCall(20, [&](size_t) {
+			altsound_resample(decoded.data(), decoded_frames, BENCH_CHANNELS, BENCH_SAMPLE_RATE, out_rate, quality, converted);
+		}) / (converted.size() / BENCH_CHANNELS);
+		std::cout << " " << altsound_resample_quality_name(quality) << " " << std::fixed << std::setprecision(2) << ns;
+	}
+	std::cout << std::endl;
+
+	// playback: every voice through its own resampling decoder, then the same
+	// voices from converted PCM
+	std::vector<float> out(block_frames * BENCH_CHANNELS);
+	volatile float sink = 0.0f;
+	double playback_ns[2] = {};
+	for (int pass = 0; pass < 2; ++pass) {
+		AltsoundMixer mixer;
+		mixer.init(BENCH_CHANNELS, voices, nullptr, nullptr);
+		std::vector<ma_decoder> decoders(pass == 0 ? voices : 0);
+
+		for (unsigned int v = 0; v < voices; ++v) {
+			AltsoundVoiceDesc desc;
+			desc.channels = BENCH_CHANNELS;
+			desc.looping = true;
+			if (pass == 0) {
+				ma_decoder_config config = altsound_ma_decoder_config_init(ma_format_f32, BENCH_CHANNELS, out_rate);
+				altsound_ma_decoder_init_memory(wav.data(), wav.size(), &config, &decoders[v]);
+				desc.source = ALT_VOICE_DECODER;
+				desc.decoder = &decoders[v];
+			}
+			else {
+				desc.source = ALT_VOICE_F32;
+				desc.pcm = converted.data();
+				desc.frame_count = converted.size() / BENCH_CHANNELS;
+			}
+			mixer.setVoice(v, desc);
+			mixer.setVolume(v, 1.0f / voices);
+			mixer.play(v);
+		}
+
+		playback_ns[pass] = timePerCall(blocks, [&](size_t) {
+			mixer.mix(out.data(), block_frames);
+			sink = out[0];
+		}) / (static_cast<double>(block_frames) * voices);
+
+		for (ma_decoder& decoder : decoders)
+			altsound_ma_decoder_uninit(&decoder);
+	}
+	(void)sink;
+
+	std::cout << "  playback per voice (ns per output frame): streamed " << std::fixed << std::setprecision(2)
+		<< playback_ns[0] << ", pre-resampled " << playback_ns[1] << std::endl;
+}
+
+static void runMicrobenchmarks()
+{
+	microSampleLookup();
+	std::cout << std::endl;
+	microPreprocess();
+	std::cout << std::endl;
+	microMixer();
+	std::cout << std::endl;
+	microResample();
+}
+
+// ---------------------------------------------------------------------------
+// Functional code
+// ---------------------------------------------------------------------------
+
+int main(int argc, const char* argv[])
+{
+	unsigned int triggers = 1000;
+	uint32_t buffer_frames = 256;
+	bool keep = false;
+
+	for (int i = 1; i < argc; ++i) {
+		const string arg = argv[i];
+		if (arg == "-n" && i + 1 < argc) {
+			triggers = static_cast<unsigned int>(std::strtoul(argv[++i], nullptr, 10));
+		}
+		else if (arg == "-b" && i + 1 < argc) {
+			buffer_frames = static_cast<uint32_t>(std::strtoul(argv[++i], nullptr, 10));
+		}
+		else if (arg == "-k") {
+			keep = true;
+		}
+		else if (arg == "--micro") {
+			runMicrobenchmarks();
+			return 0;
+		}
+		else if (arg == "--verify-preprocess") {
+			return verifyPreprocess(std::vector<string>(argv + i + 1, argv + argc));
+		}
+		else {
+			std::cout << "Usage: " << argv[0] << " [-n <triggers per run>] [-b <buffer frames>] [-k]" << std::endl;
+			std::cout << "       " << argv[0] << " --micro" << std::endl;
+			std::cout << "       " << argv[0] << " --verify-preprocess [<cmdlog.txt> ...]" << std::endl;
+			return 1;
+		}
+	}
+
+	if (triggers == 0 || buffer_frames == 0) {
+		std::cout << "Trigger count and buffer size must be positive" << std::endl;
+		return 1;
+	}
+
+	const fs::path vpm_path = fs::temp_directory_path() /
+		("altsound_bench_" + std::to_string(std::chrono::steady_clock::now().time_since_epoch().count()));
+	const char* formats[] = { "altsound", "g-sound" };
+
+	for (const char* format : formats) {
+		const fs::path game_dir = vpm_path / "altsound" / (format == string("g-sound") ? "bench_gs" : "bench_as");
+		if (!writePackage(game_dir, format)) {
+			std::cout << "Unable to write package: " << game_dir.string() << std::endl;
+			return 1;
+		}
+	}
+	std::cout << "Packages: " << (vpm_path / "altsound").string() << std::endl;
+
+	AltSoundSetLogger(vpm_path.string(), ALTSOUND_LOG_LEVEL_ERROR, false);
+
+	// Let the library create the default altsound.ini for each package
+	for (const char* format : formats) {
+		const string game = format == string("g-sound") ? "bench_gs" : "bench_as";
+		if (!AltSoundInit(vpm_path.string(), game, BENCH_SAMPLE_RATE, BENCH_CHANNELS, buffer_frames)) {
+			std::cout << "AltSoundInit failed for " << game << std::endl;
+			return 1;
+		}
+		AltSoundShutdown();
+	}
+
+	// Formats with both cache states on one generation, then every
+	// preprocessing path with a warm cache
+	std::vector<BenchRun> runs;
+	for (const char* format : formats) {
+		runs.push_back({ format, &BENCH_GENS[0], false });
+		runs.push_back({ format, &BENCH_GENS[0], true });
+	}
+	for (size_t i = 1; i < sizeof(BENCH_GENS) / sizeof(BENCH_GENS[0]); ++i)
+		runs.push_back({ formats[0], &BENCH_GENS[i], true });
+
+	std::cout << triggers << " triggers per run, " << buffer_frames << " frame buffers ("
+		<< std::fixed << std::setprecision(2) << 1000.0 * buffer_frames / BENCH_SAMPLE_RATE << " ms)" << std::endl;
+#if !defined(__linux__)
+	std::cout << "NOTE: cold runs disable the sample cache but cannot evict the OS file cache on this platform" << std::endl;
+#endif
+	std::cout << std::endl;
+	std::cout << std::left << std::setw(10) << "format" << std::setw(10) << "gen" << std::setw(7) << "cache"
+		<< std::right << std::setw(10) << "p50 ms" << std::setw(10) << "p99 ms" << std::setw(10) << "max ms"
+		<< std::setw(10) << "timeouts" << std::endl;
+
+	bool success = true;
+	std::vector<double> latencies;
+	for (const BenchRun& run : runs) {
+		unsigned int timeouts = 0;
+		if (!runBenchmark(vpm_path, run, triggers, buffer_frames, latencies, timeouts)) {
+			success = false;
+			continue;
+		}
+
+		std::sort(latencies.begin(), latencies.end());
+		std::cout << std::left << std::setw(10) << run.format << std::setw(10) << run.gen->name
+			<< std::setw(7) << (run.warm ? "warm" : "cold") << std::right << std::fixed << std::setprecision(3)
+			<< std::setw(10) << percentile(latencies, 0.50) << std::setw(10) << percentile(latencies, 0.99)
+			<< std::setw(10) << (latencies.empty() ? 0.0 : latencies.back()) << std::setw(10) << timeouts << std::endl;
+
+		if (timeouts)
+			success = false;
+	}
+
+	if (!keep) {
+		std::error_code ec;
+		fs::remove_all(vpm_path, ec);
+	}
+
+	return success ? 0 : 1;
+}
@@ -170,7 +170,7 @@ bool GSoundCsvParser::parse(std::vector<GSoundSampleInfo>& samples_out)
 				<< ", DUCK_PRF = " << entry.ducking_profile
 				<< ", FNAME = " << entry.fname;
 
-			ALT_DEBUG(0, debug_stream.str().c_str());
+			ALT_DEBUG(0, "%s", debug_stream.str().c_str());
 		}
 	}
 	catch (const std::exception& e) {
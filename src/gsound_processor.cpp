@@ -11,173 +11,126 @@
 #define NOMINMAX
 #include "gsound_processor.hpp"
 #include "gsound_csv_parser.hpp"
-#include "miniaudio_bass_compat.hpp"
+#include "altsound_context.hpp"
+#include "altsound_ini_processor.hpp"
 
-#include <map>
-#include <numeric>
+#include <algorithm>
+#include <bit>
 
 extern AltsoundLogger alog;
 
-// DAR@20230721
-// This is necessary because miniaudio callback streams run on a separate
-// thread from the main application, and both need to access/modify
-// common memory
-//
-// thread synchonization mutex.
-extern std::mutex io_mutex;
-
-// Reference to the global channel stream array
-extern StreamArray channel_stream;
-
 // ----------------------------------------------------------------------------
-// Behavior Management Support Globals
+// Behavior Management Support
 // ----------------------------------------------------------------------------
 
 constexpr unsigned int UNSET_IDX = std::numeric_limits<unsigned int>::max();
 
-// NOTE:
-// SFX streams don't require tracking since multiple can play simultaneously.
-// Other than adjusting ducking, they have no other impacts on active streams
-//
-// Single-play stream tracking
-static unsigned int cur_mus_stream_idx = UNSET_IDX;
-static unsigned int cur_callout_stream_idx = UNSET_IDX;
-static unsigned int cur_solo_stream_idx = UNSET_IDX;
-static unsigned int cur_overlay_stream_idx = UNSET_IDX;
-
-std::map<AltsoundSampleType, unsigned int*> tracked_stream_idx_map = {
-	{AltsoundSampleType::MUSIC, &cur_mus_stream_idx},
-	{AltsoundSampleType::CALLOUT, &cur_callout_stream_idx},
-	{AltsoundSampleType::SOLO, &cur_solo_stream_idx},
-	{AltsoundSampleType::OVERLAY, &cur_overlay_stream_idx}
-};
-
 // DAR@20230628
 // Because the stream.stream_type enumeration values may not match the bitset
 // values below, we need to map the AltsoundSampleType constants to the
-// bitset value that matches.  This map allows for the retrieval of the
-// correct index into the bookkeeping arrays to manage aggregate ducking
-// and pausing behaviors.
-//
-// Map stream sample types to configuration bitset values
-static std::unordered_map<AltsoundSampleType, int> streamTypeToIndex = {
-	{AltsoundSampleType::MUSIC,   0},
-	{AltsoundSampleType::CALLOUT, 1},
-	{AltsoundSampleType::SFX,     2},
-	{AltsoundSampleType::SOLO,    3},
-	{AltsoundSampleType::OVERLAY, 4}
-};
-
-// DAR@20230719
-// The maps below contain the ducking and pausing behavior impacts of sample
-// types on other sample types.  For example, the music_duck_vol map contains
-// the impacts on MUSIC volume from the behaviors of the other sample types.
-// Similarly, the music_paused map contains the paused status of MUSIC
-// streams based on the behavior of the other streams.
-//
-// The map key is the stream ID (HSTREAM) of the stream that is setting the
-// duck value.  This allows the correct entry to be removed when the
-// affecting stream ends
-//
-// Streams can have overlapping impacts on other streams.  When an affecting
-// stream ends, it can't be assumed its safe to remove the behavior impact from
-// the affected sample type.  The map key ensures ALL the behavior impacts are
-// captured for each sample type.  Only when the map is cleared, can the impact
-// be removed
-//
-// globals to manage stream ducking
-std::unordered_map<unsigned int, float> music_duck_vol;
-std::unordered_map<unsigned int, float> callout_duck_vol;
-std::unordered_map<unsigned int, float> sfx_duck_vol;
-std::unordered_map<unsigned int, float> solo_duck_vol;
-std::unordered_map<unsigned int, float> overlay_duck_vol;
-
-// convenience structure for working with ducking maps
-std::unordered_map<AltsoundSampleType, std::unordered_map<unsigned int, float>*> duck_vol_map = {
-	{MUSIC, &music_duck_vol},
-	{CALLOUT, &callout_duck_vol},
-	{SFX, &sfx_duck_vol},
-	{SOLO, &solo_duck_vol},
-	{OVERLAY, &overlay_duck_vol}
-};
-
-// globals to manage stream pausing
-std::unordered_map<unsigned int, bool> music_paused;
-std::unordered_map<unsigned int, bool> callout_paused;
-std::unordered_map<unsigned int, bool> sfx_paused;
-std::unordered_map<unsigned int, bool> solo_paused;
-std::unordered_map<unsigned int, bool> overlay_paused;
-
-// convenience structure for working with paused maps
-std::unordered_map<AltsoundSampleType, std::unordered_map<unsigned int, bool>*> paused_status_map = {
-	{MUSIC, &music_paused},
-	{CALLOUT, &callout_paused},
-	{SFX, &sfx_paused},
-	{SOLO, &solo_paused},
-	{OVERLAY, &overlay_paused}
-};
-
-
-// DAR@20230712
-// A common mixing board function is to set gain levels for individual tracks
-// and then apply a group volume to change volume for a group of tracks. while
-// maintaining relative individual volumes.  For example, if we have 3 MUSIC
-// tracks with 90, 60, 55 gain levels individually, setting the group volume
-// to 90 will duck all MUSIC tracks by 10% while maintaining the volume
-// relationships between the individual tracks.  Each index into the array
-// represents the sample type they apply to.  For example, index 0 is MUSIC
-// group volume.  Index 1 is CALLOUT These values can be set in
-// the configuration file
+// bitset value that matches.  This index is used for all the bookkeeping
+// arrays that manage aggregate ducking and pausing behaviors.
 //
-// Group volumes for sample types
-std::array<float, NUM_STREAM_TYPES> group_vol = { 1.0f, 1.0f, 1.0f, 1.0f, 1.0f };
+// Bookkeeping index of each AltsoundSampleType value, -1 for types without
+// behaviors (UNDEFINED, JINGLE)
+constexpr int TYPE_INDEX[] = { -1, 0, -1, 2, 1, 3, 4 };
 
+// Sample type of each bookkeeping index (BehaviorInfo::BehaviorBits order)
+constexpr AltsoundSampleType INDEX_TYPE[NUM_STREAM_TYPES] = { MUSIC, CALLOUT, SFX, SOLO, OVERLAY };
+
+static inline int toTypeIndex(AltsoundSampleType type)
+{
+	return (type >= 0 && type < static_cast<int>(sizeof(TYPE_INDEX) / sizeof(TYPE_INDEX[0]))) ? TYPE_INDEX[type] : -1;
+}
+
+// ----------------------------------------------------------------------------
+// Behavior bookkeeping helpers
 // ----------------------------------------------------------------------------
 
-// DAR@20230719
-// Sample type behaviors determine what impacts they will have on other sample
-// types.  For example, music_behavior defines what impacts MUSIC samples have
-// on other non-MUSIC sample types.
-//
-// NOTE: With the exception of STOP, self-impacting behaviors are not supported.
-//
-// external reference to stream behaviors
-extern BehaviorInfo music_behavior;
-extern BehaviorInfo callout_behavior;
-extern BehaviorInfo sfx_behavior;
-extern BehaviorInfo solo_behavior;
-extern BehaviorInfo overlay_behavior;
-
-// convenience structure for working with behaviors
-std::unordered_map<AltsoundSampleType, BehaviorInfo*> behavior_map = {
-	{MUSIC, &music_behavior},
-	{CALLOUT, &callout_behavior},
-	{SFX, &sfx_behavior},
-	{SOLO, &solo_behavior},
-	{OVERLAY, &overlay_behavior}
-};
+void GSoundProcessor::setDuckImpact(int type_idx, unsigned int slot, float vol)
+{
+	float& entry = duck_vol[type_idx][slot];
+	const float old_vol = entry;
+	entry = vol;
+
+	float& min_vol = min_duck_vol[type_idx];
+	if (vol <= min_vol) {
+		min_vol = vol;
+	}
+	else if (old_vol == min_vol) {
+		// the minimum was raised: rescan the slots in use
+		min_vol = *std::min_element(duck_vol[type_idx], duck_vol[type_idx] + ctx.channel_stream.size());
+	}
+}
+
+// ----------------------------------------------------------------------------
+
+void GSoundProcessor::setPauseImpact(int type_idx, unsigned int slot, bool paused)
+{
+	bool& entry = pausing[type_idx][slot];
+	if (entry == paused)
+		return;
+
+	entry = paused;
+	if (paused) {
+		++pause_count[type_idx];
+	}
+	else if (--pause_count[type_idx] == 0) {
+		resume_pending |= 1u << type_idx;
+	}
+}
+
+// ----------------------------------------------------------------------------
+
+void GSoundProcessor::clearSlotImpacts(unsigned int slot)
+{
+	for (int t = 0; t < NUM_STREAM_TYPES; ++t) {
+		if (duck_vol[t][slot] != 1.0f)
+			setDuckImpact(t, slot, 1.0f);
+		setPauseImpact(t, slot, false);
+	}
+	impact_owner[slot] = MINIAUDIO_NO_STREAM;
+}
+
+// ----------------------------------------------------------------------------
+
+void GSoundProcessor::resetBehaviorImpacts()
+{
+	cur_stream_idx.fill(UNSET_IDX);
+	impact_owner.fill(MINIAUDIO_NO_STREAM);
+	std::fill(&duck_vol[0][0], &duck_vol[0][0] + NUM_STREAM_TYPES * ALT_MAX_CHANNELS, 1.0f);
+	min_duck_vol.fill(1.0f);
+	std::fill(&pausing[0][0], &pausing[0][0] + NUM_STREAM_TYPES * ALT_MAX_CHANNELS, false);
+	pause_count.fill(0);
+	paused_slots.fill(SlotMask());
+	resume_pending = 0;
+}
 
 // ---------------------------------------------------------------------------
 // CTOR/DTOR
 // ---------------------------------------------------------------------------
 
-GSoundProcessor::GSoundProcessor(const string& _game_name, const string& _vpm_path)
-: AltsoundProcessorBase(_game_name, _vpm_path),
+GSoundProcessor::GSoundProcessor(AltSoundContext& ctx_in, const AltsoundIniProcessor& ini_in,
+	                             const string& _game_name, const string& _vpm_path)
+: AltsoundProcessorBase(ctx_in, _game_name, _vpm_path),
   is_initialized(false),
   is_stable(true), // future use
-  generator(std::random_device()()) // seed random number generator
+  generator(std::random_device()()), // seed random number generator
+  music_behavior(ini_in.getBehavior(MUSIC)),
+  callout_behavior(ini_in.getBehavior(CALLOUT)),
+  sfx_behavior(ini_in.getBehavior(SFX)),
+  solo_behavior(ini_in.getBehavior(SOLO)),
+  overlay_behavior(ini_in.getBehavior(OVERLAY))
 {
+	resetBehaviorImpacts();
 }
 
 GSoundProcessor::~GSoundProcessor()
 {
-	// clean up stream tracking
-	cur_mus_stream_idx = UNSET_IDX;
-	cur_callout_stream_idx = UNSET_IDX;
-	cur_solo_stream_idx = UNSET_IDX;
-	cur_overlay_stream_idx = UNSET_IDX;
-
 	stopAllStreams();
+
+	// clean up stream tracking and behavior impacts
+	resetBehaviorImpacts();
 }
 
 // ---------------------------------------------------------------------------
@@ -190,7 +143,10 @@ bool GSoundProcessor::handleCmd(const unsigned int cmd_combined_in)
 	ALT_INDENT;
 
 	ALT_DEBUG(1, "Acquiring mutex");
-	std::lock_guard<std::mutex> guard(io_mutex);
+	const uint64_t wait_start = AltsoundMetrics::now();
+	std::lock_guard<std::mutex> guard(ctx.io_mutex);
+	ctx.metrics.recordSince(ALTSOUND_STAGE_MUTEX_WAIT, wait_start);
+	AltsoundTraceScope trace_scope(ctx.trace, "handleCmd", "cmd", cmd_combined_in);
 
 	// Pass command to base class for processing
 	AltsoundProcessorBase::handleCmd(cmd_combined_in);
@@ -236,13 +192,16 @@ bool GSoundProcessor::handleCmd(const unsigned int cmd_combined_in)
 		return false;
 	}
 
-	AltsoundStreamInfo* new_stream = new AltsoundStreamInfo();
+	AltsoundStreamInfo* new_stream = ctx.stream_info_pool.acquire();
+	new_stream->reset();
 
 	// pre-populate stream info
 	new_stream->sample_path = samples[sample_idx].fname;
 	new_stream->gain = samples[sample_idx].gain;
 	new_stream->loop = samples[sample_idx].loop;
 	new_stream->ducking_profile = samples[sample_idx].ducking_profile;
+	new_stream->sample_data = samples[sample_idx].data;
+	new_stream->sample_size = samples[sample_idx].data_size;
 
 	const AltsoundSampleType sample_type = toSampleType(samples[sample_idx].type);
 
@@ -250,11 +209,12 @@ bool GSoundProcessor::handleCmd(const unsigned int cmd_combined_in)
 	case MUSIC:
 		new_stream->stream_type = MUSIC;
 		if (ALT_CALL(processStream(music_behavior, new_stream))) {
-			channel_stream[new_stream->channel_idx] = new_stream;
-			cur_mus_stream_idx = new_stream->channel_idx;
+			ctx.channel_stream.assign(new_stream->channel_idx, new_stream);
+			cur_stream_idx[TYPE_INDEX[MUSIC]] = new_stream->channel_idx;
 		}
 		else {
 			ALT_ERROR(1, "FAILED GSoundProcessor::processMusic()");
+			ctx.stream_info_pool.release(new_stream);
 
 			ALT_OUTDENT;
 			ALT_DEBUG(0, "END GSoundProcessor::handleCmd()");
@@ -264,10 +224,11 @@ bool GSoundProcessor::handleCmd(const unsigned int cmd_combined_in)
 	case SFX:
 		new_stream->stream_type = SFX;
 		if (ALT_CALL(processStream(sfx_behavior, new_stream))) {
-			channel_stream[new_stream->channel_idx] = new_stream;
+			ctx.channel_stream.assign(new_stream->channel_idx, new_stream);
 		}
 		else {
 			ALT_ERROR(1, "FAILED GSoundProcessor::processSfx()");
+			ctx.stream_info_pool.release(new_stream);
 
 			ALT_OUTDENT;
 			ALT_DEBUG(0, "END GSoundProcessor::handleCmd()");
@@ -277,11 +238,12 @@ bool GSoundProcessor::handleCmd(const unsigned int cmd_combined_in)
 	case CALLOUT:
 		new_stream->stream_type = CALLOUT;
 		if (ALT_CALL(processStream(callout_behavior, new_stream))) {
-			channel_stream[new_stream->channel_idx] = new_stream;
-			cur_callout_stream_idx = new_stream->channel_idx;
+			ctx.channel_stream.assign(new_stream->channel_idx, new_stream);
+			cur_stream_idx[TYPE_INDEX[CALLOUT]] = new_stream->channel_idx;
 		}
 		else {
 			ALT_ERROR(1, "FAILED GSoundProcessor::processCallout()");
+			ctx.stream_info_pool.release(new_stream);
 
 			ALT_OUTDENT;
 			ALT_DEBUG(0, "END GSoundProcessor::handleCmd()");
@@ -291,11 +253,12 @@ bool GSoundProcessor::handleCmd(const unsigned int cmd_combined_in)
 	case SOLO:
 		new_stream->stream_type = SOLO;
 		if (ALT_CALL(processStream(solo_behavior, new_stream))) {
-			channel_stream[new_stream->channel_idx] = new_stream;
-			cur_solo_stream_idx = new_stream->channel_idx;
+			ctx.channel_stream.assign(new_stream->channel_idx, new_stream);
+			cur_stream_idx[TYPE_INDEX[SOLO]] = new_stream->channel_idx;
 		}
 		else {
 			ALT_ERROR(1,"FAILED GSoundProcessor::processSolo()");
+			ctx.stream_info_pool.release(new_stream);
 
 			ALT_OUTDENT;
 			ALT_DEBUG(0, "END GSoundProcessor::handleCmd()");
@@ -305,11 +268,12 @@ bool GSoundProcessor::handleCmd(const unsigned int cmd_combined_in)
 	case OVERLAY:
 		new_stream->stream_type = OVERLAY;
 		if (ALT_CALL(processStream(overlay_behavior, new_stream))) {
-			channel_stream[new_stream->channel_idx] = new_stream;
-			cur_overlay_stream_idx = new_stream->channel_idx;
+			ctx.channel_stream.assign(new_stream->channel_idx, new_stream);
+			cur_stream_idx[TYPE_INDEX[OVERLAY]] = new_stream->channel_idx;
 		}
 		else {
 			ALT_ERROR(1, "FAILED GSoundProcessor::processOverlay()");
+			ctx.stream_info_pool.release(new_stream);
 
 			ALT_OUTDENT;
 			ALT_DEBUG(0, "END GSoundProcessor::handleCmd()");
@@ -317,7 +281,12 @@ bool GSoundProcessor::handleCmd(const unsigned int cmd_combined_in)
 		}
 		break;
 	default:
-		break;
+		ALT_ERROR(1, "Unknown sample type: %s", samples[sample_idx].type.c_str());
+		ctx.stream_info_pool.release(new_stream);
+
+		ALT_OUTDENT;
+		ALT_DEBUG(0, "END GSoundProcessor::handleCmd()");
+		return false;
 	}
 
 	// set volume for active streams
@@ -333,7 +302,7 @@ bool GSoundProcessor::handleCmd(const unsigned int cmd_combined_in)
 		ALT_DEBUG(1, "HSTREAM(%u)  CH(%02d)  CMD(%04X)  SAMPLE(%s)", new_stream->hstream,
 			      new_stream->channel_idx, cmd_combined_in, sample_short_path);
 
-		if (!MiniAudio_ChannelPlay(new_stream->hstream, false)) {
+		if (!MiniAudio_ChannelPlay(ctx, new_stream->hstream, false)) {
 			// Sound playback failed
 			ALT_ERROR(2, "FAILED %s stream playback: %s", stream_type_str, get_miniaudio_err());
 
@@ -358,11 +327,8 @@ void GSoundProcessor::init()
 	ALT_DEBUG(0, "BEGIN GSoundProcessor::init()");
 	ALT_INDENT;
 
-	// reset stream tracking variables
-	cur_mus_stream_idx = UNSET_IDX;
-	cur_callout_stream_idx = UNSET_IDX;
-	cur_solo_stream_idx = UNSET_IDX;
-	cur_overlay_stream_idx = UNSET_IDX;
+	// reset stream tracking and behavior impacts
+	resetBehaviorImpacts();
 
 	if (!loadSamples()) {
 		ALT_ERROR(1, "FAILED GSoundProcessor::loadSamples()");
@@ -370,11 +336,11 @@ void GSoundProcessor::init()
 	ALT_INFO(1, "SUCCESS: GSoundProcessor::loadSamples()");
 
 	// populate group volumes
-	group_vol[streamTypeToIndex[MUSIC]]   = music_behavior.group_vol;
-	group_vol[streamTypeToIndex[CALLOUT]] = callout_behavior.group_vol;
-	group_vol[streamTypeToIndex[SFX]]     = sfx_behavior.group_vol;
-	group_vol[streamTypeToIndex[OVERLAY]] = overlay_behavior.group_vol;
-	group_vol[streamTypeToIndex[SOLO]]    = solo_behavior.group_vol;
+	group_vol[TYPE_INDEX[MUSIC]]   = music_behavior.group_vol;
+	group_vol[TYPE_INDEX[CALLOUT]] = callout_behavior.group_vol;
+	group_vol[TYPE_INDEX[SFX]]     = sfx_behavior.group_vol;
+	group_vol[TYPE_INDEX[OVERLAY]] = overlay_behavior.group_vol;
+	group_vol[TYPE_INDEX[SOLO]]    = solo_behavior.group_vol;
 
 	// if we are here, initialization succeeded
 	is_initialized = true;
@@ -400,16 +366,36 @@ bool GSoundProcessor::loadSamples()
 		altsound_path += string() + "altsound/" + game_name + '/';
 	}
 
-	GSoundCsvParser csv_parser(altsound_path);
+	if (ctx.sample_pack.isOpen()) {
+		std::vector<SampleIndexEntry> index_entries;
+		if (!ctx.sample_pack.getSamples(altsound_path, samples) || !ctx.sample_pack.getIndex(index_entries)) {
+			ALT_ERROR(1, "FAILED AltsoundPack::getSamples()");
 
-	if (!csv_parser.parse(samples)) {
-		ALT_ERROR(1, "FAILED GSoundCsvParser::parse()");
+			ALT_OUTDENT;
+			ALT_DEBUG(0, "END GSoundProcessor::init()");
+			return false;
+		}
+		ALT_INFO(1, "SUCCESS AltsoundPack::getSamples()");
 
-		ALT_OUTDENT;
-		ALT_DEBUG(0, "END GSoundProcessor::init()");
-		return false;
+		// pack samples are stored sorted by ID, so use the pack index as is
+		sample_index.assign(index_entries);
 	}
-	ALT_INFO(1, "SUCCESS GSoundCsvParser::parse()");
+	else {
+		GSoundCsvParser csv_parser(altsound_path);
+
+		if (!csv_parser.parse(samples)) {
+			ALT_ERROR(1, "FAILED GSoundCsvParser::parse()");
+
+			ALT_OUTDENT;
+			ALT_DEBUG(0, "END GSoundProcessor::init()");
+			return false;
+		}
+		ALT_INFO(1, "SUCCESS GSoundCsvParser::parse()");
+	}
+
+	if (!ctx.sample_pack.isOpen())
+		sample_index.build(samples);
+	ALT_INFO(1, "Indexed %zu samples for %zu commands", samples.size(), sample_index.size());
 
 	ALT_OUTDENT;
 	ALT_DEBUG(0, "END GSoundProcessor::init()");
@@ -423,29 +409,23 @@ unsigned int GSoundProcessor::getSample(const unsigned int cmd_combined_in)
 	ALT_DEBUG(0, "BEGIN GSoundProcessor::getSample()");
 	ALT_INDENT;
 
-	int matching_sample_count = 0;
-	unsigned int sample_idx = UNSET_IDX;
-
-	std::uniform_int_distribution<int> distribution(0, std::numeric_limits<int>::max());
+	AltsoundStageTimer timer(ctx.metrics, ALTSOUND_STAGE_GET_SAMPLE);
 
-	for (size_t i = 0; i < samples.size(); ++i) {
-		if (samples[i].id == cmd_combined_in) {
-			matching_sample_count++;
+	unsigned int sample_idx = UNSET_IDX;
 
-			// reservoir sampling approach
-			// Each matching sample has equal chance (1/matching_sample_count) to
-			// become the selected one.
-			if (distribution(generator) % matching_sample_count == 0) {
-				sample_idx = static_cast<unsigned int>(i);
-			}
-		}
+	// Samples are sorted by ID, so all samples for the command are adjacent.
+	// Each has an equal chance of being picked
+	const SampleRange range = sample_index.find(cmd_combined_in);
+	if (range.count > 0) {
+		std::uniform_int_distribution<unsigned int> distribution(0, range.count - 1);
+		sample_idx = range.first + distribution(generator);
 	}
 
-	if (matching_sample_count == 0) {
+	if (range.count == 0) {
 		ALT_INFO(0, "No sample(s) found for ID: %04X", cmd_combined_in);
 	}
 	else {
-		ALT_INFO(0, "Found %d sample(s) for ID: %04X", matching_sample_count, cmd_combined_in);
+		ALT_INFO(0, "Found %u sample(s) for ID: %04X", range.count, cmd_combined_in);
 		if (sample_idx != UNSET_IDX) {
 			ALT_INFO(0, "Sample: %s", getShortPath(samples[sample_idx].fname).c_str());
 		}
@@ -507,22 +487,28 @@ bool GSoundProcessor::processBehaviors(const BehaviorInfo& behavior, const Altso
 	ALT_DEBUG(0, "BEGIN: GSoundProcessor::processBehaviors()");
 	ALT_INDENT;
 
-	// Syntactic sugar for accessing bitset values
-	using BB = BehaviorInfo::BehaviorBits;
+	// Take over the voice slot's impacts.  Anything left by a previous stream
+	// on this slot is stale
+	const unsigned int slot = stream->channel_idx;
+	if (impact_owner[slot] != stream->hstream) {
+		clearSlotImpacts(slot);
+		impact_owner[slot] = stream->hstream;
+	}
 
-	// Iterate through all sample types
-	for (const auto& iter : streamTypeToIndex)
+	// Iterate through the sample types the behavior acts on.  The actions
+	// were compiled at load time, with STOP taking precedence over PAUSE and
+	// self-impacts other than STOP removed
+	for (uint32_t mask = behavior.action_mask; mask; mask &= mask - 1)
 	{
-		AltsoundSampleType sampleType = iter.first;
-		int behaviorBitIndex = iter.second;
+		const int type_idx = std::countr_zero(mask);
+		const uint8_t action = behavior.actions[type_idx];
+		const AltsoundSampleType sampleType = INDEX_TYPE[type_idx];
 
-		// Retrieve the behavior bit for the current sample type
-		BB sampleBehaviorBit = static_cast<BB>(behaviorBitIndex);
 		ALT_DEBUG(1, "Processing %s behaviors on %s streams", toString(stream->stream_type),
 			      toString(sampleType));
 
 		// Process STOP behavior impact
-		if (behavior.stops.test(static_cast<size_t>(sampleBehaviorBit)))
+		if (action & BehaviorInfo::ACTION_STOP)
 		{
 			// current stream behavior calls to stop current stream
 			if (!stopExclusiveStream(sampleType)) {
@@ -533,63 +519,45 @@ bool GSoundProcessor::processBehaviors(const BehaviorInfo& behavior, const Altso
 				return false;
 			}
 		}
-		else if (behavior.pauses.test(static_cast<size_t>(sampleBehaviorBit)))
+		else if (action & BehaviorInfo::ACTION_PAUSE)
 		{
 			// Add pause impact from the current stream on the current sample type
-			if (sampleType != stream->stream_type) {
-				// get tracked stream index
-				const unsigned int* cur_stream_idx = tracked_stream_idx_map[sampleType];
-
-				if (*cur_stream_idx != UNSET_IDX) {
-					unsigned int hstream = channel_stream[*cur_stream_idx]->hstream;
-					if (!MiniAudio_ChannelPause(hstream)) {
-						ALT_ERROR(1, "FAILED MiniAudio_ChannelPause(): %s", get_miniaudio_err());
-
-						ALT_OUTDENT;
-						ALT_DEBUG(0, "END GSoundProcessor::processMusicImpacts()");
-						return false;
-					}
-					else {
-						ALT_INFO(1, "SUCCESS MiniAudio_ChannelPause(%u)", hstream);
-					}
+			// get tracked stream index
+			const unsigned int paused_idx = cur_stream_idx[type_idx];
+
+			if (paused_idx != UNSET_IDX) {
+				unsigned int hstream = ctx.channel_stream[paused_idx]->hstream;
+				if (!MiniAudio_ChannelPause(ctx, hstream)) {
+					ALT_ERROR(1, "FAILED MiniAudio_ChannelPause(): %s", get_miniaudio_err());
+
+					ALT_OUTDENT;
+					ALT_DEBUG(0, "END GSoundProcessor::processMusicImpacts()");
+					return false;
 				}
-		
-				// DAR@20230723
-				// Whether or not there was actually a stream playing, record the fact
-				// that the current behavior wanted it paused.  This way, if a stream
-				// starts that should be paused, it will be, as long as the stream that
-				// set the behavior is still playing
-				auto& map = *paused_status_map[sampleType];
-				map[stream->hstream] = true;
-			}
-			else
-			{
-				ALT_WARNING(1, "%s streams cannot pause another %s stream", toString(sampleType), toString(sampleType));
+				else {
+					ALT_INFO(1, "SUCCESS MiniAudio_ChannelPause(%u)", hstream);
+				}
+				paused_slots[type_idx][paused_idx / 64] |= uint64_t(1) << (paused_idx % 64);
 			}
+
+			// DAR@20230723
+			// Whether or not there was actually a stream playing, record the fact
+			// that the current behavior wanted it paused.  This way, if a stream
+			// starts that should be paused, it will be, as long as the stream that
+			// set the behavior is still playing
+			setPauseImpact(type_idx, slot, true);
 		}
 
 		// Process DUCKING behavior impact
-		if (behavior.ducks.test(static_cast<size_t>(sampleBehaviorBit)))
+		if ((action & BehaviorInfo::ACTION_DUCK) && stream->ducking_profile != 0)
 		{
 			// Add ducking impact from the current stream on the current sample type
-			if (sampleType != stream->stream_type)	{
-				// Get ducking volume for this sample to apply to the current sample type
-				if (stream->ducking_profile != 0) {
-					const float duck_vol = behavior.getDuckVolume(stream->ducking_profile, sampleType);
-
-					auto& map = *duck_vol_map[sampleType];
-					map[stream->hstream] = duck_vol;
-				}
-			}
-			else
-			{
-				ALT_WARNING(1, "%s streams cannot duck another %s stream", toString(sampleType), toString(sampleType));
-			}
+			setDuckImpact(type_idx, slot, behavior.getDuckVolume(stream->ducking_profile, type_idx));
 		}
 	}
 
 	// DEBUG helper
-	printBehaviorData();
+	ALT_DEBUG_ONLY(printBehaviorData());
 
 	ALT_OUTDENT;
 	ALT_DEBUG(0, "END GSoundProcessor::processBehaviors()");
@@ -601,66 +569,22 @@ bool GSoundProcessor::processBehaviors(const BehaviorInfo& behavior, const Altso
 // behavior impacts of the stream ending on other streams
 // ----------------------------------------------------------------------------
 
-bool GSoundProcessor::postProcessBehaviors(const BehaviorInfo& behavior,
-	                                       const AltsoundStreamInfo& finished_stream)
+bool GSoundProcessor::postProcessBehaviors(const AltsoundStreamInfo& finished_stream)
 {
 	ALT_DEBUG(0, "BEGIN: GSoundProcessor::postProcessBehaviors()");
 	ALT_INDENT;
 
-	// Syntactic sugar for accessing bitset values
-	using BB = BehaviorInfo::BehaviorBits;
-
-	// Iterate through all sample types
-	for (const auto& iter : streamTypeToIndex)
-	{
-		AltsoundSampleType sampleType = iter.first;
-		int behaviorBitIndex = iter.second;
-		const char* finished_stream_type_str = toString(finished_stream.stream_type);
-		ALT_DEBUG(1, "Post-processing %s behaviors on %s streams", finished_stream_type_str, toString(sampleType));
-
-		// Retrieve the behavior bit for the current sample type
-		BB sampleBehaviorBit = static_cast<BB>(behaviorBitIndex);
-
-		// Process STOP behavior impact
-		if (behavior.stops.test(static_cast<size_t>(sampleBehaviorBit)))
-		{
-			// Currently ended stream stopped the current sample type. Nothing to do.
-		}
-
-		// Process PAUSE behavior impact
-		if (behavior.pauses.test(static_cast<size_t>(sampleBehaviorBit)))
-		{
-			auto& map = *paused_status_map[sampleType];
-
-			if (!map.empty()) {
-				unsigned int stream_id = finished_stream.hstream;
-				auto it = map.find(stream_id);
-				if (it != map.end()) {
-					ALT_DEBUG(1, "Erasing pausing impact from %s stream: %u", toString(finished_stream.stream_type), finished_stream.hstream);
-					map.erase(it);
-				}
-			}
-		}
-
-		// Process DUCKING behavior impact
-		ALT_DEBUG(1, "Post-processing %s ducking impact on %s streams", toString(finished_stream.stream_type), toString(sampleType));
-		if (behavior.ducks.test(static_cast<size_t>(sampleBehaviorBit)))
-		{
-			auto& map = *duck_vol_map[sampleType];
-
-			if (!map.empty()) {
-				unsigned int stream_id = finished_stream.hstream;
-				auto it = map.find(stream_id);
-				if (it != map.end()) {
-					ALT_DEBUG(1, "Erasing ducking impact from %s stream: %u", toString(finished_stream.stream_type), finished_stream.hstream);
-					map.erase(it);
-				}
-			}
-		}
+	// The slot only holds impacts of the stream that set them.  Impacts of a
+	// looping MUSIC stream are removed when its first pass ends, so a later
+	// stop finds nothing left to remove
+	const unsigned int slot = finished_stream.channel_idx;
+	if (slot < ctx.channel_stream.size() && impact_owner[slot] == finished_stream.hstream) {
+		ALT_DEBUG(1, "Erasing behavior impacts from %s stream: %u", toString(finished_stream.stream_type), finished_stream.hstream);
+		clearSlotImpacts(slot);
 	}
 
 	// DEBUG helper
-	printBehaviorData();
+	ALT_DEBUG_ONLY(printBehaviorData());
 
 	ALT_OUTDENT;
 	ALT_DEBUG(0, "END GSoundProcessor::postProcessBehaviors()");
@@ -697,6 +621,39 @@ bool GSoundProcessor::stopMusic()
 	return true;
 }
 
+// ----------------------------------------------------------------------------
+
+std::vector<PreloadItem> GSoundProcessor::getPreloadItems() const
+{
+	std::vector<PreloadItem> items;
+	items.reserve(samples.size());
+
+	for (const GSoundSampleInfo& sample : samples) {
+		PreloadItem item;
+		item.path = sample.fname;
+		item.type = toSampleType(sample.type);
+		item.data = sample.data;
+		item.data_size = sample.data_size;
+		items.push_back(item);
+	}
+	return items;
+}
+
+// ----------------------------------------------------------------------------
+// A stolen stream lifts its behavior impacts like a stream that ends.  Sample
+// types it paused resume with the next stream that ends or stops, as they do
+// after a STOP behavior
+// ----------------------------------------------------------------------------
+
+void GSoundProcessor::forgetStream(const AltsoundStreamInfo& stream)
+{
+	postProcessBehaviors(stream);
+
+	const int type_idx = toTypeIndex(stream.stream_type);
+	if (type_idx >= 0 && cur_stream_idx[type_idx] == stream.channel_idx)
+		cur_stream_idx[type_idx] = UNSET_IDX;
+}
+
 // ----------------------------------------------------------------------------
 // This method is used to stop one of the exclusive (one-at-a-time) sample tyoe
 // streams.  The argument to this function must be the address of one of the
@@ -713,9 +670,10 @@ bool GSoundProcessor::stopExclusiveStream(const AltsoundSampleType stream_type)
 	ALT_INDENT;
 
 	// Get the current stream index for the sample type
-	unsigned int* cur_stream_idx = tracked_stream_idx_map[stream_type];
+	const int type_idx = toTypeIndex(stream_type);
+	unsigned int* tracked_idx = type_idx >= 0 ? &cur_stream_idx[type_idx] : nullptr;
 
-	if (*cur_stream_idx == UNSET_IDX) {
+	if (!tracked_idx || *tracked_idx == UNSET_IDX) {
 		ALT_INFO(1, "No active %s stream", toString(stream_type));
 
 		ALT_OUTDENT;
@@ -723,12 +681,12 @@ bool GSoundProcessor::stopExclusiveStream(const AltsoundSampleType stream_type)
 		return true;
 	}
 
-	AltsoundStreamInfo* cur_stream = channel_stream[*cur_stream_idx];
+	AltsoundStreamInfo* cur_stream = ctx.channel_stream[*tracked_idx];
 
 	// DAR@20230724
 	// We have to first post-process the sample behavior to remove any
 	// impacts the stream we are about to stop may have had
-	postProcessBehaviors(*behavior_map[stream_type], *cur_stream);
+	postProcessBehaviors(*cur_stream);
 
 	unsigned int hstream = cur_stream->hstream;
 	const unsigned int ch_idx = cur_stream->channel_idx;
@@ -739,9 +697,8 @@ bool GSoundProcessor::stopExclusiveStream(const AltsoundSampleType stream_type)
 	const bool success = stopStream(hstream);
 	if (success) {
 		ALT_INFO(1, "Stopped %s stream: %u  Chan: %02d", toString(stream_type), hstream, ch_idx);
-		delete channel_stream[ch_idx];
-		channel_stream[ch_idx] = nullptr;
-		*cur_stream_idx = UNSET_IDX;
+		ctx.channel_stream.release(ch_idx);
+		*tracked_idx = UNSET_IDX;
 	}
 	else {
 		ALT_ERROR(1, "FAILED stopStream(%u)", hstream);
@@ -756,58 +713,52 @@ bool GSoundProcessor::stopExclusiveStream(const AltsoundSampleType stream_type)
 // ----------------------------------------------------------------------------
 
 void ALTSOUNDCALLBACK GSoundProcessor::common_callback(unsigned int handle, unsigned int channel, unsigned int data, void* user)
+{
+	static_cast<GSoundProcessor*>(user)->streamEnded(handle, channel);
+}
+
+// ---------------------------------------------------------------------------
+
+void GSoundProcessor::streamEnded(unsigned int hsync, unsigned int hstream_in)
 {
 	ALT_DEBUG(0, "\nBEGIN: GSoundProcessor::common_callback()");
 	ALT_INDENT;
 
-	ALT_INFO(1, "HSYNC: %u  HSTREAM: %u", handle, channel);
+	ALT_INFO(1, "HSYNC: %u  HSTREAM: %u", hsync, hstream_in);
 	ALT_DEBUG(1, "Acquiring mutex");
-	std::lock_guard<std::mutex> guard(io_mutex);
-
-	unsigned int hstream_in = channel;
-	const AltsoundStreamInfo* stream_inst = static_cast<AltsoundStreamInfo*>(user);
-	unsigned int inst_hstream = stream_inst->hstream;
+	std::lock_guard<std::mutex> guard(ctx.io_mutex);
 
-	if (inst_hstream != hstream_in) {
-		ALT_ERROR(1, "Callback HSTREAM != instance HSTREAM");
+	// a stream stopped or stolen after it ended no longer owns its channel
+	const AltsoundStreamInfo* stream_inst = findStream(hstream_in);
+	if (!stream_inst) {
+		ALT_ERROR(1, "Callback HSTREAM no longer owns a channel");
 
 		ALT_OUTDENT;
 		ALT_DEBUG(0, "END GSoundProcessor::common_callback()");
 		return;
 	}
 
+	const unsigned int inst_hstream = stream_inst->hstream;
 	const unsigned int inst_ch_idx = stream_inst->channel_idx;
 	const AltsoundSampleType stream_type = stream_inst->stream_type;
 
-	BehaviorInfo behavior;
 	switch (stream_type) {
 	case SOLO:
-		behavior = solo_behavior;
-		cur_solo_stream_idx = UNSET_IDX;
+	case CALLOUT:
+	case OVERLAY:
+		cur_stream_idx[TYPE_INDEX[stream_type]] = UNSET_IDX;
 		break;
 
 	case MUSIC:
-		behavior = music_behavior;
 		// DAR@20230706
 		// This callback gets hit when the sample ends even if it's set to loop.
 		// If it's cleaned up here, it will not loop. This is not desirable.  A future
 		// use may be to create an independent music callback that can limit the
 		// number of loops.
-		//cur_mus_stream_idx = UNSET_IDX;
+		//cur_stream_idx[TYPE_INDEX[MUSIC]] = UNSET_IDX;
 		break;
 
 	case SFX:
-		behavior = sfx_behavior;
-		break;
-
-	case CALLOUT:
-		behavior = callout_behavior;
-		cur_callout_stream_idx = UNSET_IDX;
-		break;
-
-	case OVERLAY:
-		behavior = overlay_behavior;
-		cur_overlay_stream_idx = UNSET_IDX;
 		break;
 
 	default:
@@ -819,7 +770,7 @@ void ALTSOUNDCALLBACK GSoundProcessor::common_callback(unsigned int handle, unsi
 	}
 
 	// update ducking behavior tracking
-	postProcessBehaviors(behavior, *stream_inst);
+	postProcessBehaviors(*stream_inst);
 
 	if (stream_type != MUSIC) {
 		// free stream resources
@@ -827,8 +778,7 @@ void ALTSOUNDCALLBACK GSoundProcessor::common_callback(unsigned int handle, unsi
 			ALT_ERROR(1, "FAILED AltsoundProcessorBase::free_stream(%u): %s", inst_hstream, get_miniaudio_err());
 		}
 
-		delete channel_stream[inst_ch_idx];
-		channel_stream[inst_ch_idx] = nullptr;
+		ctx.channel_stream.release(inst_ch_idx);
 	}
 
 	// re-adjust stream volumes
@@ -850,36 +800,26 @@ bool GSoundProcessor::adjustStreamVolumes()
 	ALT_INFO(0, "BEGIN GSoundProcessor::adjustStreamVolumes()");
 	ALT_INDENT;
 
+	AltsoundStageTimer timer(ctx.metrics, ALTSOUND_STAGE_ADJUST_VOLUMES);
+
 	bool success = true;
 	int num_x_streams = 0;
 
-	for (const auto& streamPtr : channel_stream) {
+	for (const auto& streamPtr : ctx.channel_stream) {
 		if (!streamPtr) continue; // Stream is not defined
 
 		const auto& stream = *streamPtr; // Dereference pointer for readability
 		float ducking_value = 1.0f;
 
-		const float grp_vol = behavior_map[stream.stream_type]->group_vol;
-
 		const AltsoundSampleType stream_type = stream.stream_type;
+		const int type_idx = toTypeIndex(stream_type);
 
-		switch (stream_type) {
-		case MUSIC:
-			ducking_value = findLowestDuckVolume(MUSIC);
-			break;
-		case CALLOUT:
-			ducking_value = findLowestDuckVolume(CALLOUT);
-			break;
-		case SFX:
-			ducking_value = findLowestDuckVolume(SFX);
-			break;
-		case SOLO:
-			ducking_value = findLowestDuckVolume(SOLO);
-			break;
-		case OVERLAY:
-			ducking_value = findLowestDuckVolume(OVERLAY);
-			break;
-		default:
+		float grp_vol = 1.0f;
+		if (type_idx >= 0) {
+			grp_vol = group_vol[type_idx];
+			ducking_value = findLowestDuckVolume(stream_type);
+		}
+		else {
 			ALT_WARNING(1, "Sample type not found. Using default");
 		}
 
@@ -911,10 +851,28 @@ bool GSoundProcessor::processPausedStreams()
 	ALT_DEBUG(0, "BEGIN GSoundProcessor::processPausedStreams()");
 	ALT_INDENT;
 
+	// Only sample types whose last pausing stream ended since the last call
+	// have anything to resume, and only on the slots their pausing paused
 	bool success = true;
-	for (const auto* stream : channel_stream) {
-		if (stream) {
-			success &= tryResumeStream(*stream);
+	while (resume_pending) {
+		const int type_idx = std::countr_zero(resume_pending);
+		resume_pending &= resume_pending - 1;
+
+		if (pause_count[type_idx] > 0)
+			continue; // paused again in the meantime
+
+		const SlotMask slots = paused_slots[type_idx];
+		paused_slots[type_idx] = SlotMask();
+		for (unsigned int word = 0; word < slots.size(); ++word) {
+			for (uint64_t bits = slots[word]; bits; bits &= bits - 1) {
+				const unsigned int slot = word * 64 + static_cast<unsigned int>(std::countr_zero(bits));
+
+				// the slot may have been reused by another sample type
+				const AltsoundStreamInfo* stream = ctx.channel_stream[slot];
+				if (stream && stream->stream_type == INDEX_TYPE[type_idx]) {
+					success &= tryResumeStream(*stream);
+				}
+			}
 		}
 	}
 
@@ -930,29 +888,24 @@ bool GSoundProcessor::tryResumeStream(const AltsoundStreamInfo& stream)
 	ALT_DEBUG(0, "BEGIN GSoundProcessor::tryResumeStream()");
 	ALT_INDENT;
 
-	// Find the pause map for the stream type
-	auto pauseStatusMapIter = paused_status_map.find(stream.stream_type);
+	const int type_idx = toTypeIndex(stream.stream_type);
 
 	// If the stream type is not found, log an error and return
-	if (pauseStatusMapIter == paused_status_map.end()) {
+	if (type_idx < 0) {
 		ALT_ERROR(1, "Unknown stream type");
 		ALT_OUTDENT;
 		ALT_DEBUG(0, "END GSoundProcessor::tryResumeStream()");
 		return false;
 	}
 
-	// Get a reference to the relevant pause map
-	const auto& pauseMap = *pauseStatusMapIter->second;
-
-	// Search the pause map for any value that is true (indicating a pause)
-	const bool shouldRemainPaused = std::any_of(pauseMap.begin(), pauseMap.end(),
-		[](const auto& valuePair) { return valuePair.second; });
+	// Any stream still pausing the type keeps it paused
+	const bool shouldRemainPaused = pause_count[type_idx] > 0;
 
 	if (!shouldRemainPaused) {
 		unsigned int hstream = stream.hstream;
 
-		if (MiniAudio_ChannelIsActive(hstream) == MINIAUDIO_ACTIVE_PAUSED) {
-			if (!MiniAudio_ChannelPlay(hstream, false)) {
+		if (MiniAudio_ChannelIsActive(ctx, hstream) == MINIAUDIO_ACTIVE_PAUSED) {
+			if (!MiniAudio_ChannelPlay(ctx, hstream, false)) {
 				ALT_ERROR(1, "FAILED MiniAudio_ChannelPlay(%u): %s", hstream, get_miniaudio_err());
 				ALT_OUTDENT;
 				ALT_DEBUG(0, "END GSoundProcessor::tryResumeStream()");
@@ -968,35 +921,16 @@ bool GSoundProcessor::tryResumeStream(const AltsoundStreamInfo& stream)
 }
 
 // ----------------------------------------------------------------------------
-// Helper function to find the lowest volume in the ducking map associated
-// with the passed-in stream type
+// Helper function to find the lowest ducking volume imposed on the passed-in
+// stream type.  The minimum is maintained as impacts are added and removed
 // ----------------------------------------------------------------------------
 
-float GSoundProcessor::findLowestDuckVolume(AltsoundSampleType stream_type)
+float GSoundProcessor::findLowestDuckVolume(AltsoundSampleType stream_type) const
 {
-	ALT_DEBUG(0, "BEGIN GSoundProcessor::findLowestDuckVolume()");
-	ALT_INDENT;
-
-	const auto map = duck_vol_map[stream_type];
-
-	if (map->empty()) {
-		// If there are no entries in the map, return the default volume.
-		ALT_DEBUG(1, "%s duck_vol_map is empty()", toString(stream_type));
-
-		ALT_OUTDENT;
-		ALT_DEBUG(0, "END GSoundProcessor::findLowestDuckVolume()");
-		return 1.0f;
-	}
-
-	// Search for lowest volume in the map, defaulting to 1.0f if empty
-	const float min_vol = std::accumulate(map->begin(), map->end(), 1.0f,
-		[](float currentMin, const auto& pair) { return std::min(currentMin, pair.second); });
+	const int type_idx = toTypeIndex(stream_type);
+	const float min_vol = type_idx >= 0 ? min_duck_vol[type_idx] : 1.0f;
 
 	ALT_DEBUG(1, "Min ducking value for %s streams: %.02f", toString(stream_type), min_vol);
-
-
-	ALT_OUTDENT;
-	ALT_DEBUG(0, "END GSoundProcessor::findLowestDuckVolume()");
 	return min_vol;
 }
 
@@ -1004,30 +938,32 @@ float GSoundProcessor::findLowestDuckVolume(AltsoundSampleType stream_type)
 // Helper DEBUG functions to output all behavior bookkeeping data
 // ---------------------------------------------------------------------------
 
-void GSoundProcessor::printBehaviorData() {
+#if ALT_LOG_ENABLED(DEBUG)
+void GSoundProcessor::printBehaviorData() const {
 	ALT_DEBUG(0, "BEGIN GSoundProcessor::printBehaviorData()");
 	ALT_INDENT;
 
-	ALT_DEBUG(0, "Printing duck_vol_map:");
-	for (const auto& duckPair : duck_vol_map) {
-		const char* streamTypeStr = toString(duckPair.first);
-		ALT_DEBUG(0, "Stream Type: %s", streamTypeStr);
-		for (const auto& volPair : *(duckPair.second)) {
-			ALT_DEBUG(0, "Stream ID: %lu, Duck Volume: %f", volPair.first, volPair.second);
+	ALT_DEBUG(0, "Printing ducking impacts:");
+	for (int t = 0; t < NUM_STREAM_TYPES; ++t) {
+		ALT_DEBUG(0, "Stream Type: %s, Min Duck Volume: %f", toString(INDEX_TYPE[t]), min_duck_vol[t]);
+		for (unsigned int slot = 0; slot < ctx.channel_stream.size(); ++slot) {
+			if (duck_vol[t][slot] != 1.0f)
+				ALT_DEBUG(0, "Stream ID: %u, Duck Volume: %f", impact_owner[slot], duck_vol[t][slot]);
 		}
 	}
 
-	ALT_DEBUG(0, "Printing paused_status_map:");
-	for (const auto& pausedPair : paused_status_map) {
-		const char* streamTypeStr = toString(pausedPair.first);
-		ALT_DEBUG(0, "Stream Type: %s", streamTypeStr);
-		for (const auto& statusPair : *(pausedPair.second)) {
-			ALT_DEBUG(0, "Stream ID: %lu, Pause Status: %s", statusPair.first, statusPair.second ? "true" : "false");
+	ALT_DEBUG(0, "Printing pausing impacts:");
+	for (int t = 0; t < NUM_STREAM_TYPES; ++t) {
+		ALT_DEBUG(0, "Stream Type: %s, Pausing Streams: %u", toString(INDEX_TYPE[t]), pause_count[t]);
+		for (unsigned int slot = 0; slot < ctx.channel_stream.size(); ++slot) {
+			if (pausing[t][slot])
+				ALT_DEBUG(0, "Stream ID: %u, Pause Status: true", impact_owner[slot]);
 		}
 	}
 
 	ALT_OUTDENT;
 	ALT_DEBUG(0, "END GSoundProcessor::printBehaviorData()");
 }
+#endif
 
 // ----------------------------------------------------------------------------
@@ -22,9 +22,13 @@
 
 #include "altsound_processor_base.hpp"
 #include "altsound_logger.hpp"
+#include "altsound_sample_index.hpp"
 
+#include <array>
 #include <random>
 
+class AltsoundIniProcessor;
+
 constexpr int NUM_STREAM_TYPES = 5;
 
 // ---------------------------------------------------------------------------
@@ -41,8 +45,9 @@ public:
 	// Copy Constructor
 	GSoundProcessor(GSoundProcessor&) = delete;
 
-	// Standard constructor
-	GSoundProcessor(const string& game_name, const string& vpm_path);
+	// Standard constructor.  Sample type behaviors are copied from ini_in
+	GSoundProcessor(AltSoundContext& ctx_in, const AltsoundIniProcessor& ini_in,
+	                const string& game_name, const string& vpm_path);
 
 	// Destructor
 	~GSoundProcessor();
@@ -50,11 +55,16 @@ public:
 	// External interface to stop MUSIC stream
 	bool stopMusic() override;
 
+	// List of parsed samples for the background preloader
+	std::vector<PreloadItem> getPreloadItems() const override;
+
 	// Process ROM commands to the sound board
 	bool handleCmd(const unsigned int cmd_combined_in) override;
 
+#if ALT_LOG_ENABLED(DEBUG)
 	// DEBUG helper fns to print all behavior data
-	static void printBehaviorData();
+	void printBehaviorData() const;
+#endif
 
 protected:
 
@@ -69,6 +79,9 @@ private: // functions
 	// find sample matching provided command
 	unsigned int getSample(const unsigned int cmd_combined_in) override;
 
+	// drop behavior impacts and tracking of a stream that is being stolen
+	void forgetStream(const AltsoundStreamInfo& stream) override;
+
 	// process stream commands
 	bool processStream(const BehaviorInfo& behavior, AltsoundStreamInfo* stream_out);
 
@@ -76,32 +89,125 @@ private: // functions
 	bool processBehaviors(const BehaviorInfo& behavior, const AltsoundStreamInfo* stream);
 
 	// Update behavior impacts when streams end
-	static bool postProcessBehaviors(const BehaviorInfo& behavior, const AltsoundStreamInfo& finished_stream);
+	bool postProcessBehaviors(const AltsoundStreamInfo& finished_stream);
 
 	// Stop the exclusive stream referenced by stream_ptr
 	bool stopExclusiveStream(const AltsoundSampleType stream_type);
 
-	// BASS SYNCPROC callback whan a stream ends
+	// BASS SYNCPROC callback whan a stream ends.  user is the processor
 	static void ALTSOUNDCALLBACK common_callback(unsigned int handle, unsigned int channel, unsigned int data, void* user);
 
+	// handle the end of a stream
+	void streamEnded(unsigned int hsync, unsigned int hstream_in);
+
 	// adjust volume of active streams to accommodate current ducking impacts
-	static bool adjustStreamVolumes();
+	bool adjustStreamVolumes();
 
 	// determine lowest ducking volume impacts on stream_type
-	static float findLowestDuckVolume(AltsoundSampleType stream_type);
+	float findLowestDuckVolume(AltsoundSampleType stream_type) const;
 
-	// process PAUSED behavior impacts for all streams
-	static bool processPausedStreams();
+	// resume streams of sample types that are no longer paused
+	bool processPausedStreams();
 
 	// resume paused playback on streams that no longer need to be paused
-	static bool tryResumeStream(const AltsoundStreamInfo& stream);
+	bool tryResumeStream(const AltsoundStreamInfo& stream);
+
+	// Set the ducking volume a slot imposes on a sample type, keeping the minimum
+	void setDuckImpact(int type_idx, unsigned int slot, float vol);
+
+	// Set whether a slot pauses a sample type, keeping the pausing stream count
+	void setPauseImpact(int type_idx, unsigned int slot, bool paused);
+
+	// Remove all impacts a slot holds
+	void clearSlotImpacts(unsigned int slot);
+
+	// Forget all impacts
+	void resetBehaviorImpacts();
 
 private: // data
 
 	bool is_initialized;
 	bool is_stable; // future use
-	std::vector<GSoundSampleInfo> samples;
+	std::vector<GSoundSampleInfo> samples; // sorted by ID
+	AltsoundSampleIndex sample_index;
 	std::mt19937 generator; // mersenne twister
+
+	// DAR@20230719
+	// Sample type behaviors determine what impacts they will have on other sample
+	// types.  For example, music_behavior defines what impacts MUSIC samples have
+	// on other non-MUSIC sample types.
+	//
+	// NOTE: With the exception of STOP, self-impacting behaviors are not supported.
+	BehaviorInfo music_behavior;
+	BehaviorInfo callout_behavior;
+	BehaviorInfo sfx_behavior;
+	BehaviorInfo solo_behavior;
+	BehaviorInfo overlay_behavior;
+
+	// NOTE:
+	// SFX streams don't require tracking since multiple can play simultaneously.
+	// Other than adjusting ducking, they have no other impacts on active streams
+	//
+	// Single-play stream tracking, by bookkeeping index.  The SFX entry is never set
+	std::array<unsigned int, NUM_STREAM_TYPES> cur_stream_idx;
+
+	// DAR@20230719
+	// The arrays below contain the ducking and pausing behavior impacts of sample
+	// types on other sample types.  For example, duck_vol[MUSIC] contains the
+	// impacts on MUSIC volume from the behaviors of the other sample types.
+	// Similarly, pausing[MUSIC] contains the paused status of MUSIC streams based
+	// on the behavior of the other streams.
+	//
+	// The second index is the voice slot (channel_idx) of the stream that set the
+	// impact, and impact_owner records that stream's handle.  This allows the
+	// correct entries to be removed when the affecting stream ends, and stale
+	// entries to be discarded when a slot is reused
+	//
+	// Streams can have overlapping impacts on other streams.  When an affecting
+	// stream ends, it can't be assumed its safe to remove the behavior impact from
+	// the affected sample type.  The lowest ducking volume and the number of
+	// pausing streams are maintained per sample type as impacts come and go, so
+	// the impact is only removed when no stream imposes it anymore
+	static_assert(ALT_MAX_CHANNELS % 64 == 0, "voice slot masks are 64-bit words");
+
+	// one bit per voice slot
+	typedef std::array<uint64_t, ALT_MAX_CHANNELS / 64> SlotMask;
+
+	// stream whose impacts each voice slot holds, MINIAUDIO_NO_STREAM when none
+	std::array<unsigned int, ALT_MAX_CHANNELS> impact_owner;
+
+	// ducking volume each slot's stream imposes on each sample type, 1.0f when none
+	float duck_vol[NUM_STREAM_TYPES][ALT_MAX_CHANNELS];
+
+	// lowest value in each duck_vol row
+	std::array<float, NUM_STREAM_TYPES> min_duck_vol;
+
+	// whether each slot's stream pauses each sample type
+	bool pausing[NUM_STREAM_TYPES][ALT_MAX_CHANNELS];
+
+	// number of streams pausing each sample type
+	std::array<unsigned int, NUM_STREAM_TYPES> pause_count;
+
+	// voice slots paused by behaviors, per sample type
+	std::array<SlotMask, NUM_STREAM_TYPES> paused_slots;
+
+	// sample types no longer paused by any stream, as a bit mask by bookkeeping
+	// index, waiting for processPausedStreams() to resume them
+	uint32_t resume_pending;
+
+	// DAR@20230712
+	// A common mixing board function is to set gain levels for individual tracks
+	// and then apply a group volume to change volume for a group of tracks. while
+	// maintaining relative individual volumes.  For example, if we have 3 MUSIC
+	// tracks with 90, 60, 55 gain levels individually, setting the group volume
+	// to 90 will duck all MUSIC tracks by 10% while maintaining the volume
+	// relationships between the individual tracks.  Each index into the array
+	// represents the sample type they apply to.  For example, index 0 is MUSIC
+	// group volume.  Index 1 is CALLOUT These values can be set in
+	// the configuration file
+	//
+	// Group volumes for sample types
+	std::array<float, NUM_STREAM_TYPES> group_vol = { 1.0f, 1.0f, 1.0f, 1.0f, 1.0f };
 };
 
 // ---------------------------------------------------------------------------
@@ -10,153 +10,447 @@
 
 #include "miniaudio_bass_compat.hpp"
 #include "miniaudio_private.h"
-#include "altsound_data.hpp"
+#include "altsound_context.hpp"
 #include "altsound_logger.hpp"
 
-#include <unordered_map>
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <memory>
 #include <mutex>
 
-extern StreamArray channel_stream;
-extern std::unordered_map<unsigned int, _internal_stream_data> g_streamMap;
-extern std::mutex g_streamMapMutex;
-extern uint32_t g_nextStreamId;
-extern uint32_t g_channels;
-extern uint32_t g_sampleRate;
-extern ma_engine* g_engine;
+thread_local int g_last_ma_err = 0;
 
-std::vector<EndedStream> g_endedStreams;
-std::mutex g_endedMutex;
+// ---------------------------------------------------------------------------
+// Stream slots
+//
+// A stream handle encodes a slot index (low bits) and the slot's generation
+// (high bits). Freeing a stream bumps the generation, so stale handles stop
+// resolving instead of aliasing a newer stream. The generation never wraps
+// to 0, so a valid handle is never MINIAUDIO_NO_STREAM. A slot's index is
+// also its voice in the mixer.
+//
+// Only the handle and playback state are shared with the audio thread, as
+// atomics. Everything else in a slot is written by the command path, which
+// the processors already serialize with the context's io_mutex.  Handles are
+// only meaningful within the context that created them.
+// ---------------------------------------------------------------------------
+
+#define STREAM_INDEX_BITS 10
+#define STREAM_INDEX_MASK ((1u << STREAM_INDEX_BITS) - 1)
+#define STREAM_MAX_SLOTS (1u << STREAM_INDEX_BITS)
+
+// Resolve a handle to its slot. Returns nullptr for stale or invalid handles
+static inline StreamSlot* MiniAudio_StreamSlot(AltSoundContext& ctx, unsigned int hstream)
+{
+	const unsigned int index = hstream & STREAM_INDEX_MASK;
+	if (hstream == MINIAUDIO_NO_STREAM || index >= ctx.streams.slot_count)
+		return nullptr;
+
+	StreamSlot* slot = &ctx.streams.slots[index];
+	return slot->hstream.load(std::memory_order_acquire) == hstream ? slot : nullptr;
+}
 
-// Fired by miniAudio (audio thread) the moment a non-looping sound reaches its
+// Fired by the mixer (audio thread) the moment a non-looping voice reaches its
 // end. We only mark the stream and queue its SYNCPROC here; the actual firing
-// (which frees the sound) happens later from the engine's onProcess, as the
-// sound must not be uninitialized from within this callback
-static void MiniAudio_StreamEndCallback(void* pUserData, ma_sound* pSound)
+// (which frees the stream) happens on the housekeeping thread, as the voice
+// must not be cleared from within this callback
+static void MiniAudio_VoiceEndCallback(unsigned int voice, void* user)
+{
+	AltSoundContext& ctx = *static_cast<AltSoundContext*>(user);
+
+	// clearing a voice waits for the mixer, so the slot cannot be released
+	// while this runs
+	StreamSlot* slot = &ctx.streams.slots[voice];
+	const unsigned int hstream = slot->hstream.load(std::memory_order_acquire);
+	if (hstream == MINIAUDIO_NO_STREAM)
+		return;
+
+	slot->state.store(MINIAUDIO_ACTIVE_STOPPED, std::memory_order_release);
+	ctx.trace.instant("StreamEnd", "hstream", hstream);
+	const SYNCPROC callback = slot->sync_callback.load(std::memory_order_acquire);
+	if (callback) {
+		EndedStream ended;
+		ended.callback = callback;
+		ended.hsync = slot->hsync;
+		ended.hstream = hstream;
+		ended.userdata = slot->sync_userdata;
+		ctx.housekeeper.post(ended);
+	}
+}
+
+// Determine if a sample is long enough to stream through the read-ahead
+// thread. Samples of unknown length are treated as long
+static bool MiniAudio_IsLongSample(AltSoundContext& ctx, ma_decoder* decoder)
+{
+	if (!ctx.read_ahead.isRunning())
+		return false;
+
+	ma_uint64 frame_count = 0;
+	if (altsound_ma_decoder_get_length_in_pcm_frames(decoder, &frame_count) != MA_SUCCESS || frame_count == 0)
+		return true;
+
+	return frame_count * 1000 / decoder->outputSampleRate > ctx.read_ahead_threshold_ms;
+}
+
+// Determine if a sample is short enough to decode on the command path when it
+// is first played, without delaying its start noticeably
+static bool MiniAudio_IsQuickDecode(ma_decoder* decoder)
+{
+	ma_uint64 frame_count = 0;
+	if (altsound_ma_decoder_get_length_in_pcm_frames(decoder, &frame_count) != MA_SUCCESS || frame_count == 0)
+		return false;
+
+	return frame_count * 1000 / decoder->outputSampleRate <= ALT_SAMPLE_CACHE_ON_PLAY_MAX_MS;
+}
+
+// Decode the whole of an open decoder into a cache entry, converted once to
+// the output rate. Returns nullptr if the decoder does not report a length or
+// the sample is too large to cache or long enough to stream ahead
+static CachedSamplePtr MiniAudio_DecodeToCache(AltSoundContext& ctx, ma_decoder* decoder)
+{
+	ma_uint64 frame_count = 0;
+	if (altsound_ma_decoder_get_length_in_pcm_frames(decoder, &frame_count) != MA_SUCCESS || frame_count == 0
+	    || MiniAudio_IsLongSample(ctx, decoder))
+		return nullptr;
+
+	const uint32_t channels = decoder->outputChannels;
+	const uint32_t sample_rate = decoder->outputSampleRate;
+	const uint64_t bytes = frame_count * ctx.sample_rate / sample_rate * channels * sizeof(float);
+	if (bytes > ctx.sample_cache.getMaxEntryBytes())
+		return nullptr;
+
+	// samples at the output rate decode straight into the entry
+	auto sample = std::make_shared<CachedSample>();
+	std::vector<float> decoded;
+	std::vector<float>& pcm = sample_rate == ctx.sample_rate ? sample->pcm : decoded;
+	pcm.resize(static_cast<size_t>(frame_count * channels));
+
+	ma_uint64 frames_read = 0;
+	const ma_result result = altsound_ma_decoder_read_pcm_frames(decoder, pcm.data(), frame_count, &frames_read);
+	if ((result != MA_SUCCESS && result != MA_AT_END) || frames_read == 0)
+		return nullptr;
+
+	// reported length is an estimate for some formats
+	pcm.resize(static_cast<size_t>(frames_read * channels));
+
+	if (sample_rate != ctx.sample_rate
+	    && !altsound_resample(decoded.data(), frames_read, channels, sample_rate, ctx.sample_rate, ctx.resample_quality, sample->pcm))
+		return nullptr;
+
+	sample->channels = channels;
+	sample->sample_rate = ctx.sample_rate;
+	sample->frame_count = sample->pcm.size() / channels;
+	return sample;
+}
+
+// Open a decoder with an output channel count and rate (0 for the file's own)
+static ma_result MiniAudio_DecoderOpen(bool mem, const void* file, unsigned long long length, uint32_t channels,
+                                       uint32_t sample_rate, ma_decoder* decoder)
+{
+	ma_decoder_config config = altsound_ma_decoder_config_init(ma_format_f32, channels, sample_rate);
+	if (mem)
+		return altsound_ma_decoder_init_memory(file, static_cast<size_t>(length), &config, decoder);
+
+	return altsound_ma_decoder_init_file(static_cast<const char*>(file), &config, decoder);
+}
+
+// Open a decoder on a sample file (mem = false, file is a path) or on encoded
+// sample data in memory (mem = true, file points to length bytes). Output is
+// float at sample_rate (0 for the file's own). Mono samples stay mono, as the
+// mixer spreads them over the output channels; other layouts are converted
+// to the output's
+static ma_result MiniAudio_DecoderInit(AltSoundContext& ctx, bool mem, const void* file, unsigned long long length,
+                                       uint32_t sample_rate, ma_decoder* decoder)
 {
-	const unsigned int hstream = static_cast<unsigned int>(reinterpret_cast<uintptr_t>(pUserData));
+	const ma_result result = MiniAudio_DecoderOpen(mem, file, length, 0, sample_rate, decoder);
+	if (result != MA_SUCCESS || decoder->outputChannels == 1 || decoder->outputChannels == ctx.channels)
+		return result;
 
-	std::lock_guard<std::mutex> lock(g_streamMapMutex);
-	auto it = g_streamMap.find(hstream);
-	if (it == g_streamMap.end())
+	altsound_ma_decoder_uninit(decoder);
+	return MiniAudio_DecoderOpen(mem, file, length, ctx.channels, sample_rate, decoder);
+}
+
+// Sample cache key.  Memory samples live in the mapped .altpack for the whole
+// session, so their address identifies them
+std::string MiniAudio_SampleKey(bool mem, const void* file, unsigned long long length)
+{
+	if (!mem)
+		return static_cast<const char*>(file);
+
+	char key[48];
+	snprintf(key, sizeof(key), "mem:%p:%llu", file, length);
+	return key;
+}
+
+// Fully decode a sample for the cache, at its own rate, and resample it to the
+// output rate. Returns nullptr on failure or if the sample is too large to
+// cache
+CachedSamplePtr MiniAudio_SampleDecode(AltSoundContext& ctx, bool mem, const void* file, unsigned long long length)
+{
+	ma_decoder decoder;
+	if (MiniAudio_DecoderInit(ctx, mem, file, length, 0, &decoder) != MA_SUCCESS)
+		return nullptr;
+
+	CachedSamplePtr sample = MiniAudio_DecodeToCache(ctx, &decoder);
+	altsound_ma_decoder_uninit(&decoder);
+	return sample;
+}
+
+// Uninitialize a stream's decoder and return it to its pool. The stream's
+// voice must be cleared first
+static void MiniAudio_StreamRelease(AltSoundContext& ctx, _internal_stream_data& data)
+{
+	if (data.read_ahead)
+		ctx.read_ahead.close(data.read_ahead);
+
+	if (data.decoder) {
+		altsound_ma_decoder_uninit(data.decoder);
+		ctx.streams.decoder_pool.release(data.decoder);
+	}
+
+	data = _internal_stream_data(); // drops the cached PCM reference
+}
+
+// Stop a stream's voice and move it back to its first frame
+static void MiniAudio_StreamRewind(AltSoundContext& ctx, StreamSlot& slot, unsigned int voice)
+{
+	ctx.mixer.rewind(voice);
+	if (slot.data.read_ahead)
+		ctx.read_ahead.rewind(slot.data.read_ahead);
+}
+
+// Invalidate a released slot's handle and return it to the free list
+static void MiniAudio_StreamRetire(AltSoundContext& ctx, StreamSlot& slot)
+{
+	slot.hstream.store(MINIAUDIO_NO_STREAM, std::memory_order_release);
+	slot.state.store(MINIAUDIO_ACTIVE_STOPPED, std::memory_order_relaxed);
+	slot.sync_callback.store(nullptr, std::memory_order_relaxed);
+	slot.channel_idx = -1;
+
+	// skip 0 so the next handle can never be MINIAUDIO_NO_STREAM
+	slot.generation = (slot.generation + 1) & (UINT32_MAX >> STREAM_INDEX_BITS);
+	if (slot.generation == 0)
+		slot.generation = 1;
+
+	std::lock_guard<std::mutex> lock(ctx.streams.free_slots_mutex);
+	ctx.streams.free_slots.push_back(static_cast<unsigned int>(&slot - &ctx.streams.slots[0]));
+}
+
+// Free the slots of stolen streams that have faded out. If no slot is free,
+// the oldest fade is cut short for the new stream
+static void MiniAudio_ReclaimFadedStreams(AltSoundContext& ctx)
+{
+	if (ctx.streams.fading.empty())
 		return;
 
-	it->second.playing = false;
-	if (it->second.sync_callback) {
-		std::lock_guard<std::mutex> endLock(g_endedMutex);
-		g_endedStreams.push_back({ it->second.sync_callback, it->second.hsync, hstream, it->second.sync_userdata });
+	auto faded = std::remove_if(ctx.streams.fading.begin(), ctx.streams.fading.end(), [&ctx](unsigned int hstream) {
+		if (ctx.mixer.isPlaying(hstream & STREAM_INDEX_MASK))
+			return false;
+		MiniAudio_StreamFree(ctx, hstream);
+		return true;
+	});
+	ctx.streams.fading.erase(faded, ctx.streams.fading.end());
+
+	bool slot_free;
+	{
+		std::lock_guard<std::mutex> lock(ctx.streams.free_slots_mutex);
+		slot_free = !ctx.streams.free_slots.empty();
+	}
+	if (!slot_free && !ctx.streams.fading.empty()) {
+		MiniAudio_StreamFree(ctx, ctx.streams.fading.front());
+		ctx.streams.fading.erase(ctx.streams.fading.begin());
 	}
 }
 
-unsigned int MiniAudio_StreamCreateFile(bool mem, const std::string& file, unsigned long long length, bool loop)
+unsigned int MiniAudio_StreamCreateFile(AltSoundContext& ctx, bool mem, const void* file, unsigned long long length, bool loop)
 {
-	if (file.empty()) {
+	AltsoundStageTimer timer(ctx.metrics, ALTSOUND_STAGE_STREAM_CREATE);
+	AltsoundTraceScope trace_scope(ctx.trace, "StreamCreate");
+
+	MiniAudio_ReclaimFadedStreams(ctx);
+
+	if (!file || (mem && length == 0) || (!mem && !*static_cast<const char*>(file))) {
 		MiniAudio_ErrorSetCode(MA_INVALID_ARGS);
 		return MINIAUDIO_NO_STREAM;
 	}
 
-	ma_decoder_config config = altsound_ma_decoder_config_init(ma_format_f32, g_channels, g_sampleRate);
-	ma_decoder* decoder = new ma_decoder();
-	ma_result result = altsound_ma_decoder_init_file(file.c_str(), &config, decoder);
-	if (result != MA_SUCCESS) {
-		MiniAudio_ErrorSetCode(result);
-		delete decoder;
-		return MINIAUDIO_NO_STREAM;
+	_internal_stream_data data;
+	data.looping = loop;
+	data.start_frame = ctx.streams.start_frame;
+
+	AltsoundVoiceDesc voice;
+	voice.looping = loop;
+
+	// Pre-decoded PCM in the .altpack at the output format: play it straight
+	// from the mapping
+	if (mem) {
+		uint64_t frame_count = 0;
+		const int16_t* pcm = ctx.sample_pack.findPCM(file, ctx.sample_rate, ctx.channels, frame_count);
+		if (pcm) {
+			voice.source = ALT_VOICE_S16;
+			voice.pcm = pcm;
+			voice.frame_count = frame_count;
+			voice.channels = ctx.channels;
+		}
 	}
 
-	ma_sound* sound = new ma_sound();
-	result = altsound_ma_sound_init_from_decoder(g_engine, decoder, MA_SOUND_FLAG_NO_SPATIALIZATION | MA_SOUND_FLAG_NO_PITCH, sound);
-	if (result != MA_SUCCESS) {
-		MiniAudio_ErrorSetCode(result);
-		altsound_ma_decoder_uninit(decoder);
-		delete decoder;
-		delete sound;
-		return MINIAUDIO_NO_STREAM;
+	if (!voice.pcm) {
+		const std::string key = MiniAudio_SampleKey(mem, file, length);
+
+		// Cache hit: no file I/O or decoding on the command path
+		data.cached = ctx.sample_cache.find(key);
+		if (!data.cached) {
+			// open the streaming decoder, resampling as it goes, once.  Its
+			// length decides how the sample plays
+			ma_decoder* decoder = ctx.streams.decoder_pool.acquire();
+			ma_result result = MiniAudio_DecoderInit(ctx, mem, file, length, ctx.sample_rate, decoder);
+			if (result != MA_SUCCESS) {
+				MiniAudio_ErrorSetCode(result);
+				ctx.streams.decoder_pool.release(decoder);
+				return MINIAUDIO_NO_STREAM;
+			}
+
+			// long samples are decoded ahead on the read-ahead thread.  Very
+			// short ones are cached on their first play, decoded at their own
+			// rate, unless the preloader is running: then they stream this
+			// time and a worker caches them.  Anything longer would hold up
+			// the command, so it streams until the preloader caches it
+			const bool is_long = MiniAudio_IsLongSample(ctx, decoder);
+			if (!is_long && !ctx.preloader.isRunning() && MiniAudio_IsQuickDecode(decoder))
+				data.cached = MiniAudio_SampleDecode(ctx, mem, file, length);
+
+			if (data.cached) {
+				ctx.sample_cache.insert(key, data.cached);
+				altsound_ma_decoder_uninit(decoder);
+				ctx.streams.decoder_pool.release(decoder);
+			}
+			else {
+				data.decoder = decoder;
+				voice.channels = decoder->outputChannels;
+
+				if (is_long) {
+					data.read_ahead = ctx.read_ahead.open(decoder, voice.channels, loop);
+					voice.source = ALT_VOICE_READ_AHEAD;
+					voice.read_ahead = data.read_ahead;
+				}
+				else {
+					// not cached: decoded on the mixing thread
+					voice.source = ALT_VOICE_DECODER;
+					voice.decoder = decoder;
+				}
+			}
+		}
+
+		if (data.cached) {
+			voice.source = ALT_VOICE_F32;
+			voice.pcm = data.cached->pcm.data();
+			voice.frame_count = data.cached->frame_count;
+			voice.channels = data.cached->channels;
+		}
 	}
 
-	altsound_ma_sound_set_looping(sound, loop ? MA_TRUE : MA_FALSE);
+	data.channels = voice.channels;
 
-	unsigned int hstream = g_nextStreamId++;
+	unsigned int index;
+	{
+		std::lock_guard<std::mutex> lock(ctx.streams.free_slots_mutex);
+		if (ctx.streams.free_slots.empty()) {
+			++ctx.streams.slot_misses;
+			index = STREAM_MAX_SLOTS;
+		}
+		else {
+			index = ctx.streams.free_slots.back();
+			ctx.streams.free_slots.pop_back();
+		}
+	}
 
-	altsound_ma_sound_set_end_callback(sound, MiniAudio_StreamEndCallback, reinterpret_cast<void*>(static_cast<uintptr_t>(hstream)));
+	if (index == STREAM_MAX_SLOTS) {
+		// every slot is in use: release what was created above
+		MiniAudio_StreamRelease(ctx, data);
+		MiniAudio_ErrorSetCode(MA_OUT_OF_MEMORY);
+		return MINIAUDIO_NO_STREAM;
+	}
 
-	std::lock_guard<std::mutex> lock(g_streamMapMutex);
-	g_streamMap[hstream] = {
-		.decoder = decoder,
-		.sound = sound,
-		.playing = false,
-		.paused = false,
-		.looping = loop,
-		.sample_rate = decoder->outputSampleRate,
-		.channels = decoder->outputChannels,
-		.sync_callback = nullptr,
-		.sync_userdata = nullptr
-	};
+	StreamSlot* slot = &ctx.streams.slots[index];
+	if (!ctx.mixer.setVoice(index, voice)) {
+		// channel layout the mixer cannot take
+		MiniAudio_StreamRelease(ctx, data);
+		std::lock_guard<std::mutex> lock(ctx.streams.free_slots_mutex);
+		ctx.streams.free_slots.push_back(index);
+		MiniAudio_ErrorSetCode(MA_INVALID_DATA);
+		return MINIAUDIO_NO_STREAM;
+	}
 
+	const unsigned int hstream = (slot->generation << STREAM_INDEX_BITS) | index;
+	slot->data = std::move(data);
+	slot->channel_idx = -1;
+	slot->state.store(MINIAUDIO_ACTIVE_STOPPED, std::memory_order_relaxed);
+	slot->sync_callback.store(nullptr, std::memory_order_relaxed);
+	slot->hstream.store(hstream, std::memory_order_release);
+
+	trace_scope.setArg("hstream", hstream);
 	MiniAudio_ErrorSetCode(MA_SUCCESS);
 	return hstream;
 }
 
-bool MiniAudio_ChannelSetVolume(unsigned int hstream, float value)
+bool MiniAudio_ChannelSetVolume(AltSoundContext& ctx, unsigned int hstream, float value)
 {
 	if (hstream == MINIAUDIO_NO_STREAM) {
 		MiniAudio_ErrorSetCode(MA_INVALID_ARGS);
 		return false;
 	}
 
-	std::lock_guard<std::mutex> lock(g_streamMapMutex);
-	auto it = g_streamMap.find(hstream);
-	if (it == g_streamMap.end()) {
+	StreamSlot* slot = MiniAudio_StreamSlot(ctx, hstream);
+	if (!slot) {
 		MiniAudio_ErrorSetCode(MA_INVALID_ARGS);
 		return false;
 	}
 
-	it->second.volume = value;
-	if (it->second.sound)
-		altsound_ma_sound_set_volume(it->second.sound, value);
+	slot->data.volume = value;
+	ctx.mixer.setVolume(hstream & STREAM_INDEX_MASK, value);
 	MiniAudio_ErrorSetCode(MA_SUCCESS);
 	return true;
 }
 
-bool MiniAudio_ChannelGetVolume(unsigned int hstream, float& value)
+bool MiniAudio_ChannelGetVolume(AltSoundContext& ctx, unsigned int hstream, float& value)
 {
 	if (hstream == MINIAUDIO_NO_STREAM) {
 		MiniAudio_ErrorSetCode(MA_INVALID_ARGS);
 		return false;
 	}
 
-	std::lock_guard<std::mutex> lock(g_streamMapMutex);
-	const auto it = g_streamMap.find(hstream);
-	if (it == g_streamMap.end()) {
+	StreamSlot* slot = MiniAudio_StreamSlot(ctx, hstream);
+	if (!slot) {
 		MiniAudio_ErrorSetCode(MA_INVALID_ARGS);
 		return false;
 	}
 
-	value = it->second.volume;
+	value = slot->data.volume;
 	MiniAudio_ErrorSetCode(MA_SUCCESS);
 	return true;
 }
 
-unsigned int MiniAudio_ChannelSetSync(unsigned int hstream, unsigned int type, void* proc, void* user)
+unsigned int MiniAudio_ChannelSetSync(AltSoundContext& ctx, unsigned int hstream, unsigned int type, void* proc, void* user)
 {
 	if (hstream == MINIAUDIO_NO_STREAM || !proc) {
 		MiniAudio_ErrorSetCode(MA_INVALID_ARGS);
 		return 0;
 	}
 
-	std::lock_guard<std::mutex> lock(g_streamMapMutex);
-	auto it = g_streamMap.find(hstream);
-	if (it == g_streamMap.end()) {
+	StreamSlot* slot = MiniAudio_StreamSlot(ctx, hstream);
+	if (!slot) {
 		MiniAudio_ErrorSetCode(MA_INVALID_ARGS);
 		return 0;
 	}
 
 	if (type & MINIAUDIO_SYNC_END) {
-		it->second.sync_callback = reinterpret_cast<SYNCPROC>(proc);
-		it->second.sync_userdata = user;
+		unsigned int hsync = ctx.streams.next_sync++;
+		slot->sync_userdata = user;
+		slot->hsync = hsync;
 
-		static unsigned int sync_id = 1;
-		unsigned int hsync = sync_id++;
-		it->second.hsync = hsync;
+		// publishes sync_userdata and hsync to the end callback
+		slot->sync_callback.store(reinterpret_cast<SYNCPROC>(proc), std::memory_order_release);
 		MiniAudio_ErrorSetCode(MA_SUCCESS);
 		return hsync;
 	}
@@ -164,141 +458,234 @@ unsigned int MiniAudio_ChannelSetSync(unsigned int hstream, unsigned int type, v
 	return 0;
 }
 
-bool MiniAudio_ChannelPlay(unsigned int hstream, bool restart)
+bool MiniAudio_ChannelPlay(AltSoundContext& ctx, unsigned int hstream, bool restart)
 {
 	if (hstream == MINIAUDIO_NO_STREAM) {
 		MiniAudio_ErrorSetCode(MA_INVALID_ARGS);
 		return false;
 	}
 
-	std::lock_guard<std::mutex> lock(g_streamMapMutex);
-	auto it = g_streamMap.find(hstream);
-	if (it == g_streamMap.end()) {
+	StreamSlot* slot = MiniAudio_StreamSlot(ctx, hstream);
+	if (!slot) {
 		MiniAudio_ErrorSetCode(MA_INVALID_ARGS);
 		return false;
 	}
 
-	if (restart && it->second.sound) {
-		altsound_ma_sound_seek_to_pcm_frame(it->second.sound, 0);
-	}
+	const unsigned int voice = hstream & STREAM_INDEX_MASK;
+	if (restart)
+		MiniAudio_StreamRewind(ctx, *slot, voice);
 
-	if (it->second.sound) {
-		altsound_ma_sound_set_volume(it->second.sound, it->second.volume);
-		altsound_ma_sound_start(it->second.sound);
-	}
+	ctx.trace.instant("StreamPlay", "hstream", hstream);
+
+	// set before starting, so a sound that ends right away is not left
+	// marked as playing
+	slot->state.store(MINIAUDIO_ACTIVE_PLAYING, std::memory_order_release);
 
-	it->second.playing = true;
-	it->second.paused = false;
+	ctx.mixer.setVolume(voice, slot->data.volume);
+
+	// a scheduled start applies to the first play only
+	ctx.mixer.play(voice, slot->data.start_frame);
+	slot->data.start_frame = 0;
 	MiniAudio_ErrorSetCode(MA_SUCCESS);
 	return true;
 }
 
-bool MiniAudio_ChannelPause(unsigned int hstream)
+bool MiniAudio_ChannelPause(AltSoundContext& ctx, unsigned int hstream)
 {
 	if (hstream == MINIAUDIO_NO_STREAM) {
 		MiniAudio_ErrorSetCode(MA_INVALID_ARGS);
 		return false;
 	}
 
-	std::lock_guard<std::mutex> lock(g_streamMapMutex);
-	auto it = g_streamMap.find(hstream);
-	if (it == g_streamMap.end()) {
+	StreamSlot* slot = MiniAudio_StreamSlot(ctx, hstream);
+	if (!slot) {
 		MiniAudio_ErrorSetCode(MA_INVALID_ARGS);
 		return false;
 	}
 
-	if (it->second.sound)
-		altsound_ma_sound_stop(it->second.sound);
+	ctx.trace.instant("StreamPause", "hstream", hstream);
+
+	ctx.mixer.pause(hstream & STREAM_INDEX_MASK);
 
-	it->second.paused = true;
+	slot->state.store(MINIAUDIO_ACTIVE_PAUSED, std::memory_order_release);
 	MiniAudio_ErrorSetCode(MA_SUCCESS);
 	return true;
 }
 
-bool MiniAudio_ChannelStop(unsigned int hstream)
+bool MiniAudio_ChannelStop(AltSoundContext& ctx, unsigned int hstream)
 {
 	if (hstream == MINIAUDIO_NO_STREAM) {
 		MiniAudio_ErrorSetCode(MA_INVALID_ARGS);
 		return false;
 	}
 
-	std::lock_guard<std::mutex> lock(g_streamMapMutex);
-	auto it = g_streamMap.find(hstream);
-	if (it == g_streamMap.end()) {
+	StreamSlot* slot = MiniAudio_StreamSlot(ctx, hstream);
+	if (!slot) {
 		MiniAudio_ErrorSetCode(MA_INVALID_ARGS);
 		return false;
 	}
 
-	if (it->second.sound) {
-		altsound_ma_sound_stop(it->second.sound);
-		altsound_ma_sound_seek_to_pcm_frame(it->second.sound, 0);
-	}
+	ctx.trace.instant("StreamStop", "hstream", hstream);
+
+	MiniAudio_StreamRewind(ctx, *slot, hstream & STREAM_INDEX_MASK);
 
-	it->second.playing = false;
-	it->second.paused = false;
+	slot->state.store(MINIAUDIO_ACTIVE_STOPPED, std::memory_order_release);
 	MiniAudio_ErrorSetCode(MA_SUCCESS);
 	return true;
 }
 
-bool MiniAudio_StreamFree(unsigned int hstream)
+bool MiniAudio_StreamSetChannel(AltSoundContext& ctx, unsigned int hstream, unsigned int channel_idx)
 {
-	if (hstream == MINIAUDIO_NO_STREAM) {
+	StreamSlot* slot = MiniAudio_StreamSlot(ctx, hstream);
+	if (!slot || channel_idx >= ctx.channel_stream.size()) {
 		MiniAudio_ErrorSetCode(MA_INVALID_ARGS);
 		return false;
 	}
 
-	std::lock_guard<std::mutex> lock(g_streamMapMutex);
-	auto it = g_streamMap.find(hstream);
-	if (it == g_streamMap.end()) {
+	slot->channel_idx = static_cast<int>(channel_idx);
+	MiniAudio_ErrorSetCode(MA_SUCCESS);
+	return true;
+}
+
+bool MiniAudio_StreamGetChannel(AltSoundContext& ctx, unsigned int hstream, unsigned int& channel_idx)
+{
+	const StreamSlot* slot = MiniAudio_StreamSlot(ctx, hstream);
+	if (!slot || slot->channel_idx < 0) {
 		MiniAudio_ErrorSetCode(MA_INVALID_ARGS);
 		return false;
 	}
 
-	if (it->second.sound) {
-		altsound_ma_sound_uninit(it->second.sound);
-		delete it->second.sound;
-	}
+	channel_idx = static_cast<unsigned int>(slot->channel_idx);
+	MiniAudio_ErrorSetCode(MA_SUCCESS);
+	return true;
+}
 
-	if (it->second.decoder) {
-		altsound_ma_decoder_uninit(it->second.decoder);
-		delete it->second.decoder;
+bool MiniAudio_StreamFree(AltSoundContext& ctx, unsigned int hstream)
+{
+	StreamSlot* slot = MiniAudio_StreamSlot(ctx, hstream);
+	if (!slot) {
+		MiniAudio_ErrorSetCode(MA_INVALID_ARGS);
+		return false;
 	}
 
-	g_streamMap.erase(it);
+	ctx.trace.instant("StreamFree", "hstream", hstream);
 
-	for (int i = 0; i < ALT_MAX_CHANNELS; ++i) {
-		if (channel_stream[i] && channel_stream[i]->hstream == hstream) {
-			delete channel_stream[i];
-			channel_stream[i] = nullptr;
-			break;
-		}
+	// clears the voice first, so the end callback is done with the slot
+	// before its handle is retired
+	ctx.mixer.clearVoice(hstream & STREAM_INDEX_MASK);
+	MiniAudio_StreamRelease(ctx, slot->data);
+
+	const int ch_idx = slot->channel_idx;
+	if (ch_idx >= 0 && ctx.channel_stream[ch_idx] && ctx.channel_stream[ch_idx]->hstream == hstream)
+		ctx.channel_stream.release(ch_idx);
+
+	MiniAudio_StreamRetire(ctx, *slot);
+
+	MiniAudio_ErrorSetCode(MA_SUCCESS);
+	return true;
+}
+
+bool MiniAudio_StreamFadeOut(AltSoundContext& ctx, unsigned int hstream, uint32_t fade_ms)
+{
+	StreamSlot* slot = MiniAudio_StreamSlot(ctx, hstream);
+	if (!slot) {
+		MiniAudio_ErrorSetCode(MA_INVALID_ARGS);
+		return false;
 	}
 
+	// the stream no longer belongs to its channel or fires its SYNCPROC
+	slot->channel_idx = -1;
+	slot->sync_callback.store(nullptr, std::memory_order_release);
+
+	const unsigned int voice = hstream & STREAM_INDEX_MASK;
+	const uint32_t frames = static_cast<uint32_t>(static_cast<uint64_t>(ctx.sample_rate) * fade_ms / 1000);
+	if (frames == 0 || !ctx.mixer.isPlaying(voice))
+		return MiniAudio_StreamFree(ctx, hstream);
+
+	ctx.trace.instant("StreamFadeOut", "hstream", hstream);
+	ctx.mixer.fadeOut(voice, frames);
+	ctx.streams.fading.push_back(hstream);
+
 	MiniAudio_ErrorSetCode(MA_SUCCESS);
 	return true;
 }
 
-unsigned int MiniAudio_ChannelIsActive(unsigned int hstream)
+unsigned int MiniAudio_ChannelIsActive(AltSoundContext& ctx, unsigned int hstream)
 {
 	if (hstream == MINIAUDIO_NO_STREAM) {
 		MiniAudio_ErrorSetCode(MA_INVALID_ARGS);
 		return MINIAUDIO_ACTIVE_STOPPED;
 	}
 
-	std::lock_guard<std::mutex> lock(g_streamMapMutex);
-	auto it = g_streamMap.find(hstream);
-	if (it != g_streamMap.end()) {
-		const _internal_stream_data& internal = it->second;
-		if (internal.paused) {
-			MiniAudio_ErrorSetCode(MA_SUCCESS);
-			return MINIAUDIO_ACTIVE_PAUSED;
-		}
-		else if (internal.playing) {
-			MiniAudio_ErrorSetCode(MA_SUCCESS);
-			return MINIAUDIO_ACTIVE_PLAYING;
-		}
+	MiniAudio_ErrorSetCode(MA_SUCCESS);
+
+	const StreamSlot* slot = MiniAudio_StreamSlot(ctx, hstream);
+	if (!slot)
+		return MINIAUDIO_ACTIVE_STOPPED;
+
+	const unsigned int state = slot->state.load(std::memory_order_acquire);
+
+	// the slot may have been reused while reading its state
+	if (slot->hstream.load(std::memory_order_acquire) != hstream)
+		return MINIAUDIO_ACTIVE_STOPPED;
+
+	return state;
+}
+
+void MiniAudio_StreamFreeAll(AltSoundContext& ctx)
+{
+	ctx.streams.fading.clear();
+	for (unsigned int i = 0; i < ctx.streams.slot_count; ++i) {
+		StreamSlot& slot = ctx.streams.slots[i];
+		if (slot.hstream.load(std::memory_order_acquire) == MINIAUDIO_NO_STREAM)
+			continue;
+
+		ctx.mixer.clearVoice(i);
+		MiniAudio_StreamRelease(ctx, slot.data);
+		MiniAudio_StreamRetire(ctx, slot);
 	}
+}
 
-	MiniAudio_ErrorSetCode(MA_SUCCESS);
-	return MINIAUDIO_ACTIVE_STOPPED;
+void MiniAudio_SetStreamStartTime(AltSoundContext& ctx, uint64_t start_frame)
+{
+	ctx.streams.start_frame = start_frame;
+}
+
+void MiniAudio_VoicePoolInit(AltSoundContext& ctx, unsigned int voices)
+{
+	ctx.streams.decoder_pool.reserve(voices);
+
+	// Slots keep their generation across re-init, so handles from a previous
+	// session stay stale. They are only reallocated when the count changes
+	const unsigned int slot_count = voices < STREAM_MAX_SLOTS ? voices : STREAM_MAX_SLOTS;
+	if (slot_count != ctx.streams.slot_count) {
+		ctx.streams.slots.reset(new StreamSlot[slot_count]);
+		ctx.streams.slot_count = slot_count;
+		for (unsigned int i = 0; i < slot_count; ++i)
+			ctx.streams.slots[i].generation = 1;
+	}
+
+	ctx.mixer.init(ctx.channels, slot_count, MiniAudio_VoiceEndCallback, &ctx);
+	ctx.streams.fading.clear();
+	ctx.streams.fading.reserve(slot_count);
+
+	{
+		std::lock_guard<std::mutex> lock(ctx.streams.free_slots_mutex);
+		ctx.streams.free_slots.clear();
+		ctx.streams.free_slots.reserve(slot_count);
+		for (unsigned int i = slot_count; i > 0; --i)
+			ctx.streams.free_slots.push_back(i - 1);
+		ctx.streams.slot_misses = 0;
+	}
+}
+
+uint64_t MiniAudio_VoicePoolHeapAllocs(AltSoundContext& ctx)
+{
+	return ctx.streams.decoder_pool.getHeapAllocCount();
+}
+
+uint64_t MiniAudio_StreamSlotMisses(AltSoundContext& ctx)
+{
+	std::lock_guard<std::mutex> lock(ctx.streams.free_slots_mutex);
+	return ctx.streams.slot_misses;
 }
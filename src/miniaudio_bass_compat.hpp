@@ -7,11 +7,16 @@
 // ---------------------------------------------------------------------------
 #pragma once
 
+#include <atomic>
 #include <cstdint>
+#include <memory>
 #include <vector>
 #include <mutex>
 #include <string>
 #include "altsound_data.hpp"
+#include "altsound_lockfree.hpp"
+#include "altsound_object_pool.hpp"
+#include "altsound_sample_cache.hpp"
 
 #define MINIAUDIO_SYNC_END 2
 #define MINIAUDIO_SYNC_ONETIME 0x80000000
@@ -20,41 +25,77 @@
 #define MINIAUDIO_ACTIVE_PLAYING 1
 #define MINIAUDIO_ACTIVE_PAUSED 3
 
+// Capacity of the end-of-stream queue. Only streams with a sync set are
+// queued, each at most once per play, so this only needs to exceed the
+// number of concurrent streams
+#define MINIAUDIO_ENDED_QUEUE_SIZE 256
+
 struct ma_decoder;
-struct ma_sound;
+struct AltSoundContext;
+class ReadAheadStream;
 typedef void (ALTSOUNDCALLBACK *SYNCPROC)(unsigned int hsync, unsigned int hstream, unsigned int data, void *user);
 
 struct _internal_stream_data {
-	ma_decoder* decoder = nullptr;
-	ma_sound* sound = nullptr;
-	bool playing = false;
-	bool paused = false;
+	ma_decoder* decoder = nullptr;     // set when the sample is streamed from its file
+	ReadAheadStream* read_ahead = nullptr; // set when a long sample is decoded ahead
+	CachedSamplePtr cached;            // keeps cached PCM alive while playing
 	bool looping = false;
-	uint32_t sample_rate = 44100;
-	uint32_t channels = 2;
+	uint32_t channels = 2;             // 1 or the output channel count
 	float volume = 1.0f;
-	SYNCPROC sync_callback = nullptr;
-	void* sync_userdata = nullptr;
-	unsigned int hsync = 0;
+	uint64_t start_frame = 0;          // mixer frame of a scheduled first start, 0 to start at once
 };
 
-// An ended (non-looping) stream queued by the miniAudio end callback (audio
-// thread) to have its SYNCPROC fired from a safe point (the engine's onProcess,
-// after the read), since the SYNCPROC frees the sound, which must not happen
-// from within the end callback
+// An ended (non-looping) stream queued by the mixer's end callback (audio
+// thread) to have its SYNCPROC fired by the housekeeping thread, since the
+// SYNCPROC takes io_mutex and frees the sound, neither of which may happen on
+// the audio thread
 struct EndedStream {
-	SYNCPROC callback;
-	unsigned int hsync;
-	unsigned int hstream;
-	void* userdata;
+	SYNCPROC callback = nullptr;
+	unsigned int hsync = 0;
+	unsigned int hstream = 0;
+	void* userdata = nullptr;
+	uint64_t queued_ns = 0;
+};
+
+typedef AltsoundMPSCRing<EndedStream, MINIAUDIO_ENDED_QUEUE_SIZE> EndedStreamQueue;
+
+// A stream handle's slot.  Only the handle, playback state and end sync are
+// shared with the audio thread.  sync_userdata and hsync are written before
+// sync_callback is published, and only read after it is loaded
+struct alignas(64) StreamSlot {
+	std::atomic<unsigned int> hstream{ MINIAUDIO_NO_STREAM }; // current handle, NO_STREAM when free
+	std::atomic<unsigned int> state{ MINIAUDIO_ACTIVE_STOPPED };
+	std::atomic<SYNCPROC> sync_callback{ nullptr };
+	void* sync_userdata = nullptr;
+	unsigned int hsync = 0;
+	uint32_t generation = 0;
+	int channel_idx = -1; // owning channel_stream[] entry, if any
+	_internal_stream_data data;
 };
 
-extern std::vector<EndedStream> g_endedStreams;
-extern std::mutex g_endedMutex;
+// Streams of one context
+struct MiniAudioStreamState {
+	// decoders of streamed samples, recycled instead of allocated per trigger
+	AltsoundObjectPool<ma_decoder> decoder_pool;
+
+	std::unique_ptr<StreamSlot[]> slots;
+	unsigned int slot_count = 0;
+	std::vector<unsigned int> free_slots;
+	std::mutex free_slots_mutex;
+	uint64_t slot_misses = 0;
 
-extern uint32_t g_sampleRate;
-extern uint32_t g_channels;
-extern int g_last_ma_err;
+	// start frame given to new streams, set by the command being processed
+	uint64_t start_frame = 0;
+
+	// stolen streams fading out, oldest first.  Their slots are freed on the
+	// command path once the mixer has silenced them
+	std::vector<unsigned int> fading;
+
+	unsigned int next_sync = 1;
+};
+
+// Like BASS, the error code is kept per thread
+extern thread_local int g_last_ma_err;
 
 inline int MiniAudio_ErrorGetCode()
 {
@@ -66,12 +107,38 @@ inline void MiniAudio_ErrorSetCode(int ma_err)
 	g_last_ma_err = ma_err;
 }
 
-unsigned int MiniAudio_StreamCreateFile(bool mem, const std::string& file, unsigned long long length, bool loop);
-bool MiniAudio_ChannelSetVolume(unsigned int hstream, float value);
-bool MiniAudio_ChannelGetVolume(unsigned int hstream, float& value);
-unsigned int MiniAudio_ChannelSetSync(unsigned int hstream, unsigned int type, void* proc, void* user);
-bool MiniAudio_ChannelPlay(unsigned int hstream, bool restart);
-bool MiniAudio_ChannelPause(unsigned int hstream);
-bool MiniAudio_ChannelStop(unsigned int hstream);
-unsigned int MiniAudio_ChannelIsActive(unsigned int hstream);
-bool MiniAudio_StreamFree(unsigned int hstream);
+// Calls taking a context operate on that context's streams
+std::string MiniAudio_SampleKey(bool mem, const void* file, unsigned long long length);
+CachedSamplePtr MiniAudio_SampleDecode(AltSoundContext& ctx, bool mem, const void* file, unsigned long long length);
+unsigned int MiniAudio_StreamCreateFile(AltSoundContext& ctx, bool mem, const void* file, unsigned long long length, bool loop);
+bool MiniAudio_ChannelSetVolume(AltSoundContext& ctx, unsigned int hstream, float value);
+bool MiniAudio_ChannelGetVolume(AltSoundContext& ctx, unsigned int hstream, float& value);
+unsigned int MiniAudio_ChannelSetSync(AltSoundContext& ctx, unsigned int hstream, unsigned int type, void* proc, void* user);
+bool MiniAudio_ChannelPlay(AltSoundContext& ctx, unsigned int hstream, bool restart);
+bool MiniAudio_ChannelPause(AltSoundContext& ctx, unsigned int hstream);
+bool MiniAudio_ChannelStop(AltSoundContext& ctx, unsigned int hstream);
+unsigned int MiniAudio_ChannelIsActive(AltSoundContext& ctx, unsigned int hstream);
+bool MiniAudio_StreamSetChannel(AltSoundContext& ctx, unsigned int hstream, unsigned int channel_idx);
+
+// Get the channel_stream[] entry a stream was assigned to.  Returns false
+// for stale handles and streams without a channel
+bool MiniAudio_StreamGetChannel(AltSoundContext& ctx, unsigned int hstream, unsigned int& channel_idx);
+
+bool MiniAudio_StreamFree(AltSoundContext& ctx, unsigned int hstream);
+
+// Fade a stream out over fade_ms and free it once silent. Its channel and
+// SYNCPROC are detached at once. Streams that are not playing are freed now
+bool MiniAudio_StreamFadeOut(AltSoundContext& ctx, unsigned int hstream, uint32_t fade_ms);
+void MiniAudio_StreamFreeAll(AltSoundContext& ctx);
+
+// Mixer frame at which streams created from now on first start, or 0 to
+// start them as soon as they are played.  Resuming a paused stream is never
+// delayed
+void MiniAudio_SetStreamStartTime(AltSoundContext& ctx, uint64_t start_frame);
+
+// Preallocate per-voice objects and mixer voices for the provided number of
+// concurrent streams, and report how often they had to come from the heap
+// instead
+void MiniAudio_VoicePoolInit(AltSoundContext& ctx, unsigned int voices);
+uint64_t MiniAudio_VoicePoolHeapAllocs(AltSoundContext& ctx);
+uint64_t MiniAudio_StreamSlotMisses(AltSoundContext& ctx);
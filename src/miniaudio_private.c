@@ -47,28 +47,59 @@ ma_decoder_config altsound_ma_decoder_config_init(ma_format outputFormat, ma_uin
     return ma_decoder_config_init(outputFormat, outputChannels, outputSampleRate);
 }
 
-ma_result altsound_ma_engine_init_null_device(ma_uint32 channels, ma_uint32 sampleRate, ma_uint32 periodSizeInFrames,
-    ma_engine_process_proc onProcess, void* pProcessUserData, ma_context* pContext, ma_engine* pEngine)
+ma_result altsound_ma_resample_linear_f32(ma_uint32 channels, ma_uint32 sampleRateIn, ma_uint32 sampleRateOut,
+    const float* pFramesIn, ma_uint64 frameCountIn, float* pFramesOut, ma_uint64* pFrameCountOut)
+{
+    // The linear resampler (with its low-pass filter) decoders use, run once
+    // over a whole buffer. *pFrameCountOut holds the output capacity on input
+    // and the frames written on return
+    ma_linear_resampler_config config = ma_linear_resampler_config_init(ma_format_f32, channels, sampleRateIn, sampleRateOut);
+    ma_linear_resampler resampler;
+    ma_result result = ma_linear_resampler_init(&config, NULL, &resampler);
+    if (result != MA_SUCCESS)
+        return result;
+
+    result = ma_linear_resampler_process_pcm_frames(&resampler, pFramesIn, &frameCountIn, pFramesOut, pFrameCountOut);
+    ma_linear_resampler_uninit(&resampler, NULL);
+    return result;
+}
+
+ma_result altsound_ma_audio_buffer_init(ma_format format, ma_uint32 channels, ma_uint32 sampleRate, ma_uint64 frameCount, const void* pFrames, ma_audio_buffer* pBuffer)
+{
+    // The buffer references pFrames directly; no copy is made
+    ma_audio_buffer_config config = ma_audio_buffer_config_init(format, channels, frameCount, pFrames, NULL);
+    config.sampleRate = sampleRate;
+    return ma_audio_buffer_init(&config, pBuffer);
+}
+
+void altsound_ma_audio_buffer_uninit(ma_audio_buffer* pBuffer)
+{
+    ma_audio_buffer_uninit(pBuffer);
+}
+
+ma_result altsound_ma_device_init_null(ma_uint32 channels, ma_uint32 sampleRate, ma_uint32 periodSizeInFrames,
+    ma_device_data_proc dataCallback, void* pUserData, ma_context* pContext, ma_device* pDevice)
 {
     // A null device gives us miniAudio's own realtime-paced audio thread (timing,
-    // throttling and buffering) without ever touching the hardware. The mixed
-    // output is delivered through onProcess and forwarded to the host.
+    // throttling and buffering) without ever touching the hardware. The data
+    // callback mixes each period and forwards it to the host.
     ma_backend backends[] = { ma_backend_null };
     ma_context_config contextConfig = ma_context_config_init();
     ma_result result = ma_context_init(backends, 1, &contextConfig, pContext);
     if (result != MA_SUCCESS)
         return result;
 
-    ma_engine_config config = ma_engine_config_init();
-    config.pContext = pContext;
-    config.channels = channels;
+    ma_device_config config = ma_device_config_init(ma_device_type_playback);
+    config.playback.format = ma_format_f32;
+    config.playback.channels = channels;
     config.sampleRate = sampleRate;
     config.periodSizeInFrames = periodSizeInFrames;
-    config.onProcess = onProcess;
-    config.pProcessUserData = pProcessUserData;
-    config.noAutoStart = MA_TRUE;
+    config.dataCallback = dataCallback;
+    config.pUserData = pUserData;
+    config.noPreSilencedOutputBuffer = MA_TRUE; // the mixer clears the buffer
+    config.noClip = MA_TRUE;
 
-    result = ma_engine_init(&config, pEngine);
+    result = ma_device_init(pContext, &config, pDevice);
     if (result != MA_SUCCESS) {
         ma_context_uninit(pContext);
         return result;
@@ -76,9 +107,19 @@ ma_result altsound_ma_engine_init_null_device(ma_uint32 channels, ma_uint32 samp
     return MA_SUCCESS;
 }
 
-void altsound_ma_engine_uninit(ma_engine* pEngine)
+void altsound_ma_device_uninit(ma_device* pDevice)
 {
-    ma_engine_uninit(pEngine);
+    ma_device_uninit(pDevice);
+}
+
+ma_result altsound_ma_device_start(ma_device* pDevice)
+{
+    return ma_device_start(pDevice);
+}
+
+ma_result altsound_ma_device_stop(ma_device* pDevice)
+{
+    return ma_device_stop(pDevice);
 }
 
 void altsound_ma_context_uninit(ma_context* pContext)
@@ -86,19 +127,31 @@ void altsound_ma_context_uninit(ma_context* pContext)
     ma_context_uninit(pContext);
 }
 
-ma_result altsound_ma_engine_start(ma_engine* pEngine)
+ma_result altsound_ma_engine_init_no_device(ma_uint32 channels, ma_uint32 sampleRate, ma_engine* pEngine)
+{
+    // An engine without a device, read with altsound_ma_engine_read_pcm_frames().
+    // Only used as the reference the mixer is benchmarked against.
+    ma_engine_config config = ma_engine_config_init();
+    config.noDevice = MA_TRUE;
+    config.channels = channels;
+    config.sampleRate = sampleRate;
+
+    return ma_engine_init(&config, pEngine);
+}
+
+ma_result altsound_ma_engine_read_pcm_frames(ma_engine* pEngine, void* pFramesOut, ma_uint64 frameCount, ma_uint64* pFramesRead)
 {
-    return ma_engine_start(pEngine);
+    return ma_engine_read_pcm_frames(pEngine, pFramesOut, frameCount, pFramesRead);
 }
 
-ma_result altsound_ma_engine_stop(ma_engine* pEngine)
+void altsound_ma_engine_uninit(ma_engine* pEngine)
 {
-    return ma_engine_stop(pEngine);
+    ma_engine_uninit(pEngine);
 }
 
-ma_result altsound_ma_sound_init_from_decoder(ma_engine* pEngine, ma_decoder* pDecoder, ma_uint32 flags, ma_sound* pSound)
+ma_result altsound_ma_sound_init_from_audio_buffer(ma_engine* pEngine, ma_audio_buffer* pBuffer, ma_uint32 flags, ma_sound* pSound)
 {
-    return ma_sound_init_from_data_source(pEngine, (ma_data_source*)pDecoder, flags, NULL, pSound);
+    return ma_sound_init_from_data_source(pEngine, (ma_data_source*)pBuffer, flags, NULL, pSound);
 }
 
 void altsound_ma_sound_uninit(ma_sound* pSound)
@@ -111,11 +164,6 @@ ma_result altsound_ma_sound_start(ma_sound* pSound)
     return ma_sound_start(pSound);
 }
 
-ma_result altsound_ma_sound_stop(ma_sound* pSound)
-{
-    return ma_sound_stop(pSound);
-}
-
 void altsound_ma_sound_set_volume(ma_sound* pSound, float volume)
 {
     ma_sound_set_volume(pSound, volume);
@@ -125,13 +173,3 @@ void altsound_ma_sound_set_looping(ma_sound* pSound, ma_bool32 loop)
 {
     ma_sound_set_looping(pSound, loop);
 }
-
-ma_result altsound_ma_sound_seek_to_pcm_frame(ma_sound* pSound, ma_uint64 frameIndex)
-{
-    return ma_sound_seek_to_pcm_frame(pSound, frameIndex);
-}
-
-void altsound_ma_sound_set_end_callback(ma_sound* pSound, ma_sound_end_proc callback, void* pUserData)
-{
-    ma_sound_set_end_callback(pSound, callback, pUserData);
-}
@@ -14,21 +14,28 @@ ma_result altsound_ma_decoder_get_length_in_pcm_frames(ma_decoder* pDecoder, ma_
 void altsound_ma_decoder_uninit(ma_decoder* pDecoder);
 ma_decoder_config altsound_ma_decoder_config_init(ma_format outputFormat, ma_uint32 outputChannels, ma_uint32 outputSampleRate);
 
-ma_result altsound_ma_engine_init_null_device(ma_uint32 channels, ma_uint32 sampleRate, ma_uint32 periodSizeInFrames,
-    ma_engine_process_proc onProcess, void* pProcessUserData, ma_context* pContext, ma_engine* pEngine);
-void altsound_ma_engine_uninit(ma_engine* pEngine);
+ma_result altsound_ma_resample_linear_f32(ma_uint32 channels, ma_uint32 sampleRateIn, ma_uint32 sampleRateOut,
+    const float* pFramesIn, ma_uint64 frameCountIn, float* pFramesOut, ma_uint64* pFrameCountOut);
+
+ma_result altsound_ma_audio_buffer_init(ma_format format, ma_uint32 channels, ma_uint32 sampleRate, ma_uint64 frameCount, const void* pFrames, ma_audio_buffer* pBuffer);
+void altsound_ma_audio_buffer_uninit(ma_audio_buffer* pBuffer);
+
+ma_result altsound_ma_device_init_null(ma_uint32 channels, ma_uint32 sampleRate, ma_uint32 periodSizeInFrames,
+    ma_device_data_proc dataCallback, void* pUserData, ma_context* pContext, ma_device* pDevice);
+void altsound_ma_device_uninit(ma_device* pDevice);
+ma_result altsound_ma_device_start(ma_device* pDevice);
+ma_result altsound_ma_device_stop(ma_device* pDevice);
 void altsound_ma_context_uninit(ma_context* pContext);
-ma_result altsound_ma_engine_start(ma_engine* pEngine);
-ma_result altsound_ma_engine_stop(ma_engine* pEngine);
 
-ma_result altsound_ma_sound_init_from_decoder(ma_engine* pEngine, ma_decoder* pDecoder, ma_uint32 flags, ma_sound* pSound);
+// ma_engine playback, kept as the benchmark reference for the mixer
+ma_result altsound_ma_engine_init_no_device(ma_uint32 channels, ma_uint32 sampleRate, ma_engine* pEngine);
+ma_result altsound_ma_engine_read_pcm_frames(ma_engine* pEngine, void* pFramesOut, ma_uint64 frameCount, ma_uint64* pFramesRead);
+void altsound_ma_engine_uninit(ma_engine* pEngine);
+ma_result altsound_ma_sound_init_from_audio_buffer(ma_engine* pEngine, ma_audio_buffer* pBuffer, ma_uint32 flags, ma_sound* pSound);
 void altsound_ma_sound_uninit(ma_sound* pSound);
 ma_result altsound_ma_sound_start(ma_sound* pSound);
-ma_result altsound_ma_sound_stop(ma_sound* pSound);
 void altsound_ma_sound_set_volume(ma_sound* pSound, float volume);
 void altsound_ma_sound_set_looping(ma_sound* pSound, ma_bool32 loop);
-ma_result altsound_ma_sound_seek_to_pcm_frame(ma_sound* pSound, ma_uint64 frameIndex);
-void altsound_ma_sound_set_end_callback(ma_sound* pSound, ma_sound_end_proc callback, void* pUserData);
 
 #ifdef __cplusplus
 }
@@ -22,6 +22,11 @@
 // 2. set logging level to DEBUG
 // 3. recreate the problem
 // 4. send the problem description, along with the altsound.log and cmdlog.txt
+//
+// With --render <file.wav>, the command file is rendered offline instead:
+// commands are injected at their exact frame positions on a virtual clock
+// and the mix is written to a WAV file as fast as the CPU allows.  No sound
+// card is needed, so this can run on build machines.
 // ---------------------------------------------------------------------------
 // license:<TODO>
 // ---------------------------------------------------------------------------
@@ -70,97 +75,20 @@ struct InitData {
 static ma_device g_device;
 static ma_device_config g_deviceConfig;
 
-#include <mutex>
-#include <queue>
-#include <vector>
-
-struct AltsoundAudioBuffer {
-	std::vector<float> data;
-	size_t frameCount;
-	uint32_t sampleRate;
-	uint32_t channels;
-};
-
-static std::queue<AltsoundAudioBuffer> g_audioQueue;
-static std::mutex g_audioQueueMutex;
-static const size_t MAX_QUEUE_SIZE = 10;
+// Offline render settings
+static const uint32_t RENDER_SAMPLE_RATE = 44100;
+static const uint32_t RENDER_CHANNELS = 2;
+static const uint32_t RENDER_BLOCK_FRAMES = 1024;
+static const unsigned int TAIL_MSEC = 5000;
 
+// The device callback pulls mixed output straight from AltSound, so there is
+// a single clock and no intermediate buffer queue
 void data_callback(ma_device* pDevice, void* pOutput, const void* pInput, ma_uint32 frameCount)
 {
 	(void)pDevice;
 	(void)pInput;
 
-	float* output = (float*)pOutput;
-	const uint32_t channels = pDevice->playback.channels;
-	static uint32_t underrun_count = 0;
-
-	std::unique_lock<std::mutex> lock(g_audioQueueMutex);
-
-	if (g_audioQueue.empty()) {
-		++underrun_count;
-		if (underrun_count == 1 || (underrun_count % 100) == 0) {
-			std::cout << "Audio queue underrun (count=" << std::dec << underrun_count << ")" << std::endl;
-		}
-		memset(output, 0, frameCount * channels * sizeof(float));
-		return;
-	}
-
-	size_t outIndex = 0;
-	size_t framesRemaining = frameCount;
-
-	while (framesRemaining > 0 && !g_audioQueue.empty()) {
-		AltsoundAudioBuffer& buffer = g_audioQueue.front();
-
-		if (buffer.data.empty()) {
-			g_audioQueue.pop();
-			continue;
-		}
-
-		const size_t bufferFrames = buffer.data.size() / channels;
-		const size_t framesToCopy = std::min(framesRemaining, bufferFrames);
-		const size_t samplesToCopy = framesToCopy * channels;
-
-		memcpy(&output[outIndex], buffer.data.data(), samplesToCopy * sizeof(float));
-
-		outIndex += samplesToCopy;
-		framesRemaining -= framesToCopy;
-
-		if (framesToCopy >= bufferFrames) {
-			g_audioQueue.pop();
-		} else {
-			buffer.data.erase(buffer.data.begin(), buffer.data.begin() + samplesToCopy);
-		}
-	}
-
-	if (framesRemaining > 0) {
-		memset(&output[outIndex], 0, framesRemaining * channels * sizeof(float));
-	}
-}
-
-void audio_callback_bridge(const float* samples, size_t frameCount, uint32_t sampleRate, uint32_t channels, void* userData)
-{
-	(void)userData;
-
-	if (!samples || frameCount == 0 || channels == 0)
-		return;
-
-	std::lock_guard<std::mutex> lock(g_audioQueueMutex);
-
-	if (g_audioQueue.size() >= MAX_QUEUE_SIZE) {
-		std::cout << "Audio queue full; dropping buffer" << std::endl;
-		return;
-	}
-
-	AltsoundAudioBuffer buffer;
-	buffer.frameCount = frameCount;
-	buffer.sampleRate = sampleRate;
-	buffer.channels = channels;
-
-	const size_t totalSamples = frameCount * channels;
-	buffer.data.reserve(totalSamples);
-	buffer.data.assign(samples, samples + totalSamples);
-
-	g_audioQueue.emplace(std::move(buffer));
+	AltSoundRender(static_cast<float*>(pOutput), frameCount);
 }
 
 // ----------------------------------------------------------------------------
@@ -193,9 +121,91 @@ bool playbackCommands(const std::vector<TestData>& test_data)
 			std::this_thread::sleep_for(std::chrono::milliseconds(td.msec));
 		else {
 			// Sleep for 5 seconds before exiting
-			std::this_thread::sleep_for(std::chrono::milliseconds(5000));
+			std::this_thread::sleep_for(std::chrono::milliseconds(TAIL_MSEC));
+		}
+	}
+	return true;
+}
+
+// ----------------------------------------------------------------------------
+// Print the pipeline latency histograms as count/mean/max per stage, plus the
+// upper bound of the bucket holding the 99th percentile
+// ----------------------------------------------------------------------------
+
+void printStats()
+{
+	static const char* const stage_names[ALTSOUND_STAGE_COUNT] = {
+		"command", "queue wait", "preprocess", "mutex wait",
+		"get sample", "stream create", "adjust volumes", "syncproc delay"
+	};
+
+	AltSoundStats stats;
+	AltSoundGetStats(stats);
+
+	std::cout << "Stage latencies (usec):" << std::endl;
+	for (int i = 0; i < ALTSOUND_STAGE_COUNT; ++i) {
+		const AltSoundStageStats& st = stats.stages[i];
+		if (st.count == 0)
+			continue;
+
+		uint64_t seen = 0;
+		int p99_bucket = 0;
+		while (p99_bucket < ALTSOUND_STATS_BUCKETS - 1 && (seen += st.buckets[p99_bucket]) * 100 < st.count * 99)
+			++p99_bucket;
+
+		std::cout << std::dec << "  " << stage_names[i] << ": count " << st.count
+			<< ", mean " << st.total_ns / st.count / 1000.0
+			<< ", p99 < " << (2ull << p99_bucket) / 1000.0
+			<< ", max " << st.max_ns / 1000.0 << std::endl;
+	}
+}
+
+// ----------------------------------------------------------------------------
+// Offline renderer.  Mirrors playbackCommands(), but advances a virtual clock
+// by rendering frames instead of sleeping
+// ----------------------------------------------------------------------------
+
+bool renderCommands(const std::vector<TestData>& test_data, const string& wav_path)
+{
+	ma_encoder_config config = ma_encoder_config_init(ma_encoding_format_wav, ma_format_f32,
+	                                                  RENDER_CHANNELS, RENDER_SAMPLE_RATE);
+	ma_encoder encoder;
+	if (ma_encoder_init_file(wav_path.c_str(), &config, &encoder) != MA_SUCCESS) {
+		std::cout << "Unable to create WAV file: " << wav_path << std::endl;
+		return false;
+	}
+
+	std::vector<float> block(RENDER_BLOCK_FRAMES * RENDER_CHANNELS);
+	uint64_t frame_pos = 0;
+	uint64_t elapsed_msec = 0;
+
+	const auto start = std::chrono::steady_clock::now();
+
+	for (size_t i = 0; i < test_data.size(); ++i) {
+		const TestData& td = test_data[i];
+		if (!AltSoundProcessCommand(td.snd_cmd, 0))
+			std::cout << "Command playback failed" << std::endl;
+
+		// render up to the next command, from the total elapsed time so
+		// rounding does not accumulate
+		elapsed_msec += (i < test_data.size() - 1) ? td.msec : TAIL_MSEC;
+		const uint64_t next_frame = elapsed_msec * RENDER_SAMPLE_RATE / 1000;
+
+		while (frame_pos < next_frame) {
+			const size_t frames = static_cast<size_t>(std::min<uint64_t>(RENDER_BLOCK_FRAMES, next_frame - frame_pos));
+			AltSoundRender(block.data(), frames);
+			ma_encoder_write_pcm_frames(&encoder, block.data(), frames, NULL);
+			frame_pos += frames;
 		}
 	}
+
+	ma_encoder_uninit(&encoder);
+
+	const double wall_sec = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	const double audio_sec = static_cast<double>(frame_pos) / RENDER_SAMPLE_RATE;
+	std::cout << "Rendered " << std::fixed << std::setprecision(1) << audio_sec << " s of audio in "
+		<< std::setprecision(3) << wall_sec << " s (" << std::setprecision(1)
+		<< (wall_sec > 0.0 ? audio_sec / wall_sec : 0.0) << "x realtime) to " << wav_path << std::endl;
 	return true;
 }
 
@@ -306,7 +316,7 @@ bool parseCmdFile(InitData& init_data)
 
 // ---------------------------------------------------------------------------
 
-std::pair<bool, InitData> init(const string& log_path)
+std::pair<bool, InitData> init(const string& log_path, bool offline)
 {
 	std::cout << "BEGIN init()" << std::endl;
 
@@ -321,6 +331,19 @@ std::pair<bool, InitData> init(const string& log_path)
 		std::cout << "Num commands parsed: " << init_data.test_data.size()
 			<< " (expanded from " << init_data.combined_commands << " combined)" << std::endl;
 
+		if (offline) {
+			AltSoundSetRenderMode(ALTSOUND_RENDER_MODE_OFFLINE);
+			if (!AltSoundInit(init_data.vpm_path, init_data.game_name,
+			                  RENDER_SAMPLE_RATE, RENDER_CHANNELS, RENDER_BLOCK_FRAMES)) {
+				std::cout << "AltSoundInit failed." << std::endl;
+				throw std::runtime_error("AltSoundInit failed");
+			}
+			AltSoundSetHardwareGen(init_data.hardware_gen);
+
+			std::cout << "END init()" << std::endl;
+			return std::make_pair(true, init_data);
+		}
+
         g_deviceConfig = ma_device_config_init(ma_device_type_playback);
         g_deviceConfig.playback.format = ma_format_f32;
         g_deviceConfig.playback.channels = 2;
@@ -337,6 +360,7 @@ std::pair<bool, InitData> init(const string& log_path)
 
         const uint32_t bufferSize = g_device.playback.internalPeriodSizeInFrames;
 
+		AltSoundSetRenderMode(ALTSOUND_RENDER_MODE_PULL);
 		const bool init_ok = AltSoundInit(init_data.vpm_path, init_data.game_name,
 										  g_device.sampleRate, g_device.playback.channels, bufferSize);
 		if (!init_ok) {
@@ -352,8 +376,6 @@ std::pair<bool, InitData> init(const string& log_path)
             throw std::runtime_error("Failed to start miniaudio device");
         }
 
-        AltSoundSetAudioCallback(audio_callback_bridge, nullptr);
-
         std::this_thread::sleep_for(std::chrono::milliseconds(100));
 
 		std::cout << "END init()" << std::endl;
@@ -371,16 +393,29 @@ std::pair<bool, InitData> init(const string& log_path)
 // ---------------------------------------------------------------------------
 
 int main(int argc, const char* argv[]) {
-	if (argc < 2) {
-		std::cout << "Usage: " << argv[0] << " <gamename>-cmdlog.txt path" << std::endl;
+	string render_path;
+	if (argc == 4 && string(argv[2]) == "--render")
+		render_path = argv[3];
+
+	if (argc != 2 && render_path.empty()) {
+		std::cout << "Usage: " << argv[0] << " <gamename>-cmdlog.txt path [--render <file.wav>]" << std::endl;
 		std::cout << "Where <gamename>-cmdlog.txt path is the full path and "
 				<< "filename of recording file" << std::endl;
+		std::cout << "With --render, the mix is rendered offline to <file.wav> "
+				<< "instead of played in realtime" << std::endl;
 		return 1;
 	}
 
 	AltSoundSetLogger("./", ALTSOUND_LOG_LEVEL_DEBUG, true);
 
-	const auto init_result = init(argv[1]);
+	const bool offline = !render_path.empty();
+	const auto init_result = init(argv[1], offline);
+
+	if (init_result.first && offline) {
+		const bool rendered = renderCommands(init_result.second.test_data, render_path);
+		AltSoundShutdown();
+		return rendered ? 0 : 1;
+	}
 
 	if (!init_result.first) {
 		std::cout << "Initialization failed." << std::endl;
@@ -399,6 +434,7 @@ int main(int argc, const char* argv[]) {
 			return 1;
 		}
 		std::cout << "Playback finished for \"" << init_result.second.altsound_path << "\"..." << std::endl;
+		printStats();
 	}
 	catch (const std::exception& e) {
 		std::cout << "Unexpected error during playback:" << e.what()  << std::endl;